@@ -11,6 +11,7 @@
 #define JPEG_INTERNALS
 #include "jinclude.h"
 #include "jpeglib.h"
+#include "jsimd.h"
 
 
 /* Private subobject */
@@ -401,6 +402,10 @@ jinit_color_converter (j_compress_ptr cinfo)
     else if (cinfo->in_color_space == JCS_RGB) {
       cconvert->pub.start_pass = rgb_ycc_start;
       cconvert->pub.color_convert = rgb_gray_convert;
+#ifdef SIMD_SUPPORTED
+      if (jsimd_can_rgb_ycc())
+	cconvert->pub.color_convert = jsimd_rgb_gray_convert;
+#endif
     } else if (cinfo->in_color_space == JCS_YCbCr)
       cconvert->pub.color_convert = grayscale_convert;
     else
@@ -422,6 +427,10 @@ jinit_color_converter (j_compress_ptr cinfo)
     if (cinfo->in_color_space == JCS_RGB) {
       cconvert->pub.start_pass = rgb_ycc_start;
       cconvert->pub.color_convert = rgb_ycc_convert;
+#ifdef SIMD_SUPPORTED
+      if (jsimd_can_rgb_ycc())
+	cconvert->pub.color_convert = jsimd_rgb_ycc_convert;
+#endif
     } else if (cinfo->in_color_space == JCS_YCbCr)
       cconvert->pub.color_convert = null_convert;
     else
@@ -15,6 +15,7 @@
 #include "jinclude.h"
 #include "jpeglib.h"
 #include "jdct.h"		/* Private declarations for DCT subsystem */
+#include "jsimd.h"
 
 
 /* Private subobject for this module */
@@ -36,6 +37,17 @@ typedef struct {
   float_DCT_method_ptr do_float_dct;
   FAST_FLOAT * float_divisors[NUM_QUANT_TBLS];
 #endif
+
+#ifdef SIMD_SUPPORTED
+  /* The SIMD kernel that does the DCT and quantization, or NULL, and the
+   * divisors as the reciprocal tables it uses (see jsimd.c).  A table
+   * whose divisors don't suit the kernel is done by the C code instead.
+   */
+  JMETHOD(void, simd_dct, (JSAMPARRAY sample_data, JDIMENSION start_col,
+			   const UINT16 * divisors, JCOEFPTR coef_block));
+  UINT16 * simd_divisors[NUM_QUANT_TBLS];
+  boolean simd_ok[NUM_QUANT_TBLS];
+#endif
 } my_fdct_controller;
 
 typedef my_fdct_controller * my_fdct_ptr;
@@ -164,6 +176,18 @@ start_pass_fdctmgr (j_compress_ptr cinfo)
       ERREXIT(cinfo, JERR_NOT_COMPILED);
       break;
     }
+#ifdef SIMD_SUPPORTED
+    if (fdct->simd_dct != NULL) {
+      if (fdct->simd_divisors[qtblno] == NULL) {
+	fdct->simd_divisors[qtblno] = (UINT16 *)
+	  (*cinfo->mem->alloc_small) ((j_common_ptr) cinfo, JPOOL_IMAGE,
+				      JSIMD_DIVISORS_SIZE * SIZEOF(UINT16));
+      }
+      fdct->simd_ok[qtblno] =
+	jsimd_fdct_divisors(fdct->divisors[qtblno],
+			    fdct->simd_divisors[qtblno]);
+    }
+#endif
   }
 }
 
@@ -264,6 +288,35 @@ forward_DCT (j_compress_ptr cinfo, jpeg_component_info * compptr,
 }
 
 
+#ifdef SIMD_SUPPORTED
+
+METHODDEF(void)
+forward_DCT_simd (j_compress_ptr cinfo, jpeg_component_info * compptr,
+		  JSAMPARRAY sample_data, JBLOCKROW coef_blocks,
+		  JDIMENSION start_row, JDIMENSION start_col,
+		  JDIMENSION num_blocks)
+/* This version is used for the SIMD integer DCT kernels. */
+{
+  my_fdct_ptr fdct = (my_fdct_ptr) cinfo->fdct;
+  int qtblno = compptr->quant_tbl_no;
+  const UINT16 * divisors = fdct->simd_divisors[qtblno];
+  JDIMENSION bi;
+
+  if (! fdct->simd_ok[qtblno]) {
+    forward_DCT(cinfo, compptr, sample_data, coef_blocks,
+		start_row, start_col, num_blocks);
+    return;
+  }
+
+  sample_data += start_row;	/* fold in the vertical offset once */
+
+  for (bi = 0; bi < num_blocks; bi++, start_col += DCTSIZE)
+    (*fdct->simd_dct) (sample_data, start_col, divisors, coef_blocks[bi]);
+}
+
+#endif /* SIMD_SUPPORTED */
+
+
 #ifdef DCT_FLOAT_SUPPORTED
 
 METHODDEF(void)
@@ -382,6 +435,25 @@ jinit_forward_dct (j_compress_ptr cinfo)
     fdct->divisors[i] = NULL;
 #ifdef DCT_FLOAT_SUPPORTED
     fdct->float_divisors[i] = NULL;
+#endif
+#ifdef SIMD_SUPPORTED
+    fdct->simd_divisors[i] = NULL;
+    fdct->simd_ok[i] = FALSE;
 #endif
   }
+
+#ifdef SIMD_SUPPORTED
+  /* Use the SIMD kernels for the integer DCTs if the CPU has them */
+  fdct->simd_dct = NULL;
+#ifdef DCT_ISLOW_SUPPORTED
+  if (cinfo->dct_method == JDCT_ISLOW && jsimd_can_fdct_islow())
+    fdct->simd_dct = jsimd_fdct_islow_block;
+#endif
+#ifdef DCT_IFAST_SUPPORTED
+  if (cinfo->dct_method == JDCT_IFAST && jsimd_can_fdct_ifast())
+    fdct->simd_dct = jsimd_fdct_ifast_block;
+#endif
+  if (fdct->simd_dct != NULL)
+    fdct->pub.forward_DCT = forward_DCT_simd;
+#endif
 }
@@ -168,6 +168,35 @@ start_pass_huff (j_compress_ptr cinfo, boolean gather_statistics)
 }
 
 
+/*
+ * Start a band of a sequential scan for parallel encoding (jcparal.c).
+ * The band begins at restart interval first_interval of the scan, so we
+ * must emit the RSTn marker that the serial encoder would have written
+ * before it, unless it is the first.  The derived tables are unchanged
+ * since start_pass.
+ */
+
+METHODDEF(void)
+start_band_huff (j_compress_ptr cinfo, long first_interval)
+{
+  huff_entropy_ptr entropy = (huff_entropy_ptr) cinfo->entropy;
+  int ci;
+
+  for (ci = 0; ci < cinfo->comps_in_scan; ci++)
+    entropy->saved.last_dc_val[ci] = 0;
+  entropy->saved.put_buffer = 0;
+  entropy->saved.put_bits = 0;
+
+  if (first_interval > 0) {
+    entropy->restarts_to_go = 0;	/* marker goes before first MCU */
+    entropy->next_restart_num = (int) ((first_interval - 1) & 7);
+  } else {
+    entropy->restarts_to_go = cinfo->restart_interval;
+    entropy->next_restart_num = 0;
+  }
+}
+
+
 /*
  * Compute the derived values for a Huffman table.
  * This routine also performs some validation checks on the table.
@@ -898,6 +927,7 @@ jinit_huff_encoder (j_compress_ptr cinfo)
 				SIZEOF(huff_entropy_encoder));
   cinfo->entropy = (struct jpeg_entropy_encoder *) entropy;
   entropy->pub.start_pass = start_pass_huff;
+  entropy->pub.start_band = start_band_huff;
 
   /* Mark tables unallocated */
   for (i = 0; i < NUM_HUFF_TBLS; i++) {
@@ -20,6 +20,29 @@
 #include "jpeglib.h"
 
 
+/*
+ * Determine whether the parallel coefficient controller (jcparal.c) can be
+ * used: the application must allow more than one thread, and we must be
+ * writing a single sequential Huffman-coded scan in one pass.
+ * This is called once the master control has checked the parameters.
+ */
+
+LOCAL(boolean)
+use_parallel_encoding (j_compress_ptr cinfo)
+{
+#ifdef C_THREADS_SUPPORTED
+  if (cinfo->num_threads == 1)
+    return FALSE;
+  if (cinfo->num_scans > 1 || cinfo->progressive_mode ||
+      cinfo->optimize_coding || cinfo->arith_code)
+    return FALSE;
+  return TRUE;
+#else
+  return FALSE;
+#endif
+}
+
+
 /*
  * Master selection of compression modules.
  * This is done once at the start of processing an image.  We determine
@@ -54,6 +77,14 @@ jinit_compress_master (j_compress_ptr cinfo)
       jinit_huff_encoder(cinfo);
   }
 
+#ifdef C_THREADS_SUPPORTED
+  if (use_parallel_encoding(cinfo)) {
+    /* The bands must begin at restart markers */
+    if (cinfo->restart_interval == 0 && cinfo->restart_in_rows <= 0)
+      cinfo->restart_in_rows = 1;
+    jinit_c_parallel_controller(cinfo);
+  } else
+#endif
   /* Need a full-image coefficient buffer in any multi-pass mode. */
   jinit_c_coef_controller(cinfo,
 		(boolean) (cinfo->num_scans > 1 || cinfo->optimize_coding));
@@ -0,0 +1,673 @@
+/*
+ * jcparal.c
+ *
+ * Copyright (C) 1994-1997, Thomas G. Lane.
+ * This file is part of the Independent JPEG Group's software.
+ * For conditions of distribution and use, see the accompanying README file.
+ *
+ * This file contains a coefficient controller for compression that
+ * encodes a single-scan sequential file on several threads.  It takes the
+ * place of jccoefct.c's single-pass controller when the application allows
+ * more than one thread (cinfo->num_threads).
+ *
+ * Each restart marker resets the entropy encoder's state (the bit buffer
+ * and the DC predictions), so the data following it can be encoded without
+ * reference to what came before.  We divide the image into bands of iMCU
+ * rows that each begin at a restart marker, and collect the downsampled
+ * input for a batch of bands.  When the batch is full, or the image ends,
+ * the calling thread and the workers take bands in turn, DCT them and
+ * entropy-encode them into a memory buffer per band.  All the threads are
+ * joined, and the buffers are then copied to the data destination in order
+ * (this may suspend).  A band's data begins with the RSTn marker that the
+ * serial encoder would have written there, and ends with the bit buffer
+ * padded out as the serial encoder pads it before the next marker, so the
+ * output is just what jccoefct.c would have produced.
+ *
+ * Each worker has a private copy of the compression object, with its own
+ * entropy encoder, data destination and error manager; the forward DCT is
+ * reentrant, and is shared.  A band buffer that fills up is replaced by a
+ * larger one from the memory manager, under a mutex.  Warnings issued while
+ * encoding a band are saved, and reissued on the calling thread in band
+ * order once all are done (trace messages are dropped).  An error is
+ * reissued the same way.
+ */
+
+#define JPEG_INTERNALS
+#include "jinclude.h"
+#include "jpeglib.h"
+
+#ifdef C_THREADS_SUPPORTED
+
+#include "jthread.h"
+#include <setjmp.h>
+
+
+/* We aim for this many bands per thread in a batch, to even out the load. */
+#define BANDS_PER_THREAD  4
+
+/* Warnings saved per band.  If there are more, the last saved one is
+ * reissued in their place, which at least keeps the count right.
+ */
+#define MAX_BAND_WARNINGS  4
+
+/* Smallest band buffer we allocate; they double in size as they fill. */
+#define MIN_BAND_BUFFER  16384
+
+
+typedef struct {		/* A saved warning or error message */
+  int msg_code;
+  union {
+    int i[8];
+    char s[JMSG_STR_PARM_MAX];
+  } msg_parm;
+} saved_message;
+
+typedef struct {		/* A band of iMCU rows */
+  JDIMENSION start_row;		/* first iMCU row in band */
+  JDIMENSION end_row;		/* iMCU row following band */
+  long first_interval;		/* index of first restart interval in band */
+  JOCTET * data;		/* the band's encoded data */
+  size_t data_len;
+  size_t data_size;		/* allocated size of data */
+  int num_warnings;		/* # of warnings issued while encoding it */
+  saved_message warnings[MAX_BAND_WARNINGS];
+  boolean failed;		/* encoding stopped with an error */
+  saved_message error;
+} band_info;
+
+struct my_parallel_controller;
+
+typedef struct {
+  /* Private copy of the compression object.  This must come first, as
+   * the error manager and destination methods find the worker from the
+   * cinfo pointer.
+   */
+  struct jpeg_compress_struct cinfo;
+  struct jpeg_error_mgr err;	/* collects warnings, traps errors */
+  struct jpeg_destination_mgr dest; /* writes to the band's buffer */
+
+  JBLOCKROW MCU_buffer[C_MAX_BLOCKS_IN_MCU];
+
+  struct my_parallel_controller * parent;
+  band_info * band;		/* band being encoded */
+  boolean locked;		/* we hold the parent's mutex */
+  jmp_buf setjmp_buffer;	/* for return from error_exit */
+  jthread_ptr thread;		/* NULL for the calling thread */
+} my_worker;
+
+typedef my_worker * my_worker_ptr;
+
+typedef struct my_parallel_controller {
+  struct jpeg_c_coef_controller pub; /* public fields */
+
+  /* Input sample buffers for a batch of bands */
+  JSAMPARRAY batch_buffer[MAX_COMPONENTS];
+
+  JDIMENSION iMCU_row_num;	/* iMCU row # within image */
+  JDIMENSION batch_start;	/* iMCU row at top of batch buffers */
+  JDIMENSION batch_rows;	/* # of iMCU rows in a full batch */
+  JDIMENSION rows_buffered;	/* # of iMCU rows now in batch buffers */
+  boolean row_saved;		/* current input row is in the buffers */
+
+  JDIMENSION MCUs_per_iMCU_row;	/* # of MCUs in a full iMCU row */
+  JDIMENSION band_rows;		/* # of iMCU rows in a full band */
+  int num_threads;		/* # of threads we may use */
+  my_worker_ptr workers;	/* num_threads of them */
+
+  band_info * bands;		/* enough for a full batch */
+  int num_bands;		/* # of bands in current batch */
+  boolean encoded;		/* TRUE when the bands await output */
+  int out_band;			/* next band to output */
+  size_t out_offset;		/* # of bytes of it already output */
+
+  int band_ctr;			/* next band to encode */
+  jmutex_ptr mutex;		/* guards band_ctr, stop and the memory
+				 * manager while encoding */
+  boolean stop;			/* an error occurred, take no more bands */
+} my_parallel_controller;
+
+typedef my_parallel_controller * my_parallel_ptr;
+
+
+LOCAL(long)
+gcd (long a, long b)
+{
+  long t;
+
+  while (b != 0) {
+    t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+
+/*
+ * Data destination methods for the workers.  The band buffer is replaced
+ * by one twice the size whenever it fills, so we never suspend.  As with
+ * any destination, the buffer is full when empty_output_buffer is called
+ * (the entropy encoder does not update free_in_buffer until the end of
+ * the MCU).
+ */
+
+METHODDEF(boolean)
+empty_band_buffer (j_compress_ptr cinfo)
+{
+  my_worker_ptr worker = (my_worker_ptr) cinfo;
+  my_parallel_ptr par = worker->parent;
+  band_info * band = worker->band;
+  size_t len = band->data_size;
+  size_t newsize;
+  JOCTET * newbuf;
+
+  newsize = MAX(band->data_size * 2, MIN_BAND_BUFFER);
+  if (par->mutex != NULL) {
+    jmutex_lock(par->mutex);
+    worker->locked = TRUE;
+  }
+  newbuf = (JOCTET *)
+    (*cinfo->mem->alloc_large) ((j_common_ptr) cinfo, JPOOL_IMAGE, newsize);
+  if (par->mutex != NULL) {
+    worker->locked = FALSE;
+    jmutex_unlock(par->mutex);
+  }
+  if (len > 0)
+    MEMCOPY(newbuf, band->data, len);
+  band->data = newbuf;
+  band->data_size = newsize;
+
+  worker->dest.next_output_byte = newbuf + len;
+  worker->dest.free_in_buffer = newsize - len;
+  return TRUE;
+}
+
+METHODDEF(void)
+null_band_method (j_compress_ptr cinfo)
+{
+  /* no work (never called, as the worker is never started or finished) */
+}
+
+
+/*
+ * Error manager methods for the workers.
+ */
+
+LOCAL(void)
+save_message (j_common_ptr cinfo, saved_message * msg)
+{
+  msg->msg_code = cinfo->err->msg_code;
+  MEMCOPY(&msg->msg_parm, &cinfo->err->msg_parm, SIZEOF(msg->msg_parm));
+}
+
+METHODDEF(void)
+worker_emit_message (j_common_ptr cinfo, int msg_level)
+{
+  band_info * band = ((my_worker_ptr) cinfo)->band;
+
+  if (msg_level >= 0)		/* trace messages are dropped */
+    return;
+  if (band->num_warnings < MAX_BAND_WARNINGS)
+    save_message(cinfo, &band->warnings[band->num_warnings]);
+  band->num_warnings++;
+}
+
+METHODDEF(void)
+worker_error_exit (j_common_ptr cinfo)
+{
+  my_worker_ptr worker = (my_worker_ptr) cinfo;
+
+  /* An allocation failure leaves us holding the mutex */
+  if (worker->locked) {
+    worker->locked = FALSE;
+    jmutex_unlock(worker->parent->mutex);
+  }
+  save_message(cinfo, &worker->band->error);
+  worker->band->failed = TRUE;
+  longjmp(worker->setjmp_buffer, 1);
+}
+
+
+/*
+ * DCT and entropy-encode one band from the batch buffers.
+ * This is compress_data of jccoefct.c, looping over the band's rows.
+ */
+
+LOCAL(void)
+encode_band (my_worker_ptr worker, band_info * band)
+{
+  j_compress_ptr cinfo = &worker->cinfo;
+  my_parallel_ptr par = worker->parent;
+  JDIMENSION MCU_col_num;	/* index of current MCU within row */
+  JDIMENSION last_MCU_col = cinfo->MCUs_per_row - 1;
+  JDIMENSION last_iMCU_row = cinfo->total_iMCU_rows - 1;
+  JDIMENSION iMCU_row;
+  int blkn, bi, ci, yindex, yoffset, blockcnt, MCU_rows;
+  JDIMENSION ypos, xpos;
+  jpeg_component_info *compptr;
+
+  /* Start the entropy encoder afresh at the band's restart marker */
+  band->data_len = 0;
+  worker->dest.next_output_byte = band->data;
+  worker->dest.free_in_buffer = band->data_size;
+  if (worker->dest.free_in_buffer == 0)
+    (void) empty_band_buffer(cinfo);
+  (*cinfo->entropy->start_band) (cinfo, band->first_interval);
+
+  for (iMCU_row = band->start_row; iMCU_row < band->end_row; iMCU_row++) {
+    if (cinfo->comps_in_scan > 1)
+      MCU_rows = 1;
+    else if (iMCU_row < last_iMCU_row)
+      MCU_rows = cinfo->cur_comp_info[0]->v_samp_factor;
+    else
+      MCU_rows = cinfo->cur_comp_info[0]->last_row_height;
+
+    for (yoffset = 0; yoffset < MCU_rows; yoffset++) {
+      for (MCU_col_num = 0; MCU_col_num <= last_MCU_col; MCU_col_num++) {
+	/* Dummy blocks at the right or bottom edge are filled in just as
+	 * jccoefct.c does.
+	 */
+	blkn = 0;
+	for (ci = 0; ci < cinfo->comps_in_scan; ci++) {
+	  compptr = cinfo->cur_comp_info[ci];
+	  blockcnt = (MCU_col_num < last_MCU_col) ? compptr->MCU_width
+						  : compptr->last_col_width;
+	  xpos = MCU_col_num * compptr->MCU_sample_width;
+	  ypos = ((iMCU_row - par->batch_start) * compptr->v_samp_factor +
+		  (JDIMENSION) yoffset) * DCTSIZE;
+	  for (yindex = 0; yindex < compptr->MCU_height; yindex++) {
+	    if (iMCU_row < last_iMCU_row ||
+		yoffset+yindex < compptr->last_row_height) {
+	      (*cinfo->fdct->forward_DCT) (cinfo, compptr,
+			par->batch_buffer[compptr->component_index],
+			worker->MCU_buffer[blkn],
+			ypos, xpos, (JDIMENSION) blockcnt);
+	      if (blockcnt < compptr->MCU_width) {
+		/* Create some dummy blocks at the right edge of the image. */
+		jzero_far((void FAR *) worker->MCU_buffer[blkn + blockcnt],
+			  (compptr->MCU_width - blockcnt) * SIZEOF(JBLOCK));
+		for (bi = blockcnt; bi < compptr->MCU_width; bi++) {
+		  worker->MCU_buffer[blkn+bi][0][0] =
+		    worker->MCU_buffer[blkn+bi-1][0][0];
+		}
+	      }
+	    } else {
+	      /* Create a row of dummy blocks at the bottom of the image. */
+	      jzero_far((void FAR *) worker->MCU_buffer[blkn],
+			compptr->MCU_width * SIZEOF(JBLOCK));
+	      for (bi = 0; bi < compptr->MCU_width; bi++) {
+		worker->MCU_buffer[blkn+bi][0][0] =
+		  worker->MCU_buffer[blkn-1][0][0];
+	      }
+	    }
+	    blkn += compptr->MCU_width;
+	    ypos += DCTSIZE;
+	  }
+	}
+	/* Write the MCU.  The destination never suspends. */
+	(void) (*cinfo->entropy->encode_mcu) (cinfo, worker->MCU_buffer);
+      }
+    }
+  }
+
+  /* Pad out the last byte, as before a restart marker */
+  (*cinfo->entropy->finish_pass) (cinfo);
+  band->data_len = band->data_size - worker->dest.free_in_buffer;
+}
+
+
+/*
+ * Encode a band, returning FALSE if an error stopped it.
+ * worker_error_exit has then recorded the error in the band.
+ */
+
+LOCAL(boolean)
+encode_band_trapped (my_worker_ptr worker, band_info * band)
+{
+  if (setjmp(worker->setjmp_buffer))
+    return FALSE;
+  encode_band(worker, band);
+  return TRUE;
+}
+
+
+/*
+ * Take bands and encode them until there are none left.
+ * This is run by the calling thread as well as by the workers.
+ */
+
+LOCAL(void)
+run_worker (my_worker_ptr worker)
+{
+  my_parallel_ptr par = worker->parent;
+  band_info * band;
+
+  for (;;) {
+    if (par->mutex != NULL)
+      jmutex_lock(par->mutex);
+    if (par->stop || par->band_ctr >= par->num_bands) {
+      band = NULL;
+    } else {
+      band = &par->bands[par->band_ctr];
+      par->band_ctr++;
+    }
+    if (par->mutex != NULL)
+      jmutex_unlock(par->mutex);
+    if (band == NULL)
+      break;
+
+    worker->band = band;
+    if (! encode_band_trapped(worker, band)) {
+      if (par->mutex != NULL)
+	jmutex_lock(par->mutex);
+      par->stop = TRUE;
+      if (par->mutex != NULL)
+	jmutex_unlock(par->mutex);
+      break;
+    }
+  }
+}
+
+static void
+worker_main (void * arg)
+{
+  run_worker((my_worker_ptr) arg);
+}
+
+
+/*
+ * Set up a worker's private copy of the compression object.
+ * This is done on the calling thread, as it allocates memory.
+ */
+
+LOCAL(void)
+init_worker (j_compress_ptr cinfo, my_worker_ptr worker)
+{
+  my_parallel_ptr par = (my_parallel_ptr) cinfo->coef;
+  JBLOCKROW buffer;
+  int i;
+
+  worker->cinfo = *cinfo;
+  worker->parent = par;
+  worker->locked = FALSE;
+  worker->thread = NULL;
+
+  /* Our own data destination; encode_band points it at each band */
+  worker->dest.init_destination = null_band_method;
+  worker->dest.empty_output_buffer = empty_band_buffer;
+  worker->dest.term_destination = null_band_method;
+  worker->cinfo.dest = &worker->dest;
+
+  /* An entropy encoder of our own.  Any error in setting it up still goes
+   * to the application's error manager.
+   */
+  jinit_huff_encoder(&worker->cinfo);
+  (*worker->cinfo.entropy->start_pass) (&worker->cinfo, FALSE);
+
+  buffer = (JBLOCKROW)
+    (*cinfo->mem->alloc_large) ((j_common_ptr) cinfo, JPOOL_IMAGE,
+				C_MAX_BLOCKS_IN_MCU * SIZEOF(JBLOCK));
+  for (i = 0; i < C_MAX_BLOCKS_IN_MCU; i++) {
+    worker->MCU_buffer[i] = buffer + i;
+  }
+
+  /* From here on, messages are collected per band */
+  worker->cinfo.err = jpeg_std_error(&worker->err);
+  worker->err.error_exit = worker_error_exit;
+  worker->err.emit_message = worker_emit_message;
+}
+
+
+/*
+ * Initialize for a processing pass.
+ * Here we size the bands and batches, and set up the workers.
+ */
+
+METHODDEF(void)
+start_pass_coef (j_compress_ptr cinfo, J_BUF_MODE pass_mode)
+{
+  my_parallel_ptr par = (my_parallel_ptr) cinfo->coef;
+  long period, rows;
+  int ci, w;
+  jpeg_component_info *compptr;
+
+  if (pass_mode != JBUF_PASS_THRU)
+    ERREXIT(cinfo, JERR_BAD_BUFFER_MODE);
+
+  par->iMCU_row_num = 0;
+  par->batch_start = 0;
+  par->rows_buffered = 0;
+  par->row_saved = FALSE;
+  par->encoded = FALSE;
+
+  /* In an interleaved scan, an iMCU row is one MCU row; in a noninterleaved
+   * scan it is v_samp_factor MCU rows.
+   */
+  par->MCUs_per_iMCU_row = cinfo->MCUs_per_row;
+  if (cinfo->comps_in_scan == 1)
+    par->MCUs_per_iMCU_row *=
+      (JDIMENSION) cinfo->cur_comp_info[0]->v_samp_factor;
+
+  /* A band may begin only at an iMCU row that begins a restart interval;
+   * these come every 'period' iMCU rows.  A batch holds BANDS_PER_THREAD
+   * bands per thread.
+   */
+  rows = (long) cinfo->total_iMCU_rows;
+  if (cinfo->restart_interval == 0)
+    period = rows;
+  else
+    period = (long) cinfo->restart_interval /
+	     gcd((long) par->MCUs_per_iMCU_row, (long) cinfo->restart_interval);
+  period = MIN(period, rows);
+  par->band_rows = (JDIMENSION) period;
+  par->batch_rows = (JDIMENSION)
+    MIN(period * par->num_threads * BANDS_PER_THREAD, rows);
+
+  par->bands = (band_info *)
+    (*cinfo->mem->alloc_small) ((j_common_ptr) cinfo, JPOOL_IMAGE,
+				par->num_threads * BANDS_PER_THREAD *
+				SIZEOF(band_info));
+  for (w = 0; w < par->num_threads * BANDS_PER_THREAD; w++) {
+    par->bands[w].data = NULL;
+    par->bands[w].data_size = 0;
+  }
+
+  /* Allocate the batch buffers, padded to whole iMCU rows */
+  for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
+       ci++, compptr++) {
+    par->batch_buffer[ci] = (*cinfo->mem->alloc_sarray)
+      ((j_common_ptr) cinfo, JPOOL_IMAGE,
+       compptr->width_in_blocks * DCTSIZE,
+       par->batch_rows * (JDIMENSION) (compptr->v_samp_factor * DCTSIZE));
+  }
+
+  par->workers = (my_worker_ptr)
+    (*cinfo->mem->alloc_small) ((j_common_ptr) cinfo, JPOOL_IMAGE,
+				par->num_threads * SIZEOF(my_worker));
+  for (w = 0; w < par->num_threads; w++)
+    init_worker(cinfo, &par->workers[w]);
+}
+
+
+/*
+ * Encode the bands of the batch now in the buffers, on as many threads as
+ * we may, then reissue any warnings and errors on the calling thread.
+ */
+
+LOCAL(void)
+encode_batch (j_compress_ptr cinfo)
+{
+  my_parallel_ptr par = (my_parallel_ptr) cinfo->coef;
+  my_worker_ptr workers = par->workers;
+  band_info * band;
+  JDIMENSION batch_end = par->batch_start + par->rows_buffered;
+  int num_workers, w, b, i;
+
+  par->num_bands = (int) jdiv_round_up((long) par->rows_buffered,
+				       (long) par->band_rows);
+  for (b = 0; b < par->num_bands; b++) {
+    band = &par->bands[b];
+    band->start_row = par->batch_start + (JDIMENSION) b * par->band_rows;
+    band->end_row = MIN(band->start_row + par->band_rows, batch_end);
+    band->first_interval = 0;
+    if (cinfo->restart_interval != 0)
+      band->first_interval = (long) band->start_row *
+	(long) par->MCUs_per_iMCU_row / (long) cinfo->restart_interval;
+    band->num_warnings = 0;
+    band->failed = FALSE;
+  }
+
+  num_workers = MIN(par->num_threads, par->num_bands);
+  par->band_ctr = 0;
+  par->stop = FALSE;
+  par->mutex = NULL;
+  if (num_workers > 1) {
+    par->mutex = jmutex_create();
+    if (par->mutex == NULL)
+      num_workers = 1;
+  }
+  /* If a thread can't be started, the others just do more of the work */
+  for (w = 1; w < num_workers; w++)
+    workers[w].thread = jthread_start(worker_main, (void *) &workers[w]);
+  run_worker(&workers[0]);
+  for (w = 1; w < num_workers; w++) {
+    if (workers[w].thread != NULL)
+      jthread_join(workers[w].thread);
+    workers[w].thread = NULL;
+  }
+  if (par->mutex != NULL)
+    jmutex_destroy(par->mutex);
+  par->mutex = NULL;
+
+  /* Reissue the messages.  Bands after a failed one may not have been
+   * encoded, but the error ends compression anyway.
+   */
+  for (b = 0; b < par->num_bands; b++) {
+    band = &par->bands[b];
+    for (i = 0; i < band->num_warnings; i++) {
+      saved_message * msg = &band->warnings[MIN(i, MAX_BAND_WARNINGS-1)];
+      cinfo->err->msg_code = msg->msg_code;
+      MEMCOPY(&cinfo->err->msg_parm, &msg->msg_parm, SIZEOF(msg->msg_parm));
+      (*cinfo->err->emit_message) ((j_common_ptr) cinfo, -1);
+    }
+    if (band->failed) {
+      cinfo->err->msg_code = band->error.msg_code;
+      MEMCOPY(&cinfo->err->msg_parm, &band->error.msg_parm,
+	      SIZEOF(band->error.msg_parm));
+      (*cinfo->err->error_exit) ((j_common_ptr) cinfo);
+    }
+  }
+
+  par->encoded = TRUE;
+  par->out_band = 0;
+  par->out_offset = 0;
+}
+
+
+/*
+ * Copy the encoded bands to the data destination.
+ * Returns FALSE if must suspend; we can pick up where we left off.
+ * We empty the buffer as soon as it fills, as the other modules expect.
+ */
+
+LOCAL(boolean)
+output_bands (j_compress_ptr cinfo)
+{
+  my_parallel_ptr par = (my_parallel_ptr) cinfo->coef;
+  struct jpeg_destination_mgr * dest = cinfo->dest;
+  band_info * band;
+  size_t nbytes;
+
+  while (par->out_band < par->num_bands) {
+    band = &par->bands[par->out_band];
+    while (par->out_offset < band->data_len) {
+      nbytes = MIN(dest->free_in_buffer, band->data_len - par->out_offset);
+      MEMCOPY(dest->next_output_byte, band->data + par->out_offset, nbytes);
+      dest->next_output_byte += nbytes;
+      dest->free_in_buffer -= nbytes;
+      par->out_offset += nbytes;
+      if (dest->free_in_buffer == 0) {
+	if (! (*dest->empty_output_buffer) (cinfo))
+	  return FALSE;
+      }
+    }
+    par->out_band++;
+    par->out_offset = 0;
+  }
+  return TRUE;
+}
+
+
+/*
+ * Process some data.
+ * We save one iMCU row per call in the batch buffers; when they are full,
+ * or at the bottom of the image, we encode the batch and output it.
+ * Returns TRUE if the iMCU row is completed, FALSE if suspended.
+ *
+ * NB: input_buf contains a plane for each component in image,
+ * which we index according to the component's SOF position.
+ */
+
+METHODDEF(boolean)
+compress_data (j_compress_ptr cinfo, JSAMPIMAGE input_buf)
+{
+  my_parallel_ptr par = (my_parallel_ptr) cinfo->coef;
+  int ci, rows;
+  jpeg_component_info *compptr;
+
+  /* After a suspension we are called again with the same row */
+  if (! par->row_saved) {
+    for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
+	 ci++, compptr++) {
+      rows = compptr->v_samp_factor * DCTSIZE;
+      jcopy_sample_rows(input_buf[ci], 0, par->batch_buffer[ci],
+			(int) par->rows_buffered * rows, rows,
+			compptr->width_in_blocks * DCTSIZE);
+    }
+    par->rows_buffered++;
+    par->row_saved = TRUE;
+    if (par->rows_buffered == par->batch_rows ||
+	par->iMCU_row_num == cinfo->total_iMCU_rows - 1)
+      encode_batch(cinfo);
+  }
+
+  if (par->encoded) {
+    if (! output_bands(cinfo))
+      return FALSE;
+    par->encoded = FALSE;
+    par->batch_start += par->rows_buffered;
+    par->rows_buffered = 0;
+  }
+
+  /* Completed the iMCU row, advance counter for next one */
+  par->row_saved = FALSE;
+  par->iMCU_row_num++;
+  return TRUE;
+}
+
+
+/*
+ * Initialize the parallel coefficient controller.
+ */
+
+GLOBAL(void)
+jinit_c_parallel_controller (j_compress_ptr cinfo)
+{
+  my_parallel_ptr par;
+
+  par = (my_parallel_ptr)
+    (*cinfo->mem->alloc_small) ((j_common_ptr) cinfo, JPOOL_IMAGE,
+				SIZEOF(my_parallel_controller));
+  cinfo->coef = (struct jpeg_c_coef_controller *) par;
+  par->pub.start_pass = start_pass_coef;
+  par->pub.compress_data = compress_data;
+
+  par->num_threads = cinfo->num_threads;
+  if (par->num_threads <= 0)
+    par->num_threads = jthread_cpus();
+  if (par->num_threads > JMAX_THREADS)
+    par->num_threads = JMAX_THREADS;
+  par->mutex = NULL;
+}
+
+#endif /* C_THREADS_SUPPORTED */
@@ -330,6 +330,9 @@ jpeg_set_defaults (j_compress_ptr cinfo)
   cinfo->restart_interval = 0;
   cinfo->restart_in_rows = 0;
 
+  /* No parallel encoding */
+  cinfo->num_threads = 1;
+
   /* Fill in default JFIF marker parameters.  Note that whether the marker
    * will actually be written is determined by jpeg_set_colorspace.
    *
@@ -821,6 +821,7 @@ jinit_phuff_encoder (j_compress_ptr cinfo)
 				SIZEOF(phuff_entropy_encoder));
   cinfo->entropy = (struct jpeg_entropy_encoder *) entropy;
   entropy->pub.start_pass = start_pass_phuff;
+  entropy->pub.start_band = NULL;	/* no parallel encoding */
 
   /* Mark tables unallocated */
   for (i = 0; i < NUM_HUFF_TBLS; i++) {
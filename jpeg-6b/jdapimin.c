@@ -187,12 +187,16 @@ default_decompress_parms (j_decompress_ptr cinfo)
   /* Set defaults for other decompression parameters. */
   cinfo->scale_num = 1;		/* 1:1 scaling */
   cinfo->scale_denom = 1;
+  cinfo->max_output_width = 0;	/* not a thumbnail */
+  cinfo->max_output_height = 0;
+  cinfo->exact_output_size = FALSE;
   cinfo->output_gamma = 1.0;
   cinfo->buffered_image = FALSE;
   cinfo->raw_data_out = FALSE;
   cinfo->dct_method = JDCT_DEFAULT;
   cinfo->do_fancy_upsampling = TRUE;
   cinfo->do_block_smoothing = TRUE;
+  cinfo->num_threads = 1;	/* no parallel decoding */
   cinfo->quantize_colors = FALSE;
   /* We set these in case application only sets quantize_colors. */
   cinfo->dither_mode = JDITHER_FS;
@@ -21,6 +21,9 @@
 
 /* Forward declarations */
 LOCAL(boolean) output_pass_setup JPP((j_decompress_ptr cinfo));
+LOCAL(void) process_data JPP((j_decompress_ptr cinfo, JSAMPARRAY output_buf,
+			      JDIMENSION *out_row_ctr,
+			      JDIMENSION out_rows_avail));
 
 
 /*
@@ -83,6 +86,33 @@ jpeg_start_decompress (j_decompress_ptr cinfo)
 }
 
 
+/*
+ * Process some data.  When resampling to a thumbnail, rows the resampler
+ * still holds from the last row group it got are emitted on their own
+ * first: the main controller has already seen that row group consumed, and
+ * would ask the decoder for another iMCU row, which after the last one
+ * makes no progress at all.  The callers loop until they have output rows
+ * or the resampler stops taking input, so stopping here is harmless.
+ */
+
+LOCAL(void)
+process_data (j_decompress_ptr cinfo, JSAMPARRAY output_buf,
+	      JDIMENSION *out_row_ctr, JDIMENSION out_rows_avail)
+{
+  JDIMENSION in_row_group_ctr;
+
+  if (cinfo->resize != NULL && cinfo->resize->rows_pending) {
+    in_row_group_ctr = 0;
+    (*cinfo->post->post_process_data) (cinfo, (JSAMPIMAGE) NULL,
+				       &in_row_group_ctr, (JDIMENSION) 0,
+				       output_buf, out_row_ctr, out_rows_avail);
+    return;
+  }
+  (*cinfo->main->process_data) (cinfo, output_buf, out_row_ctr,
+				out_rows_avail);
+}
+
+
 /*
  * Set up for an output pass, and perform any dummy pass(es) needed.
  * Common subroutine for jpeg_start_decompress and jpeg_start_output.
@@ -105,7 +135,7 @@ output_pass_setup (j_decompress_ptr cinfo)
 #ifdef QUANT_2PASS_SUPPORTED
     /* Crank through the dummy pass */
     while (cinfo->output_scanline < cinfo->output_height) {
-      JDIMENSION last_scanline;
+      JDIMENSION last_scanline, last_input_row;
       /* Call progress monitor hook if present */
       if (cinfo->progress != NULL) {
 	cinfo->progress->pass_counter = (long) cinfo->output_scanline;
@@ -114,9 +144,12 @@ output_pass_setup (j_decompress_ptr cinfo)
       }
       /* Process some data */
       last_scanline = cinfo->output_scanline;
-      (*cinfo->main->process_data) (cinfo, (JSAMPARRAY) NULL,
-				    &cinfo->output_scanline, (JDIMENSION) 0);
-      if (cinfo->output_scanline == last_scanline)
+      last_input_row = (cinfo->resize != NULL) ? cinfo->resize->input_rows : 0;
+      process_data(cinfo, (JSAMPARRAY) NULL,
+		   &cinfo->output_scanline, (JDIMENSION) 0);
+      if (cinfo->output_scanline == last_scanline &&
+	  (cinfo->resize == NULL ||
+	   cinfo->resize->input_rows == last_input_row))
 	return FALSE;		/* No progress made, must suspend */
     }
     /* Finish up dummy pass, and set up for another one */
@@ -152,7 +185,7 @@ GLOBAL(JDIMENSION)
 jpeg_read_scanlines (j_decompress_ptr cinfo, JSAMPARRAY scanlines,
 		     JDIMENSION max_lines)
 {
-  JDIMENSION row_ctr;
+  JDIMENSION row_ctr, last_input_row;
 
   if (cinfo->global_state != DSTATE_SCANNING)
     ERREXIT1(cinfo, JERR_BAD_STATE, cinfo->global_state);
@@ -168,9 +201,16 @@ jpeg_read_scanlines (j_decompress_ptr cinfo, JSAMPARRAY scanlines,
     (*cinfo->progress->progress_monitor) ((j_common_ptr) cinfo);
   }
 
-  /* Process some data */
+  /* Process some data.  When resampling to a thumbnail, an iMCU row may
+   * not complete any output row; so long as the resizer is being fed,
+   * keep going rather than return 0, which would look like suspension.
+   */
   row_ctr = 0;
-  (*cinfo->main->process_data) (cinfo, scanlines, &row_ctr, max_lines);
+  do {
+    last_input_row = (cinfo->resize != NULL) ? cinfo->resize->input_rows : 0;
+    process_data(cinfo, scanlines, &row_ctr, max_lines);
+  } while (row_ctr == 0 && cinfo->resize != NULL &&
+	   cinfo->resize->input_rows != last_input_row);
   cinfo->output_scanline += row_ctr;
   return row_ctr;
 }
@@ -440,10 +440,15 @@ smoothing_ok (j_decompress_ptr cinfo)
     coef_bits = cinfo->coef_bits[ci];
     if (coef_bits[0] < 0)
       return FALSE;
-    /* Block smoothing is helpful if some AC coefficients remain inaccurate. */
+    /* Block smoothing is helpful if some AC coefficients remain inaccurate.
+     * Those that a reduced-size IDCT does not use count as accurate.
+     */
     for (coefi = 1; coefi <= 5; coefi++) {
-      coef_bits_latch[coefi] = coef_bits[coefi];
-      if (coef_bits[coefi] != 0)
+      if (coefi < compptr->coef_limit)
+	coef_bits_latch[coefi] = coef_bits[coefi];
+      else
+	coef_bits_latch[coefi] = 0;
+      if (coef_bits_latch[coefi] != 0)
 	smoothing_useful = TRUE;
     }
     coef_bits_latch += SAVED_COEFS;
@@ -11,6 +11,7 @@
 #define JPEG_INTERNALS
 #include "jinclude.h"
 #include "jpeglib.h"
+#include "jsimd.h"
 
 
 /* Private subobject */
@@ -23,6 +24,9 @@ typedef struct {
   int * Cb_b_tab;		/* => table for Cb to B conversion */
   INT32 * Cr_g_tab;		/* => table for Cr to G conversion */
   INT32 * Cb_g_tab;		/* => table for Cb to G conversion */
+
+  /* Layout of 4-byte RGB output pixels (JCS_EXT_xxx), see jrgb_pixel_layout */
+  int rgb_offset[4];		/* offsets of R, G, B and the X/alpha byte */
 } my_color_deconverter;
 
 typedef my_color_deconverter * my_cconvert_ptr;
@@ -126,7 +130,7 @@ ycc_rgb_convert (j_decompress_ptr cinfo,
   register JSAMPROW outptr;
   register JSAMPROW inptr0, inptr1, inptr2;
   register JDIMENSION col;
-  JDIMENSION num_cols = cinfo->output_width;
+  JDIMENSION num_cols = cinfo->scaled_width;
   /* copy these pointers into registers if possible */
   register JSAMPLE * range_limit = cinfo->sample_range_limit;
   register int * Crrtab = cconvert->Cr_r_tab;
@@ -157,6 +161,57 @@ ycc_rgb_convert (j_decompress_ptr cinfo,
 }
 
 
+/*
+ * The same for the 4-byte RGB layouts.  The X/alpha byte is set to
+ * MAXJSAMPLE, so that RGBA output is opaque.
+ */
+
+METHODDEF(void)
+ycc_extrgb_convert (j_decompress_ptr cinfo,
+		    JSAMPIMAGE input_buf, JDIMENSION input_row,
+		    JSAMPARRAY output_buf, int num_rows)
+{
+  my_cconvert_ptr cconvert = (my_cconvert_ptr) cinfo->cconvert;
+  register int y, cb, cr;
+  register JSAMPROW outptr;
+  register JSAMPROW inptr0, inptr1, inptr2;
+  register JDIMENSION col;
+  JDIMENSION num_cols = cinfo->scaled_width;
+  int rpos = cconvert->rgb_offset[0];
+  int gpos = cconvert->rgb_offset[1];
+  int bpos = cconvert->rgb_offset[2];
+  int xpos = cconvert->rgb_offset[3];
+  /* copy these pointers into registers if possible */
+  register JSAMPLE * range_limit = cinfo->sample_range_limit;
+  register int * Crrtab = cconvert->Cr_r_tab;
+  register int * Cbbtab = cconvert->Cb_b_tab;
+  register INT32 * Crgtab = cconvert->Cr_g_tab;
+  register INT32 * Cbgtab = cconvert->Cb_g_tab;
+  SHIFT_TEMPS
+
+  while (--num_rows >= 0) {
+    inptr0 = input_buf[0][input_row];
+    inptr1 = input_buf[1][input_row];
+    inptr2 = input_buf[2][input_row];
+    input_row++;
+    outptr = *output_buf++;
+    for (col = 0; col < num_cols; col++) {
+      y  = GETJSAMPLE(inptr0[col]);
+      cb = GETJSAMPLE(inptr1[col]);
+      cr = GETJSAMPLE(inptr2[col]);
+      /* Range-limiting is essential due to noise introduced by DCT losses. */
+      outptr[rpos] = range_limit[y + Crrtab[cr]];
+      outptr[gpos] = range_limit[y +
+			      ((int) RIGHT_SHIFT(Cbgtab[cb] + Crgtab[cr],
+						 SCALEBITS))];
+      outptr[bpos] = range_limit[y + Cbbtab[cb]];
+      outptr[xpos] = MAXJSAMPLE;
+      outptr += 4;
+    }
+  }
+}
+
+
 /**************** Cases other than YCbCr -> RGB **************/
 
 
@@ -173,7 +228,7 @@ null_convert (j_decompress_ptr cinfo,
   register JSAMPROW inptr, outptr;
   register JDIMENSION count;
   register int num_components = cinfo->num_components;
-  JDIMENSION num_cols = cinfo->output_width;
+  JDIMENSION num_cols = cinfo->scaled_width;
   int ci;
 
   while (--num_rows >= 0) {
@@ -203,7 +258,7 @@ grayscale_convert (j_decompress_ptr cinfo,
 		   JSAMPARRAY output_buf, int num_rows)
 {
   jcopy_sample_rows(input_buf[0], (int) input_row, output_buf, 0,
-		    num_rows, cinfo->output_width);
+		    num_rows, cinfo->scaled_width);
 }
 
 
@@ -220,7 +275,7 @@ gray_rgb_convert (j_decompress_ptr cinfo,
 {
   register JSAMPROW inptr, outptr;
   register JDIMENSION col;
-  JDIMENSION num_cols = cinfo->output_width;
+  JDIMENSION num_cols = cinfo->scaled_width;
 
   while (--num_rows >= 0) {
     inptr = input_buf[0][input_row++];
@@ -234,6 +289,69 @@ gray_rgb_convert (j_decompress_ptr cinfo,
 }
 
 
+/*
+ * Grayscale and RGB to the 4-byte RGB layouts.
+ */
+
+METHODDEF(void)
+gray_extrgb_convert (j_decompress_ptr cinfo,
+		     JSAMPIMAGE input_buf, JDIMENSION input_row,
+		     JSAMPARRAY output_buf, int num_rows)
+{
+  my_cconvert_ptr cconvert = (my_cconvert_ptr) cinfo->cconvert;
+  register JSAMPROW inptr, outptr;
+  register JDIMENSION col;
+  JDIMENSION num_cols = cinfo->scaled_width;
+  int rpos = cconvert->rgb_offset[0];
+  int gpos = cconvert->rgb_offset[1];
+  int bpos = cconvert->rgb_offset[2];
+  int xpos = cconvert->rgb_offset[3];
+
+  while (--num_rows >= 0) {
+    inptr = input_buf[0][input_row++];
+    outptr = *output_buf++;
+    for (col = 0; col < num_cols; col++) {
+      /* We can dispense with GETJSAMPLE() here */
+      outptr[rpos] = outptr[gpos] = outptr[bpos] = inptr[col];
+      outptr[xpos] = MAXJSAMPLE;
+      outptr += 4;
+    }
+  }
+}
+
+
+METHODDEF(void)
+rgb_extrgb_convert (j_decompress_ptr cinfo,
+		    JSAMPIMAGE input_buf, JDIMENSION input_row,
+		    JSAMPARRAY output_buf, int num_rows)
+{
+  my_cconvert_ptr cconvert = (my_cconvert_ptr) cinfo->cconvert;
+  register JSAMPROW inptr0, inptr1, inptr2, outptr;
+  register JDIMENSION col;
+  JDIMENSION num_cols = cinfo->scaled_width;
+  int rpos = cconvert->rgb_offset[0];
+  int gpos = cconvert->rgb_offset[1];
+  int bpos = cconvert->rgb_offset[2];
+  int xpos = cconvert->rgb_offset[3];
+
+  while (--num_rows >= 0) {
+    inptr0 = input_buf[0][input_row];
+    inptr1 = input_buf[1][input_row];
+    inptr2 = input_buf[2][input_row];
+    input_row++;
+    outptr = *output_buf++;
+    for (col = 0; col < num_cols; col++) {
+      /* We can dispense with GETJSAMPLE() here */
+      outptr[rpos] = inptr0[col];
+      outptr[gpos] = inptr1[col];
+      outptr[bpos] = inptr2[col];
+      outptr[xpos] = MAXJSAMPLE;
+      outptr += 4;
+    }
+  }
+}
+
+
 /*
  * Adobe-style YCCK->CMYK conversion.
  * We convert YCbCr to R=1-C, G=1-M, and B=1-Y using the same
@@ -251,7 +369,7 @@ ycck_cmyk_convert (j_decompress_ptr cinfo,
   register JSAMPROW outptr;
   register JSAMPROW inptr0, inptr1, inptr2, inptr3;
   register JDIMENSION col;
-  JDIMENSION num_cols = cinfo->output_width;
+  JDIMENSION num_cols = cinfo->scaled_width;
   /* copy these pointers into registers if possible */
   register JSAMPLE * range_limit = cinfo->sample_range_limit;
   register int * Crrtab = cconvert->Cr_r_tab;
@@ -360,6 +478,10 @@ jinit_color_deconverter (j_decompress_ptr cinfo)
     if (cinfo->jpeg_color_space == JCS_YCbCr) {
       cconvert->pub.color_convert = ycc_rgb_convert;
       build_ycc_rgb_table(cinfo);
+#ifdef SIMD_SUPPORTED
+      if (jsimd_can_ycc_rgb())
+	cconvert->pub.color_convert = jsimd_ycc_rgb_convert;
+#endif
     } else if (cinfo->jpeg_color_space == JCS_GRAYSCALE) {
       cconvert->pub.color_convert = gray_rgb_convert;
     } else if (cinfo->jpeg_color_space == JCS_RGB && RGB_PIXELSIZE == 3) {
@@ -368,6 +490,28 @@ jinit_color_deconverter (j_decompress_ptr cinfo)
       ERREXIT(cinfo, JERR_CONVERSION_NOTIMPL);
     break;
 
+  case JCS_EXT_RGBX:
+  case JCS_EXT_BGRX:
+  case JCS_EXT_XRGB:
+  case JCS_EXT_RGBA:
+  case JCS_EXT_BGRA:
+    cinfo->out_color_components =
+      jrgb_pixel_layout(cinfo->out_color_space, cconvert->rgb_offset);
+    if (cinfo->jpeg_color_space == JCS_YCbCr) {
+      cconvert->pub.color_convert = ycc_extrgb_convert;
+      build_ycc_rgb_table(cinfo);
+#ifdef SIMD_SUPPORTED
+      if (jsimd_can_ycc_rgb())
+	cconvert->pub.color_convert = jsimd_ycc_rgb_convert;
+#endif
+    } else if (cinfo->jpeg_color_space == JCS_GRAYSCALE) {
+      cconvert->pub.color_convert = gray_extrgb_convert;
+    } else if (cinfo->jpeg_color_space == JCS_RGB) {
+      cconvert->pub.color_convert = rgb_extrgb_convert;
+    } else
+      ERREXIT(cinfo, JERR_CONVERSION_NOTIMPL);
+    break;
+
   case JCS_CMYK:
     cinfo->out_color_components = 4;
     if (cinfo->jpeg_color_space == JCS_YCCK) {
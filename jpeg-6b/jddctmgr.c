@@ -19,6 +19,7 @@
 #include "jinclude.h"
 #include "jpeglib.h"
 #include "jdct.h"		/* Private declarations for DCT subsystem */
+#include "jsimd.h"
 
 
 /*
@@ -105,11 +106,23 @@ start_pass (j_decompress_ptr cinfo)
       method = JDCT_ISLOW;	/* jidctred uses islow-style table */
       break;
     case 2:
-      method_ptr = jpeg_idct_2x2;
+    case 4:
+      /* The 2x2 and 4x4 routines need the whole coefficient block;
+       * if jdmaster.c has limited the coefficients, use the general one.
+       */
+      if (compptr->coef_limit < DCTSIZE2)
+	method_ptr = jpeg_idct_scaled;
+      else if (compptr->DCT_scaled_size == 2)
+	method_ptr = jpeg_idct_2x2;
+      else
+	method_ptr = jpeg_idct_4x4;
       method = JDCT_ISLOW;	/* jidctred uses islow-style table */
       break;
-    case 4:
-      method_ptr = jpeg_idct_4x4;
+    case 3:
+    case 5:
+    case 6:
+    case 7:
+      method_ptr = jpeg_idct_scaled;
       method = JDCT_ISLOW;	/* jidctred uses islow-style table */
       break;
 #endif
@@ -236,6 +249,27 @@ start_pass (j_decompress_ptr cinfo)
       break;
     }
   }
+
+#ifdef SIMD_SUPPORTED
+  /* Now that the multiplier tables are built, switch the full-size integer
+   * IDCTs to the SIMD versions if the CPU and the tables allow.
+   */
+  for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
+       ci++, compptr++) {
+    if (! compptr->component_needed)
+      continue;
+#ifdef DCT_ISLOW_SUPPORTED
+    if (idct->pub.inverse_DCT[ci] == jpeg_idct_islow &&
+	jsimd_can_idct_islow(compptr))
+      idct->pub.inverse_DCT[ci] = jsimd_idct_islow;
+#endif
+#ifdef DCT_IFAST_SUPPORTED
+    if (idct->pub.inverse_DCT[ci] == jpeg_idct_ifast &&
+	jsimd_can_idct_ifast(compptr))
+      idct->pub.inverse_DCT[ci] = jsimd_idct_ifast;
+#endif
+  }
+#endif
 }
 
 
@@ -70,9 +70,11 @@ typedef struct {
   /* Pointers to derived tables to be used for each block within an MCU */
   d_derived_tbl * dc_cur_tbls[D_MAX_BLOCKS_IN_MCU];
   d_derived_tbl * ac_cur_tbls[D_MAX_BLOCKS_IN_MCU];
-  /* Whether we care about the DC and AC coefficient values for each block */
+  /* Whether we care about the DC coefficient value for each block, and
+   * how many coefficients (in zigzag order) we care about at all.
+   */
   boolean dc_needed[D_MAX_BLOCKS_IN_MCU];
-  boolean ac_needed[D_MAX_BLOCKS_IN_MCU];
+  int coef_limit[D_MAX_BLOCKS_IN_MCU];
 } huff_entropy_decoder;
 
 typedef huff_entropy_decoder * huff_entropy_ptr;
@@ -121,10 +123,11 @@ start_pass_huff_decoder (j_decompress_ptr cinfo)
     /* Decide whether we really care about the coefficient values */
     if (compptr->component_needed) {
       entropy->dc_needed[blkn] = TRUE;
-      /* we don't need the ACs if producing a 1/8th-size image */
-      entropy->ac_needed[blkn] = (compptr->DCT_scaled_size > 1);
+      /* a reduced-size IDCT may not need all the ACs (see jdmaster.c) */
+      entropy->coef_limit[blkn] = compptr->coef_limit;
     } else {
-      entropy->dc_needed[blkn] = entropy->ac_needed[blkn] = FALSE;
+      entropy->dc_needed[blkn] = FALSE;
+      entropy->coef_limit[blkn] = 1;
     }
   }
 
@@ -153,6 +156,7 @@ jpeg_make_d_derived_tbl (j_decompress_ptr cinfo, boolean isDC, int tblno,
   d_derived_tbl *dtbl;
   int p, i, l, si, numsymbols;
   int lookbits, ctr;
+  int sym, run, size, value;
   char huffsize[257];
   unsigned int huffcode[257];
   unsigned int code;
@@ -235,6 +239,7 @@ jpeg_make_d_derived_tbl (j_decompress_ptr cinfo, boolean isDC, int tblno,
    */
 
   MEMZERO(dtbl->look_nbits, SIZEOF(dtbl->look_nbits));
+  MEMZERO(dtbl->look_coef, SIZEOF(dtbl->look_coef));
 
   p = 0;
   for (l = 1; l <= HUFF_LOOKAHEAD; l++) {
@@ -247,6 +252,23 @@ jpeg_make_d_derived_tbl (j_decompress_ptr cinfo, boolean isDC, int tblno,
 	dtbl->look_sym[lookbits] = htbl->huffval[p];
 	lookbits++;
       }
+      /* If the extra bits fit too, fill in the combined table */
+      sym = htbl->huffval[p];
+      run = isDC ? 0 : (sym >> 4);
+      size = isDC ? sym : (sym & 15);
+      if (size <= 15 && l + size <= HUFF_LOOKAHEAD) {
+	lookbits = huffcode[p] << (HUFF_LOOKAHEAD-l);
+	for (ctr = 0; ctr < (1 << (HUFF_LOOKAHEAD-l)); ctr++) {
+	  value = 0;
+	  if (size) {
+	    value = ctr >> (HUFF_LOOKAHEAD-l-size);
+	    if (value < (1 << (size-1)))
+	      value -= (1 << size) - 1;	/* Figure F.12: extend sign bit */
+	  }
+	  dtbl->look_coef[lookbits + ctr] =
+	    (INT32) value * 512 + run * 32 + l + size;
+	}
+      }
     }
   }
 
@@ -498,6 +520,313 @@ process_restart (j_decompress_ptr cinfo)
 }
 
 
+/*
+ * Decode one MCU's worth of Huffman-compressed coefficients, the general
+ * way.  This handles suspension, markers and corrupt data; decode_mcu_fast
+ * below handles the common case.
+ */
+
+LOCAL(boolean)
+decode_mcu_slow (j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
+{
+  huff_entropy_ptr entropy = (huff_entropy_ptr) cinfo->entropy;
+  int blkn;
+  BITREAD_STATE_VARS;
+  savable_state state;
+
+  /* Load up working state */
+  BITREAD_LOAD_STATE(cinfo,entropy->bitstate);
+  ASSIGN_STATE(state, entropy->saved);
+
+  /* Outer loop handles each block in the MCU */
+
+  for (blkn = 0; blkn < cinfo->blocks_in_MCU; blkn++) {
+    JBLOCKROW block = MCU_data[blkn];
+    d_derived_tbl * dctbl = entropy->dc_cur_tbls[blkn];
+    d_derived_tbl * actbl = entropy->ac_cur_tbls[blkn];
+    register int s, k, r;
+    int limit;
+
+    /* Decode a single block's worth of coefficients */
+
+    /* Section F.2.2.1: decode the DC coefficient difference */
+    HUFF_DECODE(s, br_state, dctbl, return FALSE, label1);
+    if (s) {
+      CHECK_BIT_BUFFER(br_state, s, return FALSE);
+      r = GET_BITS(s);
+      s = HUFF_EXTEND(r, s);
+    }
+
+    if (entropy->dc_needed[blkn]) {
+      /* Convert DC difference to actual value, update last_dc_val */
+      int ci = cinfo->MCU_membership[blkn];
+      s += state.last_dc_val[ci];
+      state.last_dc_val[ci] = s;
+      /* Output the DC coefficient (assumes jpeg_natural_order[0] = 0) */
+      (*block)[0] = (JCOEF) s;
+    }
+
+    /* Section F.2.2.2: decode the AC coefficients */
+    /* Since zeroes are skipped, output area must be cleared beforehand */
+    limit = entropy->coef_limit[blkn];
+    for (k = 1; k < limit; k++) {
+      HUFF_DECODE(s, br_state, actbl, return FALSE, label2);
+      
+      r = s >> 4;
+      s &= 15;
+      
+      if (s) {
+	k += r;
+	CHECK_BIT_BUFFER(br_state, s, return FALSE);
+	r = GET_BITS(s);
+	s = HUFF_EXTEND(r, s);
+	/* Output coefficient in natural (dezigzagged) order.
+	 * Note: the extra entries in jpeg_natural_order[] will save us
+	 * if k >= DCTSIZE2, which could happen if the data is corrupted.
+	 */
+	(*block)[jpeg_natural_order[k]] = (JCOEF) s;
+      } else {
+	if (r != 15) {
+	  k = DCTSIZE2;		/* EOB: skip the loop below too */
+	  break;
+	}
+	k += 15;
+      }
+    }
+
+    /* The rest of the coefficients, if any, are not needed:
+     * in this loop we just discard the values.
+     */
+    for (; k < DCTSIZE2; k++) {
+      HUFF_DECODE(s, br_state, actbl, return FALSE, label3);
+      
+      r = s >> 4;
+      s &= 15;
+      
+      if (s) {
+	k += r;
+	CHECK_BIT_BUFFER(br_state, s, return FALSE);
+	DROP_BITS(s);
+      } else {
+	if (r != 15)
+	  break;
+	k += 15;
+      }
+    }
+  }
+
+  /* Completed MCU, so update state */
+  BITREAD_SAVE_STATE(cinfo,entropy->bitstate);
+  ASSIGN_STATE(entropy->saved, state);
+  return TRUE;
+}
+
+
+/*
+ * Fast path for decode_mcu, used when the source buffer holds enough bytes
+ * for any MCU and we are not yet at a marker.  A block takes at most 64
+ * codes of 16 bits plus 15 extra bits, or 496 bytes if every byte is
+ * stuffed, so BUFSIZE per block, plus one more BUFSIZE for the bytes held
+ * in and read ahead of the bit buffer, is always enough.  The bit buffer
+ * is then refilled without checking for the end of the buffer, 8 bytes at
+ * a time if none of them is 0xFF.  Codes are looked up in the combined
+ * table, which usually yields the coefficient itself.
+ *
+ * At a marker we add zero bytes, as jpeg_fill_bit_buffer adds zero bits.
+ * If the MCU is finished without using any of them, all is well: they are
+ * taken out again, and the next call will find the marker.  Otherwise, or
+ * at an invalid code, we give up: the blocks are zeroed again and FALSE is
+ * returned without having changed the permanent state, and the caller then
+ * decodes the MCU with decode_mcu_slow, which knows how to deal with those.
+ */
+
+#define BUFSIZE  (DCTSIZE2 * 8)
+
+/* Add one byte to get_buffer.  At a marker, add zeroes and stay put. */
+#define GET_BYTE_FAST \
+	{ register int c0 = GETJOCTET(*buffer); \
+	  if (c0 != 0xFF) \
+	    buffer++; \
+	  else if (GETJOCTET(buffer[1]) == 0) \
+	    buffer += 2; \
+	  else { \
+	    c0 = 0; \
+	    stuffed_bits += 8; \
+	  } \
+	  get_buffer = (get_buffer << 8) | c0; \
+	  bits_left += 8; }
+
+#if BIT_BUF_SIZE == 64
+
+/* Enough for a code and its extra bits: refill below 32 bits */
+#define MIN_FAST_BITS  32
+
+#define ONES64  (((bit_buf_type) 0x01010101 << 32) | 0x01010101)
+#define HIGHS64  (((bit_buf_type) 0x80808080 << 32) | 0x80808080)
+
+/* Nonzero if any byte of w is 0xFF (i.e. any byte of ~w is zero) */
+#define HAS_FF_BYTE(w)  (((~(w)) - ONES64) & (w) & HIGHS64)
+
+#define FILL_BIT_BUFFER_FAST \
+	if (bits_left < MIN_FAST_BITS) { \
+	  register bit_buf_type w; \
+	  register int nbytes = (BIT_BUF_SIZE - 1 - bits_left) >> 3; \
+	  w = ((bit_buf_type) GETJOCTET(buffer[0]) << 56) | \
+	      ((bit_buf_type) GETJOCTET(buffer[1]) << 48) | \
+	      ((bit_buf_type) GETJOCTET(buffer[2]) << 40) | \
+	      ((bit_buf_type) GETJOCTET(buffer[3]) << 32) | \
+	      ((bit_buf_type) GETJOCTET(buffer[4]) << 24) | \
+	      ((bit_buf_type) GETJOCTET(buffer[5]) << 16) | \
+	      ((bit_buf_type) GETJOCTET(buffer[6]) << 8) | \
+	      ((bit_buf_type) GETJOCTET(buffer[7])); \
+	  if (! HAS_FF_BYTE(w)) { \
+	    get_buffer = (get_buffer << (nbytes * 8)) | \
+			 (w >> (64 - nbytes * 8)); \
+	    buffer += nbytes; \
+	    bits_left += nbytes * 8; \
+	  } else { \
+	    do GET_BYTE_FAST while (--nbytes > 0); \
+	  } \
+	}
+
+#else
+
+/* Enough for a code, or for the extra bits: refill below 16 bits */
+#define MIN_FAST_BITS  16
+
+#define FILL_BIT_BUFFER_FAST \
+	if (bits_left < MIN_FAST_BITS) { \
+	  do GET_BYTE_FAST while (bits_left <= BIT_BUF_SIZE - 8); \
+	}
+
+#endif
+
+/* Decode a Huffman code that the combined table couldn't, into s.
+ * The buffer holds at least 16 bits, enough for any code.
+ */
+#define HUFF_DECODE_FAST(s,nb,htbl,failaction) \
+	{ register int look = PEEK_BITS(HUFF_LOOKAHEAD); \
+	  if ((nb = htbl->look_nbits[look]) != 0) { \
+	    DROP_BITS(nb); \
+	    s = htbl->look_sym[look]; \
+	  } else { \
+	    nb = HUFF_LOOKAHEAD+1; \
+	    s = GET_BITS(nb); \
+	    while (s > htbl->maxcode[nb]) { \
+	      s = (s << 1) | GET_BITS(1); \
+	      if (++nb > 16) \
+		{ failaction; } /* bad code: let decode_mcu_slow warn */ \
+	    } \
+	    s = htbl->pub->huffval[ (int) (s + htbl->valoffset[nb]) ]; \
+	  } }
+
+LOCAL(boolean)
+decode_mcu_fast (j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
+{
+  huff_entropy_ptr entropy = (huff_entropy_ptr) cinfo->entropy;
+  int blkn;
+  BITREAD_STATE_VARS;
+  savable_state state;
+  register const JOCTET * buffer;
+  int stuffed_bits = 0;		/* # of zero bits added at a marker */
+  SHIFT_TEMPS
+
+  /* Load up working state */
+  BITREAD_LOAD_STATE(cinfo,entropy->bitstate);
+  ASSIGN_STATE(state, entropy->saved);
+  buffer = br_state.next_input_byte;
+
+  for (blkn = 0; blkn < cinfo->blocks_in_MCU; blkn++) {
+    JBLOCKROW block = MCU_data[blkn];
+    d_derived_tbl * dctbl = entropy->dc_cur_tbls[blkn];
+    d_derived_tbl * actbl = entropy->ac_cur_tbls[blkn];
+    register int s, k, r, nb;
+    register INT32 e;
+
+    /* Section F.2.2.1: decode the DC coefficient difference */
+    FILL_BIT_BUFFER_FAST;
+    e = dctbl->look_coef[PEEK_BITS(HUFF_LOOKAHEAD)];
+    if (e != 0) {
+      DROP_BITS(e & 31);
+      s = (int) RIGHT_SHIFT(e, 9);
+    } else {
+      HUFF_DECODE_FAST(s, nb, dctbl, goto give_up);
+      if (s) {
+	FILL_BIT_BUFFER_FAST;
+	r = GET_BITS(s);
+	s = HUFF_EXTEND(r, s);
+      }
+    }
+
+    if (entropy->dc_needed[blkn]) {
+      /* Convert DC difference to actual value, update last_dc_val */
+      int ci = cinfo->MCU_membership[blkn];
+      s += state.last_dc_val[ci];
+      state.last_dc_val[ci] = s;
+      /* Output the DC coefficient (assumes jpeg_natural_order[0] = 0) */
+      (*block)[0] = (JCOEF) s;
+    }
+
+    /* Section F.2.2.2: decode the AC coefficients */
+    /* Since zeroes are skipped, output area must be cleared beforehand */
+    /* (If the ACs aren't needed, they are stored anyway and ignored.) */
+    for (k = 1; k < DCTSIZE2; k++) {
+      FILL_BIT_BUFFER_FAST;
+      e = actbl->look_coef[PEEK_BITS(HUFF_LOOKAHEAD)];
+      if (e != 0) {
+	DROP_BITS(e & 31);
+	r = (int) (e >> 5) & 15;
+	s = (int) RIGHT_SHIFT(e, 9);
+	if (s) {
+	  k += r;
+	  (*block)[jpeg_natural_order[k]] = (JCOEF) s;
+	  continue;
+	}
+      } else {
+	HUFF_DECODE_FAST(s, nb, actbl, goto give_up);
+	r = s >> 4;
+	s &= 15;
+	if (s) {
+	  k += r;
+	  FILL_BIT_BUFFER_FAST;
+	  r = GET_BITS(s);
+	  s = HUFF_EXTEND(r, s);
+	  (*block)[jpeg_natural_order[k]] = (JCOEF) s;
+	  continue;
+	}
+      }
+      /* EOB or ZRL */
+      if (r != 15)
+	break;
+      k += 15;
+    }
+  }
+
+  if (stuffed_bits) {
+    /* If any of the added zero bits were used, the data ran out */
+    if (bits_left < stuffed_bits)
+      goto give_up;
+    /* Else take them out (the shift is less than BIT_BUF_SIZE, as every
+     * fill is followed by using at least one bit)
+     */
+    get_buffer >>= stuffed_bits;
+    bits_left -= stuffed_bits;
+  }
+
+  /* Completed MCU, so update state */
+  br_state.bytes_in_buffer -= (size_t) (buffer - br_state.next_input_byte);
+  br_state.next_input_byte = buffer;
+  BITREAD_SAVE_STATE(cinfo,entropy->bitstate);
+  ASSIGN_STATE(entropy->saved, state);
+  return TRUE;
+
+give_up:
+  for (blkn = 0; blkn < cinfo->blocks_in_MCU; blkn++)
+    jzero_far((void FAR *) MCU_data[blkn], SIZEOF(JBLOCK));
+  return FALSE;
+}
+
+
 /*
  * Decode and return one MCU's worth of Huffman-compressed coefficients.
  * The coefficients are reordered from zigzag order into natural array order,
@@ -517,9 +846,6 @@ METHODDEF(boolean)
 decode_mcu (j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
 {
   huff_entropy_ptr entropy = (huff_entropy_ptr) cinfo->entropy;
-  int blkn;
-  BITREAD_STATE_VARS;
-  savable_state state;
 
   /* Process restart marker if needed; may have to suspend */
   if (cinfo->restart_interval) {
@@ -532,92 +858,13 @@ decode_mcu (j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
    * This way, we return uniform gray for the remainder of the segment.
    */
   if (! entropy->pub.insufficient_data) {
-
-    /* Load up working state */
-    BITREAD_LOAD_STATE(cinfo,entropy->bitstate);
-    ASSIGN_STATE(state, entropy->saved);
-
-    /* Outer loop handles each block in the MCU */
-
-    for (blkn = 0; blkn < cinfo->blocks_in_MCU; blkn++) {
-      JBLOCKROW block = MCU_data[blkn];
-      d_derived_tbl * dctbl = entropy->dc_cur_tbls[blkn];
-      d_derived_tbl * actbl = entropy->ac_cur_tbls[blkn];
-      register int s, k, r;
-
-      /* Decode a single block's worth of coefficients */
-
-      /* Section F.2.2.1: decode the DC coefficient difference */
-      HUFF_DECODE(s, br_state, dctbl, return FALSE, label1);
-      if (s) {
-	CHECK_BIT_BUFFER(br_state, s, return FALSE);
-	r = GET_BITS(s);
-	s = HUFF_EXTEND(r, s);
-      }
-
-      if (entropy->dc_needed[blkn]) {
-	/* Convert DC difference to actual value, update last_dc_val */
-	int ci = cinfo->MCU_membership[blkn];
-	s += state.last_dc_val[ci];
-	state.last_dc_val[ci] = s;
-	/* Output the DC coefficient (assumes jpeg_natural_order[0] = 0) */
-	(*block)[0] = (JCOEF) s;
-      }
-
-      if (entropy->ac_needed[blkn]) {
-
-	/* Section F.2.2.2: decode the AC coefficients */
-	/* Since zeroes are skipped, output area must be cleared beforehand */
-	for (k = 1; k < DCTSIZE2; k++) {
-	  HUFF_DECODE(s, br_state, actbl, return FALSE, label2);
-      
-	  r = s >> 4;
-	  s &= 15;
-      
-	  if (s) {
-	    k += r;
-	    CHECK_BIT_BUFFER(br_state, s, return FALSE);
-	    r = GET_BITS(s);
-	    s = HUFF_EXTEND(r, s);
-	    /* Output coefficient in natural (dezigzagged) order.
-	     * Note: the extra entries in jpeg_natural_order[] will save us
-	     * if k >= DCTSIZE2, which could happen if the data is corrupted.
-	     */
-	    (*block)[jpeg_natural_order[k]] = (JCOEF) s;
-	  } else {
-	    if (r != 15)
-	      break;
-	    k += 15;
-	  }
-	}
-
-      } else {
-
-	/* Section F.2.2.2: decode the AC coefficients */
-	/* In this path we just discard the values */
-	for (k = 1; k < DCTSIZE2; k++) {
-	  HUFF_DECODE(s, br_state, actbl, return FALSE, label3);
-      
-	  r = s >> 4;
-	  s &= 15;
-      
-	  if (s) {
-	    k += r;
-	    CHECK_BIT_BUFFER(br_state, s, return FALSE);
-	    DROP_BITS(s);
-	  } else {
-	    if (r != 15)
-	      break;
-	    k += 15;
-	  }
-	}
-
-      }
+    if (cinfo->unread_marker != 0 ||
+	cinfo->src->bytes_in_buffer <
+	  BUFSIZE * (size_t) (cinfo->blocks_in_MCU + 1) ||
+	! decode_mcu_fast(cinfo, MCU_data)) {
+      if (! decode_mcu_slow(cinfo, MCU_data))
+	return FALSE;
     }
-
-    /* Completed MCU, so update state */
-    BITREAD_SAVE_STATE(cinfo,entropy->bitstate);
-    ASSIGN_STATE(entropy->saved, state);
   }
 
   /* Account for restart interval (no-op if not using restarts) */
@@ -43,6 +43,18 @@ typedef struct {
    */
   int look_nbits[1<<HUFF_LOOKAHEAD]; /* # bits, or 0 if too long */
   UINT8 look_sym[1<<HUFF_LOOKAHEAD]; /* symbol, or unused */
+
+  /* Combined lookahead table, used by the sequential decoder's fast path:
+   * if the next Huffman code and the extra bits that follow it together
+   * take no more than HUFF_LOOKAHEAD bits, the entry gives the decoded
+   * coefficient at once.  An entry is
+   *	value * 512 + run * 32 + total # of bits
+   * where value is the sign-extended coefficient (or DC difference), and
+   * run the count of zero coefficients preceding it.  For the AC symbols
+   * with no extra bits (EOB, ZRL) value is 0.  The entry is 0 if the
+   * code and its extra bits don't fit.
+   */
+  INT32 look_coef[1<<HUFF_LOOKAHEAD];
 } d_derived_tbl;
 
 /* Expand a Huffman table definition into the derived format */
@@ -69,16 +81,23 @@ EXTERN(void) jpeg_make_d_derived_tbl
  * necessary.
  */
 
-typedef INT32 bit_buf_type;	/* type of bit-extraction buffer */
-#define BIT_BUF_SIZE  32	/* size of buffer in bits */
-
-/* If long is > 32 bits on your machine, and shifting/masking longs is
- * reasonably fast, making bit_buf_type be long and setting BIT_BUF_SIZE
- * appropriately should be a win.  Unfortunately we can't define the size
- * with something like  #define BIT_BUF_SIZE (sizeof(bit_buf_type)*8)
+/* On 64-bit machines a 64-bit buffer is a win: it is refilled half as
+ * often, and the sequential decoder's fast path can then decode a code
+ * and its extra bits without checking the buffer in between.  (size_t is
+ * 64 bits on all the LP64 and Win64 systems we know of.)  Unfortunately
+ * we can't define the size with something like
+ * #define BIT_BUF_SIZE (sizeof(bit_buf_type)*8)
  * because not all machines measure sizeof in 8-bit bytes.
  */
 
+#if defined(_WIN64) || defined(_LP64) || defined(__LP64__)
+typedef size_t bit_buf_type;	/* type of bit-extraction buffer */
+#define BIT_BUF_SIZE  64	/* size of buffer in bits */
+#else
+typedef INT32 bit_buf_type;	/* type of bit-extraction buffer */
+#define BIT_BUF_SIZE  32	/* size of buffer in bits */
+#endif
+
 typedef struct {		/* Bitreading state saved across MCUs */
   bit_buf_type get_buffer;	/* current bit-extraction buffer */
   int bits_left;		/* # of unused bits in it */
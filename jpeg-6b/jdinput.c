@@ -100,6 +100,8 @@ initial_setup (j_decompress_ptr cinfo)
 		    (long) cinfo->max_v_samp_factor);
     /* Mark component needed, until color conversion says otherwise */
     compptr->component_needed = TRUE;
+    /* Assume the full IDCT, until jdmaster.c says otherwise */
+    compptr->coef_limit = DCTSIZE2;
     /* Mark no quantization table yet saved for component */
     compptr->quant_table = NULL;
   }
@@ -274,6 +276,34 @@ finish_input_pass (j_decompress_ptr cinfo)
 }
 
 
+/*
+ * In thumbnail mode, test whether every coefficient the output will use
+ * has been received at full precision.  No later scan of a progressive
+ * file can then change the image, so we need not read any further.
+ */
+
+LOCAL(boolean)
+thumbnail_complete (j_decompress_ptr cinfo)
+{
+  int ci, coefi;
+  jpeg_component_info *compptr;
+
+  if (cinfo->coef_bits == NULL ||
+      (cinfo->max_output_width == 0 && cinfo->max_output_height == 0))
+    return FALSE;
+  for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
+       ci++, compptr++) {
+    if (! compptr->component_needed)
+      continue;
+    for (coefi = 0; coefi < compptr->coef_limit; coefi++) {
+      if (cinfo->coef_bits[ci][coefi] != 0)
+	return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+
 /*
  * Read JPEG markers before, between, or after compressed-data scans.
  * Change state as necessary when a new scan is reached.
@@ -293,7 +323,10 @@ consume_markers (j_decompress_ptr cinfo)
   if (inputctl->pub.eoi_reached) /* After hitting EOI, read no further */
     return JPEG_REACHED_EOI;
 
-  val = (*cinfo->marker->read_markers) (cinfo);
+  if (! inputctl->inheaders && thumbnail_complete(cinfo))
+    val = JPEG_REACHED_EOI;	/* act as if the datastream ended here */
+  else
+    val = (*cinfo->marker->read_markers) (cinfo);
 
   switch (val) {
   case JPEG_REACHED_SOS:	/* Found SOS */
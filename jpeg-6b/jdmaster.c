@@ -44,13 +44,15 @@ LOCAL(boolean)
 use_merged_upsample (j_decompress_ptr cinfo)
 {
 #ifdef UPSAMPLE_MERGING_SUPPORTED
+  int offsets[4];
+
   /* Merging is the equivalent of plain box-filter upsampling */
   if (cinfo->do_fancy_upsampling || cinfo->CCIR601_sampling)
     return FALSE;
-  /* jdmerge.c only supports YCC=>RGB color conversion */
+  /* jdmerge.c only supports YCC=>RGB color conversion (any RGB layout) */
   if (cinfo->jpeg_color_space != JCS_YCbCr || cinfo->num_components != 3 ||
-      cinfo->out_color_space != JCS_RGB ||
-      cinfo->out_color_components != RGB_PIXELSIZE)
+      jrgb_pixel_layout(cinfo->out_color_space, offsets) !=
+      cinfo->out_color_components)
     return FALSE;
   /* and it only handles 2h1v or 2h2v sampling ratios */
   if (cinfo->comp_info[0].h_samp_factor != 2 ||
@@ -73,6 +75,77 @@ use_merged_upsample (j_decompress_ptr cinfo)
 }
 
 
+/*
+ * Determine whether the parallel coefficient controller (jdparal.c) can be
+ * used: the application must allow more than one thread, and the file must
+ * be a single sequential Huffman-coded scan with restart markers.
+ * This is called once the first SOS marker has been read.
+ */
+
+LOCAL(boolean)
+use_parallel_decoding (j_decompress_ptr cinfo)
+{
+#ifdef D_THREADS_SUPPORTED
+  if (cinfo->num_threads == 1 || cinfo->restart_interval == 0)
+    return FALSE;
+  if (cinfo->inputctl->has_multiple_scans || cinfo->buffered_image ||
+      cinfo->progressive_mode || cinfo->arith_code)
+    return FALSE;
+  /* jdhuff.c warns at every start_pass about bogus sequential parameters */
+  if (cinfo->Ss != 0 || cinfo->Se != DCTSIZE2-1 ||
+      cinfo->Ah != 0 || cinfo->Al != 0)
+    return FALSE;
+  return TRUE;
+#else
+  return FALSE;
+#endif
+}
+
+
+#ifdef IDCT_SCALING_SUPPORTED
+
+/* The number of leading coefficients, in zigzag order, that contain all
+ * of the top-left NxN coefficients of a block; indexed by N.
+ */
+
+static const int zigzag_limit[DCTSIZE+1] = { 0, 1, 5, 13, 25, 40, 52, 60, 64 };
+
+#endif
+
+
+/*
+ * In thumbnail mode, compute the output size: the image scaled down, if
+ * necessary, to fit within the box.  The aspect ratio is kept, rounding
+ * the other dimension to nearest.
+ */
+
+LOCAL(void)
+calc_thumbnail_size (j_decompress_ptr cinfo,
+		     JDIMENSION box_width, JDIMENSION box_height,
+		     JDIMENSION * width, JDIMENSION * height)
+{
+  double ratio;
+
+  if (box_width >= cinfo->image_width && box_height >= cinfo->image_height) {
+    *width = cinfo->image_width;
+    *height = cinfo->image_height;
+  } else if ((double) box_width * (double) cinfo->image_height <=
+	     (double) box_height * (double) cinfo->image_width) {
+    ratio = (double) box_width / (double) cinfo->image_width;
+    *width = box_width;
+    *height = (JDIMENSION) (ratio * (double) cinfo->image_height + 0.5);
+  } else {
+    ratio = (double) box_height / (double) cinfo->image_height;
+    *width = (JDIMENSION) (ratio * (double) cinfo->image_width + 0.5);
+    *height = box_height;
+  }
+  if (*width < 1)
+    *width = 1;
+  if (*height < 1)
+    *height = 1;
+}
+
+
 /*
  * Compute output image dimensions and related values.
  * NOTE: this is exported for possible use by application.
@@ -84,8 +157,10 @@ GLOBAL(void)
 jpeg_calc_output_dimensions (j_decompress_ptr cinfo)
 /* Do computations that are needed before master selection phase */
 {
+  boolean thumbnail;
+  JDIMENSION box_width, box_height, thumb_width, thumb_height;
 #ifdef IDCT_SCALING_SUPPORTED
-  int ci;
+  int ci, scale, fit;
   jpeg_component_info *compptr;
 #endif
 
@@ -93,45 +168,71 @@ jpeg_calc_output_dimensions (j_decompress_ptr cinfo)
   if (cinfo->global_state != DSTATE_READY)
     ERREXIT1(cinfo, JERR_BAD_STATE, cinfo->global_state);
 
+  /* In thumbnail mode, a zero box dimension means no limit.
+   * As we never enlarge the image, the box can be clipped to its size.
+   */
+  thumbnail = (cinfo->max_output_width != 0 || cinfo->max_output_height != 0);
+  box_width = cinfo->image_width;
+  if (cinfo->max_output_width != 0 && cinfo->max_output_width < box_width)
+    box_width = cinfo->max_output_width;
+  box_height = cinfo->image_height;
+  if (cinfo->max_output_height != 0 && cinfo->max_output_height < box_height)
+    box_height = cinfo->max_output_height;
+  thumb_width = thumb_height = 0;
+  if (thumbnail)
+    calc_thumbnail_size(cinfo, box_width, box_height,
+			&thumb_width, &thumb_height);
+
 #ifdef IDCT_SCALING_SUPPORTED
 
-  /* Compute actual output image dimensions and DCT scaling choices. */
-  if (cinfo->scale_num * 8 <= cinfo->scale_denom) {
-    /* Provide 1/8 scaling */
-    cinfo->output_width = (JDIMENSION)
-      jdiv_round_up((long) cinfo->image_width, 8L);
-    cinfo->output_height = (JDIMENSION)
-      jdiv_round_up((long) cinfo->image_height, 8L);
-    cinfo->min_DCT_scaled_size = 1;
-  } else if (cinfo->scale_num * 4 <= cinfo->scale_denom) {
-    /* Provide 1/4 scaling */
-    cinfo->output_width = (JDIMENSION)
-      jdiv_round_up((long) cinfo->image_width, 4L);
-    cinfo->output_height = (JDIMENSION)
-      jdiv_round_up((long) cinfo->image_height, 4L);
-    cinfo->min_DCT_scaled_size = 2;
-  } else if (cinfo->scale_num * 2 <= cinfo->scale_denom) {
-    /* Provide 1/2 scaling */
-    cinfo->output_width = (JDIMENSION)
-      jdiv_round_up((long) cinfo->image_width, 2L);
-    cinfo->output_height = (JDIMENSION)
-      jdiv_round_up((long) cinfo->image_height, 2L);
-    cinfo->min_DCT_scaled_size = 4;
+  /* Compute actual output image dimensions and DCT scaling choices.
+   * We provide scalings of N/8 for N = 1..8.
+   */
+  if (thumbnail) {
+    /* Use the smallest scaling that is at least the thumbnail size... */
+    for (scale = 1; scale < DCTSIZE; scale++) {
+      if ((long) cinfo->image_width * scale >= (long) thumb_width * DCTSIZE &&
+	  (long) cinfo->image_height * scale >= (long) thumb_height * DCTSIZE)
+	break;
+    }
+    /* ...unless we needn't resample, in which case use the largest
+     * scaling that fits within the box.  If none fits, we must resample
+     * (or for raw data output, just use the smallest).
+     */
+    if (! cinfo->exact_output_size || cinfo->raw_data_out) {
+      for (fit = DCTSIZE; fit > 0; fit--) {
+	if (jdiv_round_up((long) cinfo->image_width * fit, (long) DCTSIZE) <=
+	    (long) box_width &&
+	    jdiv_round_up((long) cinfo->image_height * fit, (long) DCTSIZE) <=
+	    (long) box_height)
+	  break;
+      }
+      if (fit > 0)
+	scale = fit;
+      else if (cinfo->raw_data_out)
+	scale = 1;
+    }
   } else {
-    /* Provide 1/1 scaling */
-    cinfo->output_width = cinfo->image_width;
-    cinfo->output_height = cinfo->image_height;
-    cinfo->min_DCT_scaled_size = DCTSIZE;
+    /* Use the smallest scaling that is at least scale_num/scale_denom */
+    for (scale = 1; scale < DCTSIZE; scale++) {
+      if (cinfo->scale_num * DCTSIZE <= cinfo->scale_denom * scale)
+	break;
+    }
   }
+  cinfo->scaled_width = (JDIMENSION)
+    jdiv_round_up((long) cinfo->image_width * scale, (long) DCTSIZE);
+  cinfo->scaled_height = (JDIMENSION)
+    jdiv_round_up((long) cinfo->image_height * scale, (long) DCTSIZE);
+  cinfo->min_DCT_scaled_size = scale;
+
   /* In selecting the actual DCT scaling for each component, we try to
    * scale up the chroma components via IDCT scaling rather than upsampling.
    * This saves time if the upsampler gets to use 1:1 scaling.
-   * Note this code assumes that the supported DCT scalings are powers of 2.
    */
   for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
        ci++, compptr++) {
     int ssize = cinfo->min_DCT_scaled_size;
-    while (ssize < DCTSIZE &&
+    while (ssize * 2 <= DCTSIZE &&
 	   (compptr->h_samp_factor * ssize * 2 <=
 	    cinfo->max_h_samp_factor * cinfo->min_DCT_scaled_size) &&
 	   (compptr->v_samp_factor * ssize * 2 <=
@@ -139,6 +240,15 @@ jpeg_calc_output_dimensions (j_decompress_ptr cinfo)
       ssize = ssize * 2;
     }
     compptr->DCT_scaled_size = ssize;
+    /* The 2x2 and 4x4 IDCTs of jidctred.c use coefficients from the whole
+     * block.  In thumbnail mode, and for the other reduced sizes, we use
+     * the DCT-domain IDCT, which needs only the top-left NxN coefficients.
+     */
+    if (ssize == 1 || ssize == DCTSIZE ||
+	((ssize == 2 || ssize == 4) && ! thumbnail))
+      compptr->coef_limit = (ssize == 1 ? 1 : DCTSIZE2);
+    else
+      compptr->coef_limit = zigzag_limit[ssize];
   }
 
   /* Recompute downsampled dimensions of components;
@@ -160,14 +270,26 @@ jpeg_calc_output_dimensions (j_decompress_ptr cinfo)
 #else /* !IDCT_SCALING_SUPPORTED */
 
   /* Hardwire it to "no scaling" */
-  cinfo->output_width = cinfo->image_width;
-  cinfo->output_height = cinfo->image_height;
+  cinfo->scaled_width = cinfo->image_width;
+  cinfo->scaled_height = cinfo->image_height;
   /* jdinput.c has already initialized DCT_scaled_size to DCTSIZE,
    * and has computed unscaled downsampled_width and downsampled_height.
    */
 
 #endif /* IDCT_SCALING_SUPPORTED */
 
+  /* The output is the scaled image, resampled if need be in thumbnail
+   * mode (see jdresize.c).  Raw data output is never resampled.
+   */
+  cinfo->output_width = cinfo->scaled_width;
+  cinfo->output_height = cinfo->scaled_height;
+  if (thumbnail && ! cinfo->raw_data_out &&
+      (cinfo->exact_output_size ||
+       cinfo->scaled_width > box_width || cinfo->scaled_height > box_height)) {
+    cinfo->output_width = thumb_width;
+    cinfo->output_height = thumb_height;
+  }
+
   /* Report number of components in selected colorspace. */
   /* Probably this should be in the color conversion module... */
   switch (cinfo->out_color_space) {
@@ -184,6 +306,11 @@ jpeg_calc_output_dimensions (j_decompress_ptr cinfo)
     break;
   case JCS_CMYK:
   case JCS_YCCK:
+  case JCS_EXT_RGBX:
+  case JCS_EXT_BGRX:
+  case JCS_EXT_XRGB:
+  case JCS_EXT_RGBA:
+  case JCS_EXT_BGRA:
     cinfo->out_color_components = 4;
     break;
   default:			/* else must be same colorspace as in file */
@@ -296,14 +423,17 @@ master_selection (j_decompress_ptr cinfo)
   jpeg_calc_output_dimensions(cinfo);
   prepare_range_limit_table(cinfo);
 
-  /* Width of an output scanline must be representable as JDIMENSION. */
-  samplesperrow = (long) cinfo->output_width * (long) cinfo->out_color_components;
+  /* Width of an output scanline must be representable as JDIMENSION.
+   * (The scaled image is never narrower than the output.)
+   */
+  samplesperrow = (long) cinfo->scaled_width * (long) cinfo->out_color_components;
   jd_samplesperrow = (JDIMENSION) samplesperrow;
   if ((long) jd_samplesperrow != samplesperrow)
     ERREXIT(cinfo, JERR_WIDTH_OVERFLOW);
 
   /* Initialize my private state */
   master->pass_number = 0;
+  cinfo->resize = NULL;		/* until jinit_resizer says otherwise */
   master->using_merged_upsample = use_merged_upsample(cinfo);
 
   /* Color quantizer selection */
@@ -318,6 +448,9 @@ master_selection (j_decompress_ptr cinfo)
   if (cinfo->quantize_colors) {
     if (cinfo->raw_data_out)
       ERREXIT(cinfo, JERR_NOTIMPL);
+    /* The quantizers know nothing of the 4-byte RGB layouts. */
+    if (cinfo->out_color_space >= JCS_EXT_RGBX)
+      ERREXIT(cinfo, JERR_NOTIMPL);
     /* 2-pass quantizer only works in 3-component color space. */
     if (cinfo->out_color_components != 3) {
       cinfo->enable_1pass_quant = TRUE;
@@ -367,6 +500,10 @@ master_selection (j_decompress_ptr cinfo)
       jinit_color_deconverter(cinfo);
       jinit_upsampler(cinfo);
     }
+    /* Thumbnail resampling of the upsampler's output */
+    if (cinfo->output_width != cinfo->scaled_width ||
+	cinfo->output_height != cinfo->scaled_height)
+      jinit_resizer(cinfo);
     jinit_d_post_controller(cinfo, cinfo->enable_2pass_quant);
   }
   /* Inverse DCT */
@@ -387,7 +524,12 @@ master_selection (j_decompress_ptr cinfo)
 
   /* Initialize principal buffer controllers. */
   use_c_buffer = cinfo->inputctl->has_multiple_scans || cinfo->buffered_image;
-  jinit_d_coef_controller(cinfo, use_c_buffer);
+#ifdef D_THREADS_SUPPORTED
+  if (use_parallel_decoding(cinfo))
+    jinit_d_parallel_controller(cinfo);
+  else
+#endif
+    jinit_d_coef_controller(cinfo, use_c_buffer);
 
   if (! cinfo->raw_data_out)
     jinit_d_main_controller(cinfo, FALSE /* never need full buffer here */);
@@ -467,6 +609,8 @@ prepare_for_output_pass (j_decompress_ptr cinfo)
       if (! master->using_merged_upsample)
 	(*cinfo->cconvert->start_pass) (cinfo);
       (*cinfo->upsample->start_pass) (cinfo);
+      if (cinfo->resize != NULL)
+	(*cinfo->resize->start_pass) (cinfo);
       if (cinfo->quantize_colors)
 	(*cinfo->cquantize->start_pass) (cinfo, master->pub.is_dummy_pass);
       (*cinfo->post->start_pass) (cinfo,
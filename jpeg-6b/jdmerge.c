@@ -23,7 +23,7 @@
  * multiplications needed for color conversion.
  *
  * This file currently provides implementations for the following cases:
- *	YCbCr => RGB color conversion only.
+ *	YCbCr => RGB color conversion only (JCS_RGB or a 4-byte RGB layout).
  *	Sampling ratios of 2h1v or 2h2v.
  *	No scaling needed at upsample time.
  *	Corner-aligned (non-CCIR601) sampling alignment.
@@ -35,6 +35,7 @@
 #define JPEG_INTERNALS
 #include "jinclude.h"
 #include "jpeglib.h"
+#include "jsimd.h"
 
 #ifdef UPSAMPLE_MERGING_SUPPORTED
 
@@ -55,6 +56,9 @@ typedef struct {
   INT32 * Cr_g_tab;		/* => table for Cr to G conversion */
   INT32 * Cb_g_tab;		/* => table for Cb to G conversion */
 
+  /* Layout of 4-byte RGB output pixels (JCS_EXT_xxx), see jrgb_pixel_layout */
+  int rgb_offset[4];		/* offsets of R, G, B and the X/alpha byte */
+
   /* For 2:1 vertical sampling, we produce two output rows at a time.
    * We need a "spare" row buffer to hold the second output row if the
    * application provides just a one-row buffer; we also use the spare
@@ -130,7 +134,7 @@ start_pass_merged_upsample (j_decompress_ptr cinfo)
   /* Mark the spare buffer empty */
   upsample->spare_full = FALSE;
   /* Initialize total-height counter for detecting bottom of image */
-  upsample->rows_to_go = cinfo->output_height;
+  upsample->rows_to_go = cinfo->scaled_height;
 }
 
 
@@ -246,7 +250,7 @@ h2v1_merged_upsample (j_decompress_ptr cinfo,
   inptr2 = input_buf[2][in_row_group_ctr];
   outptr = output_buf[0];
   /* Loop for each pair of output pixels */
-  for (col = cinfo->output_width >> 1; col > 0; col--) {
+  for (col = cinfo->scaled_width >> 1; col > 0; col--) {
     /* Do the chroma part of the calculation */
     cb = GETJSAMPLE(*inptr1++);
     cr = GETJSAMPLE(*inptr2++);
@@ -266,7 +270,7 @@ h2v1_merged_upsample (j_decompress_ptr cinfo,
     outptr += RGB_PIXELSIZE;
   }
   /* If image width is odd, do the last output column separately */
-  if (cinfo->output_width & 1) {
+  if (cinfo->scaled_width & 1) {
     cb = GETJSAMPLE(*inptr1);
     cr = GETJSAMPLE(*inptr2);
     cred = Crrtab[cr];
@@ -310,7 +314,7 @@ h2v2_merged_upsample (j_decompress_ptr cinfo,
   outptr0 = output_buf[0];
   outptr1 = output_buf[1];
   /* Loop for each group of output pixels */
-  for (col = cinfo->output_width >> 1; col > 0; col--) {
+  for (col = cinfo->scaled_width >> 1; col > 0; col--) {
     /* Do the chroma part of the calculation */
     cb = GETJSAMPLE(*inptr1++);
     cr = GETJSAMPLE(*inptr2++);
@@ -340,7 +344,7 @@ h2v2_merged_upsample (j_decompress_ptr cinfo,
     outptr1 += RGB_PIXELSIZE;
   }
   /* If image width is odd, do the last output column separately */
-  if (cinfo->output_width & 1) {
+  if (cinfo->scaled_width & 1) {
     cb = GETJSAMPLE(*inptr1);
     cr = GETJSAMPLE(*inptr2);
     cred = Crrtab[cr];
@@ -358,6 +362,92 @@ h2v2_merged_upsample (j_decompress_ptr cinfo,
 }
 
 
+/*
+ * The same for the 4-byte RGB layouts.  One output row is done per call;
+ * for 2:1 vertical sampling the chroma part is simply computed twice.
+ * The X/alpha byte is set to MAXJSAMPLE.
+ */
+
+LOCAL(void)
+merged_extrgb_row (j_decompress_ptr cinfo, JSAMPROW inptr0,
+		   JSAMPROW inptr1, JSAMPROW inptr2, JSAMPROW outptr)
+{
+  my_upsample_ptr upsample = (my_upsample_ptr) cinfo->upsample;
+  register int y, cred, cgreen, cblue;
+  int cb, cr;
+  JDIMENSION col;
+  int rpos = upsample->rgb_offset[0];
+  int gpos = upsample->rgb_offset[1];
+  int bpos = upsample->rgb_offset[2];
+  int xpos = upsample->rgb_offset[3];
+  /* copy these pointers into registers if possible */
+  register JSAMPLE * range_limit = cinfo->sample_range_limit;
+  int * Crrtab = upsample->Cr_r_tab;
+  int * Cbbtab = upsample->Cb_b_tab;
+  INT32 * Crgtab = upsample->Cr_g_tab;
+  INT32 * Cbgtab = upsample->Cb_g_tab;
+  SHIFT_TEMPS
+
+  /* Loop for each pair of output pixels */
+  for (col = cinfo->scaled_width >> 1; col > 0; col--) {
+    /* Do the chroma part of the calculation */
+    cb = GETJSAMPLE(*inptr1++);
+    cr = GETJSAMPLE(*inptr2++);
+    cred = Crrtab[cr];
+    cgreen = (int) RIGHT_SHIFT(Cbgtab[cb] + Crgtab[cr], SCALEBITS);
+    cblue = Cbbtab[cb];
+    /* Fetch 2 Y values and emit 2 pixels */
+    y  = GETJSAMPLE(*inptr0++);
+    outptr[rpos] = range_limit[y + cred];
+    outptr[gpos] = range_limit[y + cgreen];
+    outptr[bpos] = range_limit[y + cblue];
+    outptr[xpos] = MAXJSAMPLE;
+    y  = GETJSAMPLE(*inptr0++);
+    outptr[rpos + 4] = range_limit[y + cred];
+    outptr[gpos + 4] = range_limit[y + cgreen];
+    outptr[bpos + 4] = range_limit[y + cblue];
+    outptr[xpos + 4] = MAXJSAMPLE;
+    outptr += 8;
+  }
+  /* If image width is odd, do the last output column separately */
+  if (cinfo->scaled_width & 1) {
+    cb = GETJSAMPLE(*inptr1);
+    cr = GETJSAMPLE(*inptr2);
+    y  = GETJSAMPLE(*inptr0);
+    outptr[rpos] = range_limit[y + Crrtab[cr]];
+    outptr[gpos] = range_limit[y + (int) RIGHT_SHIFT(Cbgtab[cb] + Crgtab[cr],
+						      SCALEBITS)];
+    outptr[bpos] = range_limit[y + Cbbtab[cb]];
+    outptr[xpos] = MAXJSAMPLE;
+  }
+}
+
+
+METHODDEF(void)
+h2v1_merged_extrgb (j_decompress_ptr cinfo,
+		    JSAMPIMAGE input_buf, JDIMENSION in_row_group_ctr,
+		    JSAMPARRAY output_buf)
+{
+  merged_extrgb_row(cinfo, input_buf[0][in_row_group_ctr],
+		    input_buf[1][in_row_group_ctr],
+		    input_buf[2][in_row_group_ctr], output_buf[0]);
+}
+
+
+METHODDEF(void)
+h2v2_merged_extrgb (j_decompress_ptr cinfo,
+		    JSAMPIMAGE input_buf, JDIMENSION in_row_group_ctr,
+		    JSAMPARRAY output_buf)
+{
+  merged_extrgb_row(cinfo, input_buf[0][in_row_group_ctr*2],
+		    input_buf[1][in_row_group_ctr],
+		    input_buf[2][in_row_group_ctr], output_buf[0]);
+  merged_extrgb_row(cinfo, input_buf[0][in_row_group_ctr*2 + 1],
+		    input_buf[1][in_row_group_ctr],
+		    input_buf[2][in_row_group_ctr], output_buf[1]);
+}
+
+
 /*
  * Module initialization routine for merged upsampling/color conversion.
  *
@@ -378,7 +468,7 @@ jinit_merged_upsampler (j_decompress_ptr cinfo)
   upsample->pub.start_pass = start_pass_merged_upsample;
   upsample->pub.need_context_rows = FALSE;
 
-  upsample->out_row_width = cinfo->output_width * cinfo->out_color_components;
+  upsample->out_row_width = cinfo->scaled_width * cinfo->out_color_components;
 
   if (cinfo->max_v_samp_factor == 2) {
     upsample->pub.upsample = merged_2v_upsample;
@@ -394,7 +484,20 @@ jinit_merged_upsampler (j_decompress_ptr cinfo)
     upsample->spare_row = NULL;
   }
 
+  if (cinfo->out_color_space != JCS_RGB) {
+    (void) jrgb_pixel_layout(cinfo->out_color_space, upsample->rgb_offset);
+    upsample->upmethod = (cinfo->max_v_samp_factor == 2) ?
+			 h2v2_merged_extrgb : h2v1_merged_extrgb;
+  }
+
   build_ycc_rgb_table(cinfo);
+
+#ifdef SIMD_SUPPORTED
+  if (jsimd_can_merged_upsample())
+    upsample->upmethod = (cinfo->max_v_samp_factor == 2) ?
+			 jsimd_h2v2_merged_upsample :
+			 jsimd_h2v1_merged_upsample;
+#endif
 }
 
 #endif /* UPSAMPLE_MERGING_SUPPORTED */
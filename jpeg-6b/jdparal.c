@@ -0,0 +1,795 @@
+/*
+ * jdparal.c
+ *
+ * Copyright (C) 1994-1997, Thomas G. Lane.
+ * This file is part of the Independent JPEG Group's software.
+ * For conditions of distribution and use, see the accompanying README file.
+ *
+ * This file contains a coefficient controller for decompression that
+ * decodes a single-scan sequential file on several threads.  It takes the
+ * place of jdcoefct.c's single-pass controller when the application allows
+ * more than one thread (cinfo->num_threads) and the scan has restarts.
+ *
+ * Each restart marker resets the entropy decoder's state (the bit buffer
+ * and the DC predictions), so the data following it can be decoded without
+ * reference to what came before.  On the first call for output data we
+ * read the whole scan into memory, noting where the restart markers fall,
+ * and divide the image into bands of iMCU rows that each begin at a restart
+ * marker.  The calling thread and the workers then take bands in turn,
+ * entropy-decode them and IDCT them into a full-image sample buffer for
+ * each component.  All the threads are joined before we return, so an
+ * error or jpeg_abort never finds any of them still running.  Thereafter
+ * we hand the main controller one iMCU row per call from the buffers.
+ *
+ * Each worker has a private copy of the decompression object, with its own
+ * entropy decoder, data source, restart marker state and error manager, so
+ * the decoding modules need not be reentrant.  Warnings issued while
+ * decoding a band are saved, and reissued on the calling thread in band
+ * order once all are done (trace messages are dropped).  An error is
+ * reissued the same way.
+ *
+ * If the restart markers are not all present and in sequence, or the data
+ * holds invalid marker codes, the band boundaries cannot be trusted, so the
+ * whole scan is decoded as one band; the entropy decoder then recovers from
+ * the damage as usual.  At the end of each band we skip to the following
+ * marker as the serial decoder would, so the image and the warnings match
+ * (the count can differ by one where corrupt data leaves whole bytes in the
+ * entropy decoder's bit buffer, which serial decoding reports as skipped).
+ */
+
+#define JPEG_INTERNALS
+#include "jinclude.h"
+#include "jpeglib.h"
+
+#ifdef D_THREADS_SUPPORTED
+
+#include "jthread.h"
+#include <setjmp.h>
+
+
+/* We aim for this many bands per thread, to even out the load. */
+#define BANDS_PER_THREAD  4
+
+/* Warnings saved per band.  If there are more, the last saved one is
+ * reissued in their place, which at least keeps the count right.
+ */
+#define MAX_BAND_WARNINGS  4
+
+
+typedef struct {		/* A saved warning or error message */
+  int msg_code;
+  union {
+    int i[8];
+    char s[JMSG_STR_PARM_MAX];
+  } msg_parm;
+} saved_message;
+
+typedef struct {		/* A band of iMCU rows */
+  JDIMENSION start_row;		/* first iMCU row in band */
+  JDIMENSION end_row;		/* iMCU row following band */
+  long first_interval;		/* index of first restart interval in band */
+  size_t data_offset;		/* where its data starts in the scan data */
+  boolean located;		/* data_offset is known */
+  int num_warnings;		/* # of warnings issued while decoding it */
+  saved_message warnings[MAX_BAND_WARNINGS];
+  boolean failed;		/* decoding stopped with an error */
+  saved_message error;
+} band_info;
+
+struct my_parallel_controller;
+
+typedef struct {
+  /* Private copy of the decompression object.  This must come first, as
+   * the error manager methods find the worker from the cinfo pointer.
+   */
+  struct jpeg_decompress_struct cinfo;
+  struct jpeg_error_mgr err;	/* collects warnings, traps errors */
+  struct jpeg_source_mgr src;	/* reads the scan data from memory */
+  struct jpeg_marker_reader marker; /* restart marker state */
+
+  JBLOCKROW MCU_buffer[D_MAX_BLOCKS_IN_MCU];
+
+  struct my_parallel_controller * parent;
+  band_info * band;		/* band being decoded */
+  jmp_buf setjmp_buffer;	/* for return from error_exit */
+  jthread_ptr thread;		/* NULL for the calling thread */
+} my_worker;
+
+typedef my_worker * my_worker_ptr;
+
+typedef struct my_parallel_controller {
+  struct jpeg_d_coef_controller pub; /* public fields */
+
+  /* Sample buffers for the whole image, or NULL for unneeded components */
+  JSAMPARRAY whole_image[MAX_COMPONENTS];
+
+  JDIMENSION MCUs_per_iMCU_row;	/* # of MCUs in a full iMCU row */
+  int num_threads;		/* # of threads we may use */
+
+  /* The scan data, read by the first decompress_data call */
+  const JOCTET * data;		/* scan data, up to and including the marker
+				 * that ends it */
+  size_t data_len;
+  JOCTET * data_buf;		/* our copy, unless it was all in the source
+				 * buffer at once */
+  size_t data_size;		/* allocated size of data_buf */
+  boolean scan_read;		/* TRUE when data is complete */
+  boolean saw_ff;		/* last byte read was an FF */
+  long restarts_seen;		/* # of RSTn markers read */
+  boolean restarts_ok;		/* all in sequence so far */
+  boolean decoded;		/* TRUE when the bands are done */
+  int end_marker;		/* marker found after the last band, or 0 */
+
+  band_info * bands;
+  int num_bands;
+  int band_ctr;			/* next band to locate, then to decode */
+  jmutex_ptr mutex;		/* guards band_ctr and stop while decoding */
+  boolean stop;			/* an error occurred, take no more bands */
+} my_parallel_controller;
+
+typedef my_parallel_controller * my_parallel_ptr;
+
+
+LOCAL(long)
+gcd (long a, long b)
+{
+  long t;
+
+  while (b != 0) {
+    t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+
+/*
+ * Initialize for an input processing pass.
+ * Here we divide the image into bands.
+ */
+
+METHODDEF(void)
+start_input_pass (j_decompress_ptr cinfo)
+{
+  my_parallel_ptr par = (my_parallel_ptr) cinfo->coef;
+  long period, step, rows;
+  int b;
+
+  cinfo->input_iMCU_row = 0;
+
+  /* In an interleaved scan, an iMCU row is one MCU row; in a noninterleaved
+   * scan it is v_samp_factor MCU rows.
+   */
+  par->MCUs_per_iMCU_row = cinfo->MCUs_per_row;
+  if (cinfo->comps_in_scan == 1)
+    par->MCUs_per_iMCU_row *=
+      (JDIMENSION) cinfo->cur_comp_info[0]->v_samp_factor;
+
+  /* A band may begin only at an iMCU row that begins a restart interval;
+   * these come every 'period' iMCU rows.  Make the bands a multiple of
+   * that, and as near BANDS_PER_THREAD bands per thread as can be.
+   */
+  rows = (long) cinfo->total_iMCU_rows;
+  period = (long) cinfo->restart_interval /
+	   gcd((long) par->MCUs_per_iMCU_row, (long) cinfo->restart_interval);
+  step = jdiv_round_up(rows, period * par->num_threads * BANDS_PER_THREAD);
+  step *= period;
+  par->num_bands = (int) jdiv_round_up(rows, step);
+
+  par->bands = (band_info *)
+    (*cinfo->mem->alloc_small) ((j_common_ptr) cinfo, JPOOL_IMAGE,
+				par->num_bands * SIZEOF(band_info));
+  for (b = 0; b < par->num_bands; b++) {
+    par->bands[b].start_row = (JDIMENSION) (b * step);
+    par->bands[b].end_row = (JDIMENSION) MIN((b + 1) * step, rows);
+    par->bands[b].first_interval = (long) par->bands[b].start_row *
+      (long) par->MCUs_per_iMCU_row / (long) cinfo->restart_interval;
+    par->bands[b].data_offset = 0;
+    par->bands[b].located = (b == 0);
+    par->bands[b].num_warnings = 0;
+    par->bands[b].failed = FALSE;
+  }
+  par->band_ctr = 1;		/* band 0 starts with the scan */
+}
+
+
+/*
+ * Initialize for an output processing pass.
+ */
+
+METHODDEF(void)
+start_output_pass (j_decompress_ptr cinfo)
+{
+  cinfo->output_iMCU_row = 0;
+}
+
+
+/*
+ * Append some scan data to our copy, enlarging it as needed.
+ */
+
+LOCAL(void)
+save_data (j_decompress_ptr cinfo, const JOCTET * buf, size_t nbytes)
+{
+  my_parallel_ptr par = (my_parallel_ptr) cinfo->coef;
+  JOCTET * newbuf;
+  size_t newsize;
+
+  if (par->data_len + nbytes > par->data_size) {
+    newsize = MAX(par->data_size * 2, par->data_len + nbytes);
+    newsize = MAX(newsize, 65536);
+    newbuf = (JOCTET *)
+      (*cinfo->mem->alloc_large) ((j_common_ptr) cinfo, JPOOL_IMAGE, newsize);
+    if (par->data_len > 0)
+      MEMCOPY(newbuf, par->data_buf, par->data_len);
+    par->data_buf = newbuf;
+    par->data_size = newsize;
+  }
+  MEMCOPY(par->data_buf + par->data_len, buf, nbytes);
+}
+
+
+/*
+ * Note an RSTn marker, whose data segment begins at 'offset'.
+ */
+
+LOCAL(void)
+saw_restart (my_parallel_ptr par, int marker, size_t offset)
+{
+  band_info * band;
+
+  if (marker != JPEG_RST0 + (int) (par->restarts_seen & 7))
+    par->restarts_ok = FALSE;
+  par->restarts_seen++;
+
+  if (par->band_ctr < par->num_bands) {
+    band = &par->bands[par->band_ctr];
+    if (band->first_interval == par->restarts_seen) {
+      band->data_offset = offset;
+      band->located = TRUE;
+      par->band_ctr++;
+    }
+  }
+}
+
+
+/*
+ * Read the rest of the scan into memory, up to and including the marker
+ * that ends it, and find the restart markers at which the bands begin.
+ * We take the marker as the entropy decoder would, leaving it in
+ * cinfo->unread_marker for the input controller.
+ * Returns FALSE if must suspend; we can pick up where we left off.
+ */
+
+LOCAL(boolean)
+read_scan_data (j_decompress_ptr cinfo)
+{
+  my_parallel_ptr par = (my_parallel_ptr) cinfo->coef;
+  struct jpeg_source_mgr * src = cinfo->src;
+  const JOCTET * buf;
+  const JOCTET * ptr;
+  const JOCTET * end;
+  size_t nbytes;
+  int c;
+
+  for (;;) {
+    if (src->bytes_in_buffer == 0) {
+      if (! (*src->fill_input_buffer) (cinfo))
+	return FALSE;
+      continue;
+    }
+    buf = src->next_input_byte;
+    end = buf + src->bytes_in_buffer;
+    ptr = buf;
+    /* Scan for a marker.  FF/00 is stuffed data, FF/FF is fill, and the
+     * RSTn markers lie within the scan.  So do codes below SOF0, which
+     * are not valid markers but corrupt data.  The entropy decoder stops
+     * at them and resyncs (see jpeg_resync_to_restart), which may throw
+     * the restart intervals out of step with our bands, so we then decode
+     * the scan as one band.  Any other marker ends the scan.
+     */
+    while (ptr < end) {
+      if (! par->saw_ff) {
+	ptr = (const JOCTET *) memchr((const void *) ptr, 0xFF,
+				      (size_t) (end - ptr));
+	if (ptr == NULL) {
+	  ptr = end;
+	  break;
+	}
+	ptr++;
+	par->saw_ff = TRUE;
+	continue;
+      }
+      c = GETJOCTET(*ptr++);
+      if (c == 0xFF)
+	continue;
+      par->saw_ff = FALSE;
+      if (c == 0)
+	continue;
+      if (c >= JPEG_RST0 && c <= JPEG_RST0 + 7) {
+	saw_restart(par, c, par->data_len + (size_t) (ptr - buf));
+	continue;
+      }
+      if (c < 0xC0) {		/* SOF0 */
+	par->restarts_ok = FALSE;
+	continue;
+      }
+      cinfo->unread_marker = c;
+      par->scan_read = TRUE;
+      break;
+    }
+
+    nbytes = (size_t) (ptr - buf);
+    if (par->scan_read && par->data_len == 0) {
+      /* The whole scan was in the source buffer, which will stay put until
+       * the next fill_input_buffer call, so we can decode it in place.
+       */
+      par->data = buf;
+    } else {
+      save_data(cinfo, buf, nbytes);
+      par->data = par->data_buf;
+    }
+    par->data_len += nbytes;
+    src->next_input_byte += nbytes;
+    src->bytes_in_buffer -= nbytes;
+    if (par->scan_read)
+      return TRUE;
+  }
+}
+
+
+/*
+ * Error manager methods for the workers.
+ */
+
+LOCAL(void)
+save_message (j_common_ptr cinfo, saved_message * msg)
+{
+  msg->msg_code = cinfo->err->msg_code;
+  MEMCOPY(&msg->msg_parm, &cinfo->err->msg_parm, SIZEOF(msg->msg_parm));
+}
+
+METHODDEF(void)
+worker_emit_message (j_common_ptr cinfo, int msg_level)
+{
+  band_info * band = ((my_worker_ptr) cinfo)->band;
+
+  if (msg_level >= 0)		/* trace messages are dropped */
+    return;
+  if (band->num_warnings < MAX_BAND_WARNINGS)
+    save_message(cinfo, &band->warnings[band->num_warnings]);
+  band->num_warnings++;
+}
+
+METHODDEF(void)
+worker_error_exit (j_common_ptr cinfo)
+{
+  my_worker_ptr worker = (my_worker_ptr) cinfo;
+
+  save_message(cinfo, &worker->band->error);
+  worker->band->failed = TRUE;
+  longjmp(worker->setjmp_buffer, 1);
+}
+
+
+/*
+ * At the end of a band, skip to the marker that follows it, as the serial
+ * decoder would: to the next band's RSTn (see process_restart in jdhuff.c),
+ * or after the last band to the marker the input controller sees next.
+ * Corrupt data may leave the entropy decoder stopped short of the marker,
+ * so we skip along as next_marker and read_markers in jdmarker.c would,
+ * warning of any data skipped.  Stray RSTn after the last band are passed
+ * over if pass_restarts.  Returns the marker, or 0 if none was found.
+ */
+
+LOCAL(int)
+skip_to_marker (j_decompress_ptr cinfo, boolean pass_restarts)
+{
+  const JOCTET * ptr = cinfo->src->next_input_byte;
+  const JOCTET * end = ptr + cinfo->src->bytes_in_buffer;
+  long discarded = (long) cinfo->marker->discarded_bytes;
+  int c = cinfo->unread_marker;
+
+  for (;;) {
+    if (pass_restarts && c >= JPEG_RST0 && c <= JPEG_RST0 + 7)
+      c = 0;
+    if (c != 0)
+      return c;
+    while (ptr < end && GETJOCTET(*ptr) != 0xFF) {
+      ptr++;
+      discarded++;
+    }
+    while (ptr < end && GETJOCTET(*ptr) == 0xFF)
+      ptr++;
+    if (ptr >= end)
+      return 0;
+    c = GETJOCTET(*ptr++);
+    if (c == 0) {
+      discarded += 2;		/* stuffed zero, keep looking */
+    } else if (discarded != 0) {
+      WARNMS2(cinfo, JWRN_EXTRANEOUS_DATA, (int) discarded, c);
+      discarded = 0;
+    }
+  }
+}
+
+
+/*
+ * Entropy-decode and IDCT one band into the whole-image buffers.
+ * This is decompress_onepass of jdcoefct.c, looping over the band's rows.
+ */
+
+LOCAL(void)
+decode_band (my_worker_ptr worker, band_info * band)
+{
+  j_decompress_ptr cinfo = &worker->cinfo;
+  my_parallel_ptr par = worker->parent;
+  JDIMENSION MCU_col_num;	/* index of current MCU within row */
+  JDIMENSION last_MCU_col = cinfo->MCUs_per_row - 1;
+  JDIMENSION last_iMCU_row = cinfo->total_iMCU_rows - 1;
+  JDIMENSION iMCU_row;
+  int blkn, ci, xindex, yindex, yoffset, useful_width, MCU_rows;
+  JSAMPARRAY output_ptr;
+  JDIMENSION start_col, output_col;
+  jpeg_component_info *compptr;
+  inverse_DCT_method_ptr inverse_DCT;
+
+  /* Start the entropy decoder afresh at the band's restart marker */
+  cinfo->src->next_input_byte = par->data + band->data_offset;
+  cinfo->src->bytes_in_buffer = par->data_len - band->data_offset;
+  cinfo->unread_marker = 0;
+  cinfo->marker->next_restart_num = (int) (band->first_interval & 7);
+  cinfo->marker->discarded_bytes = 0;
+  (*cinfo->entropy->start_pass) (cinfo);
+
+  for (iMCU_row = band->start_row; iMCU_row < band->end_row; iMCU_row++) {
+    if (cinfo->comps_in_scan > 1)
+      MCU_rows = 1;
+    else if (iMCU_row < last_iMCU_row)
+      MCU_rows = cinfo->cur_comp_info[0]->v_samp_factor;
+    else
+      MCU_rows = cinfo->cur_comp_info[0]->last_row_height;
+
+    for (yoffset = 0; yoffset < MCU_rows; yoffset++) {
+      for (MCU_col_num = 0; MCU_col_num <= last_MCU_col; MCU_col_num++) {
+	/* Fetch an MCU.  The data is all in memory, so no suspension. */
+	jzero_far((void FAR *) worker->MCU_buffer[0],
+		  (size_t) (cinfo->blocks_in_MCU * SIZEOF(JBLOCK)));
+	(void) (*cinfo->entropy->decode_mcu) (cinfo, worker->MCU_buffer);
+	blkn = 0;			/* index of current DCT block within MCU */
+	for (ci = 0; ci < cinfo->comps_in_scan; ci++) {
+	  compptr = cinfo->cur_comp_info[ci];
+	  /* Don't bother to IDCT an uninteresting component. */
+	  if (! compptr->component_needed) {
+	    blkn += compptr->MCU_blocks;
+	    continue;
+	  }
+	  inverse_DCT = cinfo->idct->inverse_DCT[compptr->component_index];
+	  useful_width = (MCU_col_num < last_MCU_col) ? compptr->MCU_width
+						      : compptr->last_col_width;
+	  output_ptr = par->whole_image[compptr->component_index] +
+	    (iMCU_row * compptr->v_samp_factor + yoffset) *
+	    compptr->DCT_scaled_size;
+	  start_col = MCU_col_num * compptr->MCU_sample_width;
+	  for (yindex = 0; yindex < compptr->MCU_height; yindex++) {
+	    if (iMCU_row < last_iMCU_row ||
+		yoffset+yindex < compptr->last_row_height) {
+	      output_col = start_col;
+	      for (xindex = 0; xindex < useful_width; xindex++) {
+		(*inverse_DCT) (cinfo, compptr,
+				(JCOEFPTR) worker->MCU_buffer[blkn+xindex],
+				output_ptr, output_col);
+		output_col += compptr->DCT_scaled_size;
+	      }
+	    }
+	    blkn += compptr->MCU_width;
+	    output_ptr += compptr->DCT_scaled_size;
+	  }
+	}
+      }
+    }
+  }
+
+  if (band->end_row == cinfo->total_iMCU_rows)
+    par->end_marker = skip_to_marker(cinfo, TRUE);
+  else
+    (void) skip_to_marker(cinfo, FALSE);
+}
+
+
+/*
+ * Decode a band, returning FALSE if an error stopped it.
+ * worker_error_exit has then recorded the error in the band.
+ */
+
+LOCAL(boolean)
+decode_band_trapped (my_worker_ptr worker, band_info * band)
+{
+  if (setjmp(worker->setjmp_buffer))
+    return FALSE;
+  decode_band(worker, band);
+  return TRUE;
+}
+
+
+/*
+ * Take bands and decode them until there are none left.
+ * This is run by the calling thread as well as by the workers.
+ */
+
+LOCAL(void)
+run_worker (my_worker_ptr worker)
+{
+  my_parallel_ptr par = worker->parent;
+  band_info * band;
+
+  for (;;) {
+    if (par->mutex != NULL)
+      jmutex_lock(par->mutex);
+    if (par->stop || par->band_ctr >= par->num_bands) {
+      band = NULL;
+    } else {
+      band = &par->bands[par->band_ctr];
+      par->band_ctr++;
+    }
+    if (par->mutex != NULL)
+      jmutex_unlock(par->mutex);
+    if (band == NULL)
+      break;
+
+    worker->band = band;
+    if (! decode_band_trapped(worker, band)) {
+      if (par->mutex != NULL)
+	jmutex_lock(par->mutex);
+      par->stop = TRUE;
+      if (par->mutex != NULL)
+	jmutex_unlock(par->mutex);
+      break;
+    }
+  }
+}
+
+static void
+worker_main (void * arg)
+{
+  run_worker((my_worker_ptr) arg);
+}
+
+
+/*
+ * Set up a worker's private copy of the decompression object.
+ * This is done on the calling thread, as it allocates memory.
+ */
+
+LOCAL(void)
+init_worker (j_decompress_ptr cinfo, my_worker_ptr worker)
+{
+  my_parallel_ptr par = (my_parallel_ptr) cinfo->coef;
+  JBLOCKROW buffer;
+  int i;
+
+  worker->cinfo = *cinfo;
+  worker->parent = par;
+  worker->thread = NULL;
+
+  /* A memory source over the scan data (we position it for each band),
+   * and our own restart marker state.
+   */
+  worker->cinfo.src = &worker->src;
+  jpeg_mem_src(&worker->cinfo, (const unsigned char *) par->data,
+	       (unsigned long) par->data_len);
+  worker->marker = *cinfo->marker;
+  worker->cinfo.marker = &worker->marker;
+
+  /* An entropy decoder of our own.  Any error in setting it up still goes
+   * to the application's error manager.
+   */
+  jinit_huff_decoder(&worker->cinfo);
+  (*worker->cinfo.entropy->start_pass) (&worker->cinfo);
+
+  buffer = (JBLOCKROW)
+    (*cinfo->mem->alloc_large) ((j_common_ptr) cinfo, JPOOL_IMAGE,
+				D_MAX_BLOCKS_IN_MCU * SIZEOF(JBLOCK));
+  for (i = 0; i < D_MAX_BLOCKS_IN_MCU; i++) {
+    worker->MCU_buffer[i] = buffer + i;
+  }
+
+  /* From here on, messages are collected per band */
+  worker->cinfo.err = jpeg_std_error(&worker->err);
+  worker->err.error_exit = worker_error_exit;
+  worker->err.emit_message = worker_emit_message;
+}
+
+
+/*
+ * Decode all the bands, on as many threads as we may, then reissue any
+ * warnings and errors on the calling thread.
+ */
+
+LOCAL(void)
+decode_bands (j_decompress_ptr cinfo)
+{
+  my_parallel_ptr par = (my_parallel_ptr) cinfo->coef;
+  my_worker_ptr workers;
+  band_info * band;
+  int num_workers, w, b, i;
+
+  /* Unless we found every band's restart marker, and all the markers were
+   * in sequence, decode the scan as one band.
+   */
+  if (! par->restarts_ok || ! par->bands[par->num_bands-1].located) {
+    par->bands[0].end_row = cinfo->total_iMCU_rows;
+    par->num_bands = 1;
+  }
+
+  num_workers = MIN(par->num_threads, par->num_bands);
+  workers = (my_worker_ptr)
+    (*cinfo->mem->alloc_small) ((j_common_ptr) cinfo, JPOOL_IMAGE,
+				num_workers * SIZEOF(my_worker));
+  for (w = 0; w < num_workers; w++)
+    init_worker(cinfo, &workers[w]);
+
+  par->band_ctr = 0;
+  par->stop = FALSE;
+  par->end_marker = 0;
+  par->mutex = NULL;
+  if (num_workers > 1) {
+    par->mutex = jmutex_create();
+    if (par->mutex == NULL)
+      num_workers = 1;
+  }
+  /* If a thread can't be started, the others just do more of the work */
+  for (w = 1; w < num_workers; w++)
+    workers[w].thread = jthread_start(worker_main, (void *) &workers[w]);
+  run_worker(&workers[0]);
+  for (w = 1; w < num_workers; w++) {
+    if (workers[w].thread != NULL)
+      jthread_join(workers[w].thread);
+  }
+  if (par->mutex != NULL)
+    jmutex_destroy(par->mutex);
+  par->mutex = NULL;
+
+  /* Reissue the messages.  Bands after a failed one may not have been
+   * decoded, but the error ends decompression anyway.
+   */
+  for (b = 0; b < par->num_bands; b++) {
+    band = &par->bands[b];
+    for (i = 0; i < band->num_warnings; i++) {
+      saved_message * msg = &band->warnings[MIN(i, MAX_BAND_WARNINGS-1)];
+      cinfo->err->msg_code = msg->msg_code;
+      MEMCOPY(&cinfo->err->msg_parm, &msg->msg_parm, SIZEOF(msg->msg_parm));
+      (*cinfo->err->emit_message) ((j_common_ptr) cinfo, -1);
+    }
+    if (band->failed) {
+      cinfo->err->msg_code = band->error.msg_code;
+      MEMCOPY(&cinfo->err->msg_parm, &band->error.msg_parm,
+	      SIZEOF(band->error.msg_parm));
+      (*cinfo->err->error_exit) ((j_common_ptr) cinfo);
+    }
+  }
+  if (par->end_marker != 0)
+    cinfo->unread_marker = par->end_marker;
+  par->decoded = TRUE;
+}
+
+
+/*
+ * Decompress and return some data.
+ * The first call reads and decodes the whole scan; each call returns one
+ * iMCU row from the full-image buffers.
+ * Return value is JPEG_ROW_COMPLETED, JPEG_SCAN_COMPLETED, or JPEG_SUSPENDED.
+ *
+ * NB: output_buf contains a plane for each component in image,
+ * which we index according to the component's SOF position.
+ */
+
+METHODDEF(int)
+decompress_data (j_decompress_ptr cinfo, JSAMPIMAGE output_buf)
+{
+  my_parallel_ptr par = (my_parallel_ptr) cinfo->coef;
+  int ci, rows;
+  jpeg_component_info *compptr;
+
+  if (! par->decoded) {
+    if (! par->scan_read) {
+      if (! read_scan_data(cinfo))
+	return JPEG_SUSPENDED;
+    }
+    decode_bands(cinfo);
+  }
+
+  for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
+       ci++, compptr++) {
+    /* Don't bother to copy an uninteresting component. */
+    if (! compptr->component_needed)
+      continue;
+    /* Copy only the block rows that were decoded, as jdcoefct.c would
+     * write at the bottom of the image.
+     */
+    rows = compptr->v_samp_factor;
+    if (cinfo->output_iMCU_row == cinfo->total_iMCU_rows - 1)
+      rows = compptr->last_row_height;
+    jcopy_sample_rows(par->whole_image[ci],
+		      (int) cinfo->output_iMCU_row * compptr->v_samp_factor *
+		      compptr->DCT_scaled_size,
+		      output_buf[ci], 0, rows * compptr->DCT_scaled_size,
+		      compptr->width_in_blocks *
+		      (JDIMENSION) compptr->DCT_scaled_size);
+  }
+
+  /* Completed the iMCU row, advance counters for next one */
+  cinfo->output_iMCU_row++;
+  if (++(cinfo->input_iMCU_row) < cinfo->total_iMCU_rows)
+    return JPEG_ROW_COMPLETED;
+  /* Completed the scan */
+  (*cinfo->inputctl->finish_input_pass) (cinfo);
+  return JPEG_SCAN_COMPLETED;
+}
+
+
+/*
+ * Dummy consume-input routine, as for jdcoefct.c's single-pass operation.
+ */
+
+METHODDEF(int)
+dummy_consume_data (j_decompress_ptr cinfo)
+{
+  return JPEG_SUSPENDED;	/* Always indicate nothing was done */
+}
+
+
+/*
+ * Initialize the parallel coefficient controller.
+ */
+
+GLOBAL(void)
+jinit_d_parallel_controller (j_decompress_ptr cinfo)
+{
+  my_parallel_ptr par;
+  int ci;
+  jpeg_component_info *compptr;
+
+  par = (my_parallel_ptr)
+    (*cinfo->mem->alloc_small) ((j_common_ptr) cinfo, JPOOL_IMAGE,
+				SIZEOF(my_parallel_controller));
+  cinfo->coef = (struct jpeg_d_coef_controller *) par;
+  par->pub.start_input_pass = start_input_pass;
+  par->pub.start_output_pass = start_output_pass;
+  par->pub.consume_data = dummy_consume_data;
+  par->pub.decompress_data = decompress_data;
+  par->pub.coef_arrays = NULL;	/* flag for no virtual arrays */
+
+  par->num_threads = cinfo->num_threads;
+  if (par->num_threads <= 0)
+    par->num_threads = jthread_cpus();
+  if (par->num_threads > JMAX_THREADS)
+    par->num_threads = JMAX_THREADS;
+
+  /* Allocate the full-image sample buffers, padded to whole iMCU rows */
+  for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
+       ci++, compptr++) {
+    par->whole_image[ci] = NULL;
+    if (! compptr->component_needed)
+      continue;
+    par->whole_image[ci] = (*cinfo->mem->alloc_sarray)
+      ((j_common_ptr) cinfo, JPOOL_IMAGE,
+       compptr->width_in_blocks * (JDIMENSION) compptr->DCT_scaled_size,
+       cinfo->total_iMCU_rows * (JDIMENSION) (compptr->v_samp_factor *
+					       compptr->DCT_scaled_size));
+  }
+
+  par->data = NULL;
+  par->data_len = 0;
+  par->data_buf = NULL;
+  par->data_size = 0;
+  par->scan_read = FALSE;
+  par->saw_ff = FALSE;
+  par->restarts_seen = 0;
+  par->restarts_ok = TRUE;
+  par->decoded = FALSE;
+  par->mutex = NULL;
+}
+
+#endif /* D_THREADS_SUPPORTED */
@@ -82,6 +82,8 @@ METHODDEF(boolean) decode_mcu_DC_refine JPP((j_decompress_ptr cinfo,
 					     JBLOCKROW *MCU_data));
 METHODDEF(boolean) decode_mcu_AC_refine JPP((j_decompress_ptr cinfo,
 					     JBLOCKROW *MCU_data));
+METHODDEF(boolean) decode_mcu_skip JPP((j_decompress_ptr cinfo,
+					JBLOCKROW *MCU_data));
 
 
 /*
@@ -92,7 +94,7 @@ METHODDEF(void)
 start_pass_phuff_decoder (j_decompress_ptr cinfo)
 {
   phuff_entropy_ptr entropy = (phuff_entropy_ptr) cinfo->entropy;
-  boolean is_DC_band, bad;
+  boolean is_DC_band, bad, skip;
   int ci, coefi, tbl;
   int *coef_bit_ptr;
   jpeg_component_info * compptr;
@@ -145,8 +147,28 @@ start_pass_phuff_decoder (j_decompress_ptr cinfo)
     }
   }
 
+  /* We need not decode the scan at all if none of its components is
+   * wanted for output, or if it holds only coefficients that a reduced-size
+   * IDCT will not use (see jdmaster.c).  But an AC refinement scan needs to
+   * know which coefficients of its band are already nonzero; so unless
+   * this scan leaves the coefficients at full precision (Al = 0), a later
+   * refinement scan reaching down to the coefficients we do use would
+   * depend on it.  That cannot happen if we use only the DC coefficient.
+   */
+  skip = TRUE;
+  for (ci = 0; ci < cinfo->comps_in_scan; ci++) {
+    compptr = cinfo->cur_comp_info[ci];
+    if (! compptr->component_needed)
+      continue;
+    if (cinfo->Ss < compptr->coef_limit ||
+	(cinfo->Al != 0 && compptr->coef_limit > 1))
+      skip = FALSE;
+  }
+
   /* Select MCU decoding routine */
-  if (cinfo->Ah == 0) {
+  if (skip) {
+    entropy->pub.decode_mcu = decode_mcu_skip;
+  } else if (cinfo->Ah == 0) {
     if (is_DC_band)
       entropy->pub.decode_mcu = decode_mcu_DC_first;
     else
@@ -163,7 +185,9 @@ start_pass_phuff_decoder (j_decompress_ptr cinfo)
     /* Make sure requested tables are present, and compute derived tables.
      * We may build same derived table more than once, but it's not expensive.
      */
-    if (is_DC_band) {
+    if (skip) {
+      /* no tables needed */
+    } else if (is_DC_band) {
       if (cinfo->Ah == 0) {	/* DC refinement needs no table */
 	tbl = compptr->dc_tbl_no;
 	jpeg_make_d_derived_tbl(cinfo, TRUE, tbl,
@@ -260,6 +284,66 @@ process_restart (j_decompress_ptr cinfo)
 }
 
 
+/*
+ * Discard entropy-coded data up to the next marker, which is left in
+ * cinfo->unread_marker.  This is next_marker in jdmarker.c, except that
+ * the discarded bytes are expected, and are not counted or warned about.
+ * Returns FALSE if must suspend.
+ */
+
+LOCAL(boolean)
+skip_entropy_data (j_decompress_ptr cinfo)
+{
+  struct jpeg_source_mgr * datasrc = cinfo->src;
+  const JOCTET * next_input_byte;
+  size_t bytes_in_buffer;
+  int c;
+
+  for (;;) {
+    /* Skip any non-FF bytes.  Unlike next_marker, we need not sync after
+     * each byte, as they can all be discarded together.
+     */
+    next_input_byte = datasrc->next_input_byte;
+    bytes_in_buffer = datasrc->bytes_in_buffer;
+    while (bytes_in_buffer > 0 && GETJOCTET(*next_input_byte) != 0xFF) {
+      next_input_byte++;
+      bytes_in_buffer--;
+    }
+    datasrc->next_input_byte = next_input_byte;
+    datasrc->bytes_in_buffer = bytes_in_buffer;
+    if (bytes_in_buffer == 0) {
+      if (! (*datasrc->fill_input_buffer) (cinfo))
+	return FALSE;
+      continue;
+    }
+    /* Swallow the FF and any duplicates, then look at the byte after them.
+     * We do not sync here, so that on suspension we back up to the FF.
+     */
+    do {
+      next_input_byte++;
+      bytes_in_buffer--;
+      if (bytes_in_buffer == 0) {
+	if (! (*datasrc->fill_input_buffer) (cinfo))
+	  return FALSE;
+	next_input_byte = datasrc->next_input_byte;
+	bytes_in_buffer = datasrc->bytes_in_buffer;
+      }
+      c = GETJOCTET(*next_input_byte);
+    } while (c == 0xFF);
+    next_input_byte++;
+    bytes_in_buffer--;
+    datasrc->next_input_byte = next_input_byte;
+    datasrc->bytes_in_buffer = bytes_in_buffer;
+    if (c != 0)
+      break;			/* found a marker */
+    /* Reach here if we found a stuffed-zero data sequence (FF/00). */
+  }
+
+  cinfo->unread_marker = c;
+  return TRUE;
+}
+
+
 /*
  * Huffman MCU decoding.
  * Each of these routines decodes and returns one MCU's worth of
@@ -633,6 +717,38 @@ undoit:
 }
 
 
+/*
+ * MCU "decoding" for a scan we don't need (see start_pass_phuff_decoder).
+ * The first MCU of the scan, or of each restart interval, discards the
+ * data; the others have nothing to do.  The coefficient buffer is left
+ * untouched.
+ */
+
+METHODDEF(boolean)
+decode_mcu_skip (j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
+{
+  phuff_entropy_ptr entropy = (phuff_entropy_ptr) cinfo->entropy;
+
+  /* Process restart marker if needed; may have to suspend */
+  if (cinfo->restart_interval) {
+    if (entropy->restarts_to_go == 0)
+      if (! process_restart(cinfo))
+	return FALSE;
+  }
+
+  /* Discard the data, unless we have already reached the next marker */
+  if (cinfo->unread_marker == 0) {
+    if (! skip_entropy_data(cinfo))
+      return FALSE;
+  }
+
+  /* Account for restart interval (no-op if not using restarts) */
+  entropy->restarts_to_go--;
+
+  return TRUE;
+}
+
+
 /*
  * Module initialization routine for progressive Huffman entropy decoding.
  */
@@ -37,6 +37,15 @@ typedef struct {
   /* for two-pass mode only: */
   JDIMENSION starting_row;	/* row # of first row in current strip */
   JDIMENSION next_row;		/* index of next row to fill/empty in strip */
+
+  /* Source of the rows: the upsampler, or the resizer if there is one */
+  JMETHOD(void, upsample, (j_decompress_ptr cinfo,
+			   JSAMPIMAGE input_buf,
+			   JDIMENSION *in_row_group_ctr,
+			   JDIMENSION in_row_groups_avail,
+			   JSAMPARRAY output_buf,
+			   JDIMENSION *out_row_ctr,
+			   JDIMENSION out_rows_avail));
 } my_post_controller;
 
 typedef my_post_controller * my_post_ptr;
@@ -74,6 +83,11 @@ start_pass_dpost (j_decompress_ptr cinfo, J_BUF_MODE pass_mode)
 {
   my_post_ptr post = (my_post_ptr) cinfo->post;
 
+  if (cinfo->resize != NULL)
+    post->upsample = cinfo->resize->resize;
+  else
+    post->upsample = cinfo->upsample->upsample;
+
   switch (pass_mode) {
   case JBUF_PASS_THRU:
     if (cinfo->quantize_colors) {
@@ -92,7 +106,7 @@ start_pass_dpost (j_decompress_ptr cinfo, J_BUF_MODE pass_mode)
       /* For single-pass processing without color quantization,
        * I have no work to do; just call the upsampler directly.
        */
-      post->pub.post_process_data = cinfo->upsample->upsample;
+      post->pub.post_process_data = post->upsample;
     }
     break;
 #ifdef QUANT_2PASS_SUPPORTED
@@ -138,7 +152,7 @@ post_process_1pass (j_decompress_ptr cinfo,
   if (max_rows > post->strip_height)
     max_rows = post->strip_height;
   num_rows = 0;
-  (*cinfo->upsample->upsample) (cinfo,
+  (*post->upsample) (cinfo,
 		input_buf, in_row_group_ctr, in_row_groups_avail,
 		post->buffer, &num_rows, max_rows);
   /* Quantize and emit data. */
@@ -173,7 +187,7 @@ post_process_prepass (j_decompress_ptr cinfo,
 
   /* Upsample some data (up to a strip height's worth). */
   old_next_row = post->next_row;
-  (*cinfo->upsample->upsample) (cinfo,
+  (*post->upsample) (cinfo,
 		input_buf, in_row_group_ctr, in_row_groups_avail,
 		post->buffer, &post->next_row, post->strip_height);
 
@@ -0,0 +1,267 @@
+/*
+ * jdprobe.c
+ *
+ * Copyright (C) 1994-1996, Thomas G. Lane.
+ * This file is part of the Independent JPEG Group's software.
+ * For conditions of distribution and use, see the accompanying README file.
+ *
+ * This file contains routines to find the basic parameters of a JPEG image
+ * (dimensions, components, precision and process) without creating a
+ * decompression object.  Only the markers in front of the frame header are
+ * examined: nothing is allocated and no tables are read or validated, so
+ * these are much cheaper than jpeg_read_header when only the image size is
+ * wanted, for instance when scanning a large number of files.
+ */
+
+/* this is not a core library module, so it doesn't define JPEG_INTERNALS */
+#include "jinclude.h"
+#include "jpeglib.h"
+
+
+/* The marker codes needed here (see jdmarker.c) */
+
+#define M_SOF0	0xc0
+#define M_SOF15	0xcf
+#define M_DHT	0xc4
+#define M_JPG	0xc8
+#define M_DAC	0xcc
+#define M_RST0	0xd0
+#define M_RST7	0xd7
+#define M_SOI	0xd8
+#define M_EOI	0xd9
+#define M_SOS	0xda
+#define M_APP0	0xe0
+#define M_APP14	0xee
+#define M_TEM	0x01
+
+#define APP0_DATA_LEN	14	/* Length of interesting data in APP0 */
+#define APP14_DATA_LEN	12	/* Length of interesting data in APP14 */
+
+/* Enough of a marker segment for the length word and the interesting data
+ * of a frame header (with the IDs of up to 4 components), APP0 or APP14.
+ */
+#define PROBE_BUF_SIZE	24
+
+
+/* Where the datastream comes from: a memory buffer, or a stdio stream. */
+
+typedef struct {
+  const JOCTET * data;		/* memory source, or NULL */
+  size_t size;			/* bytes at data */
+  FILE * file;			/* stdio source if data is NULL */
+} probe_source;
+
+
+/*
+ * Read up to count bytes at the given offset in the datastream.
+ * Returns the number of bytes actually available.
+ */
+
+LOCAL(size_t)
+probe_read (probe_source * src, long offset, JOCTET * buf, size_t count)
+{
+  if (src->data != NULL) {
+    if ((size_t) offset >= src->size)
+      return 0;
+    if (count > src->size - (size_t) offset)
+      count = src->size - (size_t) offset;
+    MEMCOPY(buf, src->data + offset, count);
+    return count;
+  }
+
+  if (fseek(src->file, offset, SEEK_SET) != 0)
+    return 0;
+  return JFREAD(src->file, buf, count);
+}
+
+
+/*
+ * Guess the color space in the same way as default_decompress_parms
+ * in jdapimin.c.
+ */
+
+LOCAL(J_COLOR_SPACE)
+probe_color_space (int num_components, const int * ids,
+		   boolean saw_JFIF, boolean saw_Adobe, int Adobe_transform)
+{
+  switch (num_components) {
+  case 1:
+    return JCS_GRAYSCALE;
+
+  case 3:
+    if (saw_JFIF)
+      return JCS_YCbCr;
+    if (saw_Adobe)
+      return Adobe_transform == 0 ? JCS_RGB : JCS_YCbCr;
+    if (ids[0] == 82 && ids[1] == 71 && ids[2] == 66)
+      return JCS_RGB;		/* ASCII 'R', 'G', 'B' */
+    return JCS_YCbCr;
+
+  case 4:
+    if (saw_Adobe && Adobe_transform != 0)
+      return JCS_YCCK;
+    return JCS_CMYK;
+
+  default:
+    return JCS_UNKNOWN;
+  }
+}
+
+
+/*
+ * Scan the markers up to the first frame header, as read_markers in
+ * jdmarker.c would, and fill in info from it.
+ */
+
+LOCAL(boolean)
+probe_markers (probe_source * src, jpeg_probe_info * info)
+{
+  JOCTET buf[PROBE_BUF_SIZE];
+  boolean saw_JFIF = FALSE;
+  boolean saw_Adobe = FALSE;
+  int Adobe_transform = 0;
+  long pos = 2;
+  size_t count;
+  INT32 length;
+  int c, ci;
+
+  MEMZERO(info, SIZEOF(jpeg_probe_info));
+
+  if (probe_read(src, 0L, buf, 2) != 2 || buf[0] != 0xFF || buf[1] != M_SOI)
+    return FALSE;
+
+  for (;;) {
+    /* Find the next marker, skipping garbage and fill bytes as next_marker
+     * does.
+     */
+    if (probe_read(src, pos++, buf, 1) != 1)
+      return FALSE;
+    if (buf[0] != 0xFF)
+      continue;
+    do {
+      if (probe_read(src, pos++, buf, 1) != 1)
+	return FALSE;
+    } while (buf[0] == 0xFF);
+    c = GETJOCTET(buf[0]);
+
+    /* Stuffed zeroes and the markers without parameters */
+    if (c == 0 || c == M_SOI || c == M_TEM || (c >= M_RST0 && c <= M_RST7))
+      continue;
+
+    /* A scan or the end of the image before any frame header */
+    if (c == M_SOS || c == M_EOI)
+      return FALSE;
+
+    count = probe_read(src, pos, buf, SIZEOF(buf));
+    if (count < 2)
+      return FALSE;
+    length = ((INT32) GETJOCTET(buf[0]) << 8) + GETJOCTET(buf[1]);
+    if (length < 2)
+      return FALSE;
+
+    if (c >= M_SOF0 && c <= M_SOF15 && c != M_DHT && c != M_JPG &&
+	c != M_DAC) {
+      int ids[4];
+
+      if (count < 8)
+	return FALSE;
+      info->data_precision = GETJOCTET(buf[2]);
+      info->image_height = ((JDIMENSION) GETJOCTET(buf[3]) << 8) +
+	GETJOCTET(buf[4]);
+      info->image_width = ((JDIMENSION) GETJOCTET(buf[5]) << 8) +
+	GETJOCTET(buf[6]);
+      info->num_components = GETJOCTET(buf[7]);
+
+      /* The same checks as get_sof; a DNL height is not supported */
+      if (info->image_height == 0 || info->image_width == 0 ||
+	  info->num_components <= 0 ||
+	  length != (info->num_components * 3 + 8)) {
+	MEMZERO(info, SIZEOF(jpeg_probe_info));
+	return FALSE;
+      }
+
+      for (ci = 0; ci < 4; ci++)
+	ids[ci] = (ci < info->num_components && 8 + ci * 3 < (int) count) ?
+	  GETJOCTET(buf[8 + ci * 3]) : 0;
+
+      info->progressive_mode = (c & 3) == 2;	/* SOF2, SOF6, SOF10, SOF14 */
+      info->arith_code = c >= M_SOF0 + 9;
+      info->jpeg_color_space = probe_color_space(info->num_components, ids,
+						 saw_JFIF, saw_Adobe,
+						 Adobe_transform);
+      return TRUE;
+    }
+
+    if (c == M_APP0 && length >= APP0_DATA_LEN + 2 && count >= 7 &&
+	GETJOCTET(buf[2]) == 0x4A && GETJOCTET(buf[3]) == 0x46 &&
+	GETJOCTET(buf[4]) == 0x49 && GETJOCTET(buf[5]) == 0x46 &&
+	GETJOCTET(buf[6]) == 0)
+      saw_JFIF = TRUE;		/* "JFIF\0" */
+
+    else if (c == M_APP14 && length >= APP14_DATA_LEN + 2 && count >= 14 &&
+	     GETJOCTET(buf[2]) == 0x41 && GETJOCTET(buf[3]) == 0x64 &&
+	     GETJOCTET(buf[4]) == 0x6F && GETJOCTET(buf[5]) == 0x62 &&
+	     GETJOCTET(buf[6]) == 0x65) {
+      saw_Adobe = TRUE;		/* "Adobe" */
+      Adobe_transform = GETJOCTET(buf[13]);
+    }
+
+    pos += (long) length;
+  }
+}
+
+
+/*
+ * Probe a JPEG datastream held in memory.
+ * Returns TRUE and fills in info if a frame header was found.
+ */
+
+GLOBAL(boolean)
+jpeg_probe_memory (const JOCTET * data, size_t size, jpeg_probe_info * info)
+{
+  probe_source src;
+
+  src.data = data;
+  src.size = size;
+  src.file = NULL;
+
+  if (data == NULL) {
+    MEMZERO(info, SIZEOF(jpeg_probe_info));
+    return FALSE;
+  }
+  return probe_markers(&src, info);
+}
+
+
+/*
+ * Probe each of count named files, filling in info[0..count-1]; the
+ * num_components of a file that could not be opened or is not a JPEG file
+ * is 0.  Returns the number of JPEG files found.
+ */
+
+GLOBAL(int)
+jpeg_probe_files (const char * const * file_names, int count,
+		  jpeg_probe_info * info)
+{
+  char iobuf[4096];		/* so that stdio need not allocate one */
+  probe_source src;
+  int found = 0;
+  int i;
+
+  src.data = NULL;
+  src.size = 0;
+
+  for (i = 0; i < count; i++) {
+    MEMZERO(&info[i], SIZEOF(jpeg_probe_info));
+
+    if ((src.file = fopen(file_names[i], "rb")) == NULL)
+      continue;
+    (void) setvbuf(src.file, iobuf, _IOFBF, SIZEOF(iobuf));
+
+    if (probe_markers(&src, &info[i]))
+      found++;
+    fclose(src.file);
+  }
+
+  return found;
+}
@@ -0,0 +1,316 @@
+/*
+ * jdresize.c
+ *
+ * Copyright (C) 1994-1996, Thomas G. Lane.
+ * This file is part of the Independent JPEG Group's software.
+ * For conditions of distribution and use, see the accompanying README file.
+ *
+ * This file contains the thumbnail resampler, which shrinks the upsampled,
+ * color-converted image (of scaled_width x scaled_height) to the final
+ * output size (output_width x output_height).  It is used only in thumbnail
+ * mode, when no DCT scaling gives the output size exactly; see
+ * jpeg_calc_output_dimensions in jdmaster.c.  Its resize method sits
+ * between the postprocessing controller and the upsampler, and takes the
+ * same arguments as the upsample method.
+ *
+ * The resampling is by area averaging (a box filter): each output pixel is
+ * the average of the source pixels it covers, with partly covered source
+ * pixels weighted by the fraction covered.  As the output is never larger
+ * than the source, a source pixel touches at most two output pixels in
+ * each direction, and a source row completes at most one output row.
+ * The weights are computed from rounded cumulative positions, so that the
+ * weights making up each output pixel sum to exactly 1 in fixed point.
+ */
+
+#define JPEG_INTERNALS
+#include "jinclude.h"
+#include "jpeglib.h"
+
+
+/* The weights have WEIGHT_BITS fractional bits.  A horizontally resampled
+ * sample is at most MAXJSAMPLE << WEIGHT_BITS, and the vertical pass
+ * multiplies that by another weight, so 2*WEIGHT_BITS + BITS_IN_JSAMPLE
+ * must not exceed 30.
+ */
+
+#if BITS_IN_JSAMPLE == 8
+#define WEIGHT_BITS  11
+#else
+#define WEIGHT_BITS  9
+#endif
+
+#define WEIGHT_ONE   ((INT32) 1 << WEIGHT_BITS)
+
+
+/* Private subobject */
+
+typedef struct {
+  struct jpeg_resizer pub;	/* public fields */
+
+  /* Buffer holding one row group from the upsampler, which produces
+   * max_v_samp_factor rows at a time (fewer at the bottom of the image).
+   */
+  JSAMPARRAY buffer;
+  int buffer_rows;		/* rows in buffer */
+  int next_row;			/* index of next row to resample */
+
+  /* Horizontal tables, indexed by source column: the first output column
+   * touched (times out_color_components), and the weights for it and for
+   * the next output column.
+   */
+  JDIMENSION * col_offset;
+  INT32 * col_weight1;
+  INT32 * col_weight2;
+
+  /* Vertical tables, indexed by source row: the weights for the output row
+   * being accumulated and for the next one, and whether this source row
+   * completes the output row.
+   */
+  INT32 * row_weight1;
+  INT32 * row_weight2;
+  boolean * row_ends;
+
+  INT32 * hrow;			/* current source row, resampled horizontally */
+  INT32 * accum;		/* output row being accumulated */
+} my_resizer;
+
+typedef my_resizer * my_resize_ptr;
+
+
+/*
+ * Initialize for a resampling pass.
+ */
+
+METHODDEF(void)
+start_pass_resize (j_decompress_ptr cinfo)
+{
+  my_resize_ptr resize = (my_resize_ptr) cinfo->resize;
+
+  /* Mark the row buffer empty */
+  resize->buffer_rows = 0;
+  resize->next_row = 0;
+  resize->pub.input_rows = 0;
+  resize->pub.rows_pending = FALSE;
+  /* Clear the accumulator */
+  jzero_far((void FAR *) resize->accum,
+	    (size_t) cinfo->output_width * cinfo->out_color_components
+	    * SIZEOF(INT32));
+}
+
+
+/*
+ * Resample one source row into the accumulator, and emit the output row
+ * if this source row completes it.  Returns TRUE if a row was emitted.
+ */
+
+LOCAL(boolean)
+resize_row (j_decompress_ptr cinfo, JSAMPROW inptr, JSAMPROW outptr)
+{
+  my_resize_ptr resize = (my_resize_ptr) cinfo->resize;
+  int nc = cinfo->out_color_components;
+  JDIMENSION row = resize->pub.input_rows;
+  JDIMENSION width = cinfo->output_width * (JDIMENSION) nc;
+  JDIMENSION col, count;
+  INT32 * hptr;
+  INT32 * aptr;
+  INT32 w1, w2, v1, v2;
+  int c;
+
+  /* Horizontal pass.  There is one spare output column at the end of
+   * hrow, for the zero second weight of the last source columns.
+   */
+  jzero_far((void FAR *) resize->hrow, (size_t) (width + nc) * SIZEOF(INT32));
+  for (col = 0; col < cinfo->scaled_width; col++) {
+    hptr = resize->hrow + resize->col_offset[col];
+    w1 = resize->col_weight1[col];
+    w2 = resize->col_weight2[col];
+    for (c = 0; c < nc; c++) {
+      hptr[c] += w1 * GETJSAMPLE(inptr[c]);
+      hptr[c+nc] += w2 * GETJSAMPLE(inptr[c]);
+    }
+    inptr += nc;
+  }
+
+  /* Vertical pass */
+  hptr = resize->hrow;
+  aptr = resize->accum;
+  v1 = resize->row_weight1[row];
+  if (! resize->row_ends[row]) {
+    for (count = width; count > 0; count--)
+      *aptr++ += *hptr++ * v1;
+    return FALSE;
+  }
+  v2 = resize->row_weight2[row];
+  for (count = width; count > 0; count--) {
+    *outptr++ = (JSAMPLE)
+      ((*aptr + *hptr * v1 + ((INT32) 1 << (2*WEIGHT_BITS-1)))
+       >> (2*WEIGHT_BITS));
+    *aptr++ = *hptr++ * v2;
+  }
+  return TRUE;
+}
+
+
+/*
+ * Resize method.  Fetch rows from the upsampler as needed, and resample
+ * them until the output buffer is full or the input row groups run out.
+ * Each source row yields at most one output row, so we need only make sure
+ * that there is room for one before taking a source row.
+ *
+ * When the output buffer fills up in the middle of a row group, the rest
+ * of the row group stays in our buffer although the main controller has
+ * seen all its input consumed.  rows_pending tells process_data in
+ * jdapistd.c to get those rows out, by calling us with no input, before
+ * the main controller asks the decoder for another iMCU row (which may not
+ * exist).
+ */
+
+METHODDEF(void)
+resize_rows (j_decompress_ptr cinfo,
+	     JSAMPIMAGE input_buf, JDIMENSION *in_row_group_ctr,
+	     JDIMENSION in_row_groups_avail,
+	     JSAMPARRAY output_buf, JDIMENSION *out_row_ctr,
+	     JDIMENSION out_rows_avail)
+{
+  my_resize_ptr resize = (my_resize_ptr) cinfo->resize;
+  JDIMENSION rows_out;
+
+  while (*out_row_ctr < out_rows_avail) {
+    if (resize->next_row >= resize->buffer_rows) {
+      /* Refill the buffer with the next row group, if there is one.
+       * (The merged upsampler does not stop at the bottom of the image,
+       * so we must.)
+       */
+      if (*in_row_group_ctr >= in_row_groups_avail ||
+	  resize->pub.input_rows >= cinfo->scaled_height)
+	break;
+      rows_out = 0;
+      (*cinfo->upsample->upsample) (cinfo, input_buf, in_row_group_ctr,
+				    in_row_groups_avail, resize->buffer,
+				    &rows_out,
+				    (JDIMENSION) cinfo->max_v_samp_factor);
+      resize->buffer_rows = (int) rows_out;
+      resize->next_row = 0;
+      if (rows_out == 0)	/* bottom of image */
+	break;
+    }
+    if (resize_row(cinfo, resize->buffer[resize->next_row],
+		   output_buf[*out_row_ctr]))
+      (*out_row_ctr)++;
+    resize->next_row++;
+    resize->pub.input_rows++;
+  }
+  resize->pub.rows_pending = (resize->next_row < resize->buffer_rows);
+}
+
+
+/*
+ * Compute the area-averaging weights for resampling in_size source pixels
+ * to out_size output pixels, out_size <= in_size.  Source pixel i covers
+ * output positions P(i) to P(i+1), where P(i) is i * out_size / in_size in
+ * units of 1/WEIGHT_ONE output pixel, rounded.  Its weight for output pixel
+ * j = P(i) / WEIGHT_ONE is the overlap with j's extent, and the rest goes
+ * to pixel j+1.  As P(in_size) = out_size * WEIGHT_ONE exactly, the weights
+ * of the source pixels making up each output pixel sum to WEIGHT_ONE.
+ * index[i] is set to j, and ends[i] to whether source pixel i reaches the
+ * end of pixel j; either may be NULL if not wanted.
+ */
+
+LOCAL(void)
+compute_weights (JDIMENSION in_size, JDIMENSION out_size,
+		 JDIMENSION * index, INT32 * weight1, INT32 * weight2,
+		 boolean * ends)
+{
+  JDIMENSION i, j;
+  INT32 pos, next_pos, boundary;
+  double step = (double) out_size * (double) WEIGHT_ONE / (double) in_size;
+
+  pos = 0;
+  for (i = 0; i < in_size; i++) {
+    if (i == in_size - 1)
+      next_pos = (INT32) out_size << WEIGHT_BITS;
+    else
+      next_pos = (INT32) ((double) (i + 1) * step + 0.5);
+    j = (JDIMENSION) (pos >> WEIGHT_BITS);
+    boundary = ((INT32) j + 1) << WEIGHT_BITS;
+    if (next_pos > boundary) {
+      weight1[i] = boundary - pos;
+      weight2[i] = next_pos - boundary;
+    } else {
+      weight1[i] = next_pos - pos;
+      weight2[i] = 0;
+    }
+    if (index != NULL)
+      index[i] = j;
+    if (ends != NULL)
+      ends[i] = (next_pos >= boundary);
+    pos = next_pos;
+  }
+}
+
+
+/*
+ * Module initialization routine for the thumbnail resampler.
+ */
+
+GLOBAL(void)
+jinit_resizer (j_decompress_ptr cinfo)
+{
+  my_resize_ptr resize;
+  JDIMENSION col;
+  int nc = cinfo->out_color_components;
+
+  resize = (my_resize_ptr)
+    (*cinfo->mem->alloc_small) ((j_common_ptr) cinfo, JPOOL_IMAGE,
+				SIZEOF(my_resizer));
+  cinfo->resize = (struct jpeg_resizer *) resize;
+  resize->pub.start_pass = start_pass_resize;
+  resize->pub.resize = resize_rows;
+
+  resize->buffer = (*cinfo->mem->alloc_sarray)
+    ((j_common_ptr) cinfo, JPOOL_IMAGE,
+     cinfo->scaled_width * (JDIMENSION) nc,
+     (JDIMENSION) cinfo->max_v_samp_factor);
+
+  /* Horizontal tables */
+  resize->col_offset = (JDIMENSION *)
+    (*cinfo->mem->alloc_large) ((j_common_ptr) cinfo, JPOOL_IMAGE,
+				cinfo->scaled_width * SIZEOF(JDIMENSION));
+  resize->col_weight1 = (INT32 *)
+    (*cinfo->mem->alloc_large) ((j_common_ptr) cinfo, JPOOL_IMAGE,
+				cinfo->scaled_width * SIZEOF(INT32));
+  resize->col_weight2 = (INT32 *)
+    (*cinfo->mem->alloc_large) ((j_common_ptr) cinfo, JPOOL_IMAGE,
+				cinfo->scaled_width * SIZEOF(INT32));
+  compute_weights(cinfo->scaled_width, cinfo->output_width,
+		  resize->col_offset, resize->col_weight1, resize->col_weight2,
+		  (boolean *) NULL);
+  for (col = 0; col < cinfo->scaled_width; col++)
+    resize->col_offset[col] *= (JDIMENSION) nc;
+
+  /* Vertical tables.  The output rows are completed in order, so we need
+   * only know where each one ends, not which one a source row belongs to.
+   */
+  resize->row_weight1 = (INT32 *)
+    (*cinfo->mem->alloc_large) ((j_common_ptr) cinfo, JPOOL_IMAGE,
+				cinfo->scaled_height * SIZEOF(INT32));
+  resize->row_weight2 = (INT32 *)
+    (*cinfo->mem->alloc_large) ((j_common_ptr) cinfo, JPOOL_IMAGE,
+				cinfo->scaled_height * SIZEOF(INT32));
+  resize->row_ends = (boolean *)
+    (*cinfo->mem->alloc_large) ((j_common_ptr) cinfo, JPOOL_IMAGE,
+				cinfo->scaled_height * SIZEOF(boolean));
+  compute_weights(cinfo->scaled_height, cinfo->output_height,
+		  (JDIMENSION *) NULL, resize->row_weight1, resize->row_weight2,
+		  resize->row_ends);
+
+  /* Row workspaces, with a spare pixel at the end of hrow */
+  resize->hrow = (INT32 *)
+    (*cinfo->mem->alloc_large) ((j_common_ptr) cinfo, JPOOL_IMAGE,
+				(cinfo->output_width + 1) * (JDIMENSION) nc
+				* SIZEOF(INT32));
+  resize->accum = (INT32 *)
+    (*cinfo->mem->alloc_large) ((j_common_ptr) cinfo, JPOOL_IMAGE,
+				cinfo->output_width * (JDIMENSION) nc
+				* SIZEOF(INT32));
+}
@@ -21,6 +21,7 @@
 #define JPEG_INTERNALS
 #include "jinclude.h"
 #include "jpeglib.h"
+#include "jsimd.h"
 
 
 /* Pointer to routine to upsample a single component */
@@ -73,7 +74,7 @@ start_pass_upsample (j_decompress_ptr cinfo)
   /* Mark the conversion buffer empty */
   upsample->next_row_out = cinfo->max_v_samp_factor;
   /* Initialize total-height counter for detecting bottom of image */
-  upsample->rows_to_go = cinfo->output_height;
+  upsample->rows_to_go = cinfo->scaled_height;
 }
 
 
@@ -206,7 +207,7 @@ int_upsample (j_decompress_ptr cinfo, jpeg_component_info * compptr,
     /* Generate one output row with proper horizontal expansion */
     inptr = input_data[inrow];
     outptr = output_data[outrow];
-    outend = outptr + cinfo->output_width;
+    outend = outptr + cinfo->scaled_width;
     while (outptr < outend) {
       invalue = *inptr++;	/* don't need GETJSAMPLE() here */
       for (h = h_expand; h > 0; h--) {
@@ -216,7 +217,7 @@ int_upsample (j_decompress_ptr cinfo, jpeg_component_info * compptr,
     /* Generate any additional output rows by duplicating the first one */
     if (v_expand > 1) {
       jcopy_sample_rows(output_data, outrow, output_data, outrow+1,
-			v_expand-1, cinfo->output_width);
+			v_expand-1, cinfo->scaled_width);
     }
     inrow++;
     outrow += v_expand;
@@ -242,7 +243,7 @@ h2v1_upsample (j_decompress_ptr cinfo, jpeg_component_info * compptr,
   for (inrow = 0; inrow < cinfo->max_v_samp_factor; inrow++) {
     inptr = input_data[inrow];
     outptr = output_data[inrow];
-    outend = outptr + cinfo->output_width;
+    outend = outptr + cinfo->scaled_width;
     while (outptr < outend) {
       invalue = *inptr++;	/* don't need GETJSAMPLE() here */
       *outptr++ = invalue;
@@ -271,14 +272,14 @@ h2v2_upsample (j_decompress_ptr cinfo, jpeg_component_info * compptr,
   while (outrow < cinfo->max_v_samp_factor) {
     inptr = input_data[inrow];
     outptr = output_data[outrow];
-    outend = outptr + cinfo->output_width;
+    outend = outptr + cinfo->scaled_width;
     while (outptr < outend) {
       invalue = *inptr++;	/* don't need GETJSAMPLE() here */
       *outptr++ = invalue;
       *outptr++ = invalue;
     }
     jcopy_sample_rows(output_data, outrow, output_data, outrow+1,
-		      1, cinfo->output_width);
+		      1, cinfo->scaled_width);
     inrow++;
     outrow += 2;
   }
@@ -456,6 +457,10 @@ jinit_upsampler (j_decompress_ptr cinfo)
       /* Special cases for 2h2v upsampling */
       if (do_fancy && compptr->downsampled_width > 2) {
 	upsample->methods[ci] = h2v2_fancy_upsample;
+#ifdef SIMD_SUPPORTED
+	if (jsimd_can_h2v2_fancy_upsample())
+	  upsample->methods[ci] = jsimd_h2v2_fancy_upsample;
+#endif
 	upsample->pub.need_context_rows = TRUE;
       } else
 	upsample->methods[ci] = h2v2_upsample;
@@ -470,7 +475,7 @@ jinit_upsampler (j_decompress_ptr cinfo)
     if (need_buffer) {
       upsample->color_buf[ci] = (*cinfo->mem->alloc_sarray)
 	((j_common_ptr) cinfo, JPOOL_IMAGE,
-	 (JDIMENSION) jround_up((long) cinfo->output_width,
+	 (JDIMENSION) jround_up((long) cinfo->scaled_width,
 				(long) cinfo->max_h_samp_factor),
 	 (JDIMENSION) cinfo->max_v_samp_factor);
     }
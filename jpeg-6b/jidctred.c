@@ -17,6 +17,14 @@
  *
  * 1x1 is trivial: just take the DC coefficient divided by 8.
  *
+ * jpeg_idct_scaled produces NxN output for any N from 1 to 7, using only
+ * the top-left NxN coefficients: it is simply an N-point IDCT of those,
+ * computed straightforwardly with a table of multipliers.  This is the
+ * IDCT of the reduced-size image that the block would have had, so unlike
+ * the averaging routines above it need not decode the other coefficients.
+ * jdmaster.c uses it for the scalings that are not powers of 2, and for
+ * all scalings in thumbnail mode.
+ *
  * See jidctint.c for additional comments.
  */
 
@@ -395,4 +403,164 @@ jpeg_idct_1x1 (j_decompress_ptr cinfo, jpeg_component_info * compptr,
   output_buf[0][output_col] = range_limit[dcval & RANGE_MASK];
 }
 
+
+/* Multipliers for jpeg_idct_scaled: idct_scaled_table[N][x][u] is
+ * FIX(C(u)/2 * cos((2x+1)*u*pi/(2N))), where C(0) = 1/sqrt(2) and C(u) = 1
+ * otherwise.  By symmetry, output x = N-1-k is the even terms (even u) for
+ * output k less the odd terms, so the table need only cover x < (N+1)/2.
+ */
+
+static const INT32 idct_scaled_table[DCTSIZE][DCTSIZE/2][DCTSIZE-1] = {
+  { /* N = 0 */
+    {     0,     0,     0,     0,     0,     0,     0 },
+    {     0,     0,     0,     0,     0,     0,     0 },
+    {     0,     0,     0,     0,     0,     0,     0 },
+    {     0,     0,     0,     0,     0,     0,     0 }
+  },
+  { /* N = 1 */
+    {  2896,     0,     0,     0,     0,     0,     0 },
+    {     0,     0,     0,     0,     0,     0,     0 },
+    {     0,     0,     0,     0,     0,     0,     0 },
+    {     0,     0,     0,     0,     0,     0,     0 }
+  },
+  { /* N = 2 */
+    {  2896,  2896,     0,     0,     0,     0,     0 },
+    {     0,     0,     0,     0,     0,     0,     0 },
+    {     0,     0,     0,     0,     0,     0,     0 },
+    {     0,     0,     0,     0,     0,     0,     0 }
+  },
+  { /* N = 3 */
+    {  2896,  3547,  2048,     0,     0,     0,     0 },
+    {  2896,     0, -4096,     0,     0,     0,     0 },
+    {     0,     0,     0,     0,     0,     0,     0 },
+    {     0,     0,     0,     0,     0,     0,     0 }
+  },
+  { /* N = 4 */
+    {  2896,  3784,  2896,  1567,     0,     0,     0 },
+    {  2896,  1567, -2896, -3784,     0,     0,     0 },
+    {     0,     0,     0,     0,     0,     0,     0 },
+    {     0,     0,     0,     0,     0,     0,     0 }
+  },
+  { /* N = 5 */
+    {  2896,  3896,  3314,  2408,  1266,     0,     0 },
+    {  2896,  2408, -1266, -3896, -3314,     0,     0 },
+    {  2896,     0, -4096,     0,  4096,     0,     0 },
+    {     0,     0,     0,     0,     0,     0,     0 }
+  },
+  { /* N = 6 */
+    {  2896,  3956,  3547,  2896,  2048,  1060,     0 },
+    {  2896,  2896,     0, -2896, -4096, -2896,     0 },
+    {  2896,  1060, -3547, -2896,  2048,  3956,     0 },
+    {     0,     0,     0,     0,     0,     0,     0 }
+  },
+  { /* N = 7 */
+    {  2896,  3993,  3690,  3202,  2554,  1777,   911 },
+    {  2896,  3202,   911, -1777, -3690, -3993, -2554 },
+    {  2896,  1777, -2554, -3993,  -911,  3202,  3690 },
+    {  2896,     0, -4096,     0,  4096,     0, -4096 }
+  }
+};
+
+
+/*
+ * Perform dequantization and inverse DCT on one block of coefficients,
+ * producing a reduced-size NxN output block, where N = DCT_scaled_size.
+ */
+
+GLOBAL(void)
+jpeg_idct_scaled (j_decompress_ptr cinfo, jpeg_component_info * compptr,
+		  JCOEFPTR coef_block,
+		  JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+  INT32 even, odd;
+  INT32 coef[DCTSIZE-1];
+  const INT32 (*table)[DCTSIZE-1];
+  JCOEFPTR inptr;
+  ISLOW_MULT_TYPE * quantptr;
+  int * wsptr;
+  JSAMPROW outptr;
+  JSAMPLE *range_limit = IDCT_range_limit(cinfo);
+  int size = compptr->DCT_scaled_size;
+  int half = (size + 1) / 2;
+  int ctr, x, u;
+  int workspace[(DCTSIZE-1)*(DCTSIZE-1)]; /* buffers data between passes */
+  SHIFT_TEMPS
+
+  table = idct_scaled_table[size];
+
+  /* Pass 1: process the first N columns from input, store into work array.
+   * Row x of the work array receives output row x of each column.
+   */
+
+  inptr = coef_block;
+  quantptr = (ISLOW_MULT_TYPE *) compptr->dct_table;
+  wsptr = workspace;
+  for (ctr = 0; ctr < size; ctr++, inptr++, quantptr++, wsptr++) {
+    for (u = 1; u < size; u++) {
+      if (inptr[DCTSIZE*u] != 0)
+	break;
+    }
+    if (u == size) {
+      /* AC terms all zero: the column is constant */
+      even = MULTIPLY((INT32) DEQUANTIZE(inptr[0], quantptr[0]), table[0][0]);
+      even = DESCALE(even, CONST_BITS-PASS1_BITS);
+      for (x = 0; x < size; x++)
+	wsptr[size*x] = (int) even;
+      continue;
+    }
+
+    for (u = 0; u < size; u++)
+      coef[u] = (INT32) DEQUANTIZE(inptr[DCTSIZE*u], quantptr[DCTSIZE*u]);
+
+    for (x = 0; x < half; x++) {
+      even = odd = 0;
+      for (u = 0; u < size; u += 2)
+	even += MULTIPLY(coef[u], table[x][u]);
+      for (u = 1; u < size; u += 2)
+	odd += MULTIPLY(coef[u], table[x][u]);
+      /* For odd N, the middle output has no odd terms, and is stored twice */
+      wsptr[size*x] = (int) DESCALE(even + odd, CONST_BITS-PASS1_BITS);
+      wsptr[size*(size-1-x)] = (int) DESCALE(even - odd, CONST_BITS-PASS1_BITS);
+    }
+  }
+
+  /* Pass 2: process N rows from work array, store into output array. */
+
+  wsptr = workspace;
+  for (ctr = 0; ctr < size; ctr++, wsptr += size) {
+    outptr = output_buf[ctr] + output_col;
+
+    for (u = 1; u < size; u++) {
+      if (wsptr[u] != 0)
+	break;
+    }
+    if (u == size) {
+      /* AC terms all zero: the row is constant */
+      even = MULTIPLY((INT32) wsptr[0], table[0][0]);
+      outptr[0] = range_limit[(int) DESCALE(even, CONST_BITS+PASS1_BITS)
+			      & RANGE_MASK];
+      for (x = 1; x < size; x++)
+	outptr[x] = outptr[0];
+      continue;
+    }
+
+    for (u = 0; u < size; u++)
+      coef[u] = (INT32) wsptr[u];
+
+    for (x = 0; x < half; x++) {
+      even = odd = 0;
+      for (u = 0; u < size; u += 2)
+	even += MULTIPLY(coef[u], table[x][u]);
+      for (u = 1; u < size; u += 2)
+	odd += MULTIPLY(coef[u], table[x][u]);
+      outptr[x] = range_limit[(int) DESCALE(even + odd,
+					    CONST_BITS+PASS1_BITS)
+			      & RANGE_MASK];
+      outptr[size-1-x] = range_limit[(int) DESCALE(even - odd,
+						   CONST_BITS+PASS1_BITS)
+				     & RANGE_MASK];
+    }
+  }
+}
+
 #endif /* IDCT_SCALING_SUPPORTED */
@@ -263,6 +263,7 @@ typedef int boolean;
 #define DCT_ISLOW_SUPPORTED	/* slow but accurate integer algorithm */
 #define DCT_IFAST_SUPPORTED	/* faster, less accurate integer method */
 #define DCT_FLOAT_SUPPORTED	/* floating-point: accurate, fast on fast HW */
+#define SIMD_SUPPORTED		/* SSE2/NEON kernels where the CPU has them */
 
 /* Encoder capability options: */
 
@@ -279,6 +280,7 @@ typedef int boolean;
  * don't work for progressive mode.  (This may get fixed, however.)
  */
 #define INPUT_SMOOTHING_SUPPORTED   /* Input image smoothing option? */
+#define C_THREADS_SUPPORTED	    /* Parallel encoding of restart intervals? */
 
 /* Decoder capability options: */
 
@@ -292,6 +294,7 @@ typedef int boolean;
 #define UPSAMPLE_MERGING_SUPPORTED  /* Fast path for sloppy upsampling? */
 #define QUANT_1PASS_SUPPORTED	    /* 1-pass color quantization? */
 #define QUANT_2PASS_SUPPORTED	    /* 2-pass color quantization? */
+#define D_THREADS_SUPPORTED	    /* Parallel decoding of restart intervals? */
 
 /* more capability options later, no doubt */
 
@@ -114,6 +114,10 @@ struct jpeg_entropy_encoder {
   JMETHOD(void, start_pass, (j_compress_ptr cinfo, boolean gather_statistics));
   JMETHOD(boolean, encode_mcu, (j_compress_ptr cinfo, JBLOCKROW *MCU_data));
   JMETHOD(void, finish_pass, (j_compress_ptr cinfo));
+  /* Restart output at the start of restart interval first_interval of the
+   * scan, for parallel encoding (jcparal.c); NULL if not supported.
+   */
+  JMETHOD(void, start_band, (j_compress_ptr cinfo, long first_interval));
 };
 
 /* Marker writing */
@@ -242,6 +246,22 @@ struct jpeg_upsampler {
   boolean need_context_rows;	/* TRUE if need rows above & below */
 };
 
+/* Resampling of the upsampler's output to the thumbnail size */
+struct jpeg_resizer {
+  JMETHOD(void, start_pass, (j_decompress_ptr cinfo));
+  /* Same arguments as the upsample method, which this one calls */
+  JMETHOD(void, resize, (j_decompress_ptr cinfo,
+			 JSAMPIMAGE input_buf,
+			 JDIMENSION *in_row_group_ctr,
+			 JDIMENSION in_row_groups_avail,
+			 JSAMPARRAY output_buf,
+			 JDIMENSION *out_row_ctr,
+			 JDIMENSION out_rows_avail));
+
+  JDIMENSION input_rows;	/* # of rows taken from upsampler this pass */
+  boolean rows_pending;		/* TRUE if rows of a row group are left over */
+};
+
 /* Colorspace conversion */
 struct jpeg_color_deconverter {
   JMETHOD(void, start_pass, (j_decompress_ptr cinfo));
@@ -299,6 +319,7 @@ struct jpeg_color_quantizer {
 #define jinit_c_main_controller	jICMainC
 #define jinit_c_prep_controller	jICPrepC
 #define jinit_c_coef_controller	jICCoefC
+#define jinit_c_parallel_controller	jICParal
 #define jinit_color_converter	jICColor
 #define jinit_downsampler	jIDownsampler
 #define jinit_forward_dct	jIFDCT
@@ -308,6 +329,7 @@ struct jpeg_color_quantizer {
 #define jinit_master_decompress	jIDMaster
 #define jinit_d_main_controller	jIDMainC
 #define jinit_d_coef_controller	jIDCoefC
+#define jinit_d_parallel_controller	jIDParal
 #define jinit_d_post_controller	jIDPostC
 #define jinit_input_controller	jIInCtlr
 #define jinit_marker_reader	jIMReader
@@ -319,12 +341,14 @@ struct jpeg_color_quantizer {
 #define jinit_1pass_quantizer	jI1Quant
 #define jinit_2pass_quantizer	jI2Quant
 #define jinit_merged_upsampler	jIMUpsampler
+#define jinit_resizer		jIResizer
 #define jinit_memory_mgr	jIMemMgr
 #define jdiv_round_up		jDivRound
 #define jround_up		jRound
 #define jcopy_sample_rows	jCopySamples
 #define jcopy_block_row		jCopyBlocks
 #define jzero_far		jZeroFar
+#define jrgb_pixel_layout	jRGBLayout
 #define jpeg_zigzag_order	jZIGTable
 #define jpeg_natural_order	jZAGTable
 #endif /* NEED_SHORT_EXTERNAL_NAMES */
@@ -340,6 +364,7 @@ EXTERN(void) jinit_c_prep_controller JPP((j_compress_ptr cinfo,
 					  boolean need_full_buffer));
 EXTERN(void) jinit_c_coef_controller JPP((j_compress_ptr cinfo,
 					  boolean need_full_buffer));
+EXTERN(void) jinit_c_parallel_controller JPP((j_compress_ptr cinfo));
 EXTERN(void) jinit_color_converter JPP((j_compress_ptr cinfo));
 EXTERN(void) jinit_downsampler JPP((j_compress_ptr cinfo));
 EXTERN(void) jinit_forward_dct JPP((j_compress_ptr cinfo));
@@ -352,6 +377,7 @@ EXTERN(void) jinit_d_main_controller JPP((j_decompress_ptr cinfo,
 					  boolean need_full_buffer));
 EXTERN(void) jinit_d_coef_controller JPP((j_decompress_ptr cinfo,
 					  boolean need_full_buffer));
+EXTERN(void) jinit_d_parallel_controller JPP((j_decompress_ptr cinfo));
 EXTERN(void) jinit_d_post_controller JPP((j_decompress_ptr cinfo,
 					  boolean need_full_buffer));
 EXTERN(void) jinit_input_controller JPP((j_decompress_ptr cinfo));
@@ -364,6 +390,7 @@ EXTERN(void) jinit_color_deconverter JPP((j_decompress_ptr cinfo));
 EXTERN(void) jinit_1pass_quantizer JPP((j_decompress_ptr cinfo));
 EXTERN(void) jinit_2pass_quantizer JPP((j_decompress_ptr cinfo));
 EXTERN(void) jinit_merged_upsampler JPP((j_decompress_ptr cinfo));
+EXTERN(void) jinit_resizer JPP((j_decompress_ptr cinfo));
 /* Memory manager initialization */
 EXTERN(void) jinit_memory_mgr JPP((j_common_ptr cinfo));
 
@@ -376,6 +403,7 @@ EXTERN(void) jcopy_sample_rows JPP((JSAMPARRAY input_array, int source_row,
 EXTERN(void) jcopy_block_row JPP((JBLOCKROW input_row, JBLOCKROW output_row,
 				  JDIMENSION num_blocks));
 EXTERN(void) jzero_far JPP((void FAR * target, size_t bytestozero));
+EXTERN(int) jrgb_pixel_layout JPP((J_COLOR_SPACE space, int * offsets));
 /* Constant tables in jutils.c */
 #if 0				/* This table is not actually needed in v6a */
 extern const int jpeg_zigzag_order[]; /* natural coef order to zigzag order */
@@ -141,7 +141,7 @@ typedef struct {
   /* Size of a DCT block in samples.  Always DCTSIZE for compression.
    * For decompression this is the size of the output from one DCT block,
    * reflecting any scaling we choose to apply during the IDCT step.
-   * Values of 1,2,4,8 are likely to be supported.  Note that different
+   * Values from 1 to DCTSIZE are supported.  Note that different
    * components may receive different IDCT scalings.
    */
   int DCT_scaled_size;
@@ -158,6 +158,12 @@ typedef struct {
    * we can skip most computations for the unused components.
    */
   boolean component_needed;	/* do we need the value of this component? */
+  /* Also for decompression only: the number of coefficients, counted in
+   * zigzag order from the DC, that the selected IDCT looks at.  The entropy
+   * decoders need not store (and in progressive mode, need not even decode)
+   * any coefficient beyond this.  DCTSIZE2 unless the IDCT is scaled.
+   */
+  int coef_limit;
 
   /* These values are computed before starting a scan of the component. */
   /* The decompressor output side may not use these variables. */
@@ -209,7 +215,15 @@ typedef enum {
 	JCS_RGB,		/* red/green/blue */
 	JCS_YCbCr,		/* Y/Cb/Cr (also known as YUV) */
 	JCS_CMYK,		/* C/M/Y/K */
-	JCS_YCCK		/* Y/Cb/Cr/K */
+	JCS_YCCK,		/* Y/Cb/Cr/K */
+	/* Output-only RGB layouts for decompression.  Each pixel is 4 bytes;
+	 * the X or A byte is set to MAXJSAMPLE (opaque).
+	 */
+	JCS_EXT_RGBX,		/* red/green/blue/x */
+	JCS_EXT_BGRX,		/* blue/green/red/x */
+	JCS_EXT_XRGB,		/* x/red/green/blue */
+	JCS_EXT_RGBA,		/* red/green/blue/alpha */
+	JCS_EXT_BGRA		/* blue/green/red/alpha */
 } J_COLOR_SPACE;
 
 /* DCT/IDCT algorithm options. */
@@ -332,6 +346,17 @@ struct jpeg_compress_struct {
   unsigned int restart_interval; /* MCUs per restart, or 0 for no restart */
   int restart_in_rows;		/* if > 0, MCU rows per restart interval */
 
+  /* Single-scan sequential files can be encoded on several threads, each
+   * DCTing and entropy-encoding a band of MCU rows that starts at a restart
+   * marker.  If no restart interval is given, one MCU row is used.  Input
+   * is collected a batch of bands at a time, so the output lags behind the
+   * jpeg_write_scanlines calls, but is otherwise the same as from a serial
+   * encoder.  Bands can only begin at MCU rows that begin a restart
+   * interval, so restart_in_rows is the best way to give the interval.
+   * 1 (the default) disables this, 0 means one thread per processor.
+   */
+  int num_threads;		/* max # of threads to encode with */
+
   /* Parameters controlling emission of special markers. */
 
   boolean write_JFIF_header;	/* should a JFIF marker be written? */
@@ -431,6 +456,18 @@ struct jpeg_decompress_struct {
 
   unsigned int scale_num, scale_denom; /* fraction by which to scale image */
 
+  /* Thumbnail mode: if either of these is nonzero, scale_num/scale_denom
+   * are ignored and the output is made to fit within the given size (zero
+   * means no limit on that dimension), keeping the aspect ratio.  The
+   * smallest sufficient DCT scaling is used, and if exact_output_size is
+   * TRUE or DCT scaling alone cannot fit the box, the scaled image is then
+   * resampled to the largest size that fits.  A progressive file is read
+   * only until the coefficients this scaling needs are complete.
+   */
+  JDIMENSION max_output_width;	/* thumbnail box, or 0 */
+  JDIMENSION max_output_height;
+  boolean exact_output_size;	/* TRUE=resample to exactly fit the box */
+
   double output_gamma;		/* image gamma wanted in output */
 
   boolean buffered_image;	/* TRUE=multiple output passes */
@@ -440,6 +477,15 @@ struct jpeg_decompress_struct {
   boolean do_fancy_upsampling;	/* TRUE=apply fancy upsampling */
   boolean do_block_smoothing;	/* TRUE=apply interblock smoothing */
 
+  /* Single-scan sequential files with restart markers can be decoded on
+   * several threads, each entropy-decoding and IDCTing a band of MCU rows
+   * that starts at a restart marker.  The whole image is decoded on the
+   * first jpeg_read_scanlines call, into a full-size buffer, and the
+   * rest of the processing is done on the calling thread as usual.
+   * 1 (the default) disables this, 0 means one thread per processor.
+   */
+  int num_threads;		/* max # of threads to decode with */
+
   boolean quantize_colors;	/* TRUE=colormapped output wanted */
   /* the following are ignored if not quantize_colors: */
   J_DITHER_MODE dither_mode;	/* type of color dithering to use */
@@ -577,6 +623,13 @@ struct jpeg_decompress_struct {
 
   int min_DCT_scaled_size;	/* smallest DCT_scaled_size of any component */
 
+  /* Size of the image produced by the IDCT scaling, upsampling and color
+   * conversion steps.  This equals output_width/output_height unless the
+   * image is resampled to fit max_output_width/max_output_height.
+   */
+  JDIMENSION scaled_width;
+  JDIMENSION scaled_height;
+
   JDIMENSION total_iMCU_rows;	/* # of iMCU rows in image */
   /* The coefficient controller's input and output progress is measured in
    * units of "iMCU" (interleaved MCU) rows.  These are the same as MCU rows
@@ -627,6 +680,7 @@ struct jpeg_decompress_struct {
   struct jpeg_upsampler * upsample;
   struct jpeg_color_deconverter * cconvert;
   struct jpeg_color_quantizer * cquantize;
+  struct jpeg_resizer * resize;	/* NULL unless resampling the output */
 };
 
 
@@ -836,6 +890,8 @@ typedef JMETHOD(boolean, jpeg_marker_parser_method, (j_decompress_ptr cinfo));
 #define jpeg_destroy_decompress	jDestDecompress
 #define jpeg_stdio_dest		jStdDest
 #define jpeg_stdio_src		jStdSrc
+#define jpeg_mem_dest		jMemDest
+#define jpeg_mem_src		jMemSrc
 #define jpeg_set_defaults	jSetDefaults
 #define jpeg_set_colorspace	jSetColorspace
 #define jpeg_default_colorspace	jDefColorspace
@@ -877,6 +933,8 @@ typedef JMETHOD(boolean, jpeg_marker_parser_method, (j_decompress_ptr cinfo));
 #define jpeg_abort		jAbort
 #define jpeg_destroy		jDestroy
 #define jpeg_resync_to_restart	jResyncRestart
+#define jpeg_probe_memory	jProbeMemory
+#define jpeg_probe_files	jProbeFiles
 #endif /* NEED_SHORT_EXTERNAL_NAMES */
 
 
@@ -910,6 +968,14 @@ EXTERN(void) jpeg_destroy_decompress JPP((j_decompress_ptr cinfo));
 EXTERN(void) jpeg_stdio_dest JPP((j_compress_ptr cinfo, FILE * outfile));
 EXTERN(void) jpeg_stdio_src JPP((j_decompress_ptr cinfo, FILE * infile));
 
+/* Data source and destination managers: memory buffers. */
+EXTERN(void) jpeg_mem_dest JPP((j_compress_ptr cinfo,
+				unsigned char ** outbuffer,
+				unsigned long * outsize));
+EXTERN(void) jpeg_mem_src JPP((j_decompress_ptr cinfo,
+			       const unsigned char * inbuffer,
+			       unsigned long insize));
+
 /* Default parameter setup for compression */
 EXTERN(void) jpeg_set_defaults JPP((j_compress_ptr cinfo));
 /* Compression parameter setup aids */
@@ -1037,6 +1103,22 @@ EXTERN(void) jpeg_destroy JPP((j_common_ptr cinfo));
 EXTERN(boolean) jpeg_resync_to_restart JPP((j_decompress_ptr cinfo,
 					    int desired));
 
+/* Header-only probing, without a decompression object (see jdprobe.c). */
+typedef struct {
+  JDIMENSION image_width;	/* nominal image width */
+  JDIMENSION image_height;	/* nominal image height */
+  int num_components;		/* # of color components, 0 if no JPEG found */
+  int data_precision;		/* bits of precision in image data */
+  J_COLOR_SPACE jpeg_color_space; /* colorspace jpeg_read_header would guess */
+  boolean progressive_mode;	/* TRUE if SOFn specifies progressive mode */
+  boolean arith_code;		/* TRUE if SOFn specifies arithmetic coding */
+} jpeg_probe_info;
+
+EXTERN(boolean) jpeg_probe_memory JPP((const JOCTET * data, size_t size,
+				       jpeg_probe_info * info));
+EXTERN(int) jpeg_probe_files JPP((const char * const * file_names, int count,
+				  jpeg_probe_info * info));
+
 
 /* These marker codes are exported since applications and data source modules
  * are likely to want to use them.
@@ -1077,6 +1159,7 @@ struct jpeg_inverse_dct { long dummy; };
 struct jpeg_upsampler { long dummy; };
 struct jpeg_color_deconverter { long dummy; };
 struct jpeg_color_quantizer { long dummy; };
+struct jpeg_resizer { long dummy; };
 #endif /* JPEG_INTERNALS */
 #endif /* INCOMPLETE_TYPES_BROKEN */
 
@@ -0,0 +1,521 @@
+/*
+ * jsimd.c
+ *
+ * Copyright (C) 1994-1996, Thomas G. Lane.
+ * This file is part of the Independent JPEG Group's software.
+ * For conditions of distribution and use, see the accompanying README file.
+ *
+ * This file contains the run-time selection of the SIMD encoder and decoder
+ * routines, and the parts of those routines that are done in C: the IDCT
+ * fallback for blocks whose coefficients don't fit the 16-bit arithmetic of
+ * the kernels, the reciprocal tables for quantization, and the ends of rows
+ * that are not a whole number of vectors wide.  The kernels themselves are
+ * in jsimdsse2.c and jsimdneon.c.
+ *
+ * The SIMD code can be disabled at run time by setting the environment
+ * variable JPEGSIMD to "0", which is handy when comparing speeds.  If your
+ * system doesn't support getenv(), define NO_GETENV to disable this feature.
+ */
+
+#define JPEG_INTERNALS
+#include "jinclude.h"
+#include "jpeglib.h"
+#include "jdct.h"		/* Private declarations for DCT subsystem */
+#include "jsimd.h"
+
+#ifdef SIMD_SUPPORTED
+
+#ifndef NO_GETENV
+#ifndef HAVE_STDLIB_H		/* <stdlib.h> should declare getenv() */
+extern char * getenv JPP((const char * name));
+#endif
+#endif
+
+#ifdef JSIMD_SSE2
+#if !defined(__SSE2__) && !defined(_M_X64) && !defined(_M_AMD64) && \
+    !defined(__x86_64__)
+#define CHECK_CPUID		/* 32-bit x86: SSE2 is optional */
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+#endif
+
+#ifdef JSIMD_NEON
+#if defined(__linux__) && !defined(__aarch64__)
+#define CHECK_AUXV		/* 32-bit ARM Linux: NEON is optional */
+#define AT_HWCAP_TAG  16	/* from <elf.h> */
+#define HWCAP_NEON_BIT  4096	/* from <asm/hwcap.h> */
+#endif
+#endif
+
+
+/*
+ * Find out whether the CPU has the instructions the kernels use.
+ * The answer is cached; several threads may race to fill in the cache,
+ * but they all store the same value.
+ */
+
+static volatile int simd_support = -1; /* -1 until tested */
+
+LOCAL(int)
+init_simd (void)
+{
+  int support = 1;
+
+  if (simd_support >= 0)
+    return simd_support;
+
+#ifdef CHECK_CPUID
+  {
+#ifdef _MSC_VER
+    int info[4];
+
+    __cpuid(info, 1);
+    support = (info[3] & (1 << 26)) != 0; /* EDX bit 26: SSE2 */
+#else
+    unsigned int eax, ebx, ecx, edx;
+
+    support = __get_cpuid(1, &eax, &ebx, &ecx, &edx) &&
+	      (edx & (1U << 26)) != 0; /* EDX bit 26: SSE2 */
+#endif
+  }
+#endif
+
+#ifdef CHECK_AUXV
+  {
+    FILE * auxv = fopen("/proc/self/auxv", "rb");
+    unsigned long entry[2];
+
+    support = 0;
+    if (auxv != NULL) {
+      while (fread(entry, SIZEOF(entry), 1, auxv) == 1 && entry[0] != 0) {
+	if (entry[0] == AT_HWCAP_TAG) {
+	  support = (entry[1] & HWCAP_NEON_BIT) != 0;
+	  break;
+	}
+      }
+      fclose(auxv);
+    }
+  }
+#endif
+
+#ifndef NO_GETENV
+  { char * simdenv;
+
+    if ((simdenv = getenv("JPEGSIMD")) != NULL && simdenv[0] == '0')
+      support = 0;
+  }
+#endif
+
+  simd_support = support;
+  return support;
+}
+
+
+/*
+ * Capability tests, called when the method pointers are chosen.
+ * The IDCT kernels take the multipliers as 16-bit values, so the test
+ * looks at the table built for the component by jddctmgr.c.
+ */
+
+GLOBAL(boolean)
+jsimd_can_idct_islow (jpeg_component_info * compptr)
+{
+  ISLOW_MULT_TYPE * qtbl = (ISLOW_MULT_TYPE *) compptr->dct_table;
+  int i;
+
+  if (SIZEOF(JCOEF) != 2 || ! init_simd())
+    return FALSE;
+  for (i = 0; i < DCTSIZE2; i++) {
+    if (qtbl[i] > 32767)
+      return FALSE;
+  }
+  return TRUE;
+}
+
+
+GLOBAL(boolean)
+jsimd_can_idct_ifast (jpeg_component_info * compptr)
+{
+#ifdef USE_ACCURATE_ROUNDING
+  return FALSE;			/* the kernels truncate, as jidctfst.c does */
+#else
+  IFAST_MULT_TYPE * qtbl = (IFAST_MULT_TYPE *) compptr->dct_table;
+  int i;
+
+  if (SIZEOF(JCOEF) != 2 || ! init_simd())
+    return FALSE;
+  for (i = 0; i < DCTSIZE2; i++) {
+    if (qtbl[i] > 32767)
+      return FALSE;
+  }
+  return TRUE;
+#endif
+}
+
+
+GLOBAL(boolean)
+jsimd_can_ycc_rgb (void)
+{
+  return init_simd() ? TRUE : FALSE;
+}
+
+
+GLOBAL(boolean)
+jsimd_can_merged_upsample (void)
+{
+  return init_simd() ? TRUE : FALSE;
+}
+
+
+GLOBAL(boolean)
+jsimd_can_h2v2_fancy_upsample (void)
+{
+  return init_simd() ? TRUE : FALSE;
+}
+
+
+/*
+ * Inverse DCT.  A block that the kernel declines is done by the C routine.
+ */
+
+GLOBAL(void)
+jsimd_idct_islow (j_decompress_ptr cinfo, jpeg_component_info * compptr,
+		  JCOEFPTR coef_block,
+		  JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+  if (! jsimd_idct_islow_block(coef_block,
+			       (const MULTIPLIER *) compptr->dct_table,
+			       output_buf, output_col))
+    jpeg_idct_islow(cinfo, compptr, coef_block, output_buf, output_col);
+}
+
+
+GLOBAL(void)
+jsimd_idct_ifast (j_decompress_ptr cinfo, jpeg_component_info * compptr,
+		  JCOEFPTR coef_block,
+		  JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+  if (! jsimd_idct_ifast_block(coef_block,
+			       (const MULTIPLIER *) compptr->dct_table,
+			       output_buf, output_col))
+    jpeg_idct_ifast(cinfo, compptr, coef_block, output_buf, output_col);
+}
+
+
+/*
+ * YCbCr->RGB conversion of the pixels after the last whole vector.
+ * These are the equations of jdcolor.c, computed directly rather than
+ * through its tables (the results are the same).  With a chroma_shift
+ * of 1, each chroma sample serves two columns, as in jdmerge.c.
+ */
+
+#define SCALEBITS	16	/* speediest right-shift on some machines */
+#define ONE_HALF	((INT32) 1 << (SCALEBITS-1))
+#define FIX16(x)	((INT32) ((x) * (1L<<SCALEBITS) + 0.5))
+
+LOCAL(void)
+ycc_rgb_tail (JSAMPLE * range_limit, JSAMPROW inptr0, JSAMPROW inptr1,
+	      JSAMPROW inptr2, JSAMPROW outptr, JDIMENSION col,
+	      JDIMENSION num_cols, int chroma_shift, const int * rgb_offset)
+{
+  register int y, cb, cr;
+  int pixelsize = (rgb_offset[3] < 0) ? 3 : 4;
+  SHIFT_TEMPS
+
+  outptr += col * pixelsize;
+  for (; col < num_cols; col++) {
+    y  = GETJSAMPLE(inptr0[col]);
+    cb = GETJSAMPLE(inptr1[col >> chroma_shift]) - CENTERJSAMPLE;
+    cr = GETJSAMPLE(inptr2[col >> chroma_shift]) - CENTERJSAMPLE;
+    outptr[rgb_offset[0]] = range_limit[y + (int)
+		RIGHT_SHIFT(FIX16(1.40200) * cr + ONE_HALF, SCALEBITS)];
+    outptr[rgb_offset[1]] = range_limit[y + (int)
+		RIGHT_SHIFT(- FIX16(0.34414) * cb - FIX16(0.71414) * cr + ONE_HALF,
+			    SCALEBITS)];
+    outptr[rgb_offset[2]] = range_limit[y + (int)
+		RIGHT_SHIFT(FIX16(1.77200) * cb + ONE_HALF, SCALEBITS)];
+    if (rgb_offset[3] >= 0)
+      outptr[rgb_offset[3]] = MAXJSAMPLE;
+    outptr += pixelsize;
+  }
+}
+
+
+GLOBAL(void)
+jsimd_ycc_rgb_convert (j_decompress_ptr cinfo,
+		       JSAMPIMAGE input_buf, JDIMENSION input_row,
+		       JSAMPARRAY output_buf, int num_rows)
+{
+  JDIMENSION num_cols = cinfo->scaled_width;
+  JDIMENSION simd_cols = num_cols & ~((JDIMENSION) 15);
+  JSAMPROW inptr0, inptr1, inptr2, outptr;
+  int rgb_offset[4];
+
+  (void) jrgb_pixel_layout(cinfo->out_color_space, rgb_offset);
+  while (--num_rows >= 0) {
+    inptr0 = input_buf[0][input_row];
+    inptr1 = input_buf[1][input_row];
+    inptr2 = input_buf[2][input_row];
+    input_row++;
+    outptr = *output_buf++;
+    jsimd_ycc_rgb_row(inptr0, inptr1, inptr2, outptr, simd_cols, rgb_offset);
+    ycc_rgb_tail(cinfo->sample_range_limit, inptr0, inptr1, inptr2,
+		 outptr, simd_cols, num_cols, 0, rgb_offset);
+  }
+}
+
+
+/*
+ * Merged upsampling: each chroma sample serves two columns of pixels.
+ * The row tails are done by ycc_rgb_tail with a chroma shift of 1.
+ */
+
+GLOBAL(void)
+jsimd_h2v1_merged_upsample (j_decompress_ptr cinfo,
+			    JSAMPIMAGE input_buf, JDIMENSION in_row_group_ctr,
+			    JSAMPARRAY output_buf)
+{
+  JDIMENSION num_cols = cinfo->scaled_width;
+  JDIMENSION simd_cols = num_cols & ~((JDIMENSION) 15);
+  JSAMPROW inptr0, inptr1, inptr2;
+  int rgb_offset[4];
+
+  (void) jrgb_pixel_layout(cinfo->out_color_space, rgb_offset);
+  inptr0 = input_buf[0][in_row_group_ctr];
+  inptr1 = input_buf[1][in_row_group_ctr];
+  inptr2 = input_buf[2][in_row_group_ctr];
+  jsimd_merged_row(inptr0, NULL, inptr1, inptr2, output_buf[0], NULL,
+		   simd_cols, rgb_offset);
+  ycc_rgb_tail(cinfo->sample_range_limit, inptr0, inptr1, inptr2,
+	       output_buf[0], simd_cols, num_cols, 1, rgb_offset);
+}
+
+
+GLOBAL(void)
+jsimd_h2v2_merged_upsample (j_decompress_ptr cinfo,
+			    JSAMPIMAGE input_buf, JDIMENSION in_row_group_ctr,
+			    JSAMPARRAY output_buf)
+{
+  JDIMENSION num_cols = cinfo->scaled_width;
+  JDIMENSION simd_cols = num_cols & ~((JDIMENSION) 15);
+  JSAMPROW inptr00, inptr01, inptr1, inptr2;
+  int rgb_offset[4];
+
+  (void) jrgb_pixel_layout(cinfo->out_color_space, rgb_offset);
+  inptr00 = input_buf[0][in_row_group_ctr*2];
+  inptr01 = input_buf[0][in_row_group_ctr*2 + 1];
+  inptr1 = input_buf[1][in_row_group_ctr];
+  inptr2 = input_buf[2][in_row_group_ctr];
+  jsimd_merged_row(inptr00, inptr01, inptr1, inptr2,
+		   output_buf[0], output_buf[1], simd_cols, rgb_offset);
+  ycc_rgb_tail(cinfo->sample_range_limit, inptr00, inptr1, inptr2,
+	       output_buf[0], simd_cols, num_cols, 1, rgb_offset);
+  ycc_rgb_tail(cinfo->sample_range_limit, inptr01, inptr1, inptr2,
+	       output_buf[1], simd_cols, num_cols, 1, rgb_offset);
+}
+
+
+/*
+ * Fancy upsampling, 2h2v.  The kernel does the interior columns 8 at a
+ * time; the first column, the last column and any left over in between
+ * are done here exactly as in jdsample.c.
+ */
+
+#define COLSUM(col)  (GETJSAMPLE(inptr0[col]) * 3 + GETJSAMPLE(inptr1[col]))
+
+GLOBAL(void)
+jsimd_h2v2_fancy_upsample (j_decompress_ptr cinfo,
+			   jpeg_component_info * compptr,
+			   JSAMPARRAY input_data, JSAMPARRAY * output_data_ptr)
+{
+  JSAMPARRAY output_data = *output_data_ptr;
+  register JSAMPROW inptr0, inptr1, outptr;
+  register int thiscolsum, lastcolsum, nextcolsum;
+  JDIMENSION num_cols = compptr->downsampled_width;
+  JDIMENSION simd_cols = (num_cols - 2) & ~((JDIMENSION) 7);
+  JDIMENSION col;
+  int inrow, outrow, v;
+
+  inrow = outrow = 0;
+  while (outrow < cinfo->max_v_samp_factor) {
+    for (v = 0; v < 2; v++) {
+      /* inptr0 points to nearest input row, inptr1 points to next nearest */
+      inptr0 = input_data[inrow];
+      if (v == 0)		/* next nearest is row above */
+	inptr1 = input_data[inrow-1];
+      else			/* next nearest is row below */
+	inptr1 = input_data[inrow+1];
+      outptr = output_data[outrow++];
+
+      /* Special case for first column */
+      thiscolsum = COLSUM(0);
+      nextcolsum = COLSUM(1);
+      outptr[0] = (JSAMPLE) ((thiscolsum * 4 + 8) >> 4);
+      outptr[1] = (JSAMPLE) ((thiscolsum * 3 + nextcolsum + 7) >> 4);
+
+      jsimd_h2v2_fancy_row(inptr0, inptr1, outptr, simd_cols);
+
+      /* Remaining columns; the last one is its own next neighbor */
+      for (col = simd_cols + 1; col < num_cols; col++) {
+	lastcolsum = COLSUM(col - 1);
+	thiscolsum = COLSUM(col);
+	nextcolsum = (col + 1 < num_cols) ? COLSUM(col + 1) : thiscolsum;
+	outptr[2*col] = (JSAMPLE) ((thiscolsum * 3 + lastcolsum + 8) >> 4);
+	outptr[2*col+1] = (JSAMPLE) ((thiscolsum * 3 + nextcolsum + 7) >> 4);
+      }
+    }
+    inrow++;
+  }
+}
+
+
+
+/*
+ * Encoder capability tests.  The quantization tables are checked later,
+ * by jsimd_fdct_divisors.
+ */
+
+GLOBAL(boolean)
+jsimd_can_rgb_ycc (void)
+{
+  return init_simd() ? TRUE : FALSE;
+}
+
+
+GLOBAL(boolean)
+jsimd_can_fdct_islow (void)
+{
+  if (SIZEOF(JCOEF) != 2 || SIZEOF(UINT16) != 2)
+    return FALSE;
+  return init_simd() ? TRUE : FALSE;
+}
+
+
+GLOBAL(boolean)
+jsimd_can_fdct_ifast (void)
+{
+#ifdef USE_ACCURATE_ROUNDING
+  return FALSE;			/* the kernels truncate, as jfdctfst.c does */
+#else
+  if (SIZEOF(JCOEF) != 2 || SIZEOF(UINT16) != 2)
+    return FALSE;
+  return init_simd() ? TRUE : FALSE;
+#endif
+}
+
+
+/*
+ * RGB->YCbCr conversion of the pixels after the last whole vector.
+ * These are the equations of jccolor.c, computed directly rather than
+ * through its tables (the results are the same).
+ */
+
+LOCAL(void)
+rgb_ycc_tail (JSAMPROW inptr, JSAMPROW outptr0, JSAMPROW outptr1,
+	      JSAMPROW outptr2, JDIMENSION col, JDIMENSION num_cols)
+{
+  register INT32 r, g, b;
+
+  inptr += col * RGB_PIXELSIZE;
+  for (; col < num_cols; col++) {
+    r = GETJSAMPLE(inptr[RGB_RED]);
+    g = GETJSAMPLE(inptr[RGB_GREEN]);
+    b = GETJSAMPLE(inptr[RGB_BLUE]);
+    inptr += RGB_PIXELSIZE;
+    outptr0[col] = (JSAMPLE)
+      ((FIX16(0.29900) * r + FIX16(0.58700) * g + FIX16(0.11400) * b
+	+ ONE_HALF) >> SCALEBITS);
+    if (outptr1 != NULL) {
+      outptr1[col] = (JSAMPLE)
+	((- FIX16(0.16874) * r - FIX16(0.33126) * g + FIX16(0.50000) * b
+	  + ((INT32) CENTERJSAMPLE << SCALEBITS) + ONE_HALF-1) >> SCALEBITS);
+      outptr2[col] = (JSAMPLE)
+	((FIX16(0.50000) * r - FIX16(0.41869) * g - FIX16(0.08131) * b
+	  + ((INT32) CENTERJSAMPLE << SCALEBITS) + ONE_HALF-1) >> SCALEBITS);
+    }
+  }
+}
+
+
+GLOBAL(void)
+jsimd_rgb_ycc_convert (j_compress_ptr cinfo,
+		       JSAMPARRAY input_buf, JSAMPIMAGE output_buf,
+		       JDIMENSION output_row, int num_rows)
+{
+  static const int rgb_offset[4] = { RGB_RED, RGB_GREEN, RGB_BLUE, -1 };
+  JDIMENSION num_cols = cinfo->image_width;
+  JDIMENSION simd_cols = num_cols & ~((JDIMENSION) 15);
+  JSAMPROW inptr, outptr0, outptr1, outptr2;
+
+  while (--num_rows >= 0) {
+    inptr = *input_buf++;
+    outptr0 = output_buf[0][output_row];
+    outptr1 = output_buf[1][output_row];
+    outptr2 = output_buf[2][output_row];
+    output_row++;
+    jsimd_rgb_ycc_row(inptr, outptr0, outptr1, outptr2, simd_cols,
+		      rgb_offset);
+    rgb_ycc_tail(inptr, outptr0, outptr1, outptr2, simd_cols, num_cols);
+  }
+}
+
+
+GLOBAL(void)
+jsimd_rgb_gray_convert (j_compress_ptr cinfo,
+			JSAMPARRAY input_buf, JSAMPIMAGE output_buf,
+			JDIMENSION output_row, int num_rows)
+{
+  static const int rgb_offset[4] = { RGB_RED, RGB_GREEN, RGB_BLUE, -1 };
+  JDIMENSION num_cols = cinfo->image_width;
+  JDIMENSION simd_cols = num_cols & ~((JDIMENSION) 15);
+  JSAMPROW inptr, outptr;
+
+  while (--num_rows >= 0) {
+    inptr = *input_buf++;
+    outptr = output_buf[0][output_row++];
+    jsimd_rgb_ycc_row(inptr, outptr, NULL, NULL, simd_cols, rgb_offset);
+    rgb_ycc_tail(inptr, outptr, NULL, NULL, simd_cols, num_cols);
+  }
+}
+
+
+/*
+ * Build the reciprocal table for the FDCT kernels.  jcdctmgr.c divides the
+ * magnitude of each coefficient, plus half the divisor d, by d.  For 8-bit
+ * samples that dividend a is under 16K plus d/2, so below 32K if d is.
+ * With k = floor(log2(d)) and m = ceil(2^(16+k) / d), floor(a / d) is
+ * then exactly floor(floor(a * m / 2^16) / 2^k), and the kernels compute
+ * it with two unsigned high-half multiplies:
+ *   table[i]              m, or 0 if d is a power of 2 (m = 2^16; the
+ *                         first multiply is skipped)
+ *   table[DCTSIZE2 + i]   d/2, the rounding term
+ *   table[2*DCTSIZE2 + i] 2^(16-k), or 0 if d = 1 (no shift)
+ */
+
+GLOBAL(boolean)
+jsimd_fdct_divisors (const int * divisors, UINT16 * table)
+{
+  INT32 d;
+  int i, k;
+
+  for (i = 0; i < DCTSIZE2; i++) {
+    d = divisors[i];
+    if (d < 1 || d > 32767)
+      return FALSE;
+    for (k = 0; (d >> (k+1)) != 0; k++)
+      ;
+    if ((d & (d - 1)) == 0)
+      table[i] = 0;
+    else
+      table[i] = (UINT16) ((((INT32) 1 << (16+k)) + d - 1) / d);
+    table[DCTSIZE2 + i] = (UINT16) (d >> 1);
+    table[2*DCTSIZE2 + i] = (UINT16) (k == 0 ? 0 : (INT32) 1 << (16-k));
+  }
+  return TRUE;
+}
+
+#endif /* SIMD_SUPPORTED */
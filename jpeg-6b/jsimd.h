@@ -0,0 +1,184 @@
+/*
+ * jsimd.h
+ *
+ * Copyright (C) 1994-1996, Thomas G. Lane.
+ * This file is part of the Independent JPEG Group's software.
+ * For conditions of distribution and use, see the accompanying README file.
+ *
+ * This include file contains declarations for the SIMD (SSE2 or NEON)
+ * versions of the encoder's and decoder's inner loops.  These declarations
+ * are private to the modules that select them (jccolor.c, jcdctmgr.c,
+ * jddctmgr.c, jdcolor.c, jdmerge.c, jdsample.c) and to the SIMD modules
+ * themselves (jsimd.c, jsimdsse2.c, jsimdneon.c).
+ *
+ * Each routine produces exactly the same output as the C routine it
+ * replaces.  The jsimd_can_xxx() tests say whether a routine may be used;
+ * they return FALSE if this CPU lacks the instructions, or if the
+ * environment variable JPEGSIMD is set to "0".
+ */
+
+
+/*
+ * Select the instruction set.  The code requires 8-bit samples, an 8x8
+ * DCT, and the standard RGB pixel layout of jmorecfg.h.
+ */
+
+#ifdef SIMD_SUPPORTED
+#if BITS_IN_JSAMPLE != 8 || DCTSIZE != 8 || RGB_PIXELSIZE != 3
+#undef SIMD_SUPPORTED
+#endif
+#endif
+
+#ifdef SIMD_SUPPORTED
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || \
+    defined(_M_IX86) || defined(__x86_64__) || \
+    (defined(__i386__) && defined(__GNUC__) && !defined(__clang__))
+#define JSIMD_SSE2		/* SSE2, tested at run time on 32-bit x86 */
+#else
+#if defined(__ARM_NEON__) || defined(__ARM_NEON) || defined(_M_ARM) || \
+    defined(_M_ARM64) || defined(__aarch64__)
+#define JSIMD_NEON		/* NEON, tested at run time on 32-bit Linux */
+#else
+#undef SIMD_SUPPORTED		/* no SIMD code for this machine */
+#endif
+#endif
+#endif
+
+
+#ifdef SIMD_SUPPORTED
+
+/* Short forms of external names for systems with brain-damaged linkers. */
+
+#ifdef NEED_SHORT_EXTERNAL_NAMES
+#define jsimd_can_idct_islow	jCanIslow
+#define jsimd_can_idct_ifast	jCanIfast
+#define jsimd_can_ycc_rgb	jCanYccRgb
+#define jsimd_can_merged_upsample	jCanMerged
+#define jsimd_can_h2v2_fancy_upsample	jCanFancy
+#define jsimd_idct_islow	jSDislow
+#define jsimd_idct_ifast	jSDifast
+#define jsimd_ycc_rgb_convert	jSYccRgb
+#define jsimd_h2v1_merged_upsample	jSMrg21
+#define jsimd_h2v2_merged_upsample	jSMrg22
+#define jsimd_h2v2_fancy_upsample	jSFancy22
+#define jsimd_idct_islow_block	jSKislow
+#define jsimd_idct_ifast_block	jSKifast
+#define jsimd_ycc_rgb_row	jSKyccRgb
+#define jsimd_merged_row	jSKmerged
+#define jsimd_h2v2_fancy_row	jSKfancy
+#define jsimd_can_rgb_ycc	jCanRgbYcc
+#define jsimd_can_fdct_islow	jCanFislow
+#define jsimd_can_fdct_ifast	jCanFifast
+#define jsimd_rgb_ycc_convert	jSRgbYcc
+#define jsimd_rgb_gray_convert	jSRgbGray
+#define jsimd_fdct_divisors	jSFdivisors
+#define jsimd_rgb_ycc_row	jSKrgbYcc
+#define jsimd_fdct_islow_block	jSKfislow
+#define jsimd_fdct_ifast_block	jSKfifast
+#endif /* NEED_SHORT_EXTERNAL_NAMES */
+
+/* Capability tests (jsimd.c) */
+
+EXTERN(boolean) jsimd_can_idct_islow JPP((jpeg_component_info * compptr));
+EXTERN(boolean) jsimd_can_idct_ifast JPP((jpeg_component_info * compptr));
+EXTERN(boolean) jsimd_can_ycc_rgb JPP((void));
+EXTERN(boolean) jsimd_can_merged_upsample JPP((void));
+EXTERN(boolean) jsimd_can_h2v2_fancy_upsample JPP((void));
+
+/* Method routines (jsimd.c), with the signatures of those they replace */
+
+EXTERN(void) jsimd_idct_islow
+    JPP((j_decompress_ptr cinfo, jpeg_component_info * compptr,
+	 JCOEFPTR coef_block, JSAMPARRAY output_buf, JDIMENSION output_col));
+EXTERN(void) jsimd_idct_ifast
+    JPP((j_decompress_ptr cinfo, jpeg_component_info * compptr,
+	 JCOEFPTR coef_block, JSAMPARRAY output_buf, JDIMENSION output_col));
+EXTERN(void) jsimd_ycc_rgb_convert
+    JPP((j_decompress_ptr cinfo, JSAMPIMAGE input_buf, JDIMENSION input_row,
+	 JSAMPARRAY output_buf, int num_rows));
+EXTERN(void) jsimd_h2v1_merged_upsample
+    JPP((j_decompress_ptr cinfo, JSAMPIMAGE input_buf,
+	 JDIMENSION in_row_group_ctr, JSAMPARRAY output_buf));
+EXTERN(void) jsimd_h2v2_merged_upsample
+    JPP((j_decompress_ptr cinfo, JSAMPIMAGE input_buf,
+	 JDIMENSION in_row_group_ctr, JSAMPARRAY output_buf));
+EXTERN(void) jsimd_h2v2_fancy_upsample
+    JPP((j_decompress_ptr cinfo, jpeg_component_info * compptr,
+	 JSAMPARRAY input_data, JSAMPARRAY * output_data_ptr));
+
+/*
+ * Kernels (jsimdsse2.c or jsimdneon.c).  The IDCT kernels do one block and
+ * return FALSE, having stored nothing, if the coefficients are too large
+ * for 16-bit arithmetic; the caller then uses the C routine.  The row
+ * kernels handle a number of pixels that is a multiple of 16 (of 8 input
+ * columns for jsimd_h2v2_fancy_row, which reads one column either side);
+ * the caller does the rest of the row.  The color kernels store pixels laid
+ * out as described by rgb_offset[] (see jrgb_pixel_layout): 3 bytes if
+ * rgb_offset[3] < 0, else 4 bytes with MAXJSAMPLE in the X/alpha byte.
+ */
+
+EXTERN(boolean) jsimd_idct_islow_block
+    JPP((JCOEFPTR coef_block, const MULTIPLIER * quantptr,
+	 JSAMPARRAY output_buf, JDIMENSION output_col));
+EXTERN(boolean) jsimd_idct_ifast_block
+    JPP((JCOEFPTR coef_block, const MULTIPLIER * quantptr,
+	 JSAMPARRAY output_buf, JDIMENSION output_col));
+EXTERN(void) jsimd_ycc_rgb_row
+    JPP((JSAMPROW inptr0, JSAMPROW inptr1, JSAMPROW inptr2,
+	 JSAMPROW outptr, JDIMENSION num_cols, const int * rgb_offset));
+EXTERN(void) jsimd_merged_row
+    JPP((JSAMPROW inptr00, JSAMPROW inptr01, JSAMPROW inptr1,
+	 JSAMPROW inptr2, JSAMPROW outptr0, JSAMPROW outptr1,
+	 JDIMENSION num_cols, const int * rgb_offset));
+EXTERN(void) jsimd_h2v2_fancy_row
+    JPP((JSAMPROW inptr0, JSAMPROW inptr1, JSAMPROW outptr,
+	 JDIMENSION num_cols));
+
+
+/*
+ * The encoder side.  The forward DCT kernels also quantize, which they do
+ * by multiplying by reciprocals; jsimd_fdct_divisors builds the table of
+ * reciprocals for them from jcdctmgr.c's divisors.  That returns FALSE,
+ * leaving the C routines to do that quantization table, if a divisor is
+ * too large for the 16-bit arithmetic of the kernels.
+ */
+
+#define JSIMD_DIVISORS_SIZE  (3*DCTSIZE2) /* UINT16s in a reciprocal table */
+
+/* Capability tests (jsimd.c) */
+
+EXTERN(boolean) jsimd_can_rgb_ycc JPP((void));
+EXTERN(boolean) jsimd_can_fdct_islow JPP((void));
+EXTERN(boolean) jsimd_can_fdct_ifast JPP((void));
+
+/* Method routines (jsimd.c), and the reciprocal table builder */
+
+EXTERN(void) jsimd_rgb_ycc_convert
+    JPP((j_compress_ptr cinfo, JSAMPARRAY input_buf, JSAMPIMAGE output_buf,
+	 JDIMENSION output_row, int num_rows));
+EXTERN(void) jsimd_rgb_gray_convert
+    JPP((j_compress_ptr cinfo, JSAMPARRAY input_buf, JSAMPIMAGE output_buf,
+	 JDIMENSION output_row, int num_rows));
+EXTERN(boolean) jsimd_fdct_divisors
+    JPP((const int * divisors, UINT16 * table)); /* DCTELEM is int here */
+
+/*
+ * Kernels (jsimdsse2.c or jsimdneon.c).  jsimd_rgb_ycc_row converts a
+ * number of pixels that is a multiple of 16, laid out as described by
+ * rgb_offset[] (3 bytes per pixel); if outptr1 is NULL it stores only Y.
+ * The FDCT kernels transform and quantize the 8x8 block of samples at
+ * column start_col of sample_data, given the table built by
+ * jsimd_fdct_divisors.
+ */
+
+EXTERN(void) jsimd_rgb_ycc_row
+    JPP((JSAMPROW inptr, JSAMPROW outptr0, JSAMPROW outptr1,
+	 JSAMPROW outptr2, JDIMENSION num_cols, const int * rgb_offset));
+EXTERN(void) jsimd_fdct_islow_block
+    JPP((JSAMPARRAY sample_data, JDIMENSION start_col,
+	 const UINT16 * divisors, JCOEFPTR coef_block));
+EXTERN(void) jsimd_fdct_ifast_block
+    JPP((JSAMPARRAY sample_data, JDIMENSION start_col,
+	 const UINT16 * divisors, JCOEFPTR coef_block));
+
+#endif /* SIMD_SUPPORTED */
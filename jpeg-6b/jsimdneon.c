@@ -0,0 +1,826 @@
+/*
+ * jsimdneon.c
+ *
+ * Copyright (C) 1994-1996, Thomas G. Lane.
+ * This file is part of the Independent JPEG Group's software.
+ * For conditions of distribution and use, see the accompanying README file.
+ *
+ * This file contains the NEON kernels for the encoder and decoder (see
+ * jsimd.h).  They follow jsimdsse2.c step for step, and are exact for the
+ * same reasons; see the notes there.  NEON has multiply-accumulate by a
+ * scalar, so the DCT sums are formed input by input rather than in pairs,
+ * and unsigned 16x16->32-bit multiplies, so the color conversion needs no
+ * splitting of its constants.
+ */
+
+#define JPEG_INTERNALS
+#include "jinclude.h"
+#include "jpeglib.h"
+#include "jdct.h"		/* Private declarations for DCT subsystem */
+#include "jsimd.h"
+
+#ifdef JSIMD_NEON
+
+#include <arm_neon.h>
+
+
+/* |x| for x >= 0, |x|-1 for x < 0, in each 16-bit lane */
+#define ABS_LESS(x)  veorq_s16(x, vshrq_n_s16(x, 15))
+
+/* TRUE if any bit of a vector is set */
+#define ANY_SET(v)  \
+  (vget_lane_u64(vreinterpret_u64_u16(vorr_u16( \
+     vget_low_u16(vreinterpretq_u16_s16(v)), \
+     vget_high_u16(vreinterpretq_u16_s16(v)))), 0) != 0)
+
+
+/*
+ * Transpose an 8x8 block of 16-bit values held as 8 rows.
+ */
+
+LOCAL(void)
+transpose_8x8 (int16x8_t * r)
+{
+  int16x8x2_t t01 = vtrnq_s16(r[0], r[1]);
+  int16x8x2_t t23 = vtrnq_s16(r[2], r[3]);
+  int16x8x2_t t45 = vtrnq_s16(r[4], r[5]);
+  int16x8x2_t t67 = vtrnq_s16(r[6], r[7]);
+  int32x4x2_t u02 = vtrnq_s32(vreinterpretq_s32_s16(t01.val[0]),
+			      vreinterpretq_s32_s16(t23.val[0]));
+  int32x4x2_t u13 = vtrnq_s32(vreinterpretq_s32_s16(t01.val[1]),
+			      vreinterpretq_s32_s16(t23.val[1]));
+  int32x4x2_t u46 = vtrnq_s32(vreinterpretq_s32_s16(t45.val[0]),
+			      vreinterpretq_s32_s16(t67.val[0]));
+  int32x4x2_t u57 = vtrnq_s32(vreinterpretq_s32_s16(t45.val[1]),
+			      vreinterpretq_s32_s16(t67.val[1]));
+
+#define JOIN(a,b,half)  \
+  vcombine_s16(vget_##half##_s16(vreinterpretq_s16_s32(a)), \
+	       vget_##half##_s16(vreinterpretq_s16_s32(b)))
+
+  r[0] = JOIN(u02.val[0], u46.val[0], low);
+  r[1] = JOIN(u13.val[0], u57.val[0], low);
+  r[2] = JOIN(u02.val[1], u46.val[1], low);
+  r[3] = JOIN(u13.val[1], u57.val[1], low);
+  r[4] = JOIN(u02.val[0], u46.val[0], high);
+  r[5] = JOIN(u13.val[0], u57.val[0], high);
+  r[6] = JOIN(u02.val[1], u46.val[1], high);
+  r[7] = JOIN(u13.val[1], u57.val[1], high);
+
+#undef JOIN
+}
+
+
+/*
+ * Dequantize the 8 rows of a coefficient block; any product that doesn't
+ * fit in 16 bits leaves bits set in bad.
+ */
+
+LOCAL(void)
+dequantize_block (JCOEFPTR coef_block, const MULTIPLIER * quantptr,
+		  int16x8_t * x, int16x8_t * bad)
+{
+  int16x8_t c, q;
+  int32x4_t lo, hi;
+  int i;
+
+  for (i = 0; i < DCTSIZE; i++) {
+    c = vld1q_s16((const int16_t *) (coef_block + DCTSIZE*i));
+    if (SIZEOF(MULTIPLIER) == 2)
+      q = vld1q_s16((const int16_t *) (quantptr + DCTSIZE*i));
+    else
+      q = vcombine_s16(
+	    vmovn_s32(vld1q_s32((const int32_t *) (quantptr + DCTSIZE*i))),
+	    vmovn_s32(vld1q_s32((const int32_t *) (quantptr + DCTSIZE*i + 4))));
+    lo = vmull_s16(vget_low_s16(c), vget_low_s16(q));
+    hi = vmull_s16(vget_high_s16(c), vget_high_s16(q));
+    x[i] = vcombine_s16(vmovn_s32(lo), vmovn_s32(hi));
+    *bad = vorrq_s16(*bad, veorq_s16(x[i], vcombine_s16(vqmovn_s32(lo),
+							 vqmovn_s32(hi))));
+  }
+}
+
+
+/*
+ * Range-limit the masked values of the final pass and store the block.
+ * The values are held as 8 columns.
+ */
+
+LOCAL(void)
+range_limit_store (int16x8_t * t, JSAMPARRAY output_buf,
+		   JDIMENSION output_col)
+{
+  const int16x8_t c255 = vdupq_n_s16(255);
+  int i;
+
+  for (i = 0; i < DCTSIZE; i++) {
+    t[i] = vbslq_s16(vcgtq_s16(t[i], c255),
+		     vbslq_s16(vcgtq_s16(t[i], vdupq_n_s16(639)),
+			       vdupq_n_s16(0), c255),
+		     t[i]);
+  }
+  transpose_8x8(t);
+  for (i = 0; i < DCTSIZE; i++)
+    vst1_u8(output_buf[i] + output_col, vqmovun_s16(t[i]));
+}
+
+
+/*
+ * One 1-D pass of the LL&M IDCT (jidctint.c) on 4 lanes of 16-bit inputs,
+ * giving the undescaled 32-bit outputs.
+ */
+
+LOCAL(void)
+islow_1d (const int16x4_t * in, int32x4_t * out)
+{
+  int32x4_t tmp0, tmp1, tmp2, tmp3, tmp10, tmp11, tmp12, tmp13;
+  int32x4_t o0, o1, o2, o3;
+
+  /* Even part */
+
+  tmp0 = vaddq_s32(vshll_n_s16(in[0], 13), vshll_n_s16(in[4], 13));
+  tmp1 = vsubq_s32(vshll_n_s16(in[0], 13), vshll_n_s16(in[4], 13));
+  tmp2 = vmlal_n_s16(vmull_n_s16(in[2], 4433), in[6], 4433 - 15137);
+  tmp3 = vmlal_n_s16(vmull_n_s16(in[2], 4433 + 6270), in[6], 4433);
+
+  tmp10 = vaddq_s32(tmp0, tmp3);
+  tmp13 = vsubq_s32(tmp0, tmp3);
+  tmp11 = vaddq_s32(tmp1, tmp2);
+  tmp12 = vsubq_s32(tmp1, tmp2);
+
+  /* Odd part: the constants of jidctint.c, collected per input */
+
+  o0 = vmull_n_s16(in[7], 2446 - 7373 - 16069 + 9633);
+  o0 = vmlal_n_s16(o0, in[5], 9633);
+  o0 = vmlal_n_s16(o0, in[3], - 16069 + 9633);
+  o0 = vmlal_n_s16(o0, in[1], - 7373 + 9633);
+
+  o1 = vmull_n_s16(in[7], 9633);
+  o1 = vmlal_n_s16(o1, in[5], 16819 - 20995 - 3196 + 9633);
+  o1 = vmlal_n_s16(o1, in[3], - 20995 + 9633);
+  o1 = vmlal_n_s16(o1, in[1], - 3196 + 9633);
+
+  o2 = vmull_n_s16(in[7], - 16069 + 9633);
+  o2 = vmlal_n_s16(o2, in[5], - 20995 + 9633);
+  o2 = vmlal_n_s16(o2, in[3], 25172 - 20995 - 16069 + 9633);
+  o2 = vmlal_n_s16(o2, in[1], 9633);
+
+  o3 = vmull_n_s16(in[7], - 7373 + 9633);
+  o3 = vmlal_n_s16(o3, in[5], - 3196 + 9633);
+  o3 = vmlal_n_s16(o3, in[3], 9633);
+  o3 = vmlal_n_s16(o3, in[1], 12299 - 7373 - 3196 + 9633);
+
+  out[0] = vaddq_s32(tmp10, o3);
+  out[7] = vsubq_s32(tmp10, o3);
+  out[1] = vaddq_s32(tmp11, o2);
+  out[6] = vsubq_s32(tmp11, o2);
+  out[2] = vaddq_s32(tmp12, o1);
+  out[5] = vsubq_s32(tmp12, o1);
+  out[3] = vaddq_s32(tmp13, o0);
+  out[4] = vsubq_s32(tmp13, o0);
+}
+
+
+GLOBAL(boolean)
+jsimd_idct_islow_block (JCOEFPTR coef_block, const MULTIPLIER * quantptr,
+			JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+  int16x8_t x[DCTSIZE];
+  int16x4_t lo[DCTSIZE], hi[DCTSIZE];
+  int32x4_t outlo[DCTSIZE], outhi[DCTSIZE];
+  int16x8_t bad = vdupq_n_s16(0);
+  int16x4_t n, s;
+  int i;
+
+  dequantize_block(coef_block, quantptr, x, &bad);
+  if (ANY_SET(bad))
+    return FALSE;
+
+  /* Pass 1: process columns, descale by CONST_BITS-PASS1_BITS = 11 */
+
+  for (i = 0; i < DCTSIZE; i++) {
+    lo[i] = vget_low_s16(x[i]);
+    hi[i] = vget_high_s16(x[i]);
+  }
+  islow_1d(lo, outlo);
+  islow_1d(hi, outhi);
+  for (i = 0; i < DCTSIZE; i++) {
+    n = vrshrn_n_s32(outlo[i], 11);
+    s = vqrshrn_n_s32(outlo[i], 11);
+    x[i] = vcombine_s16(n, vrshrn_n_s32(outhi[i], 11));
+    bad = vorrq_s16(bad, veorq_s16(x[i],
+				   vcombine_s16(s, vqrshrn_n_s32(outhi[i], 11))));
+  }
+  if (ANY_SET(bad))
+    return FALSE;
+
+  /* Pass 2: process rows, descale by CONST_BITS+PASS1_BITS+3 = 18,
+   * adding CENTERJSAMPLE for the range limiting.
+   */
+
+  transpose_8x8(x);
+  for (i = 0; i < DCTSIZE; i++) {
+    lo[i] = vget_low_s16(x[i]);
+    hi[i] = vget_high_s16(x[i]);
+  }
+  islow_1d(lo, outlo);
+  islow_1d(hi, outhi);
+  for (i = 0; i < DCTSIZE; i++) {
+    const int32x4_t round = vdupq_n_s32((1 << 17) + (CENTERJSAMPLE << 18));
+
+    x[i] = vcombine_s16(vmovn_s32(vshrq_n_s32(vaddq_s32(outlo[i], round), 18)),
+			vmovn_s32(vshrq_n_s32(vaddq_s32(outhi[i], round), 18)));
+    x[i] = vandq_s16(x[i], vdupq_n_s16(RANGE_MASK));
+  }
+
+  range_limit_store(x, output_buf, output_col);
+  return TRUE;
+}
+
+
+/*
+ * (v * c) >> 8 in each 16-bit lane, as MULTIPLY in jidctfst.c
+ * (truncated to 16 bits).
+ */
+
+#define MUL8(v,c)  \
+  vcombine_s16(vshrn_n_s32(vmull_n_s16(vget_low_s16(v), c), 8), \
+	       vshrn_n_s32(vmull_n_s16(vget_high_s16(v), c), 8))
+
+/*
+ * One 1-D pass of the AA&N IDCT (jidctfst.c), in place.
+ */
+
+LOCAL(void)
+ifast_1d (int16x8_t * x)
+{
+  int16x8_t tmp0, tmp1, tmp2, tmp3, tmp4, tmp5, tmp6, tmp7;
+  int16x8_t tmp10, tmp11, tmp12, tmp13;
+  int16x8_t z5, z10, z11, z12, z13;
+
+  /* Even part */
+
+  tmp10 = vaddq_s16(x[0], x[4]);
+  tmp11 = vsubq_s16(x[0], x[4]);
+  tmp13 = vaddq_s16(x[2], x[6]);
+  tmp12 = vsubq_s16(MUL8(vsubq_s16(x[2], x[6]), 362), tmp13);
+
+  tmp0 = vaddq_s16(tmp10, tmp13);
+  tmp3 = vsubq_s16(tmp10, tmp13);
+  tmp1 = vaddq_s16(tmp11, tmp12);
+  tmp2 = vsubq_s16(tmp11, tmp12);
+
+  /* Odd part */
+
+  z13 = vaddq_s16(x[5], x[3]);
+  z10 = vsubq_s16(x[5], x[3]);
+  z11 = vaddq_s16(x[1], x[7]);
+  z12 = vsubq_s16(x[1], x[7]);
+
+  tmp7 = vaddq_s16(z11, z13);
+  tmp11 = MUL8(vsubq_s16(z11, z13), 362);
+
+  z5 = MUL8(vaddq_s16(z10, z12), 473);
+  tmp10 = vsubq_s16(MUL8(z12, 277), z5);
+  tmp12 = vaddq_s16(MUL8(z10, -669), z5);
+
+  tmp6 = vsubq_s16(tmp12, tmp7);
+  tmp5 = vsubq_s16(tmp11, tmp6);
+  tmp4 = vaddq_s16(tmp10, tmp5);
+
+  x[0] = vaddq_s16(tmp0, tmp7);
+  x[7] = vsubq_s16(tmp0, tmp7);
+  x[1] = vaddq_s16(tmp1, tmp6);
+  x[6] = vsubq_s16(tmp1, tmp6);
+  x[2] = vaddq_s16(tmp2, tmp5);
+  x[5] = vsubq_s16(tmp2, tmp5);
+  x[4] = vaddq_s16(tmp3, tmp4);
+  x[3] = vsubq_s16(tmp3, tmp4);
+}
+
+
+GLOBAL(boolean)
+jsimd_idct_ifast_block (JCOEFPTR coef_block, const MULTIPLIER * quantptr,
+			JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+  int16x8_t x[DCTSIZE];
+  int16x8_t bad = vdupq_n_s16(0);
+  uint16x8_t sum, s3;
+  int i;
+
+#define UABS(v)  vreinterpretq_u16_s16(ABS_LESS(v))
+
+  dequantize_block(coef_block, quantptr, x, &bad);
+  if (ANY_SET(bad))
+    return FALSE;
+
+  /* Pass 1 is exact in 16 bits if, in each column,
+   *   |x0| + 2|x1| + 2|x2| + 3|x3| + |x4| + 3|x5| + 3|x6| + 6|x7|
+   * is under 32767, less a margin for the truncations.
+   */
+  sum = vqaddq_u16(UABS(x[1]), UABS(x[2]));
+  sum = vqaddq_u16(sum, sum);
+  s3 = vqaddq_u16(vqaddq_u16(UABS(x[3]), UABS(x[5])),
+		  vqaddq_u16(UABS(x[6]), UABS(x[7])));
+  s3 = vqaddq_u16(UABS(x[7]), s3);
+  s3 = vqaddq_u16(vqaddq_u16(s3, s3), s3);
+  sum = vqaddq_u16(sum, s3);
+  sum = vqaddq_u16(sum, vqaddq_u16(UABS(x[0]), UABS(x[4])));
+  if (ANY_SET(vreinterpretq_s16_u16(vcgtq_u16(sum,
+				    vdupq_n_u16(32767 - 64)))))
+    return FALSE;
+
+  /* Pass 1: process columns */
+
+  ifast_1d(x);
+
+  /* Pass 2 is exact (in the bits that are kept) if the odd inputs are
+   * within +-8K and inputs 2 and 6 are within +-16K.
+   */
+  transpose_8x8(x);
+  bad = vorrq_s16(vorrq_s16(ABS_LESS(x[1]), ABS_LESS(x[3])),
+		  vorrq_s16(ABS_LESS(x[5]), ABS_LESS(x[7])));
+  bad = vorrq_s16(vbicq_s16(bad, vdupq_n_s16(8191)),
+		  vbicq_s16(vorrq_s16(ABS_LESS(x[2]), ABS_LESS(x[6])),
+			    vdupq_n_s16(16383)));
+  if (ANY_SET(bad))
+    return FALSE;
+
+  /* Pass 2: process rows, descale by PASS1_BITS+3 = 5 */
+
+  ifast_1d(x);
+  for (i = 0; i < DCTSIZE; i++) {
+    x[i] = vandq_s16(vaddq_s16(vshrq_n_s16(x[i], 5),
+			       vdupq_n_s16(CENTERJSAMPLE)),
+		     vdupq_n_s16(RANGE_MASK));
+  }
+
+  range_limit_store(x, output_buf, output_col);
+  return TRUE;
+
+#undef UABS
+}
+
+
+/*
+ * Color conversion.  Given 8 values of Cb and Cr less CENTERJSAMPLE,
+ * compute the red, green and blue offsets to add to Y.  vqdmulh by k
+ * gives (2x * k) >> 16.
+ */
+
+LOCAL(void)
+ycc_offsets (int16x8_t cb, int16x8_t cr, int16x8_t * red,
+	     int16x8_t * green, int16x8_t * blue)
+{
+  int32x4_t gl, gh;
+
+  /* 1.40200 = 1 + 26345/65536 */
+  *red = vaddq_s16(cr, vrshrq_n_s16(vqdmulhq_n_s16(cr, 26345), 1));
+  /* 1.77200 = 2 - 14942/65536 */
+  *blue = vaddq_s16(vshlq_n_s16(cb, 1),
+		    vrshrq_n_s16(vqdmulhq_n_s16(cb, -14942), 1));
+  /* -0.71414 = -1 + 18734/65536 */
+  gl = vmlal_n_s16(vmull_n_s16(vget_low_s16(cb), -22554),
+		   vget_low_s16(cr), 18734);
+  gh = vmlal_n_s16(vmull_n_s16(vget_high_s16(cb), -22554),
+		   vget_high_s16(cr), 18734);
+  *green = vsubq_s16(vcombine_s16(vrshrn_n_s32(gl, 16),
+				  vrshrn_n_s32(gh, 16)), cr);
+}
+
+/* Chroma sample less CENTERJSAMPLE, widened */
+#define CENTERED(v)  \
+  vreinterpretq_s16_u16(vsubl_u8(v, vdup_n_u8(CENTERJSAMPLE)))
+
+/* Y plus an offset, clamped to 0..255 */
+#define ADD_CLAMP(y,off)  \
+  vqmovun_s16(vaddq_s16(vreinterpretq_s16_u16(vmovl_u8(y)), off))
+
+
+/*
+ * Store 16 pixels, given as 16 samples of each component, in the layout
+ * described by rgb_offset[].
+ */
+
+LOCAL(void)
+store_rgb16 (JSAMPROW outptr, uint8x16_t red, uint8x16_t green,
+	     uint8x16_t blue, const int * rgb_offset)
+{
+  uint8x16x3_t rgb;
+  uint8x16x4_t rgbx;
+
+  if (rgb_offset[3] < 0) {
+    rgb.val[rgb_offset[0]] = red;
+    rgb.val[rgb_offset[1]] = green;
+    rgb.val[rgb_offset[2]] = blue;
+    vst3q_u8(outptr, rgb);
+  } else {
+    rgbx.val[rgb_offset[0]] = red;
+    rgbx.val[rgb_offset[1]] = green;
+    rgbx.val[rgb_offset[2]] = blue;
+    rgbx.val[rgb_offset[3]] = vdupq_n_u8(MAXJSAMPLE);
+    vst4q_u8(outptr, rgbx);
+  }
+}
+
+
+GLOBAL(void)
+jsimd_ycc_rgb_row (JSAMPROW inptr0, JSAMPROW inptr1, JSAMPROW inptr2,
+		   JSAMPROW outptr, JDIMENSION num_cols,
+		   const int * rgb_offset)
+{
+  uint8x16_t y, cb, cr;
+  int16x8_t rl, gl, bl, rh, gh, bh;
+  JDIMENSION col;
+  int pixelsize = (rgb_offset[3] < 0) ? 3 : 4;
+
+  for (col = 0; col < num_cols; col += 16) {
+    y = vld1q_u8(inptr0 + col);
+    cb = vld1q_u8(inptr1 + col);
+    cr = vld1q_u8(inptr2 + col);
+    ycc_offsets(CENTERED(vget_low_u8(cb)), CENTERED(vget_low_u8(cr)),
+		&rl, &gl, &bl);
+    ycc_offsets(CENTERED(vget_high_u8(cb)), CENTERED(vget_high_u8(cr)),
+		&rh, &gh, &bh);
+    store_rgb16(outptr + col * pixelsize,
+		vcombine_u8(ADD_CLAMP(vget_low_u8(y), rl),
+			    ADD_CLAMP(vget_high_u8(y), rh)),
+		vcombine_u8(ADD_CLAMP(vget_low_u8(y), gl),
+			    ADD_CLAMP(vget_high_u8(y), gh)),
+		vcombine_u8(ADD_CLAMP(vget_low_u8(y), bl),
+			    ADD_CLAMP(vget_high_u8(y), bh)),
+		rgb_offset);
+  }
+}
+
+
+/*
+ * Merged upsampling: 8 chroma samples give the offsets for 16 pixels
+ * of one or two rows.
+ */
+
+LOCAL(void)
+merged_store (JSAMPROW inptr, JSAMPROW outptr, const int16x8x2_t * off,
+	      const int * rgb_offset)
+{
+  uint8x16_t y = vld1q_u8(inptr);
+
+  store_rgb16(outptr,
+	      vcombine_u8(ADD_CLAMP(vget_low_u8(y), off[0].val[0]),
+			  ADD_CLAMP(vget_high_u8(y), off[0].val[1])),
+	      vcombine_u8(ADD_CLAMP(vget_low_u8(y), off[1].val[0]),
+			  ADD_CLAMP(vget_high_u8(y), off[1].val[1])),
+	      vcombine_u8(ADD_CLAMP(vget_low_u8(y), off[2].val[0]),
+			  ADD_CLAMP(vget_high_u8(y), off[2].val[1])),
+	      rgb_offset);
+}
+
+
+GLOBAL(void)
+jsimd_merged_row (JSAMPROW inptr00, JSAMPROW inptr01, JSAMPROW inptr1,
+		  JSAMPROW inptr2, JSAMPROW outptr0, JSAMPROW outptr1,
+		  JDIMENSION num_cols, const int * rgb_offset)
+{
+  int16x8_t red, green, blue;
+  int16x8x2_t off[3];
+  JDIMENSION col;
+  int pixelsize = (rgb_offset[3] < 0) ? 3 : 4;
+
+  for (col = 0; col < num_cols; col += 16) {
+    ycc_offsets(CENTERED(vld1_u8(inptr1 + (col >> 1))),
+		CENTERED(vld1_u8(inptr2 + (col >> 1))),
+		&red, &green, &blue);
+    off[0] = vzipq_s16(red, red);
+    off[1] = vzipq_s16(green, green);
+    off[2] = vzipq_s16(blue, blue);
+    merged_store(inptr00 + col, outptr0 + col * pixelsize, off, rgb_offset);
+    if (inptr01 != NULL)
+      merged_store(inptr01 + col, outptr1 + col * pixelsize, off,
+		   rgb_offset);
+  }
+}
+
+
+/*
+ * Fancy upsampling, 2h2v: input columns 1..num_cols.
+ */
+
+#define COLSUM(in0,in1,col)  \
+  vmlal_u8(vmovl_u8(vld1_u8((in1) + (col))), vld1_u8((in0) + (col)), \
+	   vdup_n_u8(3))
+
+GLOBAL(void)
+jsimd_h2v2_fancy_row (JSAMPROW inptr0, JSAMPROW inptr1, JSAMPROW outptr,
+		      JDIMENSION num_cols)
+{
+  uint16x8_t lastcolsum, thiscolsum, nextcolsum;
+  uint8x8x2_t out;
+  JDIMENSION col;
+
+  for (col = 1; col < num_cols + 1; col += 8) {
+    lastcolsum = COLSUM(inptr0, inptr1, col - 1);
+    thiscolsum = vmulq_n_u16(COLSUM(inptr0, inptr1, col), 3);
+    nextcolsum = COLSUM(inptr0, inptr1, col + 1);
+    /* (x + 8) >> 4 and (x + 7) >> 4 */
+    out.val[0] = vrshrn_n_u16(vaddq_u16(thiscolsum, lastcolsum), 4);
+    out.val[1] = vshrn_n_u16(vaddq_u16(vaddq_u16(thiscolsum, nextcolsum),
+				       vdupq_n_u16(7)), 4);
+    vst2_u8(outptr + 2*col, out);
+  }
+}
+
+
+
+/*
+ * RGB->YCbCr conversion.  The sums are formed modulo 2^32 in unsigned
+ * lanes; as jccolor.c notes, the final values are never negative.
+ */
+
+#define RGB_SUM(r,g,b,cr,cg,cb,half)  \
+  vmlal_n_u16(vmlal_n_u16(vmull_n_u16(vget_##half##_u16(r), cr), \
+			  vget_##half##_u16(g), cg), \
+	      vget_##half##_u16(b), cb)
+
+#define CHROMA_SUM(x,y,z,cy,cz,half)  \
+  vmlsl_n_u16(vmlsl_n_u16(vaddq_u32(vshll_n_u16(vget_##half##_u16(x), 15), \
+				    offset), \
+			  vget_##half##_u16(y), cy), \
+	      vget_##half##_u16(z), cz)
+
+LOCAL(void)
+rgb_ycc_8 (uint16x8_t r, uint16x8_t g, uint16x8_t b,
+	   uint8x8_t * y, uint8x8_t * cb, uint8x8_t * cr)
+{
+  const uint32x4_t offset = vdupq_n_u32((CENTERJSAMPLE << 16) + 32767);
+
+  *y = vmovn_u16(vcombine_u16(
+	 vrshrn_n_u32(RGB_SUM(r, g, b, 19595, 38470, 7471, low), 16),
+	 vrshrn_n_u32(RGB_SUM(r, g, b, 19595, 38470, 7471, high), 16)));
+  if (cb == NULL)
+    return;
+  /* 0.5 * x is x << 15, and the offset is 128.5 - epsilon */
+  *cb = vmovn_u16(vcombine_u16(
+	  vshrn_n_u32(CHROMA_SUM(b, r, g, 11059, 21709, low), 16),
+	  vshrn_n_u32(CHROMA_SUM(b, r, g, 11059, 21709, high), 16)));
+  *cr = vmovn_u16(vcombine_u16(
+	  vshrn_n_u32(CHROMA_SUM(r, g, b, 27439, 5329, low), 16),
+	  vshrn_n_u32(CHROMA_SUM(r, g, b, 27439, 5329, high), 16)));
+}
+
+
+GLOBAL(void)
+jsimd_rgb_ycc_row (JSAMPROW inptr, JSAMPROW outptr0, JSAMPROW outptr1,
+		   JSAMPROW outptr2, JDIMENSION num_cols,
+		   const int * rgb_offset)
+{
+  uint8x16x3_t px;
+  uint8x16_t r, g, b;
+  uint8x8_t yl, yh, cbl, cbh, crl, crh;
+  JDIMENSION col;
+
+  for (col = 0; col < num_cols; col += 16) {
+    px = vld3q_u8(inptr);
+    inptr += 48;
+    r = px.val[rgb_offset[0]];
+    g = px.val[rgb_offset[1]];
+    b = px.val[rgb_offset[2]];
+    if (outptr1 == NULL) {
+      rgb_ycc_8(vmovl_u8(vget_low_u8(r)), vmovl_u8(vget_low_u8(g)),
+		vmovl_u8(vget_low_u8(b)), &yl, NULL, NULL);
+      rgb_ycc_8(vmovl_u8(vget_high_u8(r)), vmovl_u8(vget_high_u8(g)),
+		vmovl_u8(vget_high_u8(b)), &yh, NULL, NULL);
+    } else {
+      rgb_ycc_8(vmovl_u8(vget_low_u8(r)), vmovl_u8(vget_low_u8(g)),
+		vmovl_u8(vget_low_u8(b)), &yl, &cbl, &crl);
+      rgb_ycc_8(vmovl_u8(vget_high_u8(r)), vmovl_u8(vget_high_u8(g)),
+		vmovl_u8(vget_high_u8(b)), &yh, &cbh, &crh);
+      vst1q_u8(outptr1 + col, vcombine_u8(cbl, cbh));
+      vst1q_u8(outptr2 + col, vcombine_u8(crl, crh));
+    }
+    vst1q_u8(outptr0 + col, vcombine_u8(yl, yh));
+  }
+}
+
+
+/*
+ * Load an 8x8 block of samples as 8 rows of 16-bit values, less
+ * CENTERJSAMPLE.
+ */
+
+LOCAL(void)
+load_samples (JSAMPARRAY sample_data, JDIMENSION start_col, int16x8_t * x)
+{
+  int i;
+
+  for (i = 0; i < DCTSIZE; i++)
+    x[i] = CENTERED(vld1_u8(sample_data[i] + start_col));
+}
+
+
+/* The high half of a 16x16-bit unsigned product, in each lane */
+#define MULHI_U16(a,b)  \
+  vcombine_u16(vshrn_n_u32(vmull_u16(vget_low_u16(a), vget_low_u16(b)), 16), \
+	       vshrn_n_u32(vmull_u16(vget_high_u16(a), vget_high_u16(b)), 16))
+
+/*
+ * Quantize the 8 rows of a block, and store the coefficients; see
+ * jsimdsse2.c.
+ */
+
+LOCAL(void)
+quantize_store (int16x8_t * x, const UINT16 * divisors, JCOEFPTR coef_block)
+{
+  const uint16x8_t zero = vdupq_n_u16(0);
+  int16x8_t sign;
+  uint16x8_t a, m, t;
+  int i;
+
+  for (i = 0; i < DCTSIZE; i++) {
+    sign = vshrq_n_s16(x[i], 15);
+    a = vreinterpretq_u16_s16(vabsq_s16(x[i]));
+    a = vaddq_u16(a, vld1q_u16(divisors + DCTSIZE2 + DCTSIZE*i));
+    m = vld1q_u16(divisors + DCTSIZE*i);
+    t = vaddq_u16(MULHI_U16(a, m), vandq_u16(a, vceqq_u16(m, zero)));
+    m = vld1q_u16(divisors + 2*DCTSIZE2 + DCTSIZE*i);
+    t = vaddq_u16(MULHI_U16(t, m), vandq_u16(t, vceqq_u16(m, zero)));
+    vst1q_s16((int16_t *) (coef_block + DCTSIZE*i),
+	      vsubq_s16(veorq_s16(vreinterpretq_s16_u16(t), sign), sign));
+  }
+}
+
+
+/*
+ * One 1-D pass of the LL&M FDCT (jfdctint.c) on 8 vectors of 16-bit
+ * inputs, in place.  Pass 1 scales its outputs up by 2^PASS1_BITS = 4,
+ * pass 2 removes that scaling.
+ */
+
+/* The sum of two products, descaled by CONST_BITS-+PASS1_BITS */
+#define MUL2_DESCALE(a,ca,b,cb)  \
+  (pass1 ? \
+   vcombine_s16(vrshrn_n_s32(MUL2(a, ca, b, cb, low), 11), \
+		vrshrn_n_s32(MUL2(a, ca, b, cb, high), 11)) : \
+   vcombine_s16(vrshrn_n_s32(MUL2(a, ca, b, cb, low), 15), \
+		vrshrn_n_s32(MUL2(a, ca, b, cb, high), 15)))
+
+#define MUL2(a,ca,b,cb,half)  \
+  vmlal_n_s16(vmull_n_s16(vget_##half##_s16(a), ca), vget_##half##_s16(b), cb)
+
+/* The same for the sum of four products */
+#define MUL4_DESCALE(a,ca,b,cb,c,cc,d,cd)  \
+  (pass1 ? \
+   vcombine_s16(vrshrn_n_s32(MUL4(a, ca, b, cb, c, cc, d, cd, low), 11), \
+		vrshrn_n_s32(MUL4(a, ca, b, cb, c, cc, d, cd, high), 11)) : \
+   vcombine_s16(vrshrn_n_s32(MUL4(a, ca, b, cb, c, cc, d, cd, low), 15), \
+		vrshrn_n_s32(MUL4(a, ca, b, cb, c, cc, d, cd, high), 15)))
+
+#define MUL4(a,ca,b,cb,c,cc,d,cd,half)  \
+  vmlal_n_s16(vmlal_n_s16(MUL2(a, ca, b, cb, half), \
+			  vget_##half##_s16(c), cc), \
+	      vget_##half##_s16(d), cd)
+
+LOCAL(void)
+fdct_islow_1d (int16x8_t * x, boolean pass1)
+{
+  int16x8_t tmp0, tmp1, tmp2, tmp3, tmp4, tmp5, tmp6, tmp7;
+  int16x8_t tmp10, tmp11, tmp12, tmp13;
+
+  tmp0 = vaddq_s16(x[0], x[7]);
+  tmp7 = vsubq_s16(x[0], x[7]);
+  tmp1 = vaddq_s16(x[1], x[6]);
+  tmp6 = vsubq_s16(x[1], x[6]);
+  tmp2 = vaddq_s16(x[2], x[5]);
+  tmp5 = vsubq_s16(x[2], x[5]);
+  tmp3 = vaddq_s16(x[3], x[4]);
+  tmp4 = vsubq_s16(x[3], x[4]);
+
+  /* Even part */
+
+  tmp10 = vaddq_s16(tmp0, tmp3);
+  tmp13 = vsubq_s16(tmp0, tmp3);
+  tmp11 = vaddq_s16(tmp1, tmp2);
+  tmp12 = vsubq_s16(tmp1, tmp2);
+
+  if (pass1) {
+    x[0] = vshlq_n_s16(vaddq_s16(tmp10, tmp11), 2);
+    x[4] = vshlq_n_s16(vsubq_s16(tmp10, tmp11), 2);
+  } else {
+    /* tmp10 + tmp11 may not fit in 16 bits here */
+    x[0] = vcombine_s16(
+	     vrshrn_n_s32(vaddl_s16(vget_low_s16(tmp10),
+				    vget_low_s16(tmp11)), 2),
+	     vrshrn_n_s32(vaddl_s16(vget_high_s16(tmp10),
+				    vget_high_s16(tmp11)), 2));
+    x[4] = vcombine_s16(
+	     vrshrn_n_s32(vsubl_s16(vget_low_s16(tmp10),
+				    vget_low_s16(tmp11)), 2),
+	     vrshrn_n_s32(vsubl_s16(vget_high_s16(tmp10),
+				    vget_high_s16(tmp11)), 2));
+  }
+
+  x[2] = MUL2_DESCALE(tmp12, 4433, tmp13, 4433 + 6270);
+  x[6] = MUL2_DESCALE(tmp12, 4433 - 15137, tmp13, 4433);
+
+  /* Odd part: the constants of jfdctint.c, collected per input */
+
+  x[7] = MUL4_DESCALE(tmp4, 2446 - 7373 - 16069 + 9633, tmp5, 9633,
+		      tmp6, - 16069 + 9633, tmp7, - 7373 + 9633);
+  x[5] = MUL4_DESCALE(tmp4, 9633, tmp5, 16819 - 20995 - 3196 + 9633,
+		      tmp6, - 20995 + 9633, tmp7, - 3196 + 9633);
+  x[3] = MUL4_DESCALE(tmp4, - 16069 + 9633, tmp5, - 20995 + 9633,
+		      tmp6, 25172 - 20995 - 16069 + 9633, tmp7, 9633);
+  x[1] = MUL4_DESCALE(tmp4, - 7373 + 9633, tmp5, - 3196 + 9633,
+		      tmp6, 9633, tmp7, 12299 - 7373 - 3196 + 9633);
+}
+
+
+GLOBAL(void)
+jsimd_fdct_islow_block (JSAMPARRAY sample_data, JDIMENSION start_col,
+			const UINT16 * divisors, JCOEFPTR coef_block)
+{
+  int16x8_t x[DCTSIZE];
+
+  load_samples(sample_data, start_col, x);
+
+  /* Pass 1: process rows, which the transpose makes the vector index */
+  transpose_8x8(x);
+  fdct_islow_1d(x, TRUE);
+
+  /* Pass 2: process columns */
+  transpose_8x8(x);
+  fdct_islow_1d(x, FALSE);
+
+  quantize_store(x, divisors, coef_block);
+}
+
+
+/*
+ * One 1-D pass of the AA&N FDCT (jfdctfst.c), in place.
+ */
+
+LOCAL(void)
+fdct_ifast_1d (int16x8_t * x)
+{
+  int16x8_t tmp0, tmp1, tmp2, tmp3, tmp4, tmp5, tmp6, tmp7;
+  int16x8_t tmp10, tmp11, tmp12, tmp13;
+  int16x8_t z1, z2, z3, z4, z5, z11, z13;
+
+  tmp0 = vaddq_s16(x[0], x[7]);
+  tmp7 = vsubq_s16(x[0], x[7]);
+  tmp1 = vaddq_s16(x[1], x[6]);
+  tmp6 = vsubq_s16(x[1], x[6]);
+  tmp2 = vaddq_s16(x[2], x[5]);
+  tmp5 = vsubq_s16(x[2], x[5]);
+  tmp3 = vaddq_s16(x[3], x[4]);
+  tmp4 = vsubq_s16(x[3], x[4]);
+
+  /* Even part */
+
+  tmp10 = vaddq_s16(tmp0, tmp3);
+  tmp13 = vsubq_s16(tmp0, tmp3);
+  tmp11 = vaddq_s16(tmp1, tmp2);
+  tmp12 = vsubq_s16(tmp1, tmp2);
+
+  x[0] = vaddq_s16(tmp10, tmp11);
+  x[4] = vsubq_s16(tmp10, tmp11);
+
+  z1 = MUL8(vaddq_s16(tmp12, tmp13), 181);
+  x[2] = vaddq_s16(tmp13, z1);
+  x[6] = vsubq_s16(tmp13, z1);
+
+  /* Odd part */
+
+  tmp10 = vaddq_s16(tmp4, tmp5);
+  tmp11 = vaddq_s16(tmp5, tmp6);
+  tmp12 = vaddq_s16(tmp6, tmp7);
+
+  z5 = MUL8(vsubq_s16(tmp10, tmp12), 98);
+  z2 = vaddq_s16(MUL8(tmp10, 139), z5);
+  z4 = vaddq_s16(MUL8(tmp12, 334), z5);
+  z3 = MUL8(tmp11, 181);
+
+  z11 = vaddq_s16(tmp7, z3);
+  z13 = vsubq_s16(tmp7, z3);
+
+  x[5] = vaddq_s16(z13, z2);
+  x[3] = vsubq_s16(z13, z2);
+  x[1] = vaddq_s16(z11, z4);
+  x[7] = vsubq_s16(z11, z4);
+}
+
+
+GLOBAL(void)
+jsimd_fdct_ifast_block (JSAMPARRAY sample_data, JDIMENSION start_col,
+			const UINT16 * divisors, JCOEFPTR coef_block)
+{
+  int16x8_t x[DCTSIZE];
+
+  load_samples(sample_data, start_col, x);
+  transpose_8x8(x);
+  fdct_ifast_1d(x);
+  transpose_8x8(x);
+  fdct_ifast_1d(x);
+  quantize_store(x, divisors, coef_block);
+}
+
+#endif /* JSIMD_NEON */
@@ -0,0 +1,1005 @@
+/*
+ * jsimdsse2.c
+ *
+ * Copyright (C) 1994-1996, Thomas G. Lane.
+ * This file is part of the Independent JPEG Group's software.
+ * For conditions of distribution and use, see the accompanying README file.
+ *
+ * This file contains the SSE2 kernels for the decoder (see jsimd.h).
+ * Each one computes exactly what the corresponding C routine computes:
+ *
+ * jsimd_idct_islow_block: jidctint.c does its arithmetic in 32 bits, on
+ * 16-bit dequantized coefficients and 16-bit intermediate results.  Here
+ * each output of a 1-D pass is a sum of products of pairs of inputs with
+ * the combined constants, done by pmaddwd; this is the same sum that
+ * jidctint.c forms, so the result is identical whenever the coefficients
+ * and the pass-1 results fit in 16 bits.  Blocks for which they don't
+ * (which no sane encoder produces) are given back to the C routine.
+ *
+ * jsimd_idct_ifast_block: jidctfst.c uses only adds and multiplies by
+ * 8-bit fractions, truncated.  These are done on 16-bit lanes, which is
+ * exact for pass 1 given a bound on the inputs, and exact for pass 2 in
+ * the bits that survive the final shift and mask given a bound on the
+ * multiplier inputs.  Blocks outside the bounds go to the C routine.
+ *
+ * The range limiting at the end of the IDCT uses the fact that the
+ * sample_range_limit table (jdmaster.c) maps the masked 10-bit value t,
+ * after adding CENTERJSAMPLE, to t if t < 256, to 255 if t < 640 and to
+ * 0 otherwise.
+ *
+ * The color conversion computes the jdcolor.c table entries exactly with
+ * 16-bit multiplies:
+ *   Cr=>R = x + round(0.40200 * x)
+ *   Cb=>B = 2x + round(-0.22800 * x)
+ *   Cr,Cb=>G = round(-0.34414 * Cb + 0.28586 * Cr) - Cr
+ * where each round(k * x), with k scaled by 2^16, is formed as
+ * (mulhi(2x, k) + 1) >> 1.
+ *
+ * The encoder kernels follow in the second half of the file:
+ *
+ * jsimd_rgb_ycc_row: each jccolor.c output is a sum of products of the
+ * samples with constants scaled by 2^16, which pmaddwd forms exactly.
+ * The terms that don't fit in 16 bits (0.5 = 32768/65536, and 0.587 in
+ * Y) are split or done by shifting.
+ *
+ * jsimd_fdct_islow_block: as for the IDCT, each output of a 1-D pass of
+ * jfdctint.c is a sum of products of pairs of inputs with the combined
+ * constants.  For 8-bit samples every input to those products fits in 16
+ * bits, so no block needs the C routine.
+ *
+ * jsimd_fdct_ifast_block: jfdctfst.c on 16-bit lanes, which is exact as
+ * its intermediate results stay within 16 bits for 8-bit samples.
+ *
+ * Both FDCT kernels quantize by the reciprocal method of jsimd.c.
+ */
+
+#define JPEG_INTERNALS
+#include "jinclude.h"
+#include "jpeglib.h"
+#include "jdct.h"		/* Private declarations for DCT subsystem */
+#include "jsimd.h"
+
+#ifdef JSIMD_SSE2
+
+#if defined(__GNUC__) && !defined(__SSE2__)
+#pragma GCC target("sse2")	/* 32-bit build; SSE2 is checked at run time */
+#endif
+#include <emmintrin.h>
+
+
+/* A vector holding the pair (a,b) in every 32-bit lane, for pmaddwd */
+#define PAIR(a,b)  _mm_set_epi16(b, a, b, a, b, a, b, a)
+
+/* |x| for x >= 0, |x|-1 for x < 0, in each 16-bit lane */
+#define ABS_LESS(x)  _mm_xor_si128(x, _mm_srai_epi16(x, 15))
+
+/* Load a row of 8 multipliers as 16-bit values */
+#define LOAD_MULT(ptr)  \
+  (SIZEOF(*(ptr)) == 2 ? _mm_loadu_si128((const __m128i *) (ptr)) : \
+   _mm_packs_epi32(_mm_loadu_si128((const __m128i *) (ptr)), \
+		   _mm_loadu_si128((const __m128i *) (ptr) + 1)))
+
+
+/*
+ * Transpose an 8x8 block of 16-bit values held as 8 rows.
+ */
+
+LOCAL(void)
+transpose_8x8 (__m128i * r)
+{
+  __m128i a0, a1, a2, a3, a4, a5, a6, a7;
+  __m128i b0, b1, b2, b3, b4, b5, b6, b7;
+
+  a0 = _mm_unpacklo_epi16(r[0], r[1]);
+  a1 = _mm_unpackhi_epi16(r[0], r[1]);
+  a2 = _mm_unpacklo_epi16(r[2], r[3]);
+  a3 = _mm_unpackhi_epi16(r[2], r[3]);
+  a4 = _mm_unpacklo_epi16(r[4], r[5]);
+  a5 = _mm_unpackhi_epi16(r[4], r[5]);
+  a6 = _mm_unpacklo_epi16(r[6], r[7]);
+  a7 = _mm_unpackhi_epi16(r[6], r[7]);
+
+  b0 = _mm_unpacklo_epi32(a0, a2);
+  b1 = _mm_unpackhi_epi32(a0, a2);
+  b2 = _mm_unpacklo_epi32(a1, a3);
+  b3 = _mm_unpackhi_epi32(a1, a3);
+  b4 = _mm_unpacklo_epi32(a4, a6);
+  b5 = _mm_unpackhi_epi32(a4, a6);
+  b6 = _mm_unpacklo_epi32(a5, a7);
+  b7 = _mm_unpackhi_epi32(a5, a7);
+
+  r[0] = _mm_unpacklo_epi64(b0, b4);
+  r[1] = _mm_unpackhi_epi64(b0, b4);
+  r[2] = _mm_unpacklo_epi64(b1, b5);
+  r[3] = _mm_unpackhi_epi64(b1, b5);
+  r[4] = _mm_unpacklo_epi64(b2, b6);
+  r[5] = _mm_unpackhi_epi64(b2, b6);
+  r[6] = _mm_unpacklo_epi64(b3, b7);
+  r[7] = _mm_unpackhi_epi64(b3, b7);
+}
+
+
+/*
+ * Dequantize the 8 rows of a coefficient block.  Returns FALSE if any
+ * product doesn't fit in 16 bits.
+ */
+
+#define DEQUANTIZE_BLOCK(x, coef_block, quantptr, bad)  \
+  for (i = 0; i < DCTSIZE; i++) { \
+    __m128i c = _mm_loadu_si128((const __m128i *) (coef_block + DCTSIZE*i)); \
+    __m128i q = LOAD_MULT(quantptr + DCTSIZE*i); \
+    __m128i lo = _mm_mullo_epi16(c, q); \
+    bad = _mm_or_si128(bad, _mm_xor_si128(_mm_mulhi_epi16(c, q), \
+					 _mm_srai_epi16(lo, 15))); \
+    x[i] = lo; \
+  }
+
+
+/*
+ * Range-limit the masked values of the final pass (see above) and store
+ * the block.  The values are held as 8 columns.
+ */
+
+LOCAL(void)
+range_limit_store (__m128i * t, JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+  const __m128i c255 = _mm_set1_epi16(255);
+  const __m128i c639 = _mm_set1_epi16(639);
+  __m128i m1, m2, out;
+  int i;
+
+  for (i = 0; i < DCTSIZE; i++) {
+    m1 = _mm_cmpgt_epi16(t[i], c255);
+    m2 = _mm_cmpgt_epi16(t[i], c639);
+    t[i] = _mm_or_si128(_mm_andnot_si128(m1, t[i]),
+			_mm_and_si128(_mm_andnot_si128(m2, m1), c255));
+  }
+  transpose_8x8(t);
+  for (i = 0; i < DCTSIZE; i += 2) {
+    out = _mm_packus_epi16(t[i], t[i+1]);
+    _mm_storel_epi64((__m128i *) (output_buf[i] + output_col), out);
+    _mm_storel_epi64((__m128i *) (output_buf[i+1] + output_col),
+		     _mm_srli_si128(out, 8));
+  }
+}
+
+
+/*
+ * One 1-D pass of the LL&M IDCT (jidctint.c) on 8 vectors of 16-bit
+ * inputs, giving the undescaled 32-bit outputs in low and high halves.
+ */
+
+LOCAL(void)
+islow_1d (const __m128i * in, __m128i * lo, __m128i * hi)
+{
+  __m128i p04l, p04h, p26l, p26h, p75l, p75h, p31l, p31h;
+  __m128i t0l, t0h, t1l, t1h, t2l, t2h, t3l, t3h;
+  __m128i t10l, t10h, t11l, t11h, t12l, t12h, t13l, t13h;
+  __m128i o0l, o0h, o1l, o1h, o2l, o2h, o3l, o3h;
+  __m128i c;
+
+  p04l = _mm_unpacklo_epi16(in[0], in[4]);
+  p04h = _mm_unpackhi_epi16(in[0], in[4]);
+  p26l = _mm_unpacklo_epi16(in[2], in[6]);
+  p26h = _mm_unpackhi_epi16(in[2], in[6]);
+  p75l = _mm_unpacklo_epi16(in[7], in[5]);
+  p75h = _mm_unpackhi_epi16(in[7], in[5]);
+  p31l = _mm_unpacklo_epi16(in[3], in[1]);
+  p31h = _mm_unpackhi_epi16(in[3], in[1]);
+
+  /* Even part */
+
+  c = PAIR(8192, 8192);
+  t0l = _mm_madd_epi16(p04l, c);
+  t0h = _mm_madd_epi16(p04h, c);
+  c = PAIR(8192, -8192);
+  t1l = _mm_madd_epi16(p04l, c);
+  t1h = _mm_madd_epi16(p04h, c);
+  c = PAIR(4433, 4433 - 15137);
+  t2l = _mm_madd_epi16(p26l, c);
+  t2h = _mm_madd_epi16(p26h, c);
+  c = PAIR(4433 + 6270, 4433);
+  t3l = _mm_madd_epi16(p26l, c);
+  t3h = _mm_madd_epi16(p26h, c);
+
+  t10l = _mm_add_epi32(t0l, t3l);
+  t10h = _mm_add_epi32(t0h, t3h);
+  t13l = _mm_sub_epi32(t0l, t3l);
+  t13h = _mm_sub_epi32(t0h, t3h);
+  t11l = _mm_add_epi32(t1l, t2l);
+  t11h = _mm_add_epi32(t1h, t2h);
+  t12l = _mm_sub_epi32(t1l, t2l);
+  t12h = _mm_sub_epi32(t1h, t2h);
+
+  /* Odd part: the constants of jidctint.c, collected per input */
+
+  c = PAIR(2446 - 7373 - 16069 + 9633, 9633);
+  o0l = _mm_madd_epi16(p75l, c);
+  o0h = _mm_madd_epi16(p75h, c);
+  c = PAIR(- 16069 + 9633, - 7373 + 9633);
+  o0l = _mm_add_epi32(o0l, _mm_madd_epi16(p31l, c));
+  o0h = _mm_add_epi32(o0h, _mm_madd_epi16(p31h, c));
+
+  c = PAIR(9633, 16819 - 20995 - 3196 + 9633);
+  o1l = _mm_madd_epi16(p75l, c);
+  o1h = _mm_madd_epi16(p75h, c);
+  c = PAIR(- 20995 + 9633, - 3196 + 9633);
+  o1l = _mm_add_epi32(o1l, _mm_madd_epi16(p31l, c));
+  o1h = _mm_add_epi32(o1h, _mm_madd_epi16(p31h, c));
+
+  c = PAIR(- 16069 + 9633, - 20995 + 9633);
+  o2l = _mm_madd_epi16(p75l, c);
+  o2h = _mm_madd_epi16(p75h, c);
+  c = PAIR(25172 - 20995 - 16069 + 9633, 9633);
+  o2l = _mm_add_epi32(o2l, _mm_madd_epi16(p31l, c));
+  o2h = _mm_add_epi32(o2h, _mm_madd_epi16(p31h, c));
+
+  c = PAIR(- 7373 + 9633, - 3196 + 9633);
+  o3l = _mm_madd_epi16(p75l, c);
+  o3h = _mm_madd_epi16(p75h, c);
+  c = PAIR(9633, 12299 - 7373 - 3196 + 9633);
+  o3l = _mm_add_epi32(o3l, _mm_madd_epi16(p31l, c));
+  o3h = _mm_add_epi32(o3h, _mm_madd_epi16(p31h, c));
+
+  lo[0] = _mm_add_epi32(t10l, o3l);
+  hi[0] = _mm_add_epi32(t10h, o3h);
+  lo[7] = _mm_sub_epi32(t10l, o3l);
+  hi[7] = _mm_sub_epi32(t10h, o3h);
+  lo[1] = _mm_add_epi32(t11l, o2l);
+  hi[1] = _mm_add_epi32(t11h, o2h);
+  lo[6] = _mm_sub_epi32(t11l, o2l);
+  hi[6] = _mm_sub_epi32(t11h, o2h);
+  lo[2] = _mm_add_epi32(t12l, o1l);
+  hi[2] = _mm_add_epi32(t12h, o1h);
+  lo[5] = _mm_sub_epi32(t12l, o1l);
+  hi[5] = _mm_sub_epi32(t12h, o1h);
+  lo[3] = _mm_add_epi32(t13l, o0l);
+  hi[3] = _mm_add_epi32(t13h, o0h);
+  lo[4] = _mm_sub_epi32(t13l, o0l);
+  hi[4] = _mm_sub_epi32(t13h, o0h);
+}
+
+
+GLOBAL(boolean)
+jsimd_idct_islow_block (JCOEFPTR coef_block, const MULTIPLIER * quantptr,
+			JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+  __m128i x[DCTSIZE], lo[DCTSIZE], hi[DCTSIZE];
+  __m128i bad = _mm_setzero_si128();
+  __m128i big = _mm_setzero_si128();
+  __m128i round;
+  int i;
+
+  DEQUANTIZE_BLOCK(x, coef_block, quantptr, bad);
+  if (_mm_movemask_epi8(_mm_cmpeq_epi16(bad, _mm_setzero_si128())) != 0xFFFF)
+    return FALSE;
+
+  /* Pass 1: process columns, descale by CONST_BITS-PASS1_BITS = 11 */
+
+  islow_1d(x, lo, hi);
+  round = _mm_set1_epi32(1 << 10);
+  for (i = 0; i < DCTSIZE; i++) {
+    lo[i] = _mm_srai_epi32(_mm_add_epi32(lo[i], round), 11);
+    hi[i] = _mm_srai_epi32(_mm_add_epi32(hi[i], round), 11);
+    big = _mm_or_si128(big, _mm_xor_si128(lo[i], _mm_srai_epi32(lo[i], 31)));
+    big = _mm_or_si128(big, _mm_xor_si128(hi[i], _mm_srai_epi32(hi[i], 31)));
+    x[i] = _mm_packs_epi32(lo[i], hi[i]);
+  }
+  if (_mm_movemask_epi8(_mm_cmpgt_epi32(big, _mm_set1_epi32(32767))) != 0)
+    return FALSE;
+
+  /* Pass 2: process rows, descale by CONST_BITS+PASS1_BITS+3 = 18,
+   * adding CENTERJSAMPLE for the range limiting.
+   */
+
+  transpose_8x8(x);
+  islow_1d(x, lo, hi);
+  round = _mm_set1_epi32((1 << 17) + (CENTERJSAMPLE << 18));
+  for (i = 0; i < DCTSIZE; i++) {
+    lo[i] = _mm_srai_epi32(_mm_add_epi32(lo[i], round), 18);
+    hi[i] = _mm_srai_epi32(_mm_add_epi32(hi[i], round), 18);
+    x[i] = _mm_and_si128(_mm_packs_epi32(lo[i], hi[i]),
+			 _mm_set1_epi16(RANGE_MASK));
+  }
+
+  range_limit_store(x, output_buf, output_col);
+  return TRUE;
+}
+
+
+/*
+ * (v * c) >> 8 in each 16-bit lane, as MULTIPLY in jidctfst.c
+ * (truncated to 16 bits).
+ */
+
+#define MUL8(v,c)  \
+  _mm_or_si128(_mm_slli_epi16(_mm_mulhi_epi16(v, c), 8), \
+	       _mm_srli_epi16(_mm_mullo_epi16(v, c), 8))
+
+/*
+ * One 1-D pass of the AA&N IDCT (jidctfst.c), in place.
+ */
+
+LOCAL(void)
+ifast_1d (__m128i * x)
+{
+  __m128i tmp0, tmp1, tmp2, tmp3, tmp4, tmp5, tmp6, tmp7;
+  __m128i tmp10, tmp11, tmp12, tmp13;
+  __m128i z5, z10, z11, z12, z13;
+
+  /* Even part */
+
+  tmp10 = _mm_add_epi16(x[0], x[4]);
+  tmp11 = _mm_sub_epi16(x[0], x[4]);
+  tmp13 = _mm_add_epi16(x[2], x[6]);
+  tmp12 = _mm_sub_epi16(MUL8(_mm_sub_epi16(x[2], x[6]), _mm_set1_epi16(362)),
+			tmp13);
+
+  tmp0 = _mm_add_epi16(tmp10, tmp13);
+  tmp3 = _mm_sub_epi16(tmp10, tmp13);
+  tmp1 = _mm_add_epi16(tmp11, tmp12);
+  tmp2 = _mm_sub_epi16(tmp11, tmp12);
+
+  /* Odd part */
+
+  z13 = _mm_add_epi16(x[5], x[3]);
+  z10 = _mm_sub_epi16(x[5], x[3]);
+  z11 = _mm_add_epi16(x[1], x[7]);
+  z12 = _mm_sub_epi16(x[1], x[7]);
+
+  tmp7 = _mm_add_epi16(z11, z13);
+  tmp11 = MUL8(_mm_sub_epi16(z11, z13), _mm_set1_epi16(362));
+
+  z5 = MUL8(_mm_add_epi16(z10, z12), _mm_set1_epi16(473));
+  tmp10 = _mm_sub_epi16(MUL8(z12, _mm_set1_epi16(277)), z5);
+  tmp12 = _mm_add_epi16(MUL8(z10, _mm_set1_epi16(-669)), z5);
+
+  tmp6 = _mm_sub_epi16(tmp12, tmp7);
+  tmp5 = _mm_sub_epi16(tmp11, tmp6);
+  tmp4 = _mm_add_epi16(tmp10, tmp5);
+
+  x[0] = _mm_add_epi16(tmp0, tmp7);
+  x[7] = _mm_sub_epi16(tmp0, tmp7);
+  x[1] = _mm_add_epi16(tmp1, tmp6);
+  x[6] = _mm_sub_epi16(tmp1, tmp6);
+  x[2] = _mm_add_epi16(tmp2, tmp5);
+  x[5] = _mm_sub_epi16(tmp2, tmp5);
+  x[4] = _mm_add_epi16(tmp3, tmp4);
+  x[3] = _mm_sub_epi16(tmp3, tmp4);
+}
+
+
+GLOBAL(boolean)
+jsimd_idct_ifast_block (JCOEFPTR coef_block, const MULTIPLIER * quantptr,
+			JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+  __m128i x[DCTSIZE];
+  __m128i bad = _mm_setzero_si128();
+  __m128i sum, s3;
+  int i;
+
+  DEQUANTIZE_BLOCK(x, coef_block, quantptr, bad);
+  if (_mm_movemask_epi8(_mm_cmpeq_epi16(bad, _mm_setzero_si128())) != 0xFFFF)
+    return FALSE;
+
+  /* Pass 1 is exact in 16 bits if, in each column,
+   *   |x0| + 2|x1| + 2|x2| + 3|x3| + |x4| + 3|x5| + 3|x6| + 6|x7|
+   * is under 32767, less a margin for the truncations.
+   */
+  sum = _mm_adds_epu16(ABS_LESS(x[1]), ABS_LESS(x[2]));
+  sum = _mm_adds_epu16(sum, sum);
+  s3 = _mm_adds_epu16(_mm_adds_epu16(ABS_LESS(x[3]), ABS_LESS(x[5])),
+		      _mm_adds_epu16(ABS_LESS(x[6]), ABS_LESS(x[7])));
+  s3 = _mm_adds_epu16(ABS_LESS(x[7]), s3);
+  s3 = _mm_adds_epu16(_mm_adds_epu16(s3, s3), s3);
+  sum = _mm_adds_epu16(sum, s3);
+  sum = _mm_adds_epu16(sum, _mm_adds_epu16(ABS_LESS(x[0]), ABS_LESS(x[4])));
+  if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_subs_epu16(sum,
+		_mm_set1_epi16(32767 - 64)), _mm_setzero_si128())) != 0xFFFF)
+    return FALSE;
+
+  /* Pass 1: process columns */
+
+  ifast_1d(x);
+
+  /* Pass 2 is exact (in the bits that are kept) if the inputs of its
+   * multiplications fit in 16 bits: that holds if the odd inputs are
+   * within +-8K and inputs 2 and 6 are within +-16K.
+   */
+  transpose_8x8(x);
+  bad = _mm_or_si128(_mm_or_si128(ABS_LESS(x[1]), ABS_LESS(x[3])),
+		     _mm_or_si128(ABS_LESS(x[5]), ABS_LESS(x[7])));
+  bad = _mm_or_si128(_mm_andnot_si128(_mm_set1_epi16(8191), bad),
+		     _mm_andnot_si128(_mm_set1_epi16(16383),
+				      _mm_or_si128(ABS_LESS(x[2]),
+						   ABS_LESS(x[6]))));
+  if (_mm_movemask_epi8(_mm_cmpeq_epi16(bad, _mm_setzero_si128())) != 0xFFFF)
+    return FALSE;
+
+  /* Pass 2: process rows, descale by PASS1_BITS+3 = 5 */
+
+  ifast_1d(x);
+  for (i = 0; i < DCTSIZE; i++) {
+    x[i] = _mm_and_si128(_mm_add_epi16(_mm_srai_epi16(x[i], 5),
+				       _mm_set1_epi16(CENTERJSAMPLE)),
+			 _mm_set1_epi16(RANGE_MASK));
+  }
+
+  range_limit_store(x, output_buf, output_col);
+  return TRUE;
+}
+
+
+/*
+ * Color conversion.  Given 8 values of Cb and Cr less CENTERJSAMPLE,
+ * compute the red, green and blue offsets to add to Y.
+ */
+
+LOCAL(void)
+ycc_offsets (__m128i cb, __m128i cr, __m128i * red, __m128i * green,
+	     __m128i * blue)
+{
+  const __m128i one = _mm_set1_epi16(1);
+  __m128i cb2 = _mm_add_epi16(cb, cb);
+  __m128i cr2 = _mm_add_epi16(cr, cr);
+  __m128i gl, gh, c;
+
+  /* 1.40200 = 1 + 26345/65536 */
+  *red = _mm_add_epi16(cr, _mm_srai_epi16(_mm_add_epi16(
+	   _mm_mulhi_epi16(cr2, _mm_set1_epi16(26345)), one), 1));
+  /* 1.77200 = 2 - 14942/65536 */
+  *blue = _mm_add_epi16(cb2, _mm_srai_epi16(_mm_add_epi16(
+	    _mm_mulhi_epi16(cb2, _mm_set1_epi16(-14942)), one), 1));
+  /* -0.71414 = -1 + 18734/65536 */
+  c = PAIR(-22554, 18734);
+  gl = _mm_madd_epi16(_mm_unpacklo_epi16(cb, cr), c);
+  gh = _mm_madd_epi16(_mm_unpackhi_epi16(cb, cr), c);
+  gl = _mm_srai_epi32(_mm_add_epi32(gl, _mm_set1_epi32(32768)), 16);
+  gh = _mm_srai_epi32(_mm_add_epi32(gh, _mm_set1_epi32(32768)), 16);
+  *green = _mm_sub_epi16(_mm_packs_epi32(gl, gh), cr);
+}
+
+
+/*
+ * Store 16 RGB pixels, given as 16 samples of each component, in the
+ * layout described by rgb_offset[].
+ */
+
+LOCAL(void)
+store_rgbx16 (JSAMPROW outptr, __m128i red, __m128i green, __m128i blue,
+	      const int * rgb_offset)
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128i ch[3], lo, hi, shift, px[4];
+  int c, i;
+
+  ch[0] = red;
+  ch[1] = green;
+  ch[2] = blue;
+
+  /* Build each pixel as a 32-bit lane, shifting every sample into place */
+  shift = _mm_cvtsi32_si128(8 * rgb_offset[3]);
+  px[0] = px[1] = px[2] = px[3] =
+    _mm_sll_epi32(_mm_set1_epi32(MAXJSAMPLE), shift);
+  for (c = 0; c < 3; c++) {
+    shift = _mm_cvtsi32_si128(8 * rgb_offset[c]);
+    lo = _mm_unpacklo_epi8(ch[c], zero);
+    hi = _mm_unpackhi_epi8(ch[c], zero);
+    px[0] = _mm_or_si128(px[0],
+			 _mm_sll_epi32(_mm_unpacklo_epi16(lo, zero), shift));
+    px[1] = _mm_or_si128(px[1],
+			 _mm_sll_epi32(_mm_unpackhi_epi16(lo, zero), shift));
+    px[2] = _mm_or_si128(px[2],
+			 _mm_sll_epi32(_mm_unpacklo_epi16(hi, zero), shift));
+    px[3] = _mm_or_si128(px[3],
+			 _mm_sll_epi32(_mm_unpackhi_epi16(hi, zero), shift));
+  }
+
+  for (i = 0; i < 4; i++)
+    _mm_storeu_si128((__m128i *) (outptr + 16*i), px[i]);
+}
+
+
+/* 3-byte pixels are built in 32-bit lanes too, then squeezed together. */
+
+LOCAL(void)
+store_rgb16 (JSAMPROW outptr, __m128i red, __m128i green, __m128i blue,
+	     const int * rgb_offset)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i mask24 = _mm_set_epi32(0, 0xFFFFFF, 0, 0xFFFFFF);
+  __m128i ch[3], c01l, c01h, c2l, c2h, px[4], q;
+  int i;
+
+  if (rgb_offset[3] >= 0) {
+    store_rgbx16(outptr, red, green, blue, rgb_offset);
+    return;
+  }
+
+  ch[rgb_offset[0]] = red;
+  ch[rgb_offset[1]] = green;
+  ch[rgb_offset[2]] = blue;
+
+  /* Pixels as 32-bit lanes, fourth byte zero */
+  c01l = _mm_unpacklo_epi8(ch[0], ch[1]);
+  c01h = _mm_unpackhi_epi8(ch[0], ch[1]);
+  c2l = _mm_unpacklo_epi8(ch[2], zero);
+  c2h = _mm_unpackhi_epi8(ch[2], zero);
+  px[0] = _mm_unpacklo_epi16(c01l, c2l);
+  px[1] = _mm_unpackhi_epi16(c01l, c2l);
+  px[2] = _mm_unpacklo_epi16(c01h, c2h);
+  px[3] = _mm_unpackhi_epi16(c01h, c2h);
+
+  /* Squeeze each vector of 4 pixels into its low 12 bytes */
+  for (i = 0; i < 4; i++) {
+    q = _mm_or_si128(_mm_and_si128(px[i], mask24),
+		     _mm_andnot_si128(mask24, _mm_srli_epi64(px[i], 8)));
+    px[i] = _mm_or_si128(_mm_move_epi64(q),
+			 _mm_slli_si128(_mm_srli_si128(q, 8), 6));
+  }
+
+  _mm_storeu_si128((__m128i *) outptr,
+		   _mm_or_si128(px[0], _mm_slli_si128(px[1], 12)));
+  _mm_storeu_si128((__m128i *) (outptr + 16),
+		   _mm_or_si128(_mm_srli_si128(px[1], 4),
+				_mm_slli_si128(px[2], 8)));
+  _mm_storeu_si128((__m128i *) (outptr + 32),
+		   _mm_or_si128(_mm_srli_si128(px[2], 8),
+				_mm_slli_si128(px[3], 4)));
+}
+
+
+GLOBAL(void)
+jsimd_ycc_rgb_row (JSAMPROW inptr0, JSAMPROW inptr1, JSAMPROW inptr2,
+		   JSAMPROW outptr, JDIMENSION num_cols,
+		   const int * rgb_offset)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i center = _mm_set1_epi16(CENTERJSAMPLE);
+  __m128i y, cb, cr, rl, gl, bl, rh, gh, bh, yl, yh;
+  JDIMENSION col;
+  int pixelsize = (rgb_offset[3] < 0) ? 3 : 4;
+
+  for (col = 0; col < num_cols; col += 16) {
+    y = _mm_loadu_si128((const __m128i *) (inptr0 + col));
+    cb = _mm_loadu_si128((const __m128i *) (inptr1 + col));
+    cr = _mm_loadu_si128((const __m128i *) (inptr2 + col));
+    ycc_offsets(_mm_sub_epi16(_mm_unpacklo_epi8(cb, zero), center),
+		_mm_sub_epi16(_mm_unpacklo_epi8(cr, zero), center),
+		&rl, &gl, &bl);
+    ycc_offsets(_mm_sub_epi16(_mm_unpackhi_epi8(cb, zero), center),
+		_mm_sub_epi16(_mm_unpackhi_epi8(cr, zero), center),
+		&rh, &gh, &bh);
+    yl = _mm_unpacklo_epi8(y, zero);
+    yh = _mm_unpackhi_epi8(y, zero);
+    store_rgb16(outptr + col * pixelsize,
+		_mm_packus_epi16(_mm_add_epi16(yl, rl), _mm_add_epi16(yh, rh)),
+		_mm_packus_epi16(_mm_add_epi16(yl, gl), _mm_add_epi16(yh, gh)),
+		_mm_packus_epi16(_mm_add_epi16(yl, bl), _mm_add_epi16(yh, bh)),
+		rgb_offset);
+  }
+}
+
+
+/*
+ * Merged upsampling: 8 chroma samples give the offsets for 16 pixels
+ * of one or two rows.
+ */
+
+LOCAL(void)
+merged_store (JSAMPROW inptr, JSAMPROW outptr, __m128i * off,
+	      const int * rgb_offset)
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128i y = _mm_loadu_si128((const __m128i *) inptr);
+  __m128i yl = _mm_unpacklo_epi8(y, zero);
+  __m128i yh = _mm_unpackhi_epi8(y, zero);
+
+  store_rgb16(outptr,
+	      _mm_packus_epi16(_mm_add_epi16(yl, off[0]),
+			       _mm_add_epi16(yh, off[1])),
+	      _mm_packus_epi16(_mm_add_epi16(yl, off[2]),
+			       _mm_add_epi16(yh, off[3])),
+	      _mm_packus_epi16(_mm_add_epi16(yl, off[4]),
+			       _mm_add_epi16(yh, off[5])),
+	      rgb_offset);
+}
+
+
+GLOBAL(void)
+jsimd_merged_row (JSAMPROW inptr00, JSAMPROW inptr01, JSAMPROW inptr1,
+		  JSAMPROW inptr2, JSAMPROW outptr0, JSAMPROW outptr1,
+		  JDIMENSION num_cols, const int * rgb_offset)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i center = _mm_set1_epi16(CENTERJSAMPLE);
+  __m128i cb, cr, red, green, blue, off[6];
+  JDIMENSION col;
+  int pixelsize = (rgb_offset[3] < 0) ? 3 : 4;
+
+  for (col = 0; col < num_cols; col += 16) {
+    cb = _mm_loadl_epi64((const __m128i *) (inptr1 + (col >> 1)));
+    cr = _mm_loadl_epi64((const __m128i *) (inptr2 + (col >> 1)));
+    ycc_offsets(_mm_sub_epi16(_mm_unpacklo_epi8(cb, zero), center),
+		_mm_sub_epi16(_mm_unpacklo_epi8(cr, zero), center),
+		&red, &green, &blue);
+    off[0] = _mm_unpacklo_epi16(red, red);
+    off[1] = _mm_unpackhi_epi16(red, red);
+    off[2] = _mm_unpacklo_epi16(green, green);
+    off[3] = _mm_unpackhi_epi16(green, green);
+    off[4] = _mm_unpacklo_epi16(blue, blue);
+    off[5] = _mm_unpackhi_epi16(blue, blue);
+    merged_store(inptr00 + col, outptr0 + col * pixelsize, off, rgb_offset);
+    if (inptr01 != NULL)
+      merged_store(inptr01 + col, outptr1 + col * pixelsize, off,
+		   rgb_offset);
+  }
+}
+
+
+/*
+ * Fancy upsampling, 2h2v: input columns 1..num_cols.
+ */
+
+#define COLSUM(in0,in1,col)  \
+  _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8( \
+		  _mm_loadl_epi64((const __m128i *) ((in0) + (col))), zero), \
+		  three), \
+		_mm_unpacklo_epi8( \
+		  _mm_loadl_epi64((const __m128i *) ((in1) + (col))), zero))
+
+GLOBAL(void)
+jsimd_h2v2_fancy_row (JSAMPROW inptr0, JSAMPROW inptr1, JSAMPROW outptr,
+		      JDIMENSION num_cols)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i three = _mm_set1_epi16(3);
+  __m128i lastcolsum, thiscolsum, nextcolsum, even, odd;
+  JDIMENSION col;
+
+  for (col = 1; col < num_cols + 1; col += 8) {
+    lastcolsum = COLSUM(inptr0, inptr1, col - 1);
+    thiscolsum = _mm_mullo_epi16(COLSUM(inptr0, inptr1, col), three);
+    nextcolsum = COLSUM(inptr0, inptr1, col + 1);
+    even = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(thiscolsum, lastcolsum),
+					_mm_set1_epi16(8)), 4);
+    odd = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(thiscolsum, nextcolsum),
+				       _mm_set1_epi16(7)), 4);
+    _mm_storeu_si128((__m128i *) (outptr + 2*col),
+		     _mm_packus_epi16(_mm_unpacklo_epi16(even, odd),
+				      _mm_unpackhi_epi16(even, odd)));
+  }
+}
+
+
+
+/*
+ * RGB->YCbCr conversion.  Given 8 values of each of R, G and B as 16-bit
+ * lanes, compute 8 values of Y and, if wanted, of Cb and Cr.
+ */
+
+LOCAL(void)
+rgb_ycc_8 (__m128i r, __m128i g, __m128i b,
+	   __m128i * y, __m128i * cb, __m128i * cr)
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128i rgl = _mm_unpacklo_epi16(r, g);
+  __m128i rgh = _mm_unpackhi_epi16(r, g);
+  __m128i bgl = _mm_unpacklo_epi16(b, g);
+  __m128i bgh = _mm_unpackhi_epi16(b, g);
+  __m128i lo, hi, c;
+
+  /* Y: 0.58700 = (22086 + 16384) / 65536, the rounding term is 32768 */
+  c = _mm_set1_epi32(32768);
+  lo = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(rgl, PAIR(19595, 22086)),
+				   _mm_madd_epi16(bgl, PAIR(7471, 16384))), c);
+  hi = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(rgh, PAIR(19595, 22086)),
+				   _mm_madd_epi16(bgh, PAIR(7471, 16384))), c);
+  *y = _mm_packs_epi32(_mm_srli_epi32(lo, 16), _mm_srli_epi32(hi, 16));
+  if (cb == NULL)
+    return;
+
+  /* Cb and Cr: 0.5 * x is x << 15, and the offset is 128.5 - epsilon */
+  c = _mm_set1_epi32((CENTERJSAMPLE << 16) + 32767);
+  lo = _mm_add_epi32(_mm_madd_epi16(rgl, PAIR(-11059, -21709)),
+		     _mm_slli_epi32(_mm_unpacklo_epi16(b, zero), 15));
+  hi = _mm_add_epi32(_mm_madd_epi16(rgh, PAIR(-11059, -21709)),
+		     _mm_slli_epi32(_mm_unpackhi_epi16(b, zero), 15));
+  *cb = _mm_packs_epi32(_mm_srli_epi32(_mm_add_epi32(lo, c), 16),
+			_mm_srli_epi32(_mm_add_epi32(hi, c), 16));
+  lo = _mm_add_epi32(_mm_madd_epi16(bgl, PAIR(-5329, -27439)),
+		     _mm_slli_epi32(_mm_unpacklo_epi16(r, zero), 15));
+  hi = _mm_add_epi32(_mm_madd_epi16(bgh, PAIR(-5329, -27439)),
+		     _mm_slli_epi32(_mm_unpackhi_epi16(r, zero), 15));
+  *cr = _mm_packs_epi32(_mm_srli_epi32(_mm_add_epi32(lo, c), 16),
+			_mm_srli_epi32(_mm_add_epi32(hi, c), 16));
+}
+
+
+/*
+ * Spread 4 pixels of 3 bytes, in the low 12 bytes of v, into 32-bit lanes
+ * (the fourth byte of each lane is garbage).
+ */
+
+#define SPREAD_RGB4(v)  \
+  _mm_unpacklo_epi64(_mm_unpacklo_epi32(v, _mm_srli_si128(v, 3)), \
+		     _mm_unpacklo_epi32(_mm_srli_si128(v, 6), \
+					_mm_srli_si128(v, 9)))
+
+/* Byte c of each lane of two vectors of 4 pixels, as 8 16-bit lanes */
+#define CHANNEL8(p0,p1,c)  \
+  _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8*(c)), mask), \
+		  _mm_and_si128(_mm_srli_epi32(p1, 8*(c)), mask))
+
+GLOBAL(void)
+jsimd_rgb_ycc_row (JSAMPROW inptr, JSAMPROW outptr0, JSAMPROW outptr1,
+		   JSAMPROW outptr2, JDIMENSION num_cols,
+		   const int * rgb_offset)
+{
+  const __m128i mask = _mm_set1_epi32(0xFF);
+  __m128i a, b, c, px[4], ch[3][2], y[2], cb[2], cr[2];
+  JDIMENSION col;
+  int h;
+
+  for (col = 0; col < num_cols; col += 16) {
+    a = _mm_loadu_si128((const __m128i *) inptr);
+    b = _mm_loadu_si128((const __m128i *) (inptr + 16));
+    c = _mm_loadu_si128((const __m128i *) (inptr + 32));
+    inptr += 48;
+    px[0] = SPREAD_RGB4(a);
+    a = _mm_or_si128(_mm_srli_si128(a, 12), _mm_slli_si128(b, 4));
+    px[1] = SPREAD_RGB4(a);
+    a = _mm_or_si128(_mm_srli_si128(b, 8), _mm_slli_si128(c, 8));
+    px[2] = SPREAD_RGB4(a);
+    a = _mm_srli_si128(c, 4);
+    px[3] = SPREAD_RGB4(a);
+
+    for (h = 0; h < 2; h++) {
+      ch[0][h] = CHANNEL8(px[2*h], px[2*h+1], 0);
+      ch[1][h] = CHANNEL8(px[2*h], px[2*h+1], 1);
+      ch[2][h] = CHANNEL8(px[2*h], px[2*h+1], 2);
+    }
+    for (h = 0; h < 2; h++) {
+      rgb_ycc_8(ch[rgb_offset[0]][h], ch[rgb_offset[1]][h],
+		ch[rgb_offset[2]][h], &y[h],
+		outptr1 != NULL ? &cb[h] : (__m128i *) NULL, &cr[h]);
+    }
+    _mm_storeu_si128((__m128i *) (outptr0 + col),
+		     _mm_packus_epi16(y[0], y[1]));
+    if (outptr1 != NULL) {
+      _mm_storeu_si128((__m128i *) (outptr1 + col),
+		       _mm_packus_epi16(cb[0], cb[1]));
+      _mm_storeu_si128((__m128i *) (outptr2 + col),
+		       _mm_packus_epi16(cr[0], cr[1]));
+    }
+  }
+}
+
+
+/*
+ * Load an 8x8 block of samples as 8 rows of 16-bit values, less
+ * CENTERJSAMPLE.
+ */
+
+LOCAL(void)
+load_samples (JSAMPARRAY sample_data, JDIMENSION start_col, __m128i * x)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i center = _mm_set1_epi16(CENTERJSAMPLE);
+  int i;
+
+  for (i = 0; i < DCTSIZE; i++) {
+    x[i] = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(
+	     (const __m128i *) (sample_data[i] + start_col)), zero), center);
+  }
+}
+
+
+/*
+ * Quantize the 8 rows of a block, and store the coefficients.
+ * For each coefficient, with a = |x| + d/2, this computes
+ *   t = mulhi(a, m)  (or a, if m = 0)
+ *   q = mulhi(t, s)  (or t, if s = 0)
+ * and gives q the sign of x; see jsimd_fdct_divisors.
+ */
+
+LOCAL(void)
+quantize_store (__m128i * x, const UINT16 * divisors, JCOEFPTR coef_block)
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128i sign, a, m, t;
+  int i;
+
+  for (i = 0; i < DCTSIZE; i++) {
+    sign = _mm_srai_epi16(x[i], 15);
+    a = _mm_sub_epi16(_mm_xor_si128(x[i], sign), sign);
+    a = _mm_add_epi16(a, _mm_loadu_si128((const __m128i *)
+					 (divisors + DCTSIZE2 + DCTSIZE*i)));
+    m = _mm_loadu_si128((const __m128i *) (divisors + DCTSIZE*i));
+    t = _mm_add_epi16(_mm_mulhi_epu16(a, m),
+		      _mm_and_si128(a, _mm_cmpeq_epi16(m, zero)));
+    m = _mm_loadu_si128((const __m128i *) (divisors + 2*DCTSIZE2 + DCTSIZE*i));
+    t = _mm_add_epi16(_mm_mulhi_epu16(t, m),
+		      _mm_and_si128(t, _mm_cmpeq_epi16(m, zero)));
+    _mm_storeu_si128((__m128i *) (coef_block + DCTSIZE*i),
+		     _mm_sub_epi16(_mm_xor_si128(t, sign), sign));
+  }
+}
+
+
+/* Descale the 32-bit halves lo and hi as given by round and shift, and
+ * pack them.
+ */
+#define DESCALE_PACK(lo,hi)  \
+  _mm_packs_epi32(_mm_sra_epi32(_mm_add_epi32(lo, round), shift), \
+		  _mm_sra_epi32(_mm_add_epi32(hi, round), shift))
+
+/*
+ * One 1-D pass of the LL&M FDCT (jfdctint.c) on 8 vectors of 16-bit
+ * inputs, in place.  Pass 1 scales its outputs up by 2^PASS1_BITS = 4,
+ * pass 2 removes that scaling.
+ */
+
+LOCAL(void)
+fdct_islow_1d (__m128i * x, boolean pass1)
+{
+  __m128i tmp0, tmp1, tmp2, tmp3, tmp4, tmp5, tmp6, tmp7;
+  __m128i tmp10, tmp11, tmp12, tmp13;
+  __m128i pl, ph, ql, qh, round, shift;
+
+  tmp0 = _mm_add_epi16(x[0], x[7]);
+  tmp7 = _mm_sub_epi16(x[0], x[7]);
+  tmp1 = _mm_add_epi16(x[1], x[6]);
+  tmp6 = _mm_sub_epi16(x[1], x[6]);
+  tmp2 = _mm_add_epi16(x[2], x[5]);
+  tmp5 = _mm_sub_epi16(x[2], x[5]);
+  tmp3 = _mm_add_epi16(x[3], x[4]);
+  tmp4 = _mm_sub_epi16(x[3], x[4]);
+
+  /* Even part */
+
+  tmp10 = _mm_add_epi16(tmp0, tmp3);
+  tmp13 = _mm_sub_epi16(tmp0, tmp3);
+  tmp11 = _mm_add_epi16(tmp1, tmp2);
+  tmp12 = _mm_sub_epi16(tmp1, tmp2);
+
+  if (pass1) {
+    x[0] = _mm_slli_epi16(_mm_add_epi16(tmp10, tmp11), 2);
+    x[4] = _mm_slli_epi16(_mm_sub_epi16(tmp10, tmp11), 2);
+  } else {
+    /* tmp10 + tmp11 may not fit in 16 bits here */
+    round = _mm_set1_epi32(1 << 1);
+    shift = _mm_cvtsi32_si128(2);
+    pl = _mm_unpacklo_epi16(tmp10, tmp11);
+    ph = _mm_unpackhi_epi16(tmp10, tmp11);
+    x[0] = DESCALE_PACK(_mm_madd_epi16(pl, PAIR(1, 1)),
+			_mm_madd_epi16(ph, PAIR(1, 1)));
+    x[4] = DESCALE_PACK(_mm_madd_epi16(pl, PAIR(1, -1)),
+			_mm_madd_epi16(ph, PAIR(1, -1)));
+  }
+
+  /* The rest is descaled by CONST_BITS-PASS1_BITS or CONST_BITS+PASS1_BITS */
+
+  round = _mm_set1_epi32(pass1 ? 1 << 10 : 1 << 14);
+  shift = _mm_cvtsi32_si128(pass1 ? 11 : 15);
+
+  pl = _mm_unpacklo_epi16(tmp12, tmp13);
+  ph = _mm_unpackhi_epi16(tmp12, tmp13);
+  x[2] = DESCALE_PACK(_mm_madd_epi16(pl, PAIR(4433, 4433 + 6270)),
+		      _mm_madd_epi16(ph, PAIR(4433, 4433 + 6270)));
+  x[6] = DESCALE_PACK(_mm_madd_epi16(pl, PAIR(4433 - 15137, 4433)),
+		      _mm_madd_epi16(ph, PAIR(4433 - 15137, 4433)));
+
+  /* Odd part: the constants of jfdctint.c, collected per input */
+
+  pl = _mm_unpacklo_epi16(tmp4, tmp5);
+  ph = _mm_unpackhi_epi16(tmp4, tmp5);
+  ql = _mm_unpacklo_epi16(tmp6, tmp7);
+  qh = _mm_unpackhi_epi16(tmp6, tmp7);
+
+#define ODD_OUTPUT(c4,c5,c6,c7)  \
+  DESCALE_PACK(_mm_add_epi32(_mm_madd_epi16(pl, PAIR(c4, c5)), \
+			     _mm_madd_epi16(ql, PAIR(c6, c7))), \
+	       _mm_add_epi32(_mm_madd_epi16(ph, PAIR(c4, c5)), \
+			     _mm_madd_epi16(qh, PAIR(c6, c7))))
+
+  x[7] = ODD_OUTPUT(2446 - 7373 - 16069 + 9633, 9633,
+		    - 16069 + 9633, - 7373 + 9633);
+  x[5] = ODD_OUTPUT(9633, 16819 - 20995 - 3196 + 9633,
+		    - 20995 + 9633, - 3196 + 9633);
+  x[3] = ODD_OUTPUT(- 16069 + 9633, - 20995 + 9633,
+		    25172 - 20995 - 16069 + 9633, 9633);
+  x[1] = ODD_OUTPUT(- 7373 + 9633, - 3196 + 9633,
+		    9633, 12299 - 7373 - 3196 + 9633);
+}
+
+
+GLOBAL(void)
+jsimd_fdct_islow_block (JSAMPARRAY sample_data, JDIMENSION start_col,
+			const UINT16 * divisors, JCOEFPTR coef_block)
+{
+  __m128i x[DCTSIZE];
+
+  load_samples(sample_data, start_col, x);
+
+  /* Pass 1: process rows, which the transpose makes the vector index */
+  transpose_8x8(x);
+  fdct_islow_1d(x, TRUE);
+
+  /* Pass 2: process columns */
+  transpose_8x8(x);
+  fdct_islow_1d(x, FALSE);
+
+  quantize_store(x, divisors, coef_block);
+}
+
+
+/*
+ * One 1-D pass of the AA&N FDCT (jfdctfst.c), in place.
+ */
+
+LOCAL(void)
+fdct_ifast_1d (__m128i * x)
+{
+  __m128i tmp0, tmp1, tmp2, tmp3, tmp4, tmp5, tmp6, tmp7;
+  __m128i tmp10, tmp11, tmp12, tmp13;
+  __m128i z1, z2, z3, z4, z5, z11, z13;
+
+  tmp0 = _mm_add_epi16(x[0], x[7]);
+  tmp7 = _mm_sub_epi16(x[0], x[7]);
+  tmp1 = _mm_add_epi16(x[1], x[6]);
+  tmp6 = _mm_sub_epi16(x[1], x[6]);
+  tmp2 = _mm_add_epi16(x[2], x[5]);
+  tmp5 = _mm_sub_epi16(x[2], x[5]);
+  tmp3 = _mm_add_epi16(x[3], x[4]);
+  tmp4 = _mm_sub_epi16(x[3], x[4]);
+
+  /* Even part */
+
+  tmp10 = _mm_add_epi16(tmp0, tmp3);
+  tmp13 = _mm_sub_epi16(tmp0, tmp3);
+  tmp11 = _mm_add_epi16(tmp1, tmp2);
+  tmp12 = _mm_sub_epi16(tmp1, tmp2);
+
+  x[0] = _mm_add_epi16(tmp10, tmp11);
+  x[4] = _mm_sub_epi16(tmp10, tmp11);
+
+  z1 = MUL8(_mm_add_epi16(tmp12, tmp13), _mm_set1_epi16(181));
+  x[2] = _mm_add_epi16(tmp13, z1);
+  x[6] = _mm_sub_epi16(tmp13, z1);
+
+  /* Odd part */
+
+  tmp10 = _mm_add_epi16(tmp4, tmp5);
+  tmp11 = _mm_add_epi16(tmp5, tmp6);
+  tmp12 = _mm_add_epi16(tmp6, tmp7);
+
+  z5 = MUL8(_mm_sub_epi16(tmp10, tmp12), _mm_set1_epi16(98));
+  z2 = _mm_add_epi16(MUL8(tmp10, _mm_set1_epi16(139)), z5);
+  z4 = _mm_add_epi16(MUL8(tmp12, _mm_set1_epi16(334)), z5);
+  z3 = MUL8(tmp11, _mm_set1_epi16(181));
+
+  z11 = _mm_add_epi16(tmp7, z3);
+  z13 = _mm_sub_epi16(tmp7, z3);
+
+  x[5] = _mm_add_epi16(z13, z2);
+  x[3] = _mm_sub_epi16(z13, z2);
+  x[1] = _mm_add_epi16(z11, z4);
+  x[7] = _mm_sub_epi16(z11, z4);
+}
+
+
+GLOBAL(void)
+jsimd_fdct_ifast_block (JSAMPARRAY sample_data, JDIMENSION start_col,
+			const UINT16 * divisors, JCOEFPTR coef_block)
+{
+  __m128i x[DCTSIZE];
+
+  load_samples(sample_data, start_col, x);
+  transpose_8x8(x);
+  fdct_ifast_1d(x);
+  transpose_8x8(x);
+  fdct_ifast_1d(x);
+  quantize_store(x, divisors, coef_block);
+}
+#endif /* JSIMD_SSE2 */
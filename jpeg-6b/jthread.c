@@ -0,0 +1,192 @@
+/*
+ * jthread.c
+ *
+ * Copyright (C) 1994-1996, Thomas G. Lane.
+ * This file is part of the Independent JPEG Group's software.
+ * For conditions of distribution and use, see the accompanying README file.
+ *
+ * This file contains the thread primitives declared in jthread.h:
+ * Win32 threads (Vista and later, including Windows Phone 8), otherwise
+ * POSIX threads.  It deliberately includes none of the JPEG library's
+ * headers other than jconfig.h; see jthread.h.
+ */
+
+#include "jconfig.h"
+#include "jthread.h"
+
+#include <stdlib.h>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+
+struct jthread_struct {
+  void (*func) (void * arg);	/* what the thread is to run */
+  void * arg;
+#ifdef _WIN32
+  HANDLE handle;
+#else
+  pthread_t handle;
+#endif
+};
+
+struct jmutex_struct {
+#ifdef _WIN32
+  CRITICAL_SECTION cs;
+#else
+  pthread_mutex_t mutex;
+#endif
+};
+
+
+/*
+ * Number of processors, for "one thread per processor" requests.
+ */
+
+int
+jthread_cpus (void)
+{
+#ifdef _WIN32
+  SYSTEM_INFO info;
+
+  GetNativeSystemInfo(&info);
+  return (int) info.dwNumberOfProcessors;
+#else
+#ifdef _SC_NPROCESSORS_ONLN
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+  return (n > 0 && n < 256) ? (int) n : 1;
+#else
+  return 1;
+#endif
+#endif
+}
+
+
+/*
+ * Thread start and join.
+ */
+
+#ifdef _WIN32
+static DWORD WINAPI
+thread_main (LPVOID param)
+{
+  jthread_ptr thread = (jthread_ptr) param;
+
+  (*thread->func) (thread->arg);
+  return 0;
+}
+#else
+static void *
+thread_main (void * param)
+{
+  jthread_ptr thread = (jthread_ptr) param;
+
+  (*thread->func) (thread->arg);
+  return NULL;
+}
+#endif
+
+
+jthread_ptr
+jthread_start (void (*func) (void * arg), void * arg)
+{
+  jthread_ptr thread;
+
+  thread = (jthread_ptr) malloc(sizeof(struct jthread_struct));
+  if (thread == NULL)
+    return NULL;
+  thread->func = func;
+  thread->arg = arg;
+#ifdef _WIN32
+  thread->handle = CreateThread(NULL, 0, thread_main, thread, 0, NULL);
+  if (thread->handle == NULL) {
+    free(thread);
+    return NULL;
+  }
+#else
+  if (pthread_create(&thread->handle, NULL, thread_main, thread) != 0) {
+    free(thread);
+    return NULL;
+  }
+#endif
+  return thread;
+}
+
+
+void
+jthread_join (jthread_ptr thread)
+{
+#ifdef _WIN32
+  WaitForSingleObjectEx(thread->handle, INFINITE, FALSE);
+  CloseHandle(thread->handle);
+#else
+  pthread_join(thread->handle, NULL);
+#endif
+  free(thread);
+}
+
+
+/*
+ * Mutexes.
+ */
+
+jmutex_ptr
+jmutex_create (void)
+{
+  jmutex_ptr mutex;
+
+  mutex = (jmutex_ptr) malloc(sizeof(struct jmutex_struct));
+  if (mutex == NULL)
+    return NULL;
+#ifdef _WIN32
+  InitializeCriticalSectionEx(&mutex->cs, 2000, 0);
+#else
+  if (pthread_mutex_init(&mutex->mutex, NULL) != 0) {
+    free(mutex);
+    return NULL;
+  }
+#endif
+  return mutex;
+}
+
+
+void
+jmutex_lock (jmutex_ptr mutex)
+{
+#ifdef _WIN32
+  EnterCriticalSection(&mutex->cs);
+#else
+  pthread_mutex_lock(&mutex->mutex);
+#endif
+}
+
+
+void
+jmutex_unlock (jmutex_ptr mutex)
+{
+#ifdef _WIN32
+  LeaveCriticalSection(&mutex->cs);
+#else
+  pthread_mutex_unlock(&mutex->mutex);
+#endif
+}
+
+
+void
+jmutex_destroy (jmutex_ptr mutex)
+{
+#ifdef _WIN32
+  DeleteCriticalSection(&mutex->cs);
+#else
+  pthread_mutex_destroy(&mutex->mutex);
+#endif
+  free(mutex);
+}
@@ -0,0 +1,43 @@
+/*
+ * jthread.h
+ *
+ * Copyright (C) 1994-1996, Thomas G. Lane.
+ * This file is part of the Independent JPEG Group's software.
+ * For conditions of distribution and use, see the accompanying README file.
+ *
+ * This file declares the thread primitives used by the modules that start
+ * worker threads (jcparal.c, jdparal.c).  They are implemented in jthread.c, which is
+ * compiled apart from the rest of the library because the system thread
+ * headers (<windows.h> in particular) clash with the typedefs of jmorecfg.h.
+ * The handles are opaque; jthread_start and jmutex_create return NULL on
+ * failure.
+ */
+
+/* Short forms of external names for systems with brain-damaged linkers. */
+
+#ifdef NEED_SHORT_EXTERNAL_NAMES
+#define jthread_cpus		jTCPUs
+#define jthread_start		jTStart
+#define jthread_join		jTJoin
+#define jmutex_create		jTMCreate
+#define jmutex_lock		jTMLock
+#define jmutex_unlock		jTMUnlock
+#define jmutex_destroy		jTMDestroy
+#endif /* NEED_SHORT_EXTERNAL_NAMES */
+
+typedef struct jthread_struct * jthread_ptr;
+typedef struct jmutex_struct * jmutex_ptr;
+
+#define JMAX_THREADS  64	/* limit on # of threads we will start */
+
+/* Number of processors, for "one thread per processor" requests */
+extern int jthread_cpus (void);
+/* Start a thread running func(arg); NULL if it couldn't be started */
+extern jthread_ptr jthread_start (void (*func) (void * arg), void * arg);
+/* Wait for a thread to finish, and release it */
+extern void jthread_join (jthread_ptr thread);
+
+extern jmutex_ptr jmutex_create (void);
+extern void jmutex_lock (jmutex_ptr mutex);
+extern void jmutex_unlock (jmutex_ptr mutex);
+extern void jmutex_destroy (jmutex_ptr mutex);
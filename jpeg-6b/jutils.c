@@ -177,3 +177,38 @@ jzero_far (void FAR * target, size_t bytestozero)
   }
 #endif
 }
+
+
+GLOBAL(int)
+jrgb_pixel_layout (J_COLOR_SPACE space, int * offsets)
+/* Describe the pixels of an RGB output colorspace: offsets[0..2] receive
+ * the offsets of red, green and blue, offsets[3] that of the X/alpha byte
+ * (-1 if none).  Returns the pixel size, or 0 if space is not RGB.
+ */
+{
+  int r, g, b, x, size;
+
+  switch (space) {
+  case JCS_RGB:
+    r = RGB_RED; g = RGB_GREEN; b = RGB_BLUE; x = -1; size = RGB_PIXELSIZE;
+    break;
+  case JCS_EXT_RGBX:
+  case JCS_EXT_RGBA:
+    r = 0; g = 1; b = 2; x = 3; size = 4;
+    break;
+  case JCS_EXT_BGRX:
+  case JCS_EXT_BGRA:
+    r = 2; g = 1; b = 0; x = 3; size = 4;
+    break;
+  case JCS_EXT_XRGB:
+    r = 1; g = 2; b = 3; x = 0; size = 4;
+    break;
+  default:
+    return 0;
+  }
+  offsets[0] = r;
+  offsets[1] = g;
+  offsets[2] = b;
+  offsets[3] = x;
+  return size;
+}
@@ -198,6 +198,17 @@ typedef size_t (*curl_write_callback)(char *buffer,
                                       size_t nitems,
                                       void *outstream);
 
+/* This is the CURLOPT_RECVBUFFERFUNCTION callback proto. It is called before
+   libcurl receives more of a response body, and returns a buffer of the
+   application's to receive it into with the size of it stored in *size, or
+   NULL to have libcurl use its own buffer this time. The body data is then
+   passed to the write callback in place in that buffer, with any chunked
+   transfer-encoding framing already removed, and libcurl does not use the
+   buffer again after the write callback returns. A buffer may also go
+   unused, when there turned out to be nothing to read. */
+typedef char *(*curl_recvbuffer_callback)(size_t *size,
+                                          void *userdata);
+
 
 
 /* enumeration of file types */
@@ -1551,6 +1562,11 @@ typedef enum {
    * prototype defines. (Deprecates CURLOPT_PROGRESSFUNCTION) */
   CINIT(XFERINFOFUNCTION, FUNCTIONPOINT, 219),
 
+  /* Function that provides the buffers to receive response bodies into,
+     see curl_recvbuffer_callback, and the pointer passed to it */
+  CINIT(RECVBUFFERFUNCTION, FUNCTIONPOINT, 220),
+  CINIT(RECVBUFFERDATA, OBJECTPOINT, 221),
+
   CURLOPT_LASTENTRY /* the last unused */
 } CURLoption;
 
@@ -2012,9 +2028,19 @@ typedef enum {
   CURLINFO_PRIMARY_PORT     = CURLINFO_LONG   + 40,
   CURLINFO_LOCAL_IP         = CURLINFO_STRING + 41,
   CURLINFO_LOCAL_PORT       = CURLINFO_LONG   + 42,
+  CURLINFO_DNS_CACHE_HITS   = CURLINFO_LONG   + 43,
+  CURLINFO_DNS_CACHE_MISSES = CURLINFO_LONG   + 44,
+  CURLINFO_CONN_CACHE_REUSED = CURLINFO_LONG  + 45,
+  CURLINFO_CONN_CACHE_CONNECTS = CURLINFO_LONG + 46,
+  CURLINFO_CONN_CACHE_DEAD  = CURLINFO_LONG   + 47,
+  CURLINFO_PIPELINE_DEPTH   = CURLINFO_LONG   + 48,
+  CURLINFO_PIPELINE_WAIT    = CURLINFO_DOUBLE + 49,
+  CURLINFO_PIPELINE_REQUESTS = CURLINFO_LONG  + 50,
+  CURLINFO_PIPELINE_RTT     = CURLINFO_DOUBLE + 51,
+  CURLINFO_PIPELINE_SPEED   = CURLINFO_DOUBLE + 52,
   /* Fill in new entries below here! */
 
-  CURLINFO_LASTONE          = 42
+  CURLINFO_LASTONE          = 52
 } CURLINFO;
 
 /* CURLINFO_RESPONSE_CODE is the new name for the option previously known as
@@ -287,6 +287,24 @@ CURL_EXTERN CURLMcode curl_multi_socket_action(CURLM *multi_handle,
 CURL_EXTERN CURLMcode curl_multi_socket_all(CURLM *multi_handle,
                                             int *running_handles);
 
+/*
+ * Name:    curl_multi_perform_events()
+ *
+ * Desc:    Runs one lap of a built-in event loop for the multi_socket API.
+ *          libcurl keeps a persistent epoll or kqueue set (or a poll()
+ *          array where there is neither) of the sockets its transfers wait
+ *          on, waits at most timeout_ms milliseconds (-1 for no limit, but
+ *          never past libcurl's own next timeout) and then acts on the
+ *          sockets that got ready and the timeouts that expired. Call it in
+ *          a loop for as long as running_handles is non-zero. The first call
+ *          sets things up and drives all transfers once without waiting.
+ *
+ * Returns: CURLMcode type, general multi error code.
+ */
+CURL_EXTERN CURLMcode curl_multi_perform_events(CURLM *multi_handle,
+                                                int timeout_ms,
+                                                int *running_handles);
+
 #ifndef CURL_ALLOW_OLD_MULTI_SOCKET
 /* This macro below was added in 7.16.3 to push users who recompile to use
    the new curl_multi_socket_action() instead of the old curl_multi_socket()
@@ -363,6 +381,12 @@ typedef enum {
   /* maximum number of open connections in total */
   CINIT(MAX_TOTAL_CONNECTIONS, LONG, 13),
 
+  /* maximum number of idle connections kept per host */
+  CINIT(MAX_HOST_IDLE, LONG, 14),
+
+  /* milliseconds after which an idle connection is closed */
+  CINIT(IDLE_TIMEOUT, LONG, 15),
+
   CURLMOPT_LASTENTRY /* the last unused */
 } CURLMoption;
 
@@ -390,6 +414,94 @@ CURL_EXTERN CURLMcode curl_multi_setopt(CURLM *multi_handle,
 CURL_EXTERN CURLMcode curl_multi_assign(CURLM *multi_handle,
                                         curl_socket_t sockfd, void *sockp);
 
+/*
+ * An executor runs transfers on a number of worker threads of its own. Each
+ * worker has a multi handle and drives it with curl_multi_perform_events().
+ * Easy handles are given to the worker picked by the host name they connect
+ * to (the proxy's, if they use one), so transfers to the same host share
+ * connections. All workers share one DNS cache. Completed transfers are
+ * handed back through curl_executor_info_read().
+ *
+ * The executor functions are meant to be called from a single application
+ * thread. curl_global_init() must have been called before
+ * curl_executor_init().
+ */
+typedef void CURLX;
+
+/*
+ * Name:    curl_executor_init()
+ *
+ * Desc:    Creates an executor with 'threads' worker threads. The threads are
+ *          started when the first easy handle is added.
+ *
+ * Returns: a new CURLX handle, or NULL when it could not be created or
+ *          libcurl was built without thread support.
+ */
+CURL_EXTERN CURLX *curl_executor_init(int threads);
+
+/*
+ * Name:    curl_executor_setopt()
+ *
+ * Desc:    Sets a CURLMOPT_* option on the multi handle of every worker.
+ *          The callback options and their data are not supported. Options
+ *          can only be set before the first easy handle is added, and the
+ *          connection limits apply to each worker on its own.
+ *
+ * Returns: CURLM error code.
+ */
+CURL_EXTERN CURLMcode curl_executor_setopt(CURLX *executor,
+                                           CURLMoption option, ...);
+
+/*
+ * Name:    curl_executor_add_handle()
+ *
+ * Desc:    Gives an easy handle to the executor to be transferred. The
+ *          application must not touch the handle until it has been handed
+ *          back by curl_executor_info_read().
+ *
+ * Returns: CURLM error code.
+ */
+CURL_EXTERN CURLMcode curl_executor_add_handle(CURLX *executor,
+                                               CURL *curl_handle);
+
+/*
+ * Name:    curl_executor_wait()
+ *
+ * Desc:    Waits at most timeout_ms milliseconds (-1 for no limit) for
+ *          completed transfers. Returns at once when there already are some
+ *          or no transfer is in progress. The number of completed transfers
+ *          waiting to be read is stored in the integer 'ret' points to.
+ *
+ * Returns: CURLM error code.
+ */
+CURL_EXTERN CURLMcode curl_executor_wait(CURLX *executor, int timeout_ms,
+                                         int *ret);
+
+/*
+ * Name:    curl_executor_info_read()
+ *
+ * Desc:    Returns the next completed transfer, like curl_multi_info_read()
+ *          does, and hands its easy handle back to the application. The
+ *          returned struct is valid until the next call.
+ *
+ * Returns: A pointer to a filled-in struct, or NULL when there is none. It
+ *          also writes the number of messages left in the queue (after this
+ *          read) in the integer the second argument points to.
+ */
+CURL_EXTERN CURLMsg *curl_executor_info_read(CURLX *executor,
+                                             int *msgs_in_queue);
+
+/*
+ * Name:    curl_executor_cleanup()
+ *
+ * Desc:    Stops the worker threads and frees the executor. Easy handles
+ *          whose transfers are still in progress are aborted and left to
+ *          the application, like curl_multi_cleanup() does.
+ *
+ * Returns: CURLM error code.
+ */
+CURL_EXTERN CURLMcode curl_executor_cleanup(CURLX *executor);
+
 #ifdef __cplusplus
 } /* end of extern "C" */
 #endif
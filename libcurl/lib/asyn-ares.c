@@ -586,6 +586,22 @@ Curl_addrinfo *Curl_resolver_getaddrinfo(struct connectdata *conn,
   return NULL; /* no struct yet */
 }
 
+/*
+ * Curl_resolver_prefetch() - c-ares only makes progress while a transfer
+ * drives its channel, so there is nothing to run a background resolve on.
+ */
+bool Curl_resolver_prefetch(struct connectdata *conn,
+                            struct Curl_dnscache *cache,
+                            const char *hostname, int port, long ttl)
+{
+  (void)conn;
+  (void)cache;
+  (void)hostname;
+  (void)port;
+  (void)ttl;
+  return FALSE;
+}
+
 CURLcode Curl_set_dns_servers(struct SessionHandle *data,
                               char *servers)
 {
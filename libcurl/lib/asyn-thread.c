@@ -546,6 +546,39 @@ Curl_addrinfo *Curl_resolver_getaddrinfo(struct connectdata *conn,
 
 #else /* !HAVE_GETADDRINFO */
 
+/*
+ * resolve_family() returns the address family to ask getaddrinfo() for.
+ */
+static int resolve_family(struct connectdata *conn)
+{
+  int pf = PF_INET;
+
+#ifdef CURLRES_IPV6
+  /*
+   * Check if a limited name resolve has been requested.
+   */
+  switch(conn->ip_version) {
+  case CURL_IPRESOLVE_V4:
+    pf = PF_INET;
+    break;
+  case CURL_IPRESOLVE_V6:
+    pf = PF_INET6;
+    break;
+  default:
+    pf = PF_UNSPEC;
+    break;
+  }
+
+  if((pf != PF_INET) && !Curl_ipv6works())
+    /* the stack seems to be a non-ipv6 one */
+    pf = PF_INET;
+#else
+  (void)conn;
+#endif /* CURLRES_IPV6 */
+
+  return pf;
+}
+
 /*
  * Curl_resolver_getaddrinfo() - for getaddrinfo
  */
@@ -559,7 +592,6 @@ Curl_addrinfo *Curl_resolver_getaddrinfo(struct connectdata *conn,
   Curl_addrinfo *res;
   int error;
   char sbuf[NI_MAXSERV];
-  int pf = PF_INET;
 #ifdef CURLRES_IPV6
   struct in6_addr in6;
 #endif /* CURLRES_IPV6 */
@@ -576,30 +608,10 @@ Curl_addrinfo *Curl_resolver_getaddrinfo(struct connectdata *conn,
   if(Curl_inet_pton (AF_INET6, hostname, &in6) > 0)
     /* This is an IPv6 address literal */
     return Curl_ip2addr(AF_INET6, &in6, hostname, port);
-
-  /*
-   * Check if a limited name resolve has been requested.
-   */
-  switch(conn->ip_version) {
-  case CURL_IPRESOLVE_V4:
-    pf = PF_INET;
-    break;
-  case CURL_IPRESOLVE_V6:
-    pf = PF_INET6;
-    break;
-  default:
-    pf = PF_UNSPEC;
-    break;
-  }
-
-  if((pf != PF_INET) && !Curl_ipv6works())
-    /* the stack seems to be a non-ipv6 one */
-    pf = PF_INET;
-
 #endif /* CURLRES_IPV6 */
 
   memset(&hints, 0, sizeof(hints));
-  hints.ai_family = pf;
+  hints.ai_family = resolve_family(conn);
   hints.ai_socktype = conn->socktype;
 
   snprintf(sbuf, sizeof(sbuf), "%d", port);
@@ -625,6 +637,83 @@ Curl_addrinfo *Curl_resolver_getaddrinfo(struct connectdata *conn,
 
 #endif /* !HAVE_GETADDRINFO */
 
+/*
+ * A prefetch resolve runs in a detached thread that nobody waits for. It
+ * owns its copy of the name and a reference to the DNS cache, and hands the
+ * result to the cache when done.
+ */
+struct prefetch_data {
+  struct Curl_dnscache *cache;
+  char *hostname;
+  int port;
+  long ttl;
+#ifdef HAVE_GETADDRINFO
+  struct addrinfo hints;
+#endif
+};
+
+static unsigned int CURL_STDCALL prefetch_thread(void *arg)
+{
+  struct prefetch_data *pd = (struct prefetch_data *)arg;
+  Curl_addrinfo *res;
+#ifdef HAVE_GETADDRINFO
+  char service[NI_MAXSERV];
+
+  snprintf(service, sizeof(service), "%d", pd->port);
+  if(Curl_getaddrinfo_ex(pd->hostname, service, &pd->hints, &res))
+    res = NULL;
+#else
+  res = Curl_ipv4_resolve_r(pd->hostname, pd->port);
+#endif
+
+  Curl_dnscache_prefetched(pd->cache, pd->hostname, pd->port, res, pd->ttl);
+
+  free(pd->hostname);
+  free(pd);
+  return 0;
+}
+
+/*
+ * Curl_resolver_prefetch() starts a resolver thread that refreshes the DNS
+ * cache entry for hostname:port.
+ */
+bool Curl_resolver_prefetch(struct connectdata *conn,
+                            struct Curl_dnscache *cache,
+                            const char *hostname, int port, long ttl)
+{
+  struct prefetch_data *pd = calloc(1, sizeof(struct prefetch_data));
+  curl_thread_t thread_hnd;
+
+  if(!pd)
+    return FALSE;
+
+  pd->hostname = strdup(hostname);
+  if(!pd->hostname) {
+    free(pd);
+    return FALSE;
+  }
+  pd->cache = cache;
+  pd->port = port;
+  pd->ttl = ttl;
+#ifdef HAVE_GETADDRINFO
+  pd->hints.ai_family = resolve_family(conn);
+  pd->hints.ai_socktype = conn->socktype;
+#else
+  (void)conn;
+#endif
+
+  thread_hnd = Curl_thread_create(prefetch_thread, pd);
+  if(!thread_hnd) {
+    free(pd->hostname);
+    free(pd);
+    return FALSE;
+  }
+
+  /* let it run on its own, it cleans up after itself */
+  Curl_thread_destroy(thread_hnd);
+  return TRUE;
+}
+
 CURLcode Curl_set_dns_servers(struct SessionHandle *data,
                               char *servers)
 {
@@ -30,6 +30,7 @@ struct hostent;
 struct SessionHandle;
 struct connectdata;
 struct Curl_dns_entry;
+struct Curl_dnscache;
 
 /*
  * This header defines all functions in the internal asynch resolver interface.
@@ -144,6 +145,19 @@ Curl_addrinfo *Curl_resolver_getaddrinfo(struct connectdata *conn,
                                          int port,
                                          int *waitp);
 
+/*
+ * Curl_resolver_prefetch()
+ *
+ * Resolves the name once more without anyone waiting for the answer, to
+ * renew a DNS cache entry that is about to expire. The result is handed to
+ * Curl_dnscache_prefetched() along with 'ttl'. Returns TRUE if the resolve
+ * was started, in which case the caller's reference to 'cache' is passed on
+ * to it. Backends that cannot resolve in the background return FALSE.
+ */
+bool Curl_resolver_prefetch(struct connectdata *conn,
+                            struct Curl_dnscache *cache,
+                            const char *hostname, int port, long ttl);
+
 #ifndef CURLRES_ASYNCH
 /* convert these functions if an asynch resolver isn't used */
 #define Curl_resolver_cancel(x) Curl_nop_stmt
@@ -155,6 +169,7 @@ Curl_addrinfo *Curl_resolver_getaddrinfo(struct connectdata *conn,
 #define Curl_resolver_global_init() CURLE_OK
 #define Curl_resolver_global_cleanup() Curl_nop_stmt
 #define Curl_resolver_cleanup(x) Curl_nop_stmt
+#define Curl_resolver_prefetch(a,b,c,d,e) FALSE
 #endif
 
 #ifdef CURLRES_ASYNCH
@@ -56,6 +56,9 @@ CURLcode Curl_bundle_create(struct SessionHandle *data,
 
   (*cb_ptr)->num_connections = 0;
   (*cb_ptr)->server_supports_pipelining = FALSE;
+  (*cb_ptr)->num_idle = 0;
+  (*cb_ptr)->idle_head = NULL;
+  (*cb_ptr)->idle_tail = NULL;
 
   (*cb_ptr)->conn_list = Curl_llist_alloc((curl_llist_dtor) conn_llist_dtor);
   if(!(*cb_ptr)->conn_list) {
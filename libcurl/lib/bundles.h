@@ -27,6 +27,9 @@ struct connectbundle {
                                       set after first response */
   size_t num_connections;       /* Number of connections in the bundle */
   struct curl_llist *conn_list; /* The connectdata members of the bundle */
+  size_t num_idle;              /* Number of them that are idle */
+  struct connectdata *idle_head; /* Most recently used idle connection */
+  struct connectdata *idle_tail; /* Least recently used idle connection */
 };
 
 CURLcode Curl_bundle_create(struct SessionHandle *data,
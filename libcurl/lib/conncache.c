@@ -96,7 +96,8 @@ static bool conncache_add_bundle(struct conncache *connc,
 }
 
 static void conncache_remove_bundle(struct conncache *connc,
-                                    struct connectbundle *bundle)
+                                    struct connectbundle *bundle,
+                                    char *hostname)
 {
   struct curl_hash_iterator iter;
   struct curl_hash_element *he;
@@ -104,13 +105,21 @@ static void conncache_remove_bundle(struct conncache *connc,
   if(!connc)
     return;
 
+  /* The bundle is normally stored under the name of the host of its
+     connections, but the name of a re-used connection may differ in case
+     from the one the bundle was created with. Only then walk the hash. */
+  if(Curl_hash_pick(connc->hash, hostname, strlen(hostname)+1) == bundle) {
+    /* The bundle is destroyed by the hash destructor function,
+       free_bundle_hash_entry() */
+    Curl_hash_delete(connc->hash, hostname, strlen(hostname)+1);
+    return;
+  }
+
   Curl_hash_start_iterate(connc->hash, &iter);
 
   he = Curl_hash_next_element(&iter);
   while(he) {
     if(he->ptr == bundle) {
-      /* The bundle is destroyed by the hash destructor function,
-         free_bundle_hash_entry() */
       Curl_hash_delete(connc->hash, he->key, he->key_len);
       return;
     }
@@ -145,7 +154,8 @@ CURLcode Curl_conncache_add_conn(struct conncache *connc,
   result = Curl_bundle_add_conn(bundle, conn);
   if(result != CURLE_OK) {
     if(new_bundle)
-      conncache_remove_bundle(data->state.conn_cache, new_bundle);
+      conncache_remove_bundle(data->state.conn_cache, new_bundle,
+                              conn->host.name);
     return result;
   }
 
@@ -162,9 +172,10 @@ void Curl_conncache_remove_conn(struct conncache *connc,
   /* The bundle pointer can be NULL, since this function can be called
      due to a failed connection attempt, before being added to a bundle */
   if(bundle) {
+    Curl_conncache_conn_busy(connc, conn);
     Curl_bundle_remove_conn(bundle, conn);
     if(bundle->num_connections == 0) {
-      conncache_remove_bundle(connc, bundle);
+      conncache_remove_bundle(connc, bundle, conn->host.name);
     }
     connc->num_connections--;
 
@@ -173,6 +184,76 @@ void Curl_conncache_remove_conn(struct conncache *connc,
   }
 }
 
+/*
+ * Idle connections are kept on two doubly linked lists with the most
+ * recently used one first: the bundle's, which is all a reuse lookup for a
+ * host needs to look at, and the cache's, whose tail is the connection to
+ * close when the cache is full and where pruning starts.
+ */
+void Curl_conncache_conn_idle(struct conncache *connc,
+                              struct connectdata *conn)
+{
+  struct connectbundle *bundle = conn->bundle;
+
+  if(!bundle || conn->idle)
+    return;
+
+  conn->idle = TRUE;
+  conn->idle_since = Curl_tvnow();
+
+  conn->bundle_idle_prev = NULL;
+  conn->bundle_idle_next = bundle->idle_head;
+  if(bundle->idle_head)
+    bundle->idle_head->bundle_idle_prev = conn;
+  else
+    bundle->idle_tail = conn;
+  bundle->idle_head = conn;
+  bundle->num_idle++;
+
+  conn->cache_idle_prev = NULL;
+  conn->cache_idle_next = connc->idle_head;
+  if(connc->idle_head)
+    connc->idle_head->cache_idle_prev = conn;
+  else
+    connc->idle_tail = conn;
+  connc->idle_head = conn;
+  connc->num_idle++;
+}
+
+void Curl_conncache_conn_busy(struct conncache *connc,
+                              struct connectdata *conn)
+{
+  struct connectbundle *bundle = conn->bundle;
+
+  if(!conn->idle)
+    return;
+
+  conn->idle = FALSE;
+
+  if(conn->bundle_idle_prev)
+    conn->bundle_idle_prev->bundle_idle_next = conn->bundle_idle_next;
+  else
+    bundle->idle_head = conn->bundle_idle_next;
+  if(conn->bundle_idle_next)
+    conn->bundle_idle_next->bundle_idle_prev = conn->bundle_idle_prev;
+  else
+    bundle->idle_tail = conn->bundle_idle_prev;
+  bundle->num_idle--;
+
+  if(conn->cache_idle_prev)
+    conn->cache_idle_prev->cache_idle_next = conn->cache_idle_next;
+  else
+    connc->idle_head = conn->cache_idle_next;
+  if(conn->cache_idle_next)
+    conn->cache_idle_next->cache_idle_prev = conn->cache_idle_prev;
+  else
+    connc->idle_tail = conn->cache_idle_prev;
+  connc->num_idle--;
+
+  conn->bundle_idle_next = conn->bundle_idle_prev = NULL;
+  conn->cache_idle_next = conn->cache_idle_prev = NULL;
+}
+
 /* This function iterates the entire connection cache and calls the
    function func() with the connection pointer as the first argument
    and the supplied 'param' argument as the other,
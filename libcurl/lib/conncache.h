@@ -22,9 +22,20 @@
  *
  ***************************************************************************/
 
+/* Idle connections older than the CURLMOPT_IDLE_TIMEOUT, or closed by the
+   server, are looked for at most this often (milliseconds) */
+#define CURL_CONNCACHE_PRUNE_INTERVAL 1000
+
 struct conncache {
   struct curl_hash *hash;
   size_t num_connections;
+  size_t num_idle;
+  struct connectdata *idle_head; /* Most recently used idle connection */
+  struct connectdata *idle_tail; /* Least recently used idle connection */
+  struct timeval last_prune;     /* When idle connections were last pruned */
+  long reused;                   /* Transfers that re-used a connection */
+  long connects;                 /* New connections made */
+  long dead_on_reuse;            /* Idle connections found dead on re-use */
 };
 
 struct conncache *Curl_conncache_init(int size);
@@ -40,6 +51,15 @@ CURLcode Curl_conncache_add_conn(struct conncache *connc,
 void Curl_conncache_remove_conn(struct conncache *connc,
                                 struct connectdata *conn);
 
+/* Put a connection that is no longer in use first on the idle lists of its
+   bundle and of the cache */
+void Curl_conncache_conn_idle(struct conncache *connc,
+                              struct connectdata *conn);
+
+/* Take a connection off the idle lists, when it gets used again */
+void Curl_conncache_conn_busy(struct conncache *connc,
+                              struct connectdata *conn);
+
 void Curl_conncache_foreach(struct conncache *connc,
                             void *param,
                             int (*func)(struct connectdata *conn,
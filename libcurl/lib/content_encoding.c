@@ -5,7 +5,7 @@
  *                            | (__| |_| |  _ <| |___
  *                             \___|\___/|_| \_\_____|
  *
- * Copyright (C) 1998 - 2011, Daniel Stenberg, <daniel@haxx.se>, et al.
+ * Copyright (C) 1998 - 2013, Daniel Stenberg, <daniel@haxx.se>, et al.
  *
  * This software is licensed as described in the file COPYING, which
  * you should have received as part of this distribution. The terms
@@ -22,32 +22,110 @@
 
 #include "curl_setup.h"
 
-#ifdef HAVE_LIBZ
-
 #include "urldata.h"
 #include <curl/curl.h>
 #include "sendf.h"
+#include "rawstr.h"
+#include "http_chunks.h"
 #include "content_encoding.h"
 #include "curl_memory.h"
 
 #include "memdebug.h"
 
-/* Comment this out if zlib is always going to be at least ver. 1.2.0.4
-   (doing so will reduce code size slightly). */
-#define OLD_ZLIB_SUPPORT 1
+/* The decoded body is gathered in a buffer of this size before it is passed
+   on to the client, which is never handed more than this in one call */
+#define UNENCODE_BUFSIZE CURL_MAX_WRITE_SIZE
+
+/* This many decoding stages at most for a single response */
+#define MAX_ENCODE_STACK 5
+
+struct contenc_writer;
+
+/* A content encoding we know how to decode. They are looked up by name in
+   the encodings[] table at the end of this file. An encoding without a write
+   function gets no stage at all. */
+struct content_encoding {
+  const char *name;         /* as used in Content-Encoding: */
+  const char *alias;        /* another name for the same thing, or NULL */
+  CURLcode (*init_writer)(struct connectdata *conn,
+                          struct contenc_writer *writer);
+  CURLcode (*unencode_write)(struct connectdata *conn,
+                             struct contenc_writer *writer,
+                             const char *buf, size_t nbytes);
+  void (*close_writer)(struct connectdata *conn,
+                       struct contenc_writer *writer);
+  size_t paramsize;         /* size of the stage's private state */
+};
+
+/* A decoding stage. The stages of a request form a stack in
+   data->req.unencode: the top one is fed the body as received and each
+   passes its output on to the one below, the last one into the coalescing
+   buffer that is written to the client. */
+struct contenc_writer {
+  const struct content_encoding *handler;
+  struct contenc_writer *downstream; /* next stage or NULL for the client */
+  char *buf;        /* UNENCODE_BUFSIZE output buffer if there's a next
+                       stage */
+  void *params;     /* 'paramsize' bytes of state for the handler */
+};
+
+/*
+ * Make *out point to where 'writer' puts its decoded output, *room bytes at
+ * most. The last stage decodes straight into the free part of the
+ * coalescing buffer, which is flushed to the client first if it's full.
+ */
+static CURLcode output_space(struct connectdata *conn,
+                             struct contenc_writer *writer,
+                             char **out, size_t *room)
+{
+  struct SessionHandle *data = conn->data;
+  struct SingleRequest *k = &data->req;
+
+  if(writer->downstream) {
+    *out = writer->buf;
+    *room = UNENCODE_BUFSIZE;
+    return CURLE_OK;
+  }
+
+  if(k->unencbuflen == UNENCODE_BUFSIZE) {
+    CURLcode result = Curl_unencode_flush(conn);
+    if(result)
+      return result;
+  }
 
-#define DSIZ CURL_MAX_WRITE_SIZE /* buffer size for decompressed data */
+  *out = data->state.unencbuf + k->unencbuflen;
+  *room = UNENCODE_BUFSIZE - k->unencbuflen;
+  return CURLE_OK;
+}
 
-#define GZIP_MAGIC_0 0x1f
-#define GZIP_MAGIC_1 0x8b
+/* 'writer' has put 'nbytes' of output where output_space() told it to */
+static CURLcode output_done(struct connectdata *conn,
+                            struct contenc_writer *writer,
+                            size_t nbytes)
+{
+  struct contenc_writer *next = writer->downstream;
+
+  if(next)
+    return next->handler->unencode_write(conn, next, writer->buf, nbytes);
 
-/* gzip flag byte */
-#define ASCII_FLAG   0x01 /* bit 0 set: file probably ascii text */
-#define HEAD_CRC     0x02 /* bit 1 set: header CRC present */
-#define EXTRA_FIELD  0x04 /* bit 2 set: extra field present */
-#define ORIG_NAME    0x08 /* bit 3 set: original file name present */
-#define COMMENT      0x10 /* bit 4 set: file comment present */
-#define RESERVED     0xE0 /* bits 5..7: reserved */
+  conn->data->req.unencbuflen += nbytes;
+  return CURLE_OK;
+}
+
+#ifdef HAVE_LIBZ
+
+typedef enum {
+  ZLIB_UNINIT,          /* uninitialized */
+  ZLIB_INIT,            /* initialized */
+  ZLIB_DONE             /* end of stream seen and zlib shut down */
+} zlibInitState;
+
+struct zlib_params {
+  zlibInitState zlib_init;
+  bool retry_raw;       /* nothing inflated yet, a bad stream header may
+                           mean the server sent raw deflate data */
+  z_stream z;           /* State structure for zlib. */
+};
 
 static voidpf
 zalloc_cb(voidpf opaque, unsigned int items, unsigned int size)
@@ -79,357 +157,374 @@ process_zlib_error(struct connectdata *conn, z_stream *z)
 }
 
 static CURLcode
-exit_zlib(z_stream *z, zlibInitState *zlib_init, CURLcode result)
+exit_zlib(struct zlib_params *zp, CURLcode result)
 {
-  inflateEnd(z);
-  *zlib_init = ZLIB_UNINIT;
+  if(zp->zlib_init == ZLIB_INIT)
+    inflateEnd(&zp->z);
+  zp->zlib_init = ZLIB_UNINIT;
   return result;
 }
 
+static CURLcode
+zlib_init(struct connectdata *conn, struct contenc_writer *writer,
+          int windowbits)
+{
+  struct zlib_params *zp = (struct zlib_params *)writer->params;
+  z_stream *z = &zp->z;
+
+  z->zalloc = (alloc_func)zalloc_cb;
+  z->zfree = (free_func)zfree_cb;
+
+  if(inflateInit2(z, windowbits) != Z_OK)
+    return process_zlib_error(conn, z);
+
+  zp->zlib_init = ZLIB_INIT;
+  zp->retry_raw = TRUE;
+  return CURLE_OK;
+}
+
 static CURLcode
 inflate_stream(struct connectdata *conn,
-               struct SingleRequest *k)
+               struct contenc_writer *writer,
+               const char *buf, size_t nbytes)
 {
-  int allow_restart = 1;
-  z_stream *z = &k->z;          /* zlib state structure */
-  uInt nread = z->avail_in;
-  Bytef *orig_in = z->next_in;
+  struct zlib_params *zp = (struct zlib_params *)writer->params;
+  z_stream *z = &zp->z;         /* zlib state structure */
   int status;                   /* zlib status */
-  CURLcode result = CURLE_OK;   /* Curl_client_write status */
-  char *decomp;                 /* Put the decompressed data here. */
-
-  /* Dynamically allocate a buffer for decompression because it's uncommonly
-     large to hold on the stack */
-  decomp = malloc(DSIZ);
-  if(decomp == NULL) {
-    return exit_zlib(z, &k->zlib_init, CURLE_OUT_OF_MEMORY);
-  }
+  CURLcode result;
+
+  if(zp->zlib_init != ZLIB_INIT)
+    /* the stream has ended, ignore whatever trails it */
+    return CURLE_OK;
+
+  z->next_in = (Bytef *)buf;
+  z->avail_in = (uInt)nbytes;
 
-  /* because the buffer size is fixed, iteratively decompress and transfer to
-     the client via client_write. */
+  /* inflate straight into the space the next stage or the client buffer
+     offers, for as long as there is input or zlib fills all of it */
   for(;;) {
-    /* (re)set buffer for decompressed output for every iteration */
-    z->next_out = (Bytef *)decomp;
-    z->avail_out = DSIZ;
+    char *out;
+    size_t room;
+    size_t len;
+
+    result = output_space(conn, writer, &out, &room);
+    if(result)
+      return exit_zlib(zp, result);
+
+    z->next_out = (Bytef *)out;
+    z->avail_out = (uInt)room;
 
     status = inflate(z, Z_SYNC_FLUSH);
     if(status == Z_OK || status == Z_STREAM_END) {
-      allow_restart = 0;
-      if((DSIZ - z->avail_out) && (!k->ignorebody)) {
-        result = Curl_client_write(conn, CLIENTWRITE_BODY, decomp,
-                                   DSIZ - z->avail_out);
-        /* if !CURLE_OK, clean up, return */
-        if(result) {
-          free(decomp);
-          return exit_zlib(z, &k->zlib_init, result);
-        }
+      zp->retry_raw = FALSE;
+      len = room - z->avail_out;
+      if(len) {
+        result = output_done(conn, writer, len);
+        if(result)
+          return exit_zlib(zp, result);
       }
 
       /* Done? clean up, return */
       if(status == Z_STREAM_END) {
-        free(decomp);
-        if(inflateEnd(z) == Z_OK)
-          return exit_zlib(z, &k->zlib_init, result);
-        else
-          return exit_zlib(z, &k->zlib_init, process_zlib_error(conn, z));
+        (void)exit_zlib(zp, CURLE_OK);
+        zp->zlib_init = ZLIB_DONE;
+        return CURLE_OK;
       }
 
-      /* Done with these bytes, exit */
-
-      /* status is always Z_OK at this point! */
-      if(z->avail_in == 0) {
-        free(decomp);
-        return result;
-      }
+      /* all input used and nothing more held back */
+      if(!z->avail_in && z->avail_out)
+        return CURLE_OK;
     }
-    else if(allow_restart && status == Z_DATA_ERROR) {
+    else if(status == Z_BUF_ERROR)
+      /* nothing more to do until there's more input */
+      return CURLE_OK;
+    else if(zp->retry_raw && status == Z_DATA_ERROR) {
       /* some servers seem to not generate zlib headers, so this is an attempt
          to fix and continue anyway */
-
+      zp->retry_raw = FALSE;
       (void) inflateEnd(z);     /* don't care about the return code */
       if(inflateInit2(z, -MAX_WBITS) != Z_OK) {
-        free(decomp);
-        return exit_zlib(z, &k->zlib_init, process_zlib_error(conn, z));
+        zp->zlib_init = ZLIB_UNINIT;
+        return process_zlib_error(conn, z);
       }
-      z->next_in = orig_in;
-      z->avail_in = nread;
-      allow_restart = 0;
-      continue;
-    }
-    else {                      /* Error; exit loop, handle below */
-      free(decomp);
-      return exit_zlib(z, &k->zlib_init, process_zlib_error(conn, z));
+      z->next_in = (Bytef *)buf;
+      z->avail_in = (uInt)nbytes;
     }
+    else                        /* Error */
+      return exit_zlib(zp, process_zlib_error(conn, z));
   }
   /* Will never get here */
 }
 
-CURLcode
-Curl_unencode_deflate_write(struct connectdata *conn,
-                            struct SingleRequest *k,
-                            ssize_t nread)
+static void zlib_close_writer(struct connectdata *conn,
+                              struct contenc_writer *writer)
 {
-  z_stream *z = &k->z;          /* zlib state structure */
+  (void)conn;
+  (void)exit_zlib((struct zlib_params *)writer->params, CURLE_OK);
+}
 
-  /* Initialize zlib? */
-  if(k->zlib_init == ZLIB_UNINIT) {
-    memset(z, 0, sizeof(z_stream));
-    z->zalloc = (alloc_func)zalloc_cb;
-    z->zfree = (free_func)zfree_cb;
+/* Deflate: a zlib stream [RFC 1950 & 1951] */
+static CURLcode deflate_init_writer(struct connectdata *conn,
+                                    struct contenc_writer *writer)
+{
+  return zlib_init(conn, writer, MAX_WBITS);
+}
 
-    if(inflateInit(z) != Z_OK)
-      return process_zlib_error(conn, z);
-    k->zlib_init = ZLIB_INIT;
+static const struct content_encoding deflate_encoding = {
+  "deflate",
+  NULL,
+  deflate_init_writer,
+  inflate_stream,
+  zlib_close_writer,
+  sizeof(struct zlib_params)
+};
+
+/* Gzip [RFC 1952]. zlib 1.2.0.4 and later parse the gzip header and trailer
+   themselves, which is what asking for 32 more window bits turns on. */
+static CURLcode gzip_init_writer(struct connectdata *conn,
+                                 struct contenc_writer *writer)
+{
+  if(strcmp(zlibVersion(), "1.2.0.4") < 0) {
+    failf(conn->data, "zlib %s is too old to decode gzip", zlibVersion());
+    return CURLE_FUNCTION_NOT_FOUND;
   }
 
-  /* Set the compressed input when this function is called */
-  z->next_in = (Bytef *)k->str;
-  z->avail_in = (uInt)nread;
-
-  /* Now uncompress the data */
-  return inflate_stream(conn, k);
+  return zlib_init(conn, writer, MAX_WBITS + 32);
 }
 
-#ifdef OLD_ZLIB_SUPPORT
-/* Skip over the gzip header */
-static enum {
-  GZIP_OK,
-  GZIP_BAD,
-  GZIP_UNDERFLOW
-} check_gzip_header(unsigned char const *data, ssize_t len, ssize_t *headerlen)
+static const struct content_encoding gzip_encoding = {
+  "gzip",
+  "x-gzip",
+  gzip_init_writer,
+  inflate_stream,
+  zlib_close_writer,
+  sizeof(struct zlib_params)
+};
+
+/* Compress is recognized but zlib can't decode it, so that's an error once
+   there's a body to decode */
+static CURLcode error_init_writer(struct connectdata *conn,
+                                  struct contenc_writer *writer)
 {
-  int method, flags;
-  const ssize_t totallen = len;
-
-  /* The shortest header is 10 bytes */
-  if(len < 10)
-    return GZIP_UNDERFLOW;
-
-  if((data[0] != GZIP_MAGIC_0) || (data[1] != GZIP_MAGIC_1))
-    return GZIP_BAD;
+  (void)conn;
+  (void)writer;
+  return CURLE_OK;
+}
 
-  method = data[2];
-  flags = data[3];
+static CURLcode error_unencode_write(struct connectdata *conn,
+                                     struct contenc_writer *writer,
+                                     const char *buf, size_t nbytes)
+{
+  (void)writer;
+  (void)buf;
+  (void)nbytes;
+  failf(conn->data, "Unrecognized content encoding type. "
+        "libcurl understands `identity', `deflate' and `gzip' "
+        "content encodings.");
+  return CURLE_BAD_CONTENT_ENCODING;
+}
 
-  if(method != Z_DEFLATED || (flags & RESERVED) != 0) {
-    /* Can't handle this compression method or unknown flag */
-    return GZIP_BAD;
-  }
+static void error_close_writer(struct connectdata *conn,
+                               struct contenc_writer *writer)
+{
+  (void)conn;
+  (void)writer;
+}
 
-  /* Skip over time, xflags, OS code and all previous bytes */
-  len -= 10;
-  data += 10;
+static const struct content_encoding compress_encoding = {
+  "compress",
+  "x-compress",
+  error_init_writer,
+  error_unencode_write,
+  error_close_writer,
+  0
+};
 
-  if(flags & EXTRA_FIELD) {
-    ssize_t extra_len;
+#endif /* HAVE_LIBZ */
 
-    if(len < 2)
-      return GZIP_UNDERFLOW;
+/* Identity: nothing to undo, so no stage */
+static const struct content_encoding identity_encoding = {
+  "identity",
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  0
+};
+
+/* The encodings we know about */
+static const struct content_encoding * const encodings[] = {
+  &identity_encoding,
+#ifdef HAVE_LIBZ
+  &deflate_encoding,
+  &gzip_encoding,
+  &compress_encoding,
+#endif
+  NULL
+};
 
-    extra_len = (data[1] << 8) | data[0];
+static bool token_is(const char *token, size_t len, const char *name)
+{
+  return (name && strlen(name) == len &&
+          Curl_raw_nequal(token, name, len)) ? TRUE : FALSE;
+}
 
-    if(len < (extra_len+2))
-      return GZIP_UNDERFLOW;
+static const struct content_encoding *find_encoding(const char *name,
+                                                    size_t len)
+{
+  const struct content_encoding * const *cep;
 
-    len -= (extra_len + 2);
-    data += (extra_len + 2);
+  for(cep = encodings; *cep; cep++) {
+    if(token_is(name, len, (*cep)->name) || token_is(name, len, (*cep)->alias))
+      return *cep;
   }
+  return NULL;
+}
 
-  if(flags & ORIG_NAME) {
-    /* Skip over NUL-terminated file name */
-    while(len && *data) {
-      --len;
-      ++data;
+/* Put a stage for 'handler' on top of the request's decoding stack */
+static CURLcode push_writer(struct connectdata *conn,
+                            const struct content_encoding *handler)
+{
+  struct SessionHandle *data = conn->data;
+  struct SingleRequest *k = &data->req;
+  struct contenc_writer *writer;
+  size_t bufsize = k->unencode ? UNENCODE_BUFSIZE : 0;
+  unsigned int depth = 0;
+  CURLcode result;
+
+  for(writer = k->unencode; writer; writer = writer->downstream) {
+    if(++depth >= MAX_ENCODE_STACK) {
+      failf(data, "Reject response due to more than %u content encodings",
+            MAX_ENCODE_STACK);
+      return CURLE_BAD_CONTENT_ENCODING;
     }
-    if(!len || *data)
-      return GZIP_UNDERFLOW;
-
-    /* Skip over the NUL */
-    --len;
-    ++data;
   }
 
-  if(flags & COMMENT) {
-    /* Skip over NUL-terminated comment */
-    while(len && *data) {
-      --len;
-      ++data;
-    }
-    if(!len || *data)
-      return GZIP_UNDERFLOW;
-
-    /* Skip over the NUL */
-    --len;
+  /* the coalescing buffer is kept in the handle for all its transfers */
+  if(!data->state.unencbuf) {
+    data->state.unencbuf = malloc(UNENCODE_BUFSIZE);
+    if(!data->state.unencbuf)
+      return CURLE_OUT_OF_MEMORY;
   }
 
-  if(flags & HEAD_CRC) {
-    if(len < 2)
-      return GZIP_UNDERFLOW;
-
-    len -= 2;
+  writer = calloc(1, sizeof(struct contenc_writer) + handler->paramsize +
+                  bufsize);
+  if(!writer)
+    return CURLE_OUT_OF_MEMORY;
+
+  writer->handler = handler;
+  writer->downstream = k->unencode;
+  writer->params = writer + 1;
+  if(bufsize)
+    writer->buf = (char *)writer->params + handler->paramsize;
+
+  result = handler->init_writer(conn, writer);
+  if(result) {
+    free(writer);
+    return result;
   }
 
-  *headerlen = totallen - len;
-  return GZIP_OK;
+  k->unencode = writer;
+  return CURLE_OK;
 }
-#endif
 
-CURLcode
-Curl_unencode_gzip_write(struct connectdata *conn,
-                         struct SingleRequest *k,
-                         ssize_t nread)
+/*
+ * Set up decoding for the comma-separated list of encodings in a
+ * Content-Encoding: or Transfer-Encoding: header. They were applied in the
+ * order listed, so each gets a stage on top of the ones before it and is
+ * undone first. With 'maybechunked', 'chunked' turns on the chunk parser.
+ * Encodings we don't know are left alone.
+ */
+CURLcode Curl_build_unencoding_stack(struct connectdata *conn,
+                                     const char *enclist,
+                                     bool maybechunked)
 {
-  z_stream *z = &k->z;          /* zlib state structure */
-
-  /* Initialize zlib? */
-  if(k->zlib_init == ZLIB_UNINIT) {
-    memset(z, 0, sizeof(z_stream));
-    z->zalloc = (alloc_func)zalloc_cb;
-    z->zfree = (free_func)zfree_cb;
+  struct SessionHandle *data = conn->data;
 
-    if(strcmp(zlibVersion(), "1.2.0.4") >= 0) {
-      /* zlib ver. >= 1.2.0.4 supports transparent gzip decompressing */
-      if(inflateInit2(z, MAX_WBITS+32) != Z_OK) {
-        return process_zlib_error(conn, z);
-      }
-      k->zlib_init = ZLIB_INIT_GZIP; /* Transparent gzip decompress state */
-    }
-    else {
-      /* we must parse the gzip header ourselves */
-      if(inflateInit2(z, -MAX_WBITS) != Z_OK) {
-        return process_zlib_error(conn, z);
-      }
-      k->zlib_init = ZLIB_INIT;   /* Initial call state */
-    }
-  }
+  for(;;) {
+    const char *name;
+    size_t namelen;
+    const struct content_encoding *encoding;
+    CURLcode result;
 
-  if(k->zlib_init == ZLIB_INIT_GZIP) {
-    /* Let zlib handle the gzip decompression entirely */
-    z->next_in = (Bytef *)k->str;
-    z->avail_in = (uInt)nread;
-    /* Now uncompress the data */
-    return inflate_stream(conn, k);
-  }
+    /* skip whitespaces and commas */
+    while(*enclist && (ISSPACE(*enclist) || (*enclist == ',')))
+      enclist++;
 
-#ifndef OLD_ZLIB_SUPPORT
-  /* Support for old zlib versions is compiled away and we are running with
-     an old version, so return an error. */
-  return exit_zlib(z, &k->zlib_init, CURLE_FUNCTION_NOT_FOUND);
-
-#else
-  /* This next mess is to get around the potential case where there isn't
-   * enough data passed in to skip over the gzip header.  If that happens, we
-   * malloc a block and copy what we have then wait for the next call.  If
-   * there still isn't enough (this is definitely a worst-case scenario), we
-   * make the block bigger, copy the next part in and keep waiting.
-   *
-   * This is only required with zlib versions < 1.2.0.4 as newer versions
-   * can handle the gzip header themselves.
-   */
-
-  switch (k->zlib_init) {
-  /* Skip over gzip header? */
-  case ZLIB_INIT:
-  {
-    /* Initial call state */
-    ssize_t hlen;
-
-    switch (check_gzip_header((unsigned char *)k->str, nread, &hlen)) {
-    case GZIP_OK:
-      z->next_in = (Bytef *)k->str + hlen;
-      z->avail_in = (uInt)(nread - hlen);
-      k->zlib_init = ZLIB_GZIP_INFLATING; /* Inflating stream state */
+    if(!*enclist)
       break;
 
-    case GZIP_UNDERFLOW:
-      /* We need more data so we can find the end of the gzip header.  It's
-       * possible that the memory block we malloc here will never be freed if
-       * the transfer abruptly aborts after this point.  Since it's unlikely
-       * that circumstances will be right for this code path to be followed in
-       * the first place, and it's even more unlikely for a transfer to fail
-       * immediately afterwards, it should seldom be a problem.
-       */
-      z->avail_in = (uInt)nread;
-      z->next_in = malloc(z->avail_in);
-      if(z->next_in == NULL) {
-        return exit_zlib(z, &k->zlib_init, CURLE_OUT_OF_MEMORY);
-      }
-      memcpy(z->next_in, k->str, z->avail_in);
-      k->zlib_init = ZLIB_GZIP_HEADER;   /* Need more gzip header data state */
-      /* We don't have any data to inflate yet */
-      return CURLE_OK;
+    name = enclist;
+    while(*enclist && !ISSPACE(*enclist) && (*enclist != ','))
+      enclist++;
+    namelen = enclist - name;
 
-    case GZIP_BAD:
-    default:
-      return exit_zlib(z, &k->zlib_init, process_zlib_error(conn, z));
-    }
+    if(maybechunked && token_is(name, namelen, "chunked")) {
+      data->req.chunk = TRUE; /* chunks coming our way */
 
-  }
-  break;
-
-  case ZLIB_GZIP_HEADER:
-  {
-    /* Need more gzip header data state */
-    ssize_t hlen;
-    unsigned char *oldblock = z->next_in;
-
-    z->avail_in += (uInt)nread;
-    z->next_in = realloc(z->next_in, z->avail_in);
-    if(z->next_in == NULL) {
-      free(oldblock);
-      return exit_zlib(z, &k->zlib_init, CURLE_OUT_OF_MEMORY);
+      /* init our chunky engine */
+      Curl_httpchunk_init(conn);
+      continue;
     }
-    /* Append the new block of data to the previous one */
-    memcpy(z->next_in + z->avail_in - nread, k->str, nread);
-
-    switch (check_gzip_header(z->next_in, z->avail_in, &hlen)) {
-    case GZIP_OK:
-      /* This is the zlib stream data */
-      free(z->next_in);
-      /* Don't point into the malloced block since we just freed it */
-      z->next_in = (Bytef *)k->str + hlen + nread - z->avail_in;
-      z->avail_in = (uInt)(z->avail_in - hlen);
-      k->zlib_init = ZLIB_GZIP_INFLATING;   /* Inflating stream state */
-      break;
 
-    case GZIP_UNDERFLOW:
-      /* We still don't have any data to inflate! */
-      return CURLE_OK;
+    if(data->set.http_ce_skip)
+      /* the application wants the body as sent */
+      continue;
 
-    case GZIP_BAD:
-    default:
-      free(z->next_in);
-      return exit_zlib(z, &k->zlib_init, process_zlib_error(conn, z));
+    encoding = find_encoding(name, namelen);
+    if(encoding && encoding->unencode_write) {
+      result = push_writer(conn, encoding);
+      if(result)
+        return result;
     }
-
-  }
-  break;
-
-  case ZLIB_GZIP_INFLATING:
-  default:
-    /* Inflating stream state */
-    z->next_in = (Bytef *)k->str;
-    z->avail_in = (uInt)nread;
-    break;
   }
 
-  if(z->avail_in == 0) {
-    /* We don't have any data to inflate; wait until next time */
+  return CURLE_OK;
+}
+
+/*
+ * Decode 'nbytes' of received body. The output is gathered in the handle's
+ * coalescing buffer, so Curl_unencode_flush() must be called once the data
+ * that was read has been passed in here.
+ */
+CURLcode Curl_unencode_write(struct connectdata *conn,
+                             const char *buf, size_t nbytes)
+{
+  struct contenc_writer *writer = conn->data->req.unencode;
+
+  if(!nbytes)
     return CURLE_OK;
-  }
 
-  /* We've parsed the header, now uncompress the data */
-  return inflate_stream(conn, k);
-#endif
+  return writer->handler->unencode_write(conn, writer, buf, nbytes);
 }
 
-void Curl_unencode_cleanup(struct connectdata *conn)
+/* Write what's decoded so far to the client */
+CURLcode Curl_unencode_flush(struct connectdata *conn)
 {
   struct SessionHandle *data = conn->data;
   struct SingleRequest *k = &data->req;
-  z_stream *z = &k->z;
-  if(k->zlib_init != ZLIB_UNINIT)
-    (void) exit_zlib(z, &k->zlib_init, CURLE_OK);
+  size_t len = k->unencbuflen;
+
+  if(!len)
+    return CURLE_OK;
+
+  k->unencbuflen = 0;
+  if(k->ignorebody)
+    return CURLE_OK;
+
+  return Curl_client_write(conn, CLIENTWRITE_BODY, data->state.unencbuf, len);
 }
 
-#endif /* HAVE_LIBZ */
+void Curl_unencode_cleanup(struct connectdata *conn)
+{
+  struct SingleRequest *k = &conn->data->req;
+  struct contenc_writer *writer;
+
+  while(k->unencode) {
+    writer = k->unencode;
+    k->unencode = writer->downstream;
+    writer->handler->close_writer(conn, writer);
+    free(writer);
+  }
+  k->unencbuflen = 0;
+}
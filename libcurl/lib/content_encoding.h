@@ -7,7 +7,7 @@
  *                            | (__| |_| |  _ <| |___
  *                             \___|\___/|_| \_\_____|
  *
- * Copyright (C) 1998 - 2011, Daniel Stenberg, <daniel@haxx.se>, et al.
+ * Copyright (C) 1998 - 2013, Daniel Stenberg, <daniel@haxx.se>, et al.
  *
  * This software is licensed as described in the file COPYING, which
  * you should have received as part of this distribution. The terms
@@ -28,21 +28,18 @@
  */
 #ifdef HAVE_LIBZ
 #define ALL_CONTENT_ENCODINGS "deflate, gzip"
-/* force a cleanup */
-void Curl_unencode_cleanup(struct connectdata *conn);
 #else
 #define ALL_CONTENT_ENCODINGS "identity"
-#define Curl_unencode_cleanup(x) Curl_nop_stmt
 #endif
 
-CURLcode Curl_unencode_deflate_write(struct connectdata *conn,
-                                     struct SingleRequest *req,
-                                     ssize_t nread);
-
-CURLcode
-Curl_unencode_gzip_write(struct connectdata *conn,
-                         struct SingleRequest *k,
-                         ssize_t nread);
+CURLcode Curl_build_unencoding_stack(struct connectdata *conn,
+                                     const char *enclist,
+                                     bool maybechunked);
+CURLcode Curl_unencode_write(struct connectdata *conn,
+                             const char *buf, size_t nbytes);
+CURLcode Curl_unencode_flush(struct connectdata *conn);
 
+/* force a cleanup */
+void Curl_unencode_cleanup(struct connectdata *conn);
 
 #endif /* HEADER_CURL_CONTENT_ENCODING_H */
@@ -154,9 +154,7 @@ static bool pathmatch(const char* cookie_path, const char* request_uri)
 {
   size_t cookie_path_len;
   size_t uri_path_len;
-  char* uri_path = NULL;
-  char* pos;
-  bool ret = FALSE;
+  const char *uri_path = request_uri;
 
   /* cookie_path must not have last '/' separator. ex: /sample */
   cookie_path_len = strlen(cookie_path);
@@ -165,19 +163,12 @@ static bool pathmatch(const char* cookie_path, const char* request_uri)
     return TRUE;
   }
 
-  uri_path = strdup(request_uri);
-  if(!uri_path)
-    return FALSE;
-  pos = strchr(uri_path, '?');
-  if(pos)
-    *pos = 0x0;
-
-  /* #-fragments are already cut off! */
-  if(0 == strlen(uri_path) || uri_path[0] != '/') {
-    free(uri_path);
-    uri_path = strdup("/");
-    if(!uri_path)
-      return FALSE;
+  /* the uri-path is everything up to the query part, and #-fragments are
+     already cut off! */
+  uri_path_len = strcspn(uri_path, "?");
+  if(0 == uri_path_len || uri_path[0] != '/') {
+    uri_path = "/";
+    uri_path_len = 1;
   }
 
   /* here, RFC6265 5.1.4 says
@@ -189,36 +180,201 @@ static bool pathmatch(const char* cookie_path, const char* request_uri)
      (uri path is not /).
    */
 
-  uri_path_len = strlen(uri_path);
+  if(uri_path_len < cookie_path_len)
+    return FALSE;
+
+  /* not using checkprefix() because matching should be case-sensitive */
+  if(strncmp(cookie_path, uri_path, cookie_path_len))
+    return FALSE;
+
+  /* The cookie-path and the uri-path are identical. */
+  if(cookie_path_len == uri_path_len)
+    return TRUE;
+
+  /* here, cookie_path_len < url_path_len */
+  if(uri_path[cookie_path_len] == '/')
+    return TRUE;
+
+  return FALSE;
+}
+
+/*
+ * Second-level labels that registries commonly put under a two letter
+ * country code, as in "co.uk" or "com.au".
+ */
+static const char * const cookie_slds[] = {
+  "ac", "co", "com", "edu", "gov", "ne", "net", "or", "org", NULL
+};
+
+static bool cookie_sld(const char *label, size_t len)
+{
+  const char * const *sld;
 
-  if(uri_path_len < cookie_path_len) {
-    ret = FALSE;
-    goto pathmatched;
+  for(sld = cookie_slds; *sld; sld++) {
+    if((strlen(*sld) == len) && Curl_raw_nequal(*sld, label, len))
+      return TRUE;
   }
+  return FALSE;
+}
 
-  /* not using checkprefix() because matching should be case-sensitive */
-  if(strncmp(cookie_path, uri_path, cookie_path_len)) {
-    ret = FALSE;
-    goto pathmatched;
+/* start of the label that ends right before 'dot' */
+static const char *cookie_label(const char *domain, const char *dot)
+{
+  const char *prev = memrchr(domain, '.', dot - domain);
+  return prev ? prev + 1 : domain;
+}
+
+/*
+ * cookie_bucket()
+ *
+ * Returns the jar bucket for the given cookie domain or host name, and the
+ * hash of its registrable part in '*hash'. We have no public suffix list, so
+ * the registrable part is taken to be the last two labels, or the last three
+ * when the second last is one of the above under a country code.
+ *
+ * Every host name that tail-matches a domain ends with that domain, so as
+ * long as the domain holds all of the registrable part, the host has the same
+ * one and the cookie can only ever match hosts in its own bucket. Domains
+ * that are shorter than that (no dot at all, or "co.uk" alone) may tail-match
+ * hosts of many registrable domains and go to bucket 0, which is searched for
+ * every host.
+ */
+static size_t cookie_bucket(const char *domain, unsigned int *hash)
+{
+  const char *top;
+  const char *last;
+  unsigned int h = 5381;
+
+  *hash = 0;
+  if(!domain)
+    return 0;
+
+  last = memrchr(domain, '.', strlen(domain));
+  if(!last)
+    return 0;
+
+  top = cookie_label(domain, last);
+  if((strlen(last + 1) == 2) && cookie_sld(top, last - top)) {
+    if(top == domain)
+      return 0;
+    top = cookie_label(domain, top - 1);
   }
 
-  /* The cookie-path and the uri-path are identical. */
-  if(cookie_path_len == uri_path_len) {
-    ret = TRUE;
-    goto pathmatched;
+  while(*top) {
+    h += h << 5;
+    h ^= (unsigned char)Curl_raw_toupper(*top++);
   }
+  *hash = h;
+  return 1 + h % (COOKIE_HASH_SIZE - 1);
+}
 
-  /* here, cookie_path_len < url_path_len */
-  if(uri_path[cookie_path_len] == '/') {
-    ret = TRUE;
-    goto pathmatched;
+/*
+ * The expiry heap. Each cookie with an expiry time is kept in a binary
+ * min-heap on that time, so that expired cookies are found without looking
+ * at any others. A cookie knows its own place in the heap so that it can be
+ * taken out when it is replaced.
+ */
+static void expiry_place(struct CookieInfo *c, size_t i, struct Cookie *co)
+{
+  c->expiry[i] = co;
+  co->expiryidx = i + 1;
+}
+
+static void expiry_up(struct CookieInfo *c, size_t i)
+{
+  struct Cookie *co = c->expiry[i];
+
+  while(i) {
+    size_t parent = (i - 1) / 2;
+    if(c->expiry[parent]->expires <= co->expires)
+      break;
+    expiry_place(c, i, c->expiry[parent]);
+    i = parent;
+  }
+  expiry_place(c, i, co);
+}
+
+static void expiry_down(struct CookieInfo *c, size_t i)
+{
+  struct Cookie *co = c->expiry[i];
+
+  for(;;) {
+    size_t child = i * 2 + 1;
+    if(child >= c->numexpiry)
+      break;
+    if((child + 1 < c->numexpiry) &&
+       (c->expiry[child + 1]->expires < c->expiry[child]->expires))
+      child++;
+    if(co->expires <= c->expiry[child]->expires)
+      break;
+    expiry_place(c, i, c->expiry[child]);
+    i = child;
+  }
+  expiry_place(c, i, co);
+}
+
+static void expiry_add(struct CookieInfo *c, struct Cookie *co)
+{
+  if(c->numexpiry == c->maxexpiry) {
+    size_t newmax = c->maxexpiry ? c->maxexpiry * 2 : 32;
+    struct Cookie **newheap = realloc(c->expiry,
+                                      newmax * sizeof(struct Cookie *));
+    if(!newheap)
+      /* the cookie stays in the jar, it is just not pruned when it expires
+         but Curl_cookie_getlist() still won't send it */
+      return;
+    c->expiry = newheap;
+    c->maxexpiry = newmax;
+  }
+  c->expiry[c->numexpiry] = co;
+  c->numexpiry++;
+  expiry_up(c, c->numexpiry - 1);
+}
+
+static void expiry_remove(struct CookieInfo *c, struct Cookie *co)
+{
+  size_t i;
+
+  if(!co->expiryidx)
+    return;
+
+  i = co->expiryidx - 1;
+  co->expiryidx = 0;
+  c->numexpiry--;
+  if(i != c->numexpiry) {
+    /* move the last one into the hole and restore the heap order */
+    c->expiry[i] = c->expiry[c->numexpiry];
+    if(i && (c->expiry[i]->expires < c->expiry[(i - 1) / 2]->expires))
+      expiry_up(c, i);
+    else
+      expiry_down(c, i);
   }
+}
+
+/*
+ * remove_expired()
+ *
+ * Drop the cookies whose expiry time has passed from the jar. Not done by
+ * Curl_cookie_getlist(), whose returned list points into the cookies.
+ */
+static void remove_expired(struct CookieInfo *c, time_t now)
+{
+  while(c->numexpiry && (c->expiry[0]->expires <= now)) {
+    struct Cookie *co = c->expiry[0];
+    struct Cookie **link;
+    unsigned int hash;
 
-  ret = FALSE;
+    expiry_remove(c, co);
 
-pathmatched:
-  free(uri_path);
-  return ret;
+    link = &c->cookies[cookie_bucket(co->domain, &hash)];
+    while(*link && (*link != co))
+      link = &(*link)->next;
+    if(*link)
+      *link = co->next;
+
+    freecookie(co);
+    c->numcookies--;
+  }
 }
 
 /*
@@ -320,6 +476,7 @@ Curl_cookie_add(struct SessionHandle *data,
   char name[MAX_NAME];
   struct Cookie *co;
   struct Cookie *lastc=NULL;
+  size_t bucket;
   time_t now = time(NULL);
   bool replace_old = FALSE;
   bool badcookie = FALSE; /* cookies are good by default. mmmmm yummy */
@@ -698,9 +855,13 @@ Curl_cookie_add(struct SessionHandle *data,
 
   /* now, we have parsed the incoming line, we must now check if this
      superceeds an already existing cookie, which it may if the previous have
-     the same domain and path as this */
+     the same domain and path as this. Such a cookie has the same domain and
+     thus lives in the same bucket. */
+
+  remove_expired(c, now);
 
-  clist = c->cookies;
+  bucket = cookie_bucket(co->domain, &co->hash);
+  clist = c->cookies[bucket];
   replace_old = FALSE;
   while(clist) {
     if(Curl_raw_equal(clist->name, co->name)) {
@@ -745,6 +906,9 @@ Curl_cookie_add(struct SessionHandle *data,
       if(replace_old) {
         co->next = clist->next; /* get the next-pointer first */
 
+        /* the old expiry time goes away with the old data */
+        expiry_remove(c, clist);
+
         /* then free all the old pointers */
         free(clist->name);
         if(clist->value)
@@ -793,10 +957,13 @@ Curl_cookie_add(struct SessionHandle *data,
     if(lastc)
       lastc->next = co;
     else
-      c->cookies = co;
+      c->cookies[bucket] = co;
     c->numcookies++; /* one more cookie in the jar */
   }
 
+  if(co->expires)
+    expiry_add(c, co);
+
   return co;
 }
 
@@ -880,8 +1047,8 @@ struct CookieInfo *Curl_cookie_init(struct SessionHandle *data,
 /* sort this so that the longest path gets before the shorter path */
 static int cookie_sort(const void *p1, const void *p2)
 {
-  struct Cookie *c1 = *(struct Cookie **)p1;
-  struct Cookie *c2 = *(struct Cookie **)p2;
+  const struct Cookie *c1 = (const struct Cookie *)p1;
+  const struct Cookie *c2 = (const struct Cookie *)p2;
   size_t l1, l2;
 
   /* 1 - compare cookie path lengths */
@@ -916,105 +1083,93 @@ static int cookie_sort(const void *p1, const void *p2)
  *
  * It shall only return cookies that haven't expired.
  *
+ * Only the bucket of the host's domain and bucket 0 are searched. The list
+ * is a single allocated array of shallow cookie copies, linked in order.
+ * The copies share their strings with the jar and may be used after the
+ * share lock is released, so expired cookies are skipped here but only
+ * freed when cookies are added or saved.
+ *
  ****************************************************************************/
 
 struct Cookie *Curl_cookie_getlist(struct CookieInfo *c,
                                    const char *host, const char *path,
                                    bool secure)
 {
-  struct Cookie *newco;
   struct Cookie *co;
-  time_t now = time(NULL);
-  struct Cookie *mainco=NULL;
+  struct Cookie *array = NULL;
   size_t matches = 0;
+  size_t arraysize = 0;
+  time_t now = time(NULL);
+  unsigned int hash;
+  size_t bucket;
+  int pass;
 
-  if(!c || !c->cookies)
+  if(!c || !c->numcookies)
     return NULL; /* no cookie struct or no cookies in the struct */
 
-  co = c->cookies;
+  bucket = cookie_bucket(host, &hash);
 
-  while(co) {
-    /* only process this cookie if it is not expired or had no expire
-       date AND that if the cookie requires we're secure we must only
-       continue if we are! */
-    if((!co->expires || (co->expires > now)) &&
-       (co->secure?secure:TRUE)) {
+  for(pass = 0; pass < 2; pass++) {
+    if(pass && !bucket)
+      break; /* bucket 0 was the host's own */
 
-      /* now check if the domain is correct */
-      if(!co->domain ||
-         (co->tailmatch && tailmatch(co->domain, host)) ||
-         (!co->tailmatch && Curl_raw_equal(host, co->domain)) ) {
-        /* the right part of the host matches the domain stuff in the
-           cookie data */
-
-        /* now check the left part of the path with the cookies path
-           requirement */
-        if(!co->spath || pathmatch(co->spath, path) ) {
-
-          /* and now, we know this is a match and we should create an
-             entry for the return-linked-list */
-
-          newco = malloc(sizeof(struct Cookie));
-          if(newco) {
-            /* first, copy the whole source cookie: */
-            memcpy(newco, co, sizeof(struct Cookie));
-
-            /* then modify our next */
-            newco->next = mainco;
-
-            /* point the main to us */
-            mainco = newco;
+    for(co = c->cookies[pass ? 0 : bucket]; co; co = co->next) {
+      if(!pass && bucket && (co->hash != hash))
+        /* another domain that shares the bucket */
+        continue;
 
-            matches++;
-          }
-          else {
-            fail:
-            /* failure, clear up the allocated chain and return NULL */
-            while(mainco) {
-              co = mainco->next;
-              free(mainco);
-              mainco = co;
+      /* only process this cookie if it is not expired or had no expire
+         date AND that if the cookie requires we're secure we must only
+         continue if we are! */
+      if((!co->expires || (co->expires > now)) &&
+         (co->secure?secure:TRUE)) {
+
+        /* now check if the domain is correct */
+        if(!co->domain ||
+           (co->tailmatch && tailmatch(co->domain, host)) ||
+           (!co->tailmatch && Curl_raw_equal(host, co->domain)) ) {
+          /* the right part of the host matches the domain stuff in the
+             cookie data */
+
+          /* now check the left part of the path with the cookies path
+             requirement */
+          if(!co->spath || pathmatch(co->spath, path) ) {
+
+            /* and now, we know this is a match and we should add a copy of
+               it to the returned array */
+            if(matches == arraysize) {
+              size_t newsize = arraysize ? arraysize * 2 : 16;
+              struct Cookie *newarray =
+                realloc(array, newsize * sizeof(struct Cookie));
+              if(!newarray) {
+                Curl_safefree(array);
+                return NULL;
+              }
+              array = newarray;
+              arraysize = newsize;
             }
-
-            return NULL;
+            memcpy(&array[matches++], co, sizeof(struct Cookie));
           }
         }
       }
     }
-    co = co->next;
   }
 
   if(matches) {
     /* Now we need to make sure that if there is a name appearing more than
        once, the longest specified path version comes first. To make this
        the swiftest way, we just sort them all based on path length. */
-    struct Cookie **array;
     size_t i;
 
-    /* alloc an array and store all cookie pointers */
-    array = malloc(sizeof(struct Cookie *) * matches);
-    if(!array)
-      goto fail;
-
-    co = mainco;
-
-    for(i=0; co; co = co->next)
-      array[i++] = co;
-
-    /* now sort the cookie pointers in path length order */
-    qsort(array, matches, sizeof(struct Cookie *), cookie_sort);
+    qsort(array, matches, sizeof(struct Cookie), cookie_sort);
 
-    /* remake the linked list order according to the new order */
-
-    mainco = array[0]; /* start here */
+    /* link the list in the sorted order */
     for(i=0; i<matches-1; i++)
-      array[i]->next = array[i+1];
-    array[matches-1]->next = NULL; /* terminate the list */
-
-    free(array); /* remove the temporary data again */
+      array[i].next = &array[i+1];
+    array[matches-1].next = NULL; /* terminate the list */
   }
 
-  return mainco; /* return the new list */
+  return array; /* return the new list */
 }
 
 /*****************************************************************************
@@ -1027,8 +1182,12 @@ struct Cookie *Curl_cookie_getlist(struct CookieInfo *c,
 void Curl_cookie_clearall(struct CookieInfo *cookies)
 {
   if(cookies) {
-    Curl_cookie_freelist(cookies->cookies, TRUE);
-    cookies->cookies = NULL;
+    size_t i;
+    for(i = 0; i < COOKIE_HASH_SIZE; i++) {
+      Curl_cookie_freelist(cookies->cookies[i], TRUE);
+      cookies->cookies[i] = NULL;
+    }
+    cookies->numexpiry = 0;
     cookies->numcookies = 0;
   }
 }
@@ -1040,7 +1199,9 @@ void Curl_cookie_clearall(struct CookieInfo *cookies)
  * Free a list of cookies previously returned by Curl_cookie_getlist();
  *
  * The 'cookiestoo' argument tells this function whether to just free the
- * list or actually also free all cookies within the list as well.
+ * list or actually also free all cookies within the list as well. The
+ * former is the single array Curl_cookie_getlist() returns, the latter a
+ * chain of separately allocated cookies from the jar.
  *
  ****************************************************************************/
 
@@ -1048,13 +1209,15 @@ void Curl_cookie_freelist(struct Cookie *co, bool cookiestoo)
 {
   struct Cookie *next;
   if(co) {
+    if(!cookiestoo) {
+      /* we only free the array since the "members" are all just pointed
+         out in the main cookie list! */
+      free(co);
+      return;
+    }
     while(co) {
       next = co->next;
-      if(cookiestoo)
-        freecookie(co);
-      else
-        free(co); /* we only free the struct since the "members" are all just
-                     pointed out in the main cookie list! */
+      freecookie(co);
       co = next;
     }
   }
@@ -1070,32 +1233,25 @@ void Curl_cookie_freelist(struct Cookie *co, bool cookiestoo)
  ****************************************************************************/
 void Curl_cookie_clearsess(struct CookieInfo *cookies)
 {
-  struct Cookie *first, *curr, *next, *prev = NULL;
+  struct Cookie **link, *curr;
+  size_t i;
 
-  if(!cookies || !cookies->cookies)
+  if(!cookies)
     return;
 
-  first = curr = prev = cookies->cookies;
-
-  for(; curr; curr = next) {
-    next = curr->next;
-    if(!curr->expires) {
-      if(first == curr)
-        first = next;
-
-      if(prev == curr)
-        prev = next;
+  for(i = 0; i < COOKIE_HASH_SIZE; i++) {
+    link = &cookies->cookies[i];
+    while((curr = *link) != NULL) {
+      if(!curr->expires) {
+        /* session cookies are never in the expiry heap */
+        *link = curr->next;
+        freecookie(curr);
+        cookies->numcookies--;
+      }
       else
-        prev->next = next;
-
-      freecookie(curr);
-      cookies->numcookies--;
+        link = &curr->next;
     }
-    else
-      prev = curr;
   }
-
-  cookies->cookies = first;
 }
 
 
@@ -1110,16 +1266,21 @@ void Curl_cookie_cleanup(struct CookieInfo *c)
 {
   struct Cookie *co;
   struct Cookie *next;
+  size_t i;
   if(c) {
     if(c->filename)
       free(c->filename);
-    co = c->cookies;
+    for(i = 0; i < COOKIE_HASH_SIZE; i++) {
+      co = c->cookies[i];
 
-    while(co) {
-      next = co->next;
-      freecookie(co);
-      co = next;
+      while(co) {
+        next = co->next;
+        freecookie(co);
+        co = next;
+      }
     }
+    if(c->expiry)
+      free(c->expiry);
     free(c); /* free the base struct as well */
   }
 }
@@ -1167,6 +1328,11 @@ static int cookie_output(struct CookieInfo *c, const char *dumphere)
   struct Cookie *co;
   FILE *out;
   bool use_stdout=FALSE;
+  size_t i;
+
+  if(c)
+    /* expired cookies are not worth saving */
+    remove_expired(c, time(NULL));
 
   if((NULL == c) || (0 == c->numcookies))
     /* If there are no known cookies, we don't write or even create any
@@ -1191,19 +1357,18 @@ static int cookie_output(struct CookieInfo *c, const char *dumphere)
           "# http://curl.haxx.se/docs/http-cookies.html\n"
           "# This file was generated by libcurl! Edit at your own risk.\n\n",
           out);
-    co = c->cookies;
-
-    while(co) {
-      format_ptr = get_netscape_format(co);
-      if(format_ptr == NULL) {
-        fprintf(out, "#\n# Fatal libcurl error\n");
-        if(!use_stdout)
-          fclose(out);
-        return 1;
+    for(i = 0; i < COOKIE_HASH_SIZE; i++) {
+      for(co = c->cookies[i]; co; co = co->next) {
+        format_ptr = get_netscape_format(co);
+        if(format_ptr == NULL) {
+          fprintf(out, "#\n# Fatal libcurl error\n");
+          if(!use_stdout)
+            fclose(out);
+          return 1;
+        }
+        fprintf(out, "%s\n", format_ptr);
+        free(format_ptr);
       }
-      fprintf(out, "%s\n", format_ptr);
-      free(format_ptr);
-      co=co->next;
     }
   }
 
@@ -1219,28 +1384,28 @@ struct curl_slist *Curl_cookie_list(struct SessionHandle *data)
   struct curl_slist *beg;
   struct Cookie *c;
   char *line;
+  size_t i;
 
   if((data->cookies == NULL) ||
       (data->cookies->numcookies == 0))
     return NULL;
 
-  c = data->cookies->cookies;
-
-  while(c) {
-    /* fill the list with _all_ the cookies we know */
-    line = get_netscape_format(c);
-    if(!line) {
-      curl_slist_free_all(list);
-      return NULL;
-    }
-    beg = Curl_slist_append_nodup(list, line);
-    if(!beg) {
-      free(line);
-      curl_slist_free_all(list);
-      return NULL;
+  for(i = 0; i < COOKIE_HASH_SIZE; i++) {
+    for(c = data->cookies->cookies[i]; c; c = c->next) {
+      /* fill the list with _all_ the cookies we know */
+      line = get_netscape_format(c);
+      if(!line) {
+        curl_slist_free_all(list);
+        return NULL;
+      }
+      beg = Curl_slist_append_nodup(list, line);
+      if(!beg) {
+        free(line);
+        curl_slist_free_all(list);
+        return NULL;
+      }
+      list = beg;
     }
-    list = beg;
-    c = c->next;
   }
 
   return list;
@@ -43,11 +43,25 @@ struct Cookie {
   bool secure;       /* whether the 'secure' keyword was used */
   bool livecookie;   /* updated from a server, not a stored file */
   bool httponly;     /* true if the httponly directive is present */
+
+  unsigned int hash; /* hash of the registrable part of the domain */
+  size_t expiryidx;  /* 1 + index in the expiry heap, 0 when not in it */
 };
 
+/* Number of domain buckets in a cookie jar. Bucket 0 holds the cookies that
+   can't be indexed on a domain (no domain, or one too short to hold a
+   registrable domain), the others are picked by the hash of the registrable
+   part of the cookie domain. */
+#define COOKIE_HASH_SIZE 256
+
 struct CookieInfo {
-  /* linked list of cookies we know of */
-  struct Cookie *cookies;
+  /* linked lists of cookies we know of, one per domain bucket */
+  struct Cookie *cookies[COOKIE_HASH_SIZE];
+
+  /* binary min-heap on 'expires' of the cookies that have an expiry time */
+  struct Cookie **expiry;
+  size_t numexpiry; /* number of cookies in the heap */
+  size_t maxexpiry; /* allocated size of the heap */
 
   char *filename;  /* file we read from/write to */
   bool running;    /* state info, for cookie adding information */
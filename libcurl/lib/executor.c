@@ -0,0 +1,707 @@
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) 1998 - 2013, Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at http://curl.haxx.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ ***************************************************************************/
+
+#include "curl_setup.h"
+
+#ifdef HAVE_NETINET_IN_H
+#include <netinet/in.h>
+#endif
+#ifdef HAVE_ARPA_INET_H
+#include <arpa/inet.h>
+#endif
+
+#include <curl/curl.h>
+
+#include "urldata.h"
+#include "multihandle.h"
+#include "multiif.h"
+#include "hostip.h"
+#include "select.h"
+#include "nonblock.h"
+#include "rawstr.h"
+#include "curl_threads.h"
+
+#include "curl_memory.h"
+/* The last #include file should be: */
+#include "memdebug.h"
+
+#if defined(USE_THREADS_POSIX) || defined(USE_THREADS_WIN32)
+
+#define CURL_EXECUTOR_HANDLE 0x00e8ec07
+
+#define GOOD_EXECUTOR_HANDLE(x) \
+  ((x) && (((struct Curl_executor *)(x))->type == CURL_EXECUTOR_HANDLE))
+#define GOOD_EASY_HANDLE(x) \
+  ((x) && (((struct SessionHandle *)(x))->magic == CURLEASY_MAGIC_NUMBER))
+
+/*
+ * The queues between the application thread and the workers are stacks any
+ * number of threads push items onto and one thread takes all items off at
+ * once. That needs no more than atomic compare-and-swap and exchange of a
+ * pointer, and as items are never popped one by one the stacks are safe from
+ * the ABA problem. Where there are no such operations a mutex is used.
+ */
+#if defined(__GNUC__) && \
+  ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 1)))
+#define XQUEUE_CAS(p,o,n) __sync_val_compare_and_swap(p, o, n)
+#define XQUEUE_SWAP(p,n) __sync_lock_test_and_set(p, n)
+#elif defined(USE_THREADS_WIN32)
+#define XQUEUE_CAS(p,o,n) \
+  InterlockedCompareExchangePointer((PVOID volatile *)(p), n, o)
+#define XQUEUE_SWAP(p,n) \
+  InterlockedExchangePointer((PVOID volatile *)(p), n)
+#else
+#define XQUEUE_LOCKED
+#endif
+
+/* a transfer on its way to a worker and back */
+struct Curl_xitem {
+  struct Curl_xitem *next;
+  CURLMsg msg;
+};
+
+struct xqueue {
+  struct Curl_xitem *volatile head;
+#ifdef XQUEUE_LOCKED
+  curl_mutex_t mtx;
+#endif
+};
+
+struct Curl_xworker {
+  struct Curl_executor *executor;
+  struct Curl_multi *multi;
+  struct Curl_dnscache *hostcache; /* the one 'multi' came with */
+  curl_thread_t thread;
+  struct xqueue inbox;       /* easy handles to add to 'multi' */
+  curl_socket_t wakeup;      /* wakes the worker up when written to */
+  struct Curl_xitem stop;    /* put in the inbox to make the worker exit */
+};
+
+struct Curl_executor {
+  long type; /* set to CURL_EXECUTOR_HANDLE */
+  int nworkers;
+  struct Curl_xworker *workers;
+  bool started;              /* the worker threads have been started */
+  struct xqueue done;        /* completed transfers */
+  curl_socket_t wakeup;      /* wakes up curl_executor_wait() */
+
+  /* completed transfers taken off 'done', in the order they completed */
+  struct Curl_xitem *msgs;
+  struct Curl_xitem *msgstail;
+  int nmsgs;
+  struct Curl_xitem *lastmsg; /* the one curl_executor_info_read() returned */
+  int inflight;               /* handles not handed back yet */
+};
+
+static void xqueue_init(struct xqueue *q)
+{
+  q->head = NULL;
+#ifdef XQUEUE_LOCKED
+  Curl_mutex_init(&q->mtx);
+#endif
+}
+
+static void xqueue_destroy(struct xqueue *q)
+{
+#ifdef XQUEUE_LOCKED
+  Curl_mutex_destroy(&q->mtx);
+#else
+  (void)q;
+#endif
+}
+
+/* push an item, returns TRUE when the queue was empty before */
+static bool xqueue_push(struct xqueue *q, struct Curl_xitem *item)
+{
+  struct Curl_xitem *head;
+
+#ifdef XQUEUE_LOCKED
+  Curl_mutex_acquire(&q->mtx);
+  head = q->head;
+  item->next = head;
+  q->head = item;
+  Curl_mutex_release(&q->mtx);
+#else
+  /* guess an empty queue, every failed swap tells the real head */
+  head = NULL;
+  for(;;) {
+    struct Curl_xitem *prev;
+    item->next = head;
+    prev = XQUEUE_CAS(&q->head, head, item);
+    if(prev == head)
+      break;
+    head = prev;
+  }
+#endif
+
+  return head ? FALSE : TRUE;
+}
+
+/*
+ * Take all items off the queue. They are returned in the order they were
+ * pushed, with the last one in '*tail' and their number in '*count'.
+ */
+static struct Curl_xitem *xqueue_takeall(struct xqueue *q,
+                                         struct Curl_xitem **tail,
+                                         int *count)
+{
+  struct Curl_xitem *head;
+  struct Curl_xitem *list = NULL;
+
+#ifdef XQUEUE_LOCKED
+  Curl_mutex_acquire(&q->mtx);
+  head = q->head;
+  q->head = NULL;
+  Curl_mutex_release(&q->mtx);
+#else
+  head = XQUEUE_SWAP(&q->head, NULL);
+#endif
+
+  *tail = head;
+  *count = 0;
+  while(head) {
+    struct Curl_xitem *next = head->next;
+    head->next = list;
+    list = head;
+    head = next;
+    (*count)++;
+  }
+  return list;
+}
+
+/*
+ * A UDP socket connected to itself, for one thread to wake up another one
+ * that waits for sockets. Unlike a pipe it works the same with winsock.
+ */
+static curl_socket_t wakeup_open(void)
+{
+  struct sockaddr_in addr;
+  curl_socklen_t len = sizeof(addr);
+  curl_socket_t s = socket(AF_INET, SOCK_DGRAM, 0);
+
+  if(s == CURL_SOCKET_BAD)
+    return CURL_SOCKET_BAD;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+
+  if(bind(s, (struct sockaddr *)&addr, sizeof(addr)) ||
+     getsockname(s, (struct sockaddr *)&addr, &len) ||
+     connect(s, (struct sockaddr *)&addr, len) ||
+     curlx_nonblock(s, TRUE)) {
+    sclose(s);
+    return CURL_SOCKET_BAD;
+  }
+  return s;
+}
+
+static void wakeup_send(curl_socket_t s)
+{
+  /* when the socket buffer is full there are wakeups pending already */
+  (void)swrite(s, "", 1);
+}
+
+/* hand a transfer back to the application */
+static void finish(struct Curl_executor *x, struct Curl_xitem *item,
+                   CURLcode result)
+{
+  item->msg.msg = CURLMSG_DONE;
+  item->msg.data.result = result;
+  if(xqueue_push(&x->done, item))
+    wakeup_send(x->wakeup);
+}
+
+/*
+ * The worker thread. It adds the handles it gets to its multi handle, drives
+ * them with curl_multi_perform_events() and hands back completed ones, until
+ * it finds its 'stop' item in the inbox.
+ */
+static unsigned int CURL_STDCALL worker_run(void *arg)
+{
+  struct Curl_xworker *w = arg;
+  struct Curl_executor *x = w->executor;
+  bool stop = FALSE;
+
+  while(!stop) {
+    struct Curl_xitem *item;
+    struct Curl_xitem *tail;
+    CURLMsg *msg;
+    int running;
+    int count;
+
+    item = xqueue_takeall(&w->inbox, &tail, &count);
+    while(item) {
+      struct Curl_xitem *next = item->next;
+      if(item == &w->stop)
+        stop = TRUE;
+      else if(curl_multi_add_handle(w->multi, item->msg.easy_handle))
+        finish(x, item, CURLE_OUT_OF_MEMORY);
+      item = next;
+    }
+    if(stop)
+      break;
+
+    if(curl_multi_perform_events(w->multi, 1000, &running) > CURLM_OK)
+      /* don't spin on a failing event set */
+      Curl_wait_ms(100);
+
+    while((msg = curl_multi_info_read(w->multi, &count))) {
+      struct SessionHandle *data = msg->easy_handle;
+      CURLcode result = msg->data.result;
+
+      if(msg->msg != CURLMSG_DONE)
+        continue;
+
+      curl_multi_remove_handle(w->multi, data);
+      finish(x, data->xitem, result);
+    }
+  }
+
+  return 0;
+}
+
+/* give back handles that never completed */
+static void release_items(struct Curl_xitem *item)
+{
+  while(item) {
+    struct Curl_xitem *next = item->next;
+    struct SessionHandle *data = item->msg.easy_handle;
+    data->xitem = NULL;
+    free(item);
+    item = next;
+  }
+}
+
+static void executor_free(struct Curl_executor *x)
+{
+  struct Curl_xitem *tail;
+  int count;
+  int i;
+
+  for(i = 0; i < x->nworkers; i++) {
+    struct Curl_xworker *w = &x->workers[i];
+    struct SessionHandle *data;
+
+    release_items(xqueue_takeall(&w->inbox, &tail, &count));
+
+    if(w->multi) {
+      struct Curl_dnscache *shared = NULL;
+
+      /* The connections of the other workers may still use entries in the
+         shared DNS cache, so let the multi handle clean up the cache it came
+         with and only drop its reference to the shared one */
+      if(w->hostcache) {
+        shared = w->multi->hostcache;
+        w->multi->hostcache = w->hostcache;
+      }
+
+      /* the handles still in the multi handle keep their items */
+      for(data = w->multi->easyp; data; data = data->next) {
+        Curl_safefree(data->xitem);
+        if(shared && (data->dns.hostcache == shared))
+          data->dns.hostcache = w->hostcache;
+      }
+
+      curl_multi_cleanup(w->multi);
+      Curl_dnscache_destroy(shared);
+    }
+    if(w->wakeup != CURL_SOCKET_BAD)
+      sclose(w->wakeup);
+    xqueue_destroy(&w->inbox);
+  }
+
+  release_items(xqueue_takeall(&x->done, &tail, &count));
+  release_items(x->msgs);
+  Curl_safefree(x->lastmsg);
+  xqueue_destroy(&x->done);
+
+  if(x->wakeup != CURL_SOCKET_BAD)
+    sclose(x->wakeup);
+  Curl_safefree(x->workers);
+  free(x);
+}
+
+CURLX *curl_executor_init(int threads)
+{
+  struct Curl_executor *x;
+  struct Curl_dnscache *dnscache = NULL;
+  int i;
+
+  if(threads < 1)
+    return NULL;
+
+  x = calloc(1, sizeof(struct Curl_executor));
+  if(!x)
+    return NULL;
+
+  xqueue_init(&x->done);
+  x->wakeup = CURL_SOCKET_BAD;
+
+  x->workers = calloc(threads, sizeof(struct Curl_xworker));
+  if(!x->workers)
+    goto error;
+  x->nworkers = threads;
+  for(i = 0; i < threads; i++) {
+    struct Curl_xworker *w = &x->workers[i];
+    w->executor = x;
+    w->thread = curl_thread_t_null;
+    w->wakeup = CURL_SOCKET_BAD;
+    xqueue_init(&w->inbox);
+  }
+
+  x->wakeup = wakeup_open();
+  dnscache = Curl_mk_dnscache();
+  if((x->wakeup == CURL_SOCKET_BAD) || !dnscache)
+    goto error;
+
+  for(i = 0; i < threads; i++) {
+    struct Curl_xworker *w = &x->workers[i];
+
+    w->multi = curl_multi_init();
+    w->wakeup = wakeup_open();
+    if(!w->multi || (w->wakeup == CURL_SOCKET_BAD))
+      goto error;
+
+    w->multi->wakeup = w->wakeup;
+
+    /* all the workers use the same DNS cache */
+    w->hostcache = w->multi->hostcache;
+    Curl_dnscache_hold(dnscache);
+    w->multi->hostcache = dnscache;
+  }
+
+  /* the workers hold the cache now */
+  Curl_dnscache_destroy(dnscache);
+
+  x->type = CURL_EXECUTOR_HANDLE;
+  return x;
+
+  error:
+  Curl_dnscache_destroy(dnscache);
+  executor_free(x);
+  return NULL;
+}
+
+CURLMcode curl_executor_setopt(CURLX *executor, CURLMoption option, ...)
+{
+  struct Curl_executor *x = (struct Curl_executor *)executor;
+  CURLMcode res = CURLM_OK;
+  va_list param;
+  int i;
+
+  if(!GOOD_EXECUTOR_HANDLE(x))
+    return CURLM_BAD_HANDLE;
+
+  if(x->started)
+    /* the multi handles are in use by the workers */
+    return CURLM_BAD_HANDLE;
+
+  va_start(param, option);
+
+  switch(option) {
+  case CURLMOPT_SOCKETFUNCTION:
+  case CURLMOPT_SOCKETDATA:
+  case CURLMOPT_TIMERFUNCTION:
+  case CURLMOPT_TIMERDATA:
+    /* the workers drive their multi handles themselves */
+    res = CURLM_UNKNOWN_OPTION;
+    break;
+  default:
+    if(option < CURLOPTTYPE_OBJECTPOINT) {
+      long arg = va_arg(param, long);
+      for(i = 0; !res && (i < x->nworkers); i++)
+        res = curl_multi_setopt(x->workers[i].multi, option, arg);
+    }
+    else if(option < CURLOPTTYPE_FUNCTIONPOINT) {
+      void *arg = va_arg(param, void *);
+      for(i = 0; !res && (i < x->nworkers); i++)
+        res = curl_multi_setopt(x->workers[i].multi, option, arg);
+    }
+    else if(option >= CURLOPTTYPE_OFF_T) {
+      curl_off_t arg = va_arg(param, curl_off_t);
+      for(i = 0; !res && (i < x->nworkers); i++)
+        res = curl_multi_setopt(x->workers[i].multi, option, arg);
+    }
+    else
+      res = CURLM_UNKNOWN_OPTION;
+    break;
+  }
+
+  va_end(param);
+  return res;
+}
+
+/*
+ * Pick the worker for a handle by a hash of the host name it connects to, so
+ * that all transfers to a host use the same connection cache. The port is
+ * left out as connections to different ports of a host are often limited
+ * together.
+ */
+static int pick_worker(struct Curl_executor *x, struct SessionHandle *data)
+{
+  const char *p = data->set.str[STRING_PROXY];
+  const char *end;
+  const char *at;
+  unsigned int hash = 2166136261U;
+  bool bracket;
+
+  if(!p || !*p)
+    p = data->set.str[STRING_SET_URL];
+  if(!p)
+    return 0;
+
+  end = strstr(p, "://");
+  if(end)
+    p = end + 3;
+  end = p + strcspn(p, "/?#");
+
+  /* skip user name and password */
+  for(at = p; at < end; at++)
+    if(*at == '@')
+      p = at + 1;
+
+  /* the name ends at the port, but IPv6 addresses are in brackets */
+  bracket = (*p == '[') ? TRUE : FALSE;
+  for(; p < end; p++) {
+    if(*p == ']')
+      bracket = FALSE;
+    else if((*p == ':') && !bracket)
+      break;
+    hash ^= (unsigned char)Curl_raw_toupper(*p);
+    hash *= 16777619U;
+  }
+
+  return (int)(hash % (unsigned int)x->nworkers);
+}
+
+CURLMcode curl_executor_add_handle(CURLX *executor, CURL *curl_handle)
+{
+  struct Curl_executor *x = (struct Curl_executor *)executor;
+  struct SessionHandle *data = (struct SessionHandle *)curl_handle;
+  struct Curl_xworker *w;
+  struct Curl_xitem *item;
+  int i;
+
+  if(!GOOD_EXECUTOR_HANDLE(x))
+    return CURLM_BAD_HANDLE;
+
+  if(!GOOD_EASY_HANDLE(curl_handle))
+    return CURLM_BAD_EASY_HANDLE;
+
+  /* a handle can only be in one place at a time. Checking 'xitem' first
+     means 'multi' is only read while no worker has the handle */
+  if(data->xitem || data->multi)
+    return CURLM_BAD_EASY_HANDLE;
+
+  if(!x->started) {
+    x->started = TRUE;
+    for(i = 0; i < x->nworkers; i++) {
+      w = &x->workers[i];
+      if(w->thread == curl_thread_t_null)
+        w->thread = Curl_thread_create(worker_run, w);
+      if(w->thread == curl_thread_t_null) {
+        /* try again with the next handle */
+        x->started = FALSE;
+        return CURLM_OUT_OF_MEMORY;
+      }
+    }
+  }
+
+  item = calloc(1, sizeof(struct Curl_xitem));
+  if(!item)
+    return CURLM_OUT_OF_MEMORY;
+
+  item->msg.easy_handle = curl_handle;
+  data->xitem = item;
+  x->inflight++;
+
+  w = &x->workers[pick_worker(x, data)];
+  if(xqueue_push(&w->inbox, item))
+    wakeup_send(w->wakeup);
+
+  return CURLM_OK;
+}
+
+/* move the completed transfers over to the application's own list */
+static void collect(struct Curl_executor *x)
+{
+  struct Curl_xitem *tail;
+  struct Curl_xitem *list;
+  int count;
+
+  list = xqueue_takeall(&x->done, &tail, &count);
+  if(!list)
+    return;
+
+  if(x->msgstail)
+    x->msgstail->next = list;
+  else
+    x->msgs = list;
+  x->msgstail = tail;
+  x->nmsgs += count;
+}
+
+CURLMcode curl_executor_wait(CURLX *executor, int timeout_ms, int *ret)
+{
+  struct Curl_executor *x = (struct Curl_executor *)executor;
+  struct timeval start = Curl_tvnow();
+
+  if(!GOOD_EXECUTOR_HANDLE(x))
+    return CURLM_BAD_HANDLE;
+
+  for(;;) {
+    long left = -1;
+    int rc;
+
+    collect(x);
+    if(x->nmsgs || !x->inflight || !timeout_ms)
+      break;
+
+    if(timeout_ms > 0) {
+      left = timeout_ms - curlx_tvdiff(Curl_tvnow(), start);
+      if(left <= 0)
+        break;
+    }
+
+    rc = Curl_socket_check(x->wakeup, CURL_SOCKET_BAD, CURL_SOCKET_BAD,
+                           left);
+    if(rc < 0)
+      return CURLM_INTERNAL_ERROR;
+    if(rc)
+      Curl_wakeup_drain(x->wakeup);
+  }
+
+  if(ret)
+    *ret = x->nmsgs;
+
+  return CURLM_OK;
+}
+
+CURLMsg *curl_executor_info_read(CURLX *executor, int *msgs_in_queue)
+{
+  struct Curl_executor *x = (struct Curl_executor *)executor;
+  struct Curl_xitem *item;
+  struct SessionHandle *data;
+
+  *msgs_in_queue = 0; /* default to none */
+
+  if(!GOOD_EXECUTOR_HANDLE(x))
+    return NULL;
+
+  Curl_safefree(x->lastmsg);
+
+  collect(x);
+  item = x->msgs;
+  if(!item)
+    return NULL;
+
+  x->msgs = item->next;
+  if(!x->msgs)
+    x->msgstail = NULL;
+  x->nmsgs--;
+
+  /* the handle is the application's again */
+  data = item->msg.easy_handle;
+  data->xitem = NULL;
+  x->inflight--;
+
+  x->lastmsg = item;
+  *msgs_in_queue = x->nmsgs;
+
+  return &item->msg;
+}
+
+CURLMcode curl_executor_cleanup(CURLX *executor)
+{
+  struct Curl_executor *x = (struct Curl_executor *)executor;
+  int i;
+
+  if(!GOOD_EXECUTOR_HANDLE(x))
+    return CURLM_BAD_HANDLE;
+
+  x->type = 0; /* not good anymore */
+
+  for(i = 0; i < x->nworkers; i++) {
+    struct Curl_xworker *w = &x->workers[i];
+    if(w->thread != curl_thread_t_null) {
+      if(xqueue_push(&w->inbox, &w->stop))
+        wakeup_send(w->wakeup);
+    }
+  }
+  for(i = 0; i < x->nworkers; i++) {
+    struct Curl_xworker *w = &x->workers[i];
+    if(w->thread != curl_thread_t_null)
+      Curl_thread_join(&w->thread);
+  }
+
+  executor_free(x);
+  return CURLM_OK;
+}
+
+#else /* USE_THREADS_POSIX || USE_THREADS_WIN32 */
+
+/* without threads there are no executors */
+
+CURLX *curl_executor_init(int threads)
+{
+  (void)threads;
+  return NULL;
+}
+
+CURLMcode curl_executor_setopt(CURLX *executor, CURLMoption option, ...)
+{
+  (void)executor;
+  (void)option;
+  return CURLM_BAD_HANDLE;
+}
+
+CURLMcode curl_executor_add_handle(CURLX *executor, CURL *curl_handle)
+{
+  (void)executor;
+  (void)curl_handle;
+  return CURLM_BAD_HANDLE;
+}
+
+CURLMcode curl_executor_wait(CURLX *executor, int timeout_ms, int *ret)
+{
+  (void)executor;
+  (void)timeout_ms;
+  (void)ret;
+  return CURLM_BAD_HANDLE;
+}
+
+CURLMsg *curl_executor_info_read(CURLX *executor, int *msgs_in_queue)
+{
+  (void)executor;
+  *msgs_in_queue = 0;
+  return NULL;
+}
+
+CURLMcode curl_executor_cleanup(CURLX *executor)
+{
+  (void)executor;
+  return CURLM_BAD_HANDLE;
+}
+
+#endif /* USE_THREADS_POSIX || USE_THREADS_WIN32 */
@@ -31,6 +31,8 @@
 #include "sslgen.h"
 #include "connect.h" /* Curl_getconnectinfo() */
 #include "progress.h"
+#include "multihandle.h"
+#include "conncache.h"
 
 /* Make this the last #include */
 #include "memdebug.h"
@@ -70,6 +72,10 @@ CURLcode Curl_initinfo(struct SessionHandle *data)
   info->conn_primary_port = 0;
   info->conn_local_port = 0;
 
+  info->pipe_depth = 0;
+  info->pipe_wait = 0;
+  memset(&info->pipe, 0, sizeof(info->pipe));
+
   return CURLE_OK;
 }
 
@@ -122,6 +128,10 @@ static CURLcode getinfo_long(struct SessionHandle *data, CURLINFO info,
                              long *param_longp)
 {
   curl_socket_t sockfd;
+  struct Curl_dnscache *dnscache;
+  long dns_hits;
+  long dns_misses;
+  struct conncache *connc;
 
   union {
     unsigned long *to_ulong;
@@ -184,6 +194,42 @@ static CURLcode getinfo_long(struct SessionHandle *data, CURLINFO info,
     /* Return the local port of the most recent (primary) connection */
     *param_longp = data->info.conn_local_port;
     break;
+  case CURLINFO_DNS_CACHE_HITS:
+  case CURLINFO_DNS_CACHE_MISSES:
+    /* Return a counter of the DNS cache the handle uses, which counts the
+       lookups of all handles sharing that cache. After curl_easy_perform()
+       that is the cache of the handle's private multi handle. */
+    dnscache = data->dns.hostcache;
+    if(!dnscache && data->multi_easy)
+      dnscache = data->multi_easy->hostcache;
+    Curl_dnscache_stats(dnscache, &dns_hits, &dns_misses);
+    *param_longp = (info == CURLINFO_DNS_CACHE_HITS) ? dns_hits : dns_misses;
+    break;
+  case CURLINFO_CONN_CACHE_REUSED:
+  case CURLINFO_CONN_CACHE_CONNECTS:
+  case CURLINFO_CONN_CACHE_DEAD:
+    /* Counters of the connection cache the handle uses, in the same way as
+       for the DNS cache above */
+    connc = data->state.conn_cache;
+    if(!connc && data->multi_easy)
+      connc = data->multi_easy->conn_cache;
+    if(!connc)
+      *param_longp = 0;
+    else if(info == CURLINFO_CONN_CACHE_REUSED)
+      *param_longp = connc->reused;
+    else if(info == CURLINFO_CONN_CACHE_CONNECTS)
+      *param_longp = connc->connects;
+    else
+      *param_longp = connc->dead_on_reuse;
+    break;
+  case CURLINFO_PIPELINE_DEPTH:
+    /* responses that were ahead of the last one on its connection */
+    *param_longp = data->info.pipe_depth;
+    break;
+  case CURLINFO_PIPELINE_REQUESTS:
+    /* responses the last one's connection had received by then */
+    *param_longp = data->info.pipe.requests;
+    break;
   case CURLINFO_CONDITION_UNMET:
     /* return if the condition prevented the document to get transferred */
     *param_longp = data->info.timecond ? 1L : 0L;
@@ -249,6 +295,15 @@ static CURLcode getinfo_double(struct SessionHandle *data, CURLINFO info,
   case CURLINFO_REDIRECT_TIME:
     *param_doublep =  data->progress.t_redirect;
     break;
+  case CURLINFO_PIPELINE_WAIT:
+    *param_doublep = (double)data->info.pipe_wait / 1000.0;
+    break;
+  case CURLINFO_PIPELINE_RTT:
+    *param_doublep = (double)data->info.pipe.rtt / 8000.0;
+    break;
+  case CURLINFO_PIPELINE_SPEED:
+    *param_doublep = (double)data->info.pipe.rate;
+    break;
 
   default:
     return CURLE_BAD_FUNCTION_ARGUMENT;
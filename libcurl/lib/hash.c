@@ -23,7 +23,6 @@
 #include "curl_setup.h"
 
 #include "hash.h"
-#include "llist.h"
 
 #define _MPRINTF_REPLACE /* use our functions only */
 #include <curl/mprintf.h>
@@ -32,22 +31,36 @@
 /* The last #include file should be: */
 #include "memdebug.h"
 
-static void
-hash_element_dtor(void *user, void *element)
-{
-  struct curl_hash *h = (struct curl_hash *) user;
-  struct curl_hash_element *e = (struct curl_hash_element *) element;
+/* Smallest table we use */
+#define HASH_MIN_SLOTS 8
 
-  Curl_safefree(e->key);
+/* The key of a slot whose element has been removed. Lookups keep probing
+   past such slots, inserts may reuse them. */
+static char hash_deleted_key;
+#define DELETED_KEY (&hash_deleted_key)
 
-  if(e->ptr) {
-    h->dtor(e->ptr);
-    e->ptr = NULL;
-  }
+#define SLOT_IN_USE(he) ((he)->key && ((he)->key != DELETED_KEY))
 
-  e->key_len = 0;
+/*
+ * Release the key of an element in use and turn the slot into a removal
+ * marker. Returns the element's data, for the caller to pass to the
+ * destructor once the table is consistent again.
+ */
+static void *
+hash_element_remove(struct curl_hash *h, struct curl_hash_element *he)
+{
+  void *ptr = he->ptr;
 
-  free(e);
+  if(he->key != he->keybuf)
+    free(he->key);
+  he->key = DELETED_KEY;
+  he->key_len = 0;
+  he->ptr = NULL;
+
+  --h->size;
+  ++h->deleted;
+
+  return ptr;
 }
 
 /* return 1 on error, 0 is fine */
@@ -58,39 +71,30 @@ Curl_hash_init(struct curl_hash *h,
                comp_function comparator,
                curl_hash_dtor dtor)
 {
-  int i;
+  int size = HASH_MIN_SLOTS;
 
   if(!slots || !hfunc || !comparator ||!dtor) {
     return 1; /* failure */
   }
 
+  /* 'slots' is the number of entries the user expects; round it up to a
+     power of two */
+  while(size < slots)
+    size <<= 1;
+
   h->hash_func = hfunc;
   h->comp_func = comparator;
   h->dtor = dtor;
   h->size = 0;
-  h->slots = slots;
+  h->deleted = 0;
+  h->slots = size;
 
-  h->table = malloc(slots * sizeof(struct curl_llist *));
-  if(h->table) {
-    for(i = 0; i < slots; ++i) {
-      h->table[i] = Curl_llist_alloc((curl_llist_dtor) hash_element_dtor);
-      if(!h->table[i]) {
-        while(i--) {
-          Curl_llist_destroy(h->table[i], NULL);
-          h->table[i] = NULL;
-        }
-        free(h->table);
-        h->table = NULL;
-        h->slots = 0;
-        return 1; /* failure */
-      }
-    }
-    return 0; /* fine */
-  }
-  else {
+  h->table = calloc(size, sizeof(struct curl_hash_element));
+  if(!h->table) {
     h->slots = 0;
     return 1; /* failure */
   }
+  return 0; /* fine */
 }
 
 struct curl_hash *
@@ -117,33 +121,70 @@ Curl_hash_alloc(int slots,
   return h;
 }
 
-
-
+/*
+ * Find the element with the given key, or NULL.
+ */
 static struct curl_hash_element *
-mk_hash_element(const void *key, size_t key_len, const void *p)
+hash_find(struct curl_hash *h, void *key, size_t key_len)
 {
-  struct curl_hash_element *he = malloc(sizeof(struct curl_hash_element));
-
-  if(he) {
-    void *dupkey = malloc(key_len);
-    if(dupkey) {
-      /* copy the key */
-      memcpy(dupkey, key, key_len);
-
-      he->key = dupkey;
-      he->key_len = key_len;
-      he->ptr = (void *) p;
-    }
-    else {
-      /* failed to duplicate the key, free memory and fail */
-      free(he);
-      he = NULL;
-    }
+  size_t mask = (size_t)h->slots - 1;
+  size_t i = h->hash_func(key, key_len, (size_t)h->slots);
+
+  /* the table always has free slots, so this ends */
+  for(;;) {
+    struct curl_hash_element *he = &h->table[i];
+
+    if(!he->key)
+      return NULL;
+    if((he->key != DELETED_KEY) &&
+       h->comp_func(he->key, he->key_len, key, key_len))
+      return he;
+    i = (i + 1) & mask;
   }
-  return he;
 }
 
-#define FETCH_LIST(x,y,z) x->table[x->hash_func(y, z, x->slots)]
+/*
+ * Move all elements into a new table of 'slots' slots, dropping the removal
+ * markers on the way. Returns non-zero on failure, which leaves the hash
+ * untouched.
+ */
+static int
+hash_rebuild(struct curl_hash *h, int slots)
+{
+  struct curl_hash_element *old = h->table;
+  int oldslots = h->slots;
+  size_t mask = (size_t)slots - 1;
+  int n;
+
+  h->table = calloc(slots, sizeof(struct curl_hash_element));
+  if(!h->table) {
+    h->table = old;
+    return 1;
+  }
+  h->slots = slots;
+  h->deleted = 0;
+
+  for(n = 0; n < oldslots; n++) {
+    struct curl_hash_element *he = &old[n];
+    struct curl_hash_element *to;
+    size_t i;
+
+    if(!SLOT_IN_USE(he))
+      continue;
+
+    i = h->hash_func(he->key, he->key_len, (size_t)slots);
+    while(h->table[i].key)
+      i = (i + 1) & mask;
+
+    to = &h->table[i];
+    *to = *he;
+    if(he->key == he->keybuf)
+      to->key = to->keybuf;
+  }
+
+  free(old);
+  return 0;
+}
 
 /* Insert the data in the hash. If there already was a match in the hash,
  * that data is replaced.
@@ -153,52 +194,66 @@ mk_hash_element(const void *key, size_t key_len, const void *p)
 void *
 Curl_hash_add(struct curl_hash *h, void *key, size_t key_len, void *p)
 {
-  struct curl_hash_element  *he;
-  struct curl_llist_element *le;
-  struct curl_llist *l = FETCH_LIST (h, key, key_len);
-
-  for(le = l->head; le; le = le->next) {
-    he = (struct curl_hash_element *) le->ptr;
-    if(h->comp_func(he->key, he->key_len, key, key_len)) {
-      Curl_llist_remove(l, le, (void *)h);
-      --h->size;
-      break;
-    }
-  }
+  struct curl_hash_element *he;
+  char *keycopy;
+  size_t mask;
+  size_t i;
 
-  he = mk_hash_element(key, key_len, p);
+  he = hash_find(h, key, key_len);
   if(he) {
-    if(Curl_llist_insert_next(l, l->tail, he)) {
-      ++h->size;
-      return p; /* return the new entry */
-    }
-    /*
-     * Couldn't insert it, destroy the 'he' element and the key again. We
-     * don't call hash_element_dtor() since that would also call the
-     * "destructor" for the actual data 'p'. When we fail, we shall not touch
-     * that data.
-     */
-    free(he->key);
-    free(he);
+    void *old = he->ptr;
+
+    he->ptr = p;
+    h->dtor(old);
+    return p; /* return the new entry */
   }
 
-  return NULL; /* failure */
+  /* keep at least a quarter of the slots free, so that probe sequences
+     stay short */
+  if((h->size + h->deleted + 1) * 4 > (size_t)h->slots * 3) {
+    /* grow if the entries themselves need the room, else just sweep out
+       the removal markers */
+    int slots = ((h->size + 1) * 2 > (size_t)h->slots) ?
+      h->slots * 2 : h->slots;
+
+    if(hash_rebuild(h, slots))
+      return NULL; /* failure */
+  }
+
+  mask = (size_t)h->slots - 1;
+  i = h->hash_func(key, key_len, (size_t)h->slots);
+  while(SLOT_IN_USE(&h->table[i]))
+    i = (i + 1) & mask;
+  he = &h->table[i];
+
+  if(key_len <= CURL_HASH_INLINE_KEY)
+    keycopy = he->keybuf;
+  else {
+    keycopy = malloc(key_len);
+    if(!keycopy)
+      return NULL; /* failure */
+  }
+  memcpy(keycopy, key, key_len);
+
+  if(he->key == DELETED_KEY)
+    /* reusing the slot of a removed element */
+    --h->deleted;
+  he->key = keycopy;
+  he->key_len = key_len;
+  he->ptr = p;
+  ++h->size;
+
+  return p; /* return the new entry */
 }
 
 /* remove the identified hash entry, returns non-zero on failure */
 int Curl_hash_delete(struct curl_hash *h, void *key, size_t key_len)
 {
-  struct curl_llist_element *le;
-  struct curl_hash_element  *he;
-  struct curl_llist *l = FETCH_LIST(h, key, key_len);
-
-  for(le = l->head; le; le = le->next) {
-    he = le->ptr;
-    if(h->comp_func(he->key, he->key_len, key, key_len)) {
-      Curl_llist_remove(l, le, (void *) h);
-      --h->size;
-      return 0;
-    }
+  struct curl_hash_element *he = hash_find(h, key, key_len);
+
+  if(he) {
+    h->dtor(hash_element_remove(h, he));
+    return 0;
   }
   return 1;
 }
@@ -206,18 +261,12 @@ int Curl_hash_delete(struct curl_hash *h, void *key, size_t key_len)
 void *
 Curl_hash_pick(struct curl_hash *h, void *key, size_t key_len)
 {
-  struct curl_llist_element *le;
-  struct curl_hash_element  *he;
-  struct curl_llist *l;
+  struct curl_hash_element *he;
 
   if(h) {
-    l = FETCH_LIST(h, key, key_len);
-    for(le = l->head; le; le = le->next) {
-      he = le->ptr;
-      if(h->comp_func(he->key, he->key_len, key, key_len)) {
-        return he->ptr;
-      }
-    }
+    he = hash_find(h, key, key_len);
+    if(he)
+      return he->ptr;
   }
 
   return NULL;
@@ -225,19 +274,14 @@ Curl_hash_pick(struct curl_hash *h, void *key, size_t key_len)
 
 #if defined(DEBUGBUILD) && defined(AGGRESIVE_TEST)
 void
-Curl_hash_apply(curl_hash *h, void *user,
+Curl_hash_apply(struct curl_hash *h, void *user,
                 void (*cb)(void *user, void *ptr))
 {
-  struct curl_llist_element  *le;
-  int                  i;
+  int i;
 
   for(i = 0; i < h->slots; ++i) {
-    for(le = (h->table[i])->head;
-        le;
-        le = le->next) {
-      curl_hash_element *el = le->ptr;
-      cb(user, el->ptr);
-    }
+    if(SLOT_IN_USE(&h->table[i]))
+      cb(user, h->table[i].ptr);
   }
 }
 #endif
@@ -248,12 +292,15 @@ Curl_hash_clean(struct curl_hash *h)
   int i;
 
   for(i = 0; i < h->slots; ++i) {
-    Curl_llist_destroy(h->table[i], (void *) h);
-    h->table[i] = NULL;
+    struct curl_hash_element *he = &h->table[i];
+
+    if(SLOT_IN_USE(he))
+      h->dtor(hash_element_remove(h, he));
   }
 
   Curl_safefree(h->table);
   h->size = 0;
+  h->deleted = 0;
   h->slots = 0;
 }
 
@@ -261,27 +308,17 @@ void
 Curl_hash_clean_with_criterium(struct curl_hash *h, void *user,
                                int (*comp)(void *, void *))
 {
-  struct curl_llist_element *le;
-  struct curl_llist_element *lnext;
-  struct curl_llist *list;
   int i;
 
   if(!h)
     return;
 
   for(i = 0; i < h->slots; ++i) {
-    list = h->table[i];
-    le = list->head; /* get first list entry */
-    while(le) {
-      struct curl_hash_element *he = le->ptr;
-      lnext = le->next;
-      /* ask the callback function if we shall remove this entry or not */
-      if(comp(user, he->ptr)) {
-        Curl_llist_remove(list, le, (void *) h);
-        --h->size; /* one less entry in the hash now */
-      }
-      le = lnext;
-    }
+    struct curl_hash_element *he = &h->table[i];
+
+    /* ask the callback function if we shall remove this entry or not */
+    if(SLOT_IN_USE(he) && comp(user, he->ptr))
+      h->dtor(hash_element_remove(h, he));
   }
 }
 
@@ -296,18 +333,26 @@ Curl_hash_destroy(struct curl_hash *h)
   free(h);
 }
 
+/*
+ * FNV-1a over the key, with a final mix so that the low bits the table uses
+ * depend on all of the key.
+ */
 size_t Curl_hash_str(void* key, size_t key_length, size_t slots_num)
 {
-  const char* key_str = (const char *) key;
-  const char *end = key_str + key_length;
-  unsigned long h = 5381;
+  const unsigned char *key_str = (const unsigned char *) key;
+  const unsigned char *end = key_str + key_length;
+  unsigned int h = 2166136261U;
 
   while(key_str < end) {
-    h += h << 5;
-    h ^= (unsigned long) *key_str++;
+    h ^= *key_str++;
+    h *= 16777619U;
   }
 
-  return (h % slots_num);
+  h ^= h >> 16;
+  h *= 0x85ebca6bU;
+  h ^= h >> 13;
+
+  return (h & (slots_num - 1));
 }
 
 size_t Curl_str_key_compare(void*k1, size_t key1_len, void*k2, size_t key2_len)
@@ -329,38 +374,21 @@ void Curl_hash_start_iterate(struct curl_hash *hash,
 {
   iter->hash = hash;
   iter->slot_index = 0;
-  iter->current_element = NULL;
 }
 
 struct curl_hash_element *
 Curl_hash_next_element(struct curl_hash_iterator *iter)
 {
-  int i;
   struct curl_hash *h = iter->hash;
 
-  /* Get the next element in the current list, if any */
-  if(iter->current_element)
-    iter->current_element = iter->current_element->next;
-
-  /* If we have reached the end of the list, find the next one */
-  if(!iter->current_element) {
-    for(i = iter->slot_index;i < h->slots;i++) {
-      if(h->table[i]->head) {
-        iter->current_element = h->table[i]->head;
-        iter->slot_index = i+1;
-        break;
-      }
-    }
-  }
+  while(iter->slot_index < h->slots) {
+    struct curl_hash_element *he = &h->table[iter->slot_index++];
 
-  if(iter->current_element) {
-    struct curl_hash_element *he = iter->current_element->ptr;
-    return he;
-  }
-  else {
-    iter->current_element = NULL;
-    return NULL;
+    if(SLOT_IN_USE(he))
+      return he;
   }
+
+  return NULL;
 }
 
 #if 0 /* useful function for debugging hashes and their contents */
@@ -369,7 +397,6 @@ void Curl_hash_print(struct curl_hash *h,
 {
   struct curl_hash_iterator iter;
   struct curl_hash_element *he;
-  int last_index = -1;
 
   if(!h)
     return;
@@ -380,21 +407,16 @@ void Curl_hash_print(struct curl_hash *h,
 
   he = Curl_hash_next_element(&iter);
   while(he) {
-    if(iter.slot_index != last_index) {
-      fprintf(stderr, "index %d:", iter.slot_index);
-      if(last_index >= 0) {
-        fprintf(stderr, "\n");
-      }
-      last_index = iter.slot_index;
-    }
+    fprintf(stderr, "index %d:", iter.slot_index - 1);
 
     if(func)
       func(he->ptr);
     else
       fprintf(stderr, " [%p]", (void *)he->ptr);
 
+    fprintf(stderr, "\n");
+
     he = Curl_hash_next_element(&iter);
   }
-  fprintf(stderr, "\n");
 }
 #endif
@@ -28,7 +28,8 @@
 
 #include "llist.h"
 
-/* Hash function prototype */
+/* Hash function prototype. The table size 'slots_num' is always a power of
+   two and the returned value must be less than it. */
 typedef size_t (*hash_function) (void* key,
                                  size_t key_length,
                                  size_t slots_num);
@@ -43,8 +44,18 @@ typedef size_t (*comp_function) (void* key1,
 
 typedef void (*curl_hash_dtor)(void *);
 
+/* Keys up to this size are stored inside the element, longer keys are
+   copied to memory of their own. */
+#define CURL_HASH_INLINE_KEY 40
+
+/*
+ * The hash is an open addressing table with linear probing. It grows when
+ * three quarters of it is used up. Removed elements leave a marker in their
+ * slot until the table is rebuilt, so removing elements, including the one
+ * just returned, while iterating is fine. Adding elements is not.
+ */
 struct curl_hash {
-  struct curl_llist **table;
+  struct curl_hash_element *table;
 
   /* Hash function to be used for this hash table */
   hash_function hash_func;
@@ -52,20 +63,22 @@ struct curl_hash {
   /* Comparator function to compare keys */
   comp_function comp_func;
   curl_hash_dtor   dtor;
-  int slots;
-  size_t size;
+  int slots;      /* number of elements in 'table' */
+  size_t size;    /* number of entries */
+  size_t deleted; /* number of slots holding a removal marker */
 };
 
 struct curl_hash_element {
   void   *ptr;
-  char   *key;
+  char   *key;    /* NULL for a free slot, else 'keybuf' or an allocated
+                     copy of a longer key */
   size_t key_len;
+  char   keybuf[CURL_HASH_INLINE_KEY];
 };
 
 struct curl_hash_iterator {
   struct curl_hash *hash;
   int slot_index;
-  struct curl_llist_element *current_element;
 };
 
 int Curl_hash_init(struct curl_hash *h,
@@ -66,7 +66,7 @@
  *
  * If the status argument is CURL_ASYNC_SUCCESS, this function takes
  * ownership of the Curl_addrinfo passed, storing the resolved data
- * in the DNS cache.
+ * in the DNS cache. Otherwise a negative entry is stored.
  *
  * The storage operation locks and unlocks the DNS cache.
  */
@@ -81,12 +81,7 @@ CURLcode Curl_addrinfo_callback(struct connectdata *conn,
 
   if(CURL_ASYNC_SUCCESS == status) {
     if(ai) {
-      struct SessionHandle *data = conn->data;
-
-      if(data->share)
-        Curl_share_lock(data, CURL_LOCK_DATA_DNS, CURL_LOCK_ACCESS_SINGLE);
-
-      dns = Curl_cache_addr(data, ai,
+      dns = Curl_cache_addr(conn->data, ai,
                             conn->async.hostname,
                             conn->async.port);
       if(!dns) {
@@ -94,14 +89,14 @@ CURLcode Curl_addrinfo_callback(struct connectdata *conn,
         Curl_freeaddrinfo(ai);
         rc = CURLE_OUT_OF_MEMORY;
       }
-
-      if(data->share)
-        Curl_share_unlock(data, CURL_LOCK_DATA_DNS);
     }
     else {
       rc = CURLE_OUT_OF_MEMORY;
     }
   }
+  else
+    /* the name didn't resolve, remember that for a little while */
+    Curl_cache_negative(conn->data, conn->async.hostname, conn->async.port);
 
   conn->async.dns = dns;
 
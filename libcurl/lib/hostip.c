@@ -47,6 +47,10 @@
 #include <process.h>
 #endif
 
+#if defined(USE_THREADS_POSIX) && defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#endif
+
 #include "urldata.h"
 #include "sendf.h"
 #include "hostip.h"
@@ -56,6 +60,7 @@
 #include "url.h"
 #include "inet_ntop.h"
 #include "warnless.h"
+#include "curl_threads.h"
 
 #define _MPRINTF_REPLACE /* use our functions only */
 #include <curl/mprintf.h>
@@ -109,9 +114,36 @@
  * CURLRES_* defines based on the config*.h and curl_setup.h defines.
  */
 
-/* These two symbols are for the global DNS cache */
-static struct curl_hash hostname_cache;
-static int host_cache_initialized;
+#if defined(USE_THREADS_POSIX) || defined(USE_THREADS_WIN32)
+/* the cache does its own locking, the share lock callbacks are not used */
+#define DNSCACHE_MUTEX
+#endif
+
+/*
+ * A DNS cache is split up in CURL_DNSCACHE_SHARDS shards, each a hash table
+ * of its own with its own lock. A name is always stored in the same shard,
+ * picked by a hash of its id string, so a lookup only ever locks one shard.
+ */
+struct dnscache_shard {
+  struct curl_hash hash;
+  time_t nextprune;   /* earliest expiry of an entry in here, 0 for none */
+  long hits;          /* lookups answered from the cache */
+  long misses;        /* lookups that had to resolve */
+#ifdef DNSCACHE_MUTEX
+  curl_mutex_t mtx;
+#endif
+};
+
+struct Curl_dnscache {
+  struct dnscache_shard shard[CURL_DNSCACHE_SHARDS];
+  long refs;          /* the owner plus every running prefetch */
+#ifdef DNSCACHE_MUTEX
+  curl_mutex_t mtx;   /* protects 'refs' */
+#endif
+};
+
+/* The global DNS cache */
+static struct Curl_dnscache *hostname_cache;
 
 static void freednsentry(void *freethis);
 
@@ -120,18 +152,13 @@ static void freednsentry(void *freethis);
  * Global DNS cache is general badness. Do not use. This will be removed in
  * a future version. Use the share interface instead!
  *
- * Returns a struct curl_hash pointer on success, NULL on failure.
+ * Returns a struct Curl_dnscache pointer on success, NULL on failure.
  */
-struct curl_hash *Curl_global_host_cache_init(void)
+struct Curl_dnscache *Curl_global_host_cache_init(void)
 {
-  int rc = 0;
-  if(!host_cache_initialized) {
-    rc = Curl_hash_init(&hostname_cache, 7, Curl_hash_str,
-                        Curl_str_key_compare, freednsentry);
-    if(!rc)
-      host_cache_initialized = 1;
-  }
-  return rc?NULL:&hostname_cache;
+  if(!hostname_cache)
+    hostname_cache = Curl_mk_dnscache();
+  return hostname_cache;
 }
 
 /*
@@ -139,16 +166,17 @@ struct curl_hash *Curl_global_host_cache_init(void)
  */
 void Curl_global_host_cache_dtor(void)
 {
-  if(host_cache_initialized) {
+  if(hostname_cache) {
     /* first make sure that any custom "CURLOPT_RESOLVE" names are
        cleared off */
-    Curl_hostcache_clean(NULL, &hostname_cache);
-    /* then free the remaining hash completely */
-    Curl_hash_clean(&hostname_cache);
-    host_cache_initialized = 0;
+    Curl_hostcache_clean(NULL, hostname_cache);
+    /* then free the remaining cache completely */
+    Curl_dnscache_destroy(hostname_cache);
+    hostname_cache = NULL;
   }
 }
 
+
 /*
  * Return # of adresses in a Curl_addrinfo struct
  */
@@ -218,14 +246,59 @@ create_hostcache_id(const char *name, int port)
   return id;
 }
 
+/*
+ * Return the shard of the cache that holds the given hostcache id.
+ */
+static struct dnscache_shard *
+cache_shard(struct Curl_dnscache *cache, const char *id)
+{
+  /* FNV-1a, unrelated to the hash the shard tables use internally */
+  unsigned int h = 2166136261U;
+
+  while(*id) {
+    h ^= (unsigned char)*id++;
+    h *= 16777619U;
+  }
+  return &cache->shard[h % CURL_DNSCACHE_SHARDS];
+}
+
+/*
+ * Lock and unlock one shard. Without thread support the cache is protected
+ * by the share lock callbacks, just like all other shared data.
+ */
+static void shard_lock(struct SessionHandle *data, struct dnscache_shard *sh)
+{
+#ifdef DNSCACHE_MUTEX
+  (void)data;
+  Curl_mutex_acquire(&sh->mtx);
+#else
+  (void)sh;
+  if(data && data->share)
+    Curl_share_lock(data, CURL_LOCK_DATA_DNS, CURL_LOCK_ACCESS_SINGLE);
+#endif
+}
+
+static void shard_unlock(struct SessionHandle *data,
+                         struct dnscache_shard *sh)
+{
+#ifdef DNSCACHE_MUTEX
+  (void)data;
+  Curl_mutex_release(&sh->mtx);
+#else
+  (void)sh;
+  if(data && data->share)
+    Curl_share_unlock(data, CURL_LOCK_DATA_DNS);
+#endif
+}
+
 struct hostcache_prune_data {
-  long cache_timeout;
   time_t now;
+  time_t nextprune; /* earliest expiry among the entries that are kept */
 };
 
 /*
- * This function is set as a callback to be called for every entry in the DNS
- * cache when we want to prune old unused entries.
+ * This function is set as a callback to be called for every entry in a DNS
+ * cache shard when we want to prune expired entries.
  *
  * Returning non-zero means remove the entry, return 0 to keep it in the
  * cache.
@@ -237,78 +310,108 @@ hostcache_timestamp_remove(void *datap, void *hc)
     (struct hostcache_prune_data *) datap;
   struct Curl_dns_entry *c = (struct Curl_dns_entry *) hc;
 
-  return (data->now - c->timestamp >= data->cache_timeout);
+  if(!c->expires)
+    return 0; /* cached forever */
+
+  if(data->now >= c->expires)
+    return 1;
+
+  if(!data->nextprune || (c->expires < data->nextprune))
+    data->nextprune = c->expires;
+  return 0;
 }
 
 /*
- * Prune the DNS cache. This assumes that a lock has already been taken.
+ * Prune a DNS cache shard. This assumes that a lock has already been taken.
  */
 static void
-hostcache_prune(struct curl_hash *hostcache, long cache_timeout, time_t now)
+hostcache_prune(struct dnscache_shard *sh, time_t now)
 {
   struct hostcache_prune_data user;
 
-  user.cache_timeout = cache_timeout;
   user.now = now;
+  user.nextprune = 0;
 
-  Curl_hash_clean_with_criterium(hostcache,
+  Curl_hash_clean_with_criterium(&sh->hash,
                                  (void *) &user,
                                  hostcache_timestamp_remove);
+
+  sh->nextprune = user.nextprune;
 }
 
 /*
  * Library-wide function for pruning the DNS cache. This function takes and
- * returns the appropriate locks.
+ * returns the appropriate locks. Shards in which nothing has expired yet are
+ * not scanned.
  */
 void Curl_hostcache_prune(struct SessionHandle *data)
 {
+  struct Curl_dnscache *cache = data->dns.hostcache;
   time_t now;
+  int i;
 
-  if((data->set.dns_cache_timeout == -1) || !data->dns.hostcache)
-    /* cache forever means never prune, and NULL hostcache means
-       we can't do it */
+  if(!cache)
+    /* NULL hostcache means we can't do it */
     return;
 
-  if(data->share)
-    Curl_share_lock(data, CURL_LOCK_DATA_DNS, CURL_LOCK_ACCESS_SINGLE);
-
   time(&now);
 
-  /* Remove outdated and unused entries from the hostcache */
-  hostcache_prune(data->dns.hostcache,
-                  data->set.dns_cache_timeout,
-                  now);
+  for(i = 0; i < CURL_DNSCACHE_SHARDS; i++) {
+    struct dnscache_shard *sh = &cache->shard[i];
 
-  if(data->share)
-    Curl_share_unlock(data, CURL_LOCK_DATA_DNS);
+    shard_lock(data, sh);
+    /* Remove outdated and unused entries from the shard */
+    if(sh->nextprune && (now >= sh->nextprune))
+      hostcache_prune(sh, now);
+    shard_unlock(data, sh);
+  }
 }
 
 /*
- * Check if the entry should be pruned. Assumes a locked cache.
+ * Check if an entry found in the cache is too old for this handle to use:
+ * either it has passed its own expiry time, or it is older than the
+ * CURLOPT_DNS_CACHE_TIMEOUT of the handle asking.
  */
-static int
-remove_entry_if_stale(struct SessionHandle *data, struct Curl_dns_entry *dns)
+static bool
+entry_is_stale(struct SessionHandle *data, struct Curl_dns_entry *dns,
+               time_t now)
 {
-  struct hostcache_prune_data user;
-
-  if(!dns || (data->set.dns_cache_timeout == -1) || !data->dns.hostcache)
-    /* cache forever means never prune, and NULL hostcache means
-       we can't do it */
-    return 0;
+  if(dns->expires && (now >= dns->expires))
+    return TRUE;
 
-  time(&user.now);
-  user.cache_timeout = data->set.dns_cache_timeout;
+  return (data->set.dns_cache_timeout != -1) &&
+    (now - dns->timestamp >= data->set.dns_cache_timeout);
+}
 
-  if(!hostcache_timestamp_remove(&user,dns) )
-    return 0;
+/*
+ * Check if it is time to refresh an entry in the background: it is in the
+ * last fifth of its lifetime and nobody has started refreshing it yet.
+ */
+static bool prefetch_due(struct Curl_dns_entry *dns, time_t now)
+{
+  time_t window;
 
-  Curl_hash_clean_with_criterium(data->dns.hostcache,
-                                 (void *) &user,
-                                 hostcache_timestamp_remove);
+  if(!dns->addr || !dns->expires || dns->prefetch)
+    return FALSE;
 
-  return 1;
+  window = (dns->expires - dns->timestamp) / 5;
+  return window && (now >= dns->expires - window);
 }
 
+/*
+ * Curl_dnscache_hold() takes another reference to the cache.
+ * Curl_dnscache_destroy() drops one.
+ */
+void Curl_dnscache_hold(struct Curl_dnscache *cache)
+{
+#ifdef DNSCACHE_MUTEX
+  Curl_mutex_acquire(&cache->mtx);
+#endif
+  cache->refs++;
+#ifdef DNSCACHE_MUTEX
+  Curl_mutex_release(&cache->mtx);
+#endif
+}
 
 #ifdef HAVE_SIGSETJMP
 /* Beware this is a global and unique instance. This is used to store the
@@ -318,6 +421,44 @@ sigjmp_buf curl_jmpenv;
 #endif
 
 
+/*
+ * Store 'addr' (NULL for a negative entry) under 'entry_id' in the shard,
+ * replacing any entry already there. The entry expires 'ttl' seconds from
+ * now, or never if 'ttl' is negative. Assumes the shard is locked.
+ */
+static struct Curl_dns_entry *
+cache_add(struct dnscache_shard *sh, Curl_addrinfo *addr,
+          char *entry_id, long ttl)
+{
+  struct Curl_dns_entry *dns;
+
+  /* Create a new cache entry */
+  dns = calloc(1, sizeof(struct Curl_dns_entry));
+  if(!dns)
+    return NULL;
+
+  dns->inuse = 0;   /* init to not used */
+  dns->addr = addr; /* this is the address(es) */
+  dns->shard = sh;
+  time(&dns->timestamp);
+  if(dns->timestamp == 0)
+    dns->timestamp = 1;   /* zero indicates that entry isn't in hash table */
+
+  if(ttl >= 0) {
+    dns->expires = dns->timestamp + ttl;
+    if(!sh->nextprune || (dns->expires < sh->nextprune))
+      sh->nextprune = dns->expires;
+  }
+
+  /* Store the resolved data in our DNS cache. */
+  if(!Curl_hash_add(&sh->hash, entry_id, strlen(entry_id)+1, (void *)dns)) {
+    free(dns);
+    return NULL;
+  }
+
+  return dns;
+}
+
 /*
  * Curl_cache_addr() stores a 'Curl_addrinfo' struct in the DNS cache.
  *
@@ -325,6 +466,9 @@ sigjmp_buf curl_jmpenv;
  * address, we call this function to store the information in the dns
  * cache etc
  *
+ * The entry lives for the CURLOPT_DNS_CACHE_TIMEOUT of the handle. This
+ * function takes and returns the appropriate locks.
+ *
  * Returns the Curl_dns_entry entry pointer or NULL if the storage failed.
  */
 struct Curl_dns_entry *
@@ -334,41 +478,23 @@ Curl_cache_addr(struct SessionHandle *data,
                 int port)
 {
   char *entry_id;
-  size_t entry_len;
+  struct dnscache_shard *sh;
   struct Curl_dns_entry *dns;
-  struct Curl_dns_entry *dns2;
 
   /* Create an entry id, based upon the hostname and port */
   entry_id = create_hostcache_id(hostname, port);
   /* If we can't create the entry id, fail */
   if(!entry_id)
     return NULL;
-  entry_len = strlen(entry_id);
 
-  /* Create a new cache entry */
-  dns = calloc(1, sizeof(struct Curl_dns_entry));
-  if(!dns) {
-    free(entry_id);
-    return NULL;
-  }
+  sh = cache_shard(data->dns.hostcache, entry_id);
+  shard_lock(data, sh);
 
-  dns->inuse = 0;   /* init to not used */
-  dns->addr = addr; /* this is the address(es) */
-  time(&dns->timestamp);
-  if(dns->timestamp == 0)
-    dns->timestamp = 1;   /* zero indicates that entry isn't in hash table */
+  dns = cache_add(sh, addr, entry_id, data->set.dns_cache_timeout);
+  if(dns)
+    dns->inuse++;         /* mark entry as in-use */
 
-  /* Store the resolved data in our DNS cache. */
-  dns2 = Curl_hash_add(data->dns.hostcache, entry_id, entry_len+1,
-                       (void *)dns);
-  if(!dns2) {
-    free(dns);
-    free(entry_id);
-    return NULL;
-  }
-
-  dns = dns2;
-  dns->inuse++;         /* mark entry as in-use */
+  shard_unlock(data, sh);
 
   /* free the allocated entry_id */
   free(entry_id);
@@ -376,6 +502,44 @@ Curl_cache_addr(struct SessionHandle *data,
   return dns;
 }
 
+/*
+ * Curl_cache_negative() stores a negative entry for the host name in the DNS
+ * cache, unless another resolve of the same name has stored a fresh positive
+ * entry meanwhile. Failing to store it is not an error.
+ */
+void Curl_cache_negative(struct SessionHandle *data,
+                         const char *hostname,
+                         int port)
+{
+  char *entry_id;
+  struct dnscache_shard *sh;
+  struct Curl_dns_entry *dns;
+  long ttl = data->set.dns_cache_timeout;
+  time_t now;
+
+  if(!data->dns.hostcache)
+    return;
+
+  if((ttl < 0) || (ttl > CURL_DNSCACHE_NEGATIVE_TIMEOUT))
+    ttl = CURL_DNSCACHE_NEGATIVE_TIMEOUT;
+
+  entry_id = create_hostcache_id(hostname, port);
+  if(!entry_id)
+    return;
+
+  time(&now);
+  sh = cache_shard(data->dns.hostcache, entry_id);
+  shard_lock(data, sh);
+
+  dns = Curl_hash_pick(&sh->hash, entry_id, strlen(entry_id)+1);
+  if(!dns || !dns->addr || entry_is_stale(data, dns, now))
+    (void)cache_add(sh, NULL, entry_id, ttl);
+
+  shard_unlock(data, sh);
+
+  free(entry_id);
+}
+
 /*
  * Curl_resolv() is the main name resolve function within libcurl. It resolves
  * a name and returns a pointer to the entry in the 'entry' argument (if one
@@ -386,6 +550,10 @@ Curl_cache_addr(struct SessionHandle *data,
  * function is used. You MUST call Curl_resolv_unlock() later (when you're
  * done using this struct) to decrease the counter again.
  *
+ * A cached entry that is about to expire is returned as usual, but with a
+ * resolver that can do it a new resolve of the name is also started in the
+ * background to replace the entry before it goes stale.
+ *
  * In debug mode, we specifically test for an interface name "LocalHost"
  * and resolve "localhost" instead as a means to permit test cases
  * to connect to a local test server with any host name.
@@ -404,10 +572,14 @@ int Curl_resolv(struct connectdata *conn,
 {
   char *entry_id = NULL;
   struct Curl_dns_entry *dns = NULL;
-  size_t entry_len;
   struct SessionHandle *data = conn->data;
+  struct Curl_dnscache *cache = data->dns.hostcache;
+  struct dnscache_shard *sh;
   CURLcode result;
   int rc = CURLRESOLV_ERROR; /* default to failure */
+  bool negative = FALSE;
+  bool prefetch = FALSE;
+  time_t now;
 
   *entry = NULL;
 
@@ -417,28 +589,55 @@ int Curl_resolv(struct connectdata *conn,
   if(!entry_id)
     return rc;
 
-  entry_len = strlen(entry_id);
-
-  if(data->share)
-    Curl_share_lock(data, CURL_LOCK_DATA_DNS, CURL_LOCK_ACCESS_SINGLE);
+  time(&now);
+  sh = cache_shard(cache, entry_id);
+  shard_lock(data, sh);
 
   /* See if its already in our dns cache */
-  dns = Curl_hash_pick(data->dns.hostcache, entry_id, entry_len+1);
-
-  /* free the allocated entry_id again */
-  free(entry_id);
+  dns = Curl_hash_pick(&sh->hash, entry_id, strlen(entry_id)+1);
 
   /* See whether the returned entry is stale. Done before we release lock */
-  if(remove_entry_if_stale(data, dns))
-    dns = NULL; /* the memory deallocation is being handled by the hash */
+  if(dns && entry_is_stale(data, dns, now)) {
+    /* the memory deallocation is being handled by the hash */
+    Curl_hash_delete(&sh->hash, entry_id, strlen(entry_id)+1);
+    dns = NULL;
+  }
 
   if(dns) {
-    dns->inuse++; /* we use it! */
-    rc = CURLRESOLV_RESOLVED;
+    sh->hits++;
+    if(dns->addr) {
+      dns->inuse++; /* we use it! */
+      rc = CURLRESOLV_RESOLVED;
+      if(prefetch_due(dns, now))
+        /* only one lookup gets to start the refresh */
+        prefetch = dns->prefetch = TRUE;
+    }
+    else {
+      /* a recent resolve of this name failed */
+      negative = TRUE;
+      dns = NULL;
+    }
   }
+  else
+    sh->misses++;
 
-  if(data->share)
-    Curl_share_unlock(data, CURL_LOCK_DATA_DNS);
+  shard_unlock(data, sh);
+
+  /* free the allocated entry_id again */
+  free(entry_id);
+
+  if(negative) {
+    infof(data, "Hostname '%s' failed to resolve recently\n", hostname);
+    return CURLRESOLV_ERROR;
+  }
+
+  if(prefetch) {
+    /* the prefetch holds on to the cache until it has delivered */
+    Curl_dnscache_hold(cache);
+    if(!Curl_resolver_prefetch(conn, cache, hostname, port,
+                               data->set.dns_cache_timeout))
+      Curl_dnscache_destroy(cache); /* drops the reference again */
+  }
 
   if(!dns) {
     /* The entry was not in the cache. Resolve it to IP address */
@@ -475,17 +674,14 @@ int Curl_resolv(struct connectdata *conn,
         else
           rc = CURLRESOLV_PENDING; /* no info yet */
       }
+      else
+        /* remember the failure for a little while */
+        Curl_cache_negative(data, hostname, port);
     }
     else {
-      if(data->share)
-        Curl_share_lock(data, CURL_LOCK_DATA_DNS, CURL_LOCK_ACCESS_SINGLE);
-
       /* we got a response, store it in the cache */
       dns = Curl_cache_addr(data, addr, hostname, port);
 
-      if(data->share)
-        Curl_share_unlock(data, CURL_LOCK_DATA_DNS);
-
       if(!dns)
         /* returned failure, bail out nicely */
         Curl_freeaddrinfo(addr);
@@ -499,6 +695,7 @@ int Curl_resolv(struct connectdata *conn,
   return rc;
 }
 
+
 #ifdef USE_ALARM_TIMEOUT
 /*
  * This signal handler jumps back into the main libcurl code and continues
@@ -682,19 +879,11 @@ clean_up:
 }
 
 /*
- * Curl_resolv_unlock() unlocks the given cached DNS entry. When this has been
- * made, the struct may be destroyed due to pruning. It is important that only
- * one unlock is made for each Curl_resolv() call.
- *
- * May be called with 'data' == NULL for global cache.
+ * File-internal: drop one use of an entry, freeing it if it was the last
+ * one and the entry is no longer in the cache. Assumes a locked shard.
  */
-void Curl_resolv_unlock(struct SessionHandle *data, struct Curl_dns_entry *dns)
+static void dns_release(struct Curl_dns_entry *dns)
 {
-  DEBUGASSERT(dns && (dns->inuse>0));
-
-  if(data && data->share)
-    Curl_share_lock(data, CURL_LOCK_DATA_DNS, CURL_LOCK_ACCESS_SINGLE);
-
   dns->inuse--;
   /* only free if nobody is using AND it is not in hostcache (timestamp ==
      0) */
@@ -702,9 +891,25 @@ void Curl_resolv_unlock(struct SessionHandle *data, struct Curl_dns_entry *dns)
     Curl_freeaddrinfo(dns->addr);
     free(dns);
   }
+}
 
-  if(data && data->share)
-    Curl_share_unlock(data, CURL_LOCK_DATA_DNS);
+/*
+ * Curl_resolv_unlock() unlocks the given cached DNS entry. When this has been
+ * made, the struct may be destroyed due to pruning. It is important that only
+ * one unlock is made for each Curl_resolv() call.
+ *
+ * May be called with 'data' == NULL for global cache.
+ */
+void Curl_resolv_unlock(struct SessionHandle *data, struct Curl_dns_entry *dns)
+{
+  struct dnscache_shard *sh;
+
+  DEBUGASSERT(dns && (dns->inuse>0));
+
+  sh = dns->shard;
+  shard_lock(data, sh);
+  dns_release(dns);
+  shard_unlock(data, sh);
 }
 
 /*
@@ -725,17 +930,136 @@ static void freednsentry(void *freethis)
 /*
  * Curl_mk_dnscache() creates a new DNS cache and returns the handle for it.
  */
-struct curl_hash *Curl_mk_dnscache(void)
+struct Curl_dnscache *Curl_mk_dnscache(void)
 {
-  return Curl_hash_alloc(7, Curl_hash_str, Curl_str_key_compare, freednsentry);
+  struct Curl_dnscache *cache = calloc(1, sizeof(struct Curl_dnscache));
+  int i;
+
+  if(!cache)
+    return NULL;
+
+  for(i = 0; i < CURL_DNSCACHE_SHARDS; i++) {
+    struct dnscache_shard *sh = &cache->shard[i];
+
+    if(Curl_hash_init(&sh->hash, 7, Curl_hash_str, Curl_str_key_compare,
+                      freednsentry)) {
+      while(i--) {
+        Curl_hash_clean(&cache->shard[i].hash);
+#ifdef DNSCACHE_MUTEX
+        Curl_mutex_destroy(&cache->shard[i].mtx);
+#endif
+      }
+      free(cache);
+      return NULL;
+    }
+#ifdef DNSCACHE_MUTEX
+    Curl_mutex_init(&sh->mtx);
+#endif
+  }
+
+#ifdef DNSCACHE_MUTEX
+  Curl_mutex_init(&cache->mtx);
+#endif
+  cache->refs = 1;
+
+  return cache;
+}
+
+/*
+ * Curl_dnscache_destroy() drops a reference to the cache. The cache is freed
+ * when the last one is gone, which may be after a prefetch still running
+ * when the owner let go of it has finished.
+ */
+void Curl_dnscache_destroy(struct Curl_dnscache *cache)
+{
+  long refs;
+  int i;
+
+  if(!cache)
+    return;
+
+#ifdef DNSCACHE_MUTEX
+  Curl_mutex_acquire(&cache->mtx);
+#endif
+  refs = --cache->refs;
+#ifdef DNSCACHE_MUTEX
+  Curl_mutex_release(&cache->mtx);
+#endif
+  if(refs)
+    return;
+
+  for(i = 0; i < CURL_DNSCACHE_SHARDS; i++) {
+    Curl_hash_clean(&cache->shard[i].hash);
+#ifdef DNSCACHE_MUTEX
+    Curl_mutex_destroy(&cache->shard[i].mtx);
+#endif
+  }
+#ifdef DNSCACHE_MUTEX
+  Curl_mutex_destroy(&cache->mtx);
+#endif
+  free(cache);
+}
+
+/*
+ * Curl_dnscache_stats() sums up the hit and miss counters of all shards.
+ * A lookup that finds a negative entry counts as a hit.
+ */
+void Curl_dnscache_stats(struct Curl_dnscache *cache,
+                         long *hits, long *misses)
+{
+  int i;
+
+  *hits = *misses = 0;
+  if(!cache)
+    return;
+
+  for(i = 0; i < CURL_DNSCACHE_SHARDS; i++) {
+    struct dnscache_shard *sh = &cache->shard[i];
+
+    shard_lock(NULL, sh);
+    *hits += sh->hits;
+    *misses += sh->misses;
+    shard_unlock(NULL, sh);
+  }
+}
+
+/*
+ * Curl_dnscache_prefetched() is called from the thread that did a prefetch
+ * resolve. A failed refresh leaves the old entry to expire as usual.
+ */
+void Curl_dnscache_prefetched(struct Curl_dnscache *cache,
+                              const char *hostname, int port,
+                              Curl_addrinfo *addr, long ttl)
+{
+  char *entry_id;
+
+  if(addr) {
+    entry_id = create_hostcache_id(hostname, port);
+    if(entry_id) {
+      struct dnscache_shard *sh = cache_shard(cache, entry_id);
+
+      shard_lock(NULL, sh);
+      /* replaces the old entry, which stays alive while it is in use */
+      if(cache_add(sh, addr, entry_id, ttl))
+        addr = NULL;
+      shard_unlock(NULL, sh);
+
+      free(entry_id);
+    }
+    if(addr)
+      Curl_freeaddrinfo(addr);
+  }
+
+  Curl_dnscache_destroy(cache);
 }
 
 static int hostcache_inuse(void *data, void *hc)
 {
   struct Curl_dns_entry *c = (struct Curl_dns_entry *) hc;
 
+  (void)data;
   if(c->inuse == 1)
-    Curl_resolv_unlock(data, c);
+    dns_release(c);
 
   return 1; /* free all entries */
 }
@@ -744,17 +1068,26 @@ static int hostcache_inuse(void *data, void *hc)
  * Curl_hostcache_clean()
  *
  * This _can_ be called with 'data' == NULL but then of course no locking
- * can be done!
+ * can be done, unless the cache has its own locks!
  */
 
 void Curl_hostcache_clean(struct SessionHandle *data,
-                          struct curl_hash *hash)
+                          struct Curl_dnscache *cache)
 {
+  int i;
+
   /* Entries added to the hostcache with the CURLOPT_RESOLVE function are
    * still present in the cache with the inuse counter set to 1. Detect them
    * and cleanup!
    */
-  Curl_hash_clean_with_criterium(hash, data, hostcache_inuse);
+  for(i = 0; i < CURL_DNSCACHE_SHARDS; i++) {
+    struct dnscache_shard *sh = &cache->shard[i];
+
+    shard_lock(data, sh);
+    Curl_hash_clean_with_criterium(&sh->hash, NULL, hostcache_inuse);
+    sh->nextprune = 0;
+    shard_unlock(data, sh);
+  }
 }
 
 
@@ -774,9 +1107,9 @@ CURLcode Curl_loadhostpairs(struct SessionHandle *data)
     else if(3 == sscanf(hostp->data, "%255[^:]:%d:%255s", hostname, &port,
                         address)) {
       struct Curl_dns_entry *dns;
+      struct dnscache_shard *sh;
       Curl_addrinfo *addr;
       char *entry_id;
-      size_t entry_len;
 
       addr = Curl_str2addr(address, port);
       if(!addr) {
@@ -792,26 +1125,26 @@ CURLcode Curl_loadhostpairs(struct SessionHandle *data)
         return CURLE_OUT_OF_MEMORY;
       }
 
-      entry_len = strlen(entry_id);
-
-      if(data->share)
-        Curl_share_lock(data, CURL_LOCK_DATA_DNS, CURL_LOCK_ACCESS_SINGLE);
+      sh = cache_shard(data->dns.hostcache, entry_id);
+      shard_lock(data, sh);
 
       /* See if its already in our dns cache */
-      dns = Curl_hash_pick(data->dns.hostcache, entry_id, entry_len+1);
-
-      /* free the allocated entry_id again */
-      free(entry_id);
+      dns = Curl_hash_pick(&sh->hash, entry_id, strlen(entry_id)+1);
 
-      if(!dns)
+      if(!dns || !dns->addr) {
         /* if not in the cache already, put this host in the cache */
-        dns = Curl_cache_addr(data, addr, hostname, port);
+        dns = cache_add(sh, addr, entry_id, data->set.dns_cache_timeout);
+        if(dns)
+          dns->inuse++; /* held until Curl_hostcache_clean() */
+      }
       else
         /* this is a duplicate, free it again */
         Curl_freeaddrinfo(addr);
 
-      if(data->share)
-        Curl_share_unlock(data, CURL_LOCK_DATA_DNS);
+      shard_unlock(data, sh);
+
+      /* free the allocated entry_id again */
+      free(entry_id);
 
       if(!dns) {
         Curl_freeaddrinfo(addr);
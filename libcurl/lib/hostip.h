@@ -52,6 +52,8 @@ struct addrinfo;
 struct hostent;
 struct SessionHandle;
 struct connectdata;
+struct Curl_dnscache;
+struct dnscache_shard;
 
 /*
  * Curl_global_host_cache_init() initializes and sets up a global DNS cache.
@@ -60,16 +62,28 @@ struct connectdata;
  *
  * Returns a struct curl_hash pointer on success, NULL on failure.
  */
-struct curl_hash *Curl_global_host_cache_init(void);
+struct Curl_dnscache *Curl_global_host_cache_init(void);
 void Curl_global_host_cache_dtor(void);
 
+/* Number of independently locked parts a DNS cache is split into. Names are
+   spread over the shards by hash, so threads resolving different hosts
+   rarely wait for each other. */
+#define CURL_DNSCACHE_SHARDS 16
+
+/* How long, in seconds, a failed name resolve is remembered. Never longer
+   than the CURLOPT_DNS_CACHE_TIMEOUT of the handle that did the resolve. */
+#define CURL_DNSCACHE_NEGATIVE_TIMEOUT 5
+
 struct Curl_dns_entry {
-  Curl_addrinfo *addr;
+  Curl_addrinfo *addr; /* NULL marks a cached resolve failure */
   /* timestamp == 0 -- entry not in hostcache
      timestamp != 0 -- entry is in hostcache */
   time_t timestamp;
+  time_t expires;  /* when the entry goes stale, 0 for never */
   long inuse;      /* use-counter, make very sure you decrease this
                       when you're done using the address you received */
+  struct dnscache_shard *shard; /* the part of the cache holding the entry */
+  bool prefetch;   /* a refreshing resolve has been started */
 };
 
 /*
@@ -126,7 +140,26 @@ void Curl_resolv_unlock(struct SessionHandle *data,
 void Curl_scan_cache_used(void *user, void *ptr);
 
 /* make a new dns cache and return the handle */
-struct curl_hash *Curl_mk_dnscache(void);
+struct Curl_dnscache *Curl_mk_dnscache(void);
+
+/* let go of a dns cache made by Curl_mk_dnscache() */
+void Curl_dnscache_destroy(struct Curl_dnscache *cache);
+
+/* take another reference to a dns cache, for another owner to use it */
+void Curl_dnscache_hold(struct Curl_dnscache *cache);
+
+/* get the hit and miss counters of a dns cache */
+void Curl_dnscache_stats(struct Curl_dnscache *cache,
+                         long *hits, long *misses);
+
+/*
+ * Curl_dnscache_prefetched() receives the result of a resolve started with
+ * Curl_resolver_prefetch(), stores it in the cache if the resolve worked and
+ * drops the cache reference the prefetch held.
+ */
+void Curl_dnscache_prefetched(struct Curl_dnscache *cache,
+                              const char *hostname, int port,
+                              Curl_addrinfo *addr, long ttl);
 
 /* prune old entries from the DNS cache */
 void Curl_hostcache_prune(struct SessionHandle *data);
@@ -180,6 +213,13 @@ struct Curl_dns_entry *
 Curl_cache_addr(struct SessionHandle *data, Curl_addrinfo *addr,
                 const char *hostname, int port);
 
+/*
+ * Curl_cache_negative() remembers that resolving the host name failed, so
+ * that lookups of it fail right away for a little while.
+ */
+void Curl_cache_negative(struct SessionHandle *data,
+                         const char *hostname, int port);
+
 #ifndef INADDR_NONE
 #define CURL_INADDR_NONE (in_addr_t) ~0
 #else
@@ -203,7 +243,8 @@ CURLcode Curl_set_dns_servers(struct SessionHandle *data, char *servers);
 /*
  * Clean off entries from the cache
  */
-void Curl_hostcache_clean(struct SessionHandle *data, struct curl_hash *hash);
+void Curl_hostcache_clean(struct SessionHandle *data,
+                          struct Curl_dnscache *cache);
 
 /*
  * Destroy the hostcache of this handle.
@@ -115,6 +115,11 @@ CHUNKcode Curl_httpchunk_read(struct connectdata *conn,
   size_t piece;
   size_t length = (size_t)datalen;
   size_t *wrote = (size_t *)wrotep;
+  /* Data read into a buffer of the application's is de-chunked in place:
+     the chunk data is moved down over the framing to the start of the
+     buffer and written to the client in one go */
+  char *inplace = (k->recvbuf && datap == k->recvbuf) ? datap : NULL;
+  char *outp = inplace;
 
   *wrote = 0; /* nothing's written yet */
 
@@ -201,44 +206,23 @@ CHUNKcode Curl_httpchunk_read(struct connectdata *conn,
       piece = (ch->datasize >= length)?length:ch->datasize;
 
       /* Write the data portion available */
-#ifdef HAVE_LIBZ
-      switch (conn->data->set.http_ce_skip?
-              IDENTITY : data->req.auto_decoding) {
-      case IDENTITY:
-#endif
-        if(!k->ignorebody) {
-          if(!data->set.http_te_skip)
-            result = Curl_client_write(conn, CLIENTWRITE_BODY, datap,
-                                       piece);
-          else
-            result = CURLE_OK;
-        }
-#ifdef HAVE_LIBZ
-        break;
-
-      case DEFLATE:
-        /* update data->req.keep.str to point to the chunk data. */
-        data->req.str = datap;
-        result = Curl_unencode_deflate_write(conn, &data->req,
-                                             (ssize_t)piece);
-        break;
-
-      case GZIP:
-        /* update data->req.keep.str to point to the chunk data. */
-        data->req.str = datap;
-        result = Curl_unencode_gzip_write(conn, &data->req,
-                                          (ssize_t)piece);
-        break;
-
-      case COMPRESS:
-      default:
-        failf (conn->data,
-               "Unrecognized content encoding type. "
-               "libcurl understands `identity', `deflate' and `gzip' "
-               "content encodings.");
-        return CHUNKE_BAD_ENCODING;
+      if(k->unencode) {
+        result = Curl_unencode_write(conn, datap, piece);
+        if(result == CURLE_BAD_CONTENT_ENCODING)
+          return CHUNKE_BAD_ENCODING;
+      }
+      else if(inplace) {
+        if(outp != datap)
+          memmove(outp, datap, piece);
+        outp += piece;
+      }
+      else if(!k->ignorebody) {
+        if(!data->set.http_te_skip)
+          result = Curl_client_write(conn, CLIENTWRITE_BODY, datap,
+                                     piece);
+        else
+          result = CURLE_OK;
       }
-#endif
 
       if(result)
         return CHUNKE_WRITE_ERROR;
@@ -300,8 +284,17 @@ CHUNKcode Curl_httpchunk_read(struct connectdata *conn,
             return CHUNKE_BAD_CHUNK;
 
           if(!data->set.http_te_skip) {
-            result = Curl_client_write(conn, CLIENTWRITE_HEADER,
-                                       conn->trailer, conn->trlPos);
+            /* the body decoded so far goes first, whether it waits in the
+               decoder or was de-chunked in place */
+            result = Curl_unencode_flush(conn);
+            if(!result && inplace && (outp != inplace)) {
+              result = Curl_client_write(conn, CLIENTWRITE_BODY, inplace,
+                                         (size_t)(outp - inplace));
+              inplace = outp;
+            }
+            if(!result)
+              result = Curl_client_write(conn, CLIENTWRITE_HEADER,
+                                         conn->trailer, conn->trlPos);
             if(result)
               return CHUNKE_WRITE_ERROR;
           }
@@ -383,6 +376,11 @@ CHUNKcode Curl_httpchunk_read(struct connectdata *conn,
            even if there's no more chunks to read */
 
         ch->dataleft = length;
+
+        if(inplace && (outp != inplace) &&
+           Curl_client_write(conn, CLIENTWRITE_BODY, inplace,
+                             (size_t)(outp - inplace)))
+          return CHUNKE_WRITE_ERROR;
         return CHUNKE_STOP; /* return stop */
       }
       else
@@ -392,6 +390,12 @@ CHUNKcode Curl_httpchunk_read(struct connectdata *conn,
       return CHUNKE_STATE_ERROR;
     }
   }
+
+  if(inplace && (outp != inplace) &&
+     Curl_client_write(conn, CLIENTWRITE_BODY, inplace,
+                       (size_t)(outp - inplace)))
+    return CHUNKE_WRITE_ERROR;
+
   return CHUNKE_OK;
 }
 #endif /* CURL_DISABLE_HTTP */
@@ -40,6 +40,7 @@
 #include "conncache.h"
 #include "bundles.h"
 #include "multihandle.h"
+#include "multi_ev.h"
 #include "pipeline.h"
 
 #define _MPRINTF_REPLACE /* use our functions only */
@@ -50,9 +51,8 @@
 #include "memdebug.h"
 
 /*
-  CURL_SOCKET_HASH_TABLE_SIZE should be a prime number. Increasing it from 97
-  to 911 takes on a 32-bit machine 4 x 804 = 3211 more bytes.  Still, every
-  CURL handle takes 45-50 K memory, therefore this 3K are not significant.
+  CURL_SOCKET_HASH_TABLE_SIZE is the number of sockets the socket hash has
+  room for from the start. The hash grows on its own when more are used.
 */
 #ifndef CURL_SOCKET_HASH_TABLE_SIZE
 #define CURL_SOCKET_HASH_TABLE_SIZE 911
@@ -73,9 +73,8 @@ static int update_timer(struct Curl_multi *multi);
 
 static bool isHandleAtHead(struct SessionHandle *handle,
                            struct curl_llist *pipeline);
-static CURLMcode add_next_timeout(struct timeval now,
-                                  struct Curl_multi *multi,
-                                  struct SessionHandle *d);
+static struct SessionHandle *next_expired(struct Curl_multi *multi,
+                                          unsigned int now);
 static CURLMcode multi_timeout(struct Curl_multi *multi,
                                long *timeout_ms);
 
@@ -102,8 +101,6 @@ static const char * const statename[]={
 };
 #endif
 
-static void multi_freetimeout(void *a, void *b);
-
 /* always use this function to change state, to make debugging easier */
 static void mstate(struct SessionHandle *easy, CURLMstate state
 #ifdef DEBUGBUILD
@@ -155,6 +152,7 @@ struct Curl_sh_entry {
   int action;  /* what action READ/WRITE this socket waits for */
   curl_socket_t socket; /* mainly to ease debugging */
   void *socketp; /* settable by users with curl_multi_assign() */
+  int evslot; /* kept for the event set, see Curl_evset_update() */
 };
 /* bits for 'action' having no bits means this socket is not expecting any
    action */
@@ -205,6 +203,28 @@ static void sh_delentry(struct curl_hash *sh, curl_socket_t s)
   }
 }
 
+/*
+ * Tell the application's socket callback, and the event set if
+ * curl_multi_perform_events() has one, what 'easy' now waits for on the
+ * socket.
+ */
+static void sh_action(struct Curl_multi *multi, struct SessionHandle *easy,
+                      curl_socket_t s, int action,
+                      struct Curl_sh_entry *entry)
+{
+  if(multi->socket_cb)
+    multi->socket_cb(easy,
+                     s,
+                     action,
+                     multi->socket_userp,
+                     entry->socketp);
+
+  if(multi->evset)
+    /* failing to add a socket here stalls only that transfer, which then
+       runs into its timeout */
+    (void)Curl_evset_update(multi->evset, s, action, &entry->evslot);
+}
+
 /*
  * free a sockhash entry
  */
@@ -225,10 +245,14 @@ static size_t fd_key_compare(void *k1, size_t k1_len, void *k2, size_t k2_len)
 
 static size_t hash_fd(void *key, size_t key_length, size_t slots_num)
 {
-  int fd = *((int *) key);
+  /* Multiplicative hash: plain fd numbers would do for POSIX, but Windows
+     socket handles are multiples of four and would only use every fourth
+     slot of the power-of-two sized table */
+  unsigned int fd = (unsigned int)*((int *) key);
   (void) key_length;
 
-  return (fd % (int)slots_num);
+  fd *= 2654435761U;
+  return ((fd ^ (fd >> 16)) & (slots_num - 1));
 }
 
 /*
@@ -248,6 +272,7 @@ static size_t hash_fd(void *key, size_t key_length, size_t slots_num)
  * large default value like this. At 9000 connections I was still below 10us
  * per call."
  *
+ * The hash has since become an open addressing table that grows as needed.
  */
 static struct curl_hash *sh_init(int hashsize)
 {
@@ -290,6 +315,9 @@ struct Curl_multi *Curl_multi_handle(int hashsize, /* socket hash */
     return NULL;
 
   multi->type = CURL_MULTI_HANDLE;
+  multi->wakeup = CURL_SOCKET_BAD;
+
+  Curl_timewheel_init(&multi->timewheel, Curl_timewheel_ms(Curl_tvnow()));
 
   multi->hostcache = Curl_mk_dnscache();
   if(!multi->hostcache)
@@ -314,7 +342,7 @@ struct Curl_multi *Curl_multi_handle(int hashsize, /* socket hash */
 
   Curl_hash_destroy(multi->sockhash);
   multi->sockhash = NULL;
-  Curl_hash_destroy(multi->hostcache);
+  Curl_dnscache_destroy(multi->hostcache);
   multi->hostcache = NULL;
   Curl_conncache_destroy(multi->conn_cache);
   multi->conn_cache = NULL;
@@ -333,11 +361,10 @@ CURLM *curl_multi_init(void)
 CURLMcode curl_multi_add_handle(CURLM *multi_handle,
                                 CURL *easy_handle)
 {
-  struct curl_llist *timeoutlist;
   struct Curl_multi *multi = (struct Curl_multi *)multi_handle;
   struct SessionHandle *data = (struct SessionHandle *)easy_handle;
   struct SessionHandle *new_closure = NULL;
-  struct curl_hash *hostcache = NULL;
+  struct Curl_dnscache *hostcache = NULL;
 
   /* First, make some basic checks that the CURLM handle is a good handle */
   if(!GOOD_MULTI_HANDLE(multi))
@@ -353,17 +380,11 @@ CURLMcode curl_multi_add_handle(CURLM *multi_handle,
     /* possibly we should create a new unique error code for this condition */
     return CURLM_BAD_EASY_HANDLE;
 
-  /* Allocate and initialize timeout list for easy handle */
-  timeoutlist = Curl_llist_alloc(multi_freetimeout);
-  if(!timeoutlist)
-    return CURLM_OUT_OF_MEMORY;
-
   /* In case multi handle has no hostcache yet, allocate one */
   if(!multi->hostcache) {
     hostcache = Curl_mk_dnscache();
     if(!hostcache) {
       free(data);
-      Curl_llist_destroy(timeoutlist, NULL);
       return CURLM_OUT_OF_MEMORY;
     }
   }
@@ -373,9 +394,8 @@ CURLMcode curl_multi_add_handle(CURLM *multi_handle,
   if(!multi->closure_handle) {
     new_closure = (struct SessionHandle *)curl_easy_init();
     if(!new_closure) {
-      Curl_hash_destroy(hostcache);
+      Curl_dnscache_destroy(hostcache);
       free(data);
-      Curl_llist_destroy(timeoutlist, NULL);
       return CURLM_OUT_OF_MEMORY;
     }
   }
@@ -400,17 +420,13 @@ CURLMcode curl_multi_add_handle(CURLM *multi_handle,
   if(hostcache)
     multi->hostcache = hostcache;
 
-  /* Make easy handle use timeout list initialized above */
-  data->state.timeoutlist = timeoutlist;
-  timeoutlist = NULL;
-
   /* set the easy handle */
   multistate(data, CURLM_STATE_INIT);
 
   if((data->set.global_dns_cache) &&
      (data->dns.hostcachetype != HCACHE_GLOBAL)) {
     /* global dns cache was requested but still isn't */
-    struct curl_hash *global = Curl_global_host_cache_init();
+    struct Curl_dnscache *global = Curl_global_host_cache_init();
     if(global) {
       /* only do this if the global cache init works */
       data->dns.hostcache = global;
@@ -475,7 +491,7 @@ CURLMcode curl_multi_add_handle(CURLM *multi_handle,
      The work-around is thus simply to clear the 'lastcall' variable to force
      update_timer() to always trigger a callback to the app when a new easy
      handle is added */
-  memset(&multi->timer_lastcall, 0, sizeof(multi->timer_lastcall));
+  multi->timer_lastset = FALSE;
 
   update_timer(multi);
   return CURLM_OK;
@@ -502,7 +518,6 @@ CURLMcode curl_multi_remove_handle(CURLM *multi_handle,
 {
   struct Curl_multi *multi=(struct Curl_multi *)multi_handle;
   struct SessionHandle *easy = curl_handle;
-  struct SessionHandle *data = easy;
 
   /* First, make some basic checks that the CURLM handle is a good handle */
   if(!GOOD_MULTI_HANDLE(multi))
@@ -539,17 +554,11 @@ CURLMcode curl_multi_remove_handle(CURLM *multi_handle,
       easy->easy_conn->data = easy;
     }
 
-    /* The timer must be shut down before easy->multi is set to NULL,
-       else the timenode will remain in the splay tree after
-       curl_easy_cleanup is called. */
+    /* The timers must be shut down before easy->multi is set to NULL,
+       else they will remain in the timer wheel after curl_easy_cleanup is
+       called. */
     Curl_expire(easy, 0);
 
-    /* destroy the timeout list that is held in the easy handle */
-    if(data->state.timeoutlist) {
-      Curl_llist_destroy(data->state.timeoutlist, NULL);
-      data->state.timeoutlist = NULL;
-    }
-
     if(easy->dns.hostcachetype == HCACHE_MULTI) {
       /* stop using the multi handle's DNS cache */
       easy->dns.hostcache = NULL;
@@ -1528,6 +1537,7 @@ static CURLMcode multi_runsingle(struct Curl_multi *multi,
         Curl_posttransfer(data);
 
         /* we're no longer receiving */
+        Curl_pipeline_done(data, easy->easy_conn);
         Curl_removeHandleFromPipeline(data, easy->easy_conn->recv_pipe);
 
         /* expire the new receiving pipeline head */
@@ -1728,7 +1738,7 @@ CURLMcode curl_multi_perform(CURLM *multi_handle, int *running_handles)
   struct Curl_multi *multi=(struct Curl_multi *)multi_handle;
   struct SessionHandle *easy;
   CURLMcode returncode=CURLM_OK;
-  struct Curl_tree *t;
+  unsigned int tick;
   struct timeval now = Curl_tvnow();
 
   if(!GOOD_MULTI_HANDLE(multi))
@@ -1764,22 +1774,22 @@ CURLMcode curl_multi_perform(CURLM *multi_handle, int *running_handles)
   }
 
   /*
-   * Simply remove all expired timers from the splay since handles are dealt
+   * Simply remove all expired timers from the wheel since handles are dealt
    * with unconditionally by this function and curl_multi_timeout() requires
-   * that already passed/handled expire times are removed from the splay.
+   * that already passed/handled expire times are removed from the wheel.
    *
    * It is important that the 'now' value is set at the entry of this function
    * and not for the current time as it may have ticked a little while since
    * then and then we risk this loop to remove timers that actually have not
    * been handled!
    */
-  do {
-    multi->timetree = Curl_splaygetbest(now, multi->timetree, &t);
-    if(t)
-      /* the removed may have another timeout in queue */
-      (void)add_next_timeout(now, multi, t->payload);
+  tick = Curl_timewheel_ms(now);
+  while(next_expired(multi, tick))
+    ;
 
-  } while(t);
+  if(multi->closure_handle)
+    /* idle connections are owned by the closure handle */
+    Curl_prune_idle_connections(multi->closure_handle);
 
   *running_handles = multi->num_alive;
 
@@ -1828,6 +1838,9 @@ CURLMcode curl_multi_cleanup(CURLM *multi_handle)
     Curl_hash_destroy(multi->sockhash);
     multi->sockhash = NULL;
 
+    Curl_evset_destroy(multi->evset);
+    multi->evset = NULL;
+
     Curl_conncache_destroy(multi->conn_cache);
     multi->conn_cache = NULL;
 
@@ -1854,7 +1867,7 @@ CURLMcode curl_multi_cleanup(CURLM *multi_handle)
       easy = nexteasy;
     }
 
-    Curl_hash_destroy(multi->hostcache);
+    Curl_dnscache_destroy(multi->hostcache);
     multi->hostcache = NULL;
 
     /* Free the blacklists by setting them to NULL */
@@ -1964,12 +1977,7 @@ static void singlesocket(struct Curl_multi *multi,
     }
 
     /* we know (entry != NULL) at this point, see the logic above */
-    if(multi->socket_cb)
-      multi->socket_cb(easy,
-                       s,
-                       action,
-                       multi->socket_userp,
-                       entry->socketp);
+    sh_action(multi, easy, s, action, entry);
 
     entry->action = action; /* store the current action state */
   }
@@ -2042,12 +2050,7 @@ static void singlesocket(struct Curl_multi *multi,
 
       if(remove_sock_from_hash) {
         /* in this case 'entry' is always non-NULL */
-        if(multi->socket_cb)
-          multi->socket_cb(easy,
-                           s,
-                           CURL_POLL_REMOVE,
-                           multi->socket_userp,
-                           entry->socketp);
+        sh_action(multi, easy, s, CURL_POLL_REMOVE, entry);
         sh_delentry(multi->sockhash, s);
       }
 
@@ -2078,10 +2081,7 @@ void Curl_multi_closed(struct connectdata *conn, curl_socket_t s)
       Curl_hash_pick(multi->sockhash, (char *)&s, sizeof(s));
 
     if(entry) {
-      if(multi->socket_cb)
-        multi->socket_cb(conn->data, s, CURL_POLL_REMOVE,
-                         multi->socket_userp,
-                         entry->socketp);
+      sh_action(multi, conn->data, s, CURL_POLL_REMOVE, entry);
 
       /* now remove it from the socket hash */
       sh_delentry(multi->sockhash, s);
@@ -2092,58 +2092,37 @@ void Curl_multi_closed(struct connectdata *conn, curl_socket_t s)
 
 
 /*
- * add_next_timeout()
- *
- * Each SessionHandle has a list of timeouts. The add_next_timeout() is called
- * when it has just been removed from the splay tree because the timeout has
- * expired. This function is then to advance in the list to pick the next
- * timeout to use (skip the already expired ones) and add this node back to
- * the splay tree again.
+ * next_expired()
  *
- * The splay tree only has each sessionhandle as a single node and the nearest
- * timeout is used to sort it on.
+ * Pop the next expired timer off the wheel and return the handle it belongs
+ * to, or NULL when there are no more. The handle is dealt with by the caller
+ * as a whole, so all of its timers that have expired are dropped at once and
+ * the ones still pending are left in the wheel.
  */
-static CURLMcode add_next_timeout(struct timeval now,
-                                  struct Curl_multi *multi,
-                                  struct SessionHandle *d)
+static struct SessionHandle *next_expired(struct Curl_multi *multi,
+                                          unsigned int now)
 {
-  struct timeval *tv = &d->state.expiretime;
-  struct curl_llist *list = d->state.timeoutlist;
-  struct curl_llist_element *e;
-
-  /* move over the timeout list for this specific handle and remove all
-     timeouts that are now passed tense and store the next pending
-     timeout in *tv */
-  for(e = list->head; e; ) {
-    struct curl_llist_element *n = e->next;
-    long diff = curlx_tvdiff(*(struct timeval *)e->ptr, now);
-    if(diff <= 0)
-      /* remove outdated entry */
-      Curl_llist_remove(list, e, NULL);
-    else
-      /* the list is sorted so get out on the first mismatch */
-      break;
-    e = n;
-  }
-  e = list->head;
-  if(!e) {
-    /* clear the expire times within the handles that we remove from the
-       splay tree */
-    tv->tv_sec = 0;
-    tv->tv_usec = 0;
-  }
-  else {
-    /* copy the first entry to 'tv' */
-    memcpy(tv, e->ptr, sizeof(*tv));
+  struct Curl_timer *t = Curl_timewheel_getexpired(&multi->timewheel, now);
+  struct Curl_timer **tp;
+  struct SessionHandle *d;
 
-    /* remove first entry from list */
-    Curl_llist_remove(list, e, NULL);
+  if(!t)
+    return NULL;
 
-    /* insert this node again into the splay */
-    multi->timetree = Curl_splayinsert(*tv, multi->timetree,
-                                       &d->state.timenode);
+  d = t->payload;
+  tp = &d->state.timers;
+  while(*tp) {
+    struct Curl_timer *e = *tp;
+    if((e == t) || ((int)(e->expire - now) <= 0)) {
+      Curl_timewheel_remove(&multi->timewheel, e);
+      *tp = e->sibling;
+      e->sibling = d->state.freetimers;
+      d->state.freetimers = e;
+    }
+    else
+      tp = &e->sibling;
   }
-  return CURLM_OK;
+  return d;
 }
 
 #ifdef WIN32
@@ -2160,7 +2139,7 @@ static CURLMcode multi_socket(struct Curl_multi *multi,
 {
   CURLMcode result = CURLM_OK;
   struct SessionHandle *data = NULL;
-  struct Curl_tree *t;
+  unsigned int tick;
   struct timeval now = Curl_tvnow();
 
   if(checkall) {
@@ -2266,9 +2245,10 @@ static CURLMcode multi_socket(struct Curl_multi *multi,
 
   /*
    * The loop following here will go on as long as there are expire-times left
-   * to process in the splay and 'data' will be re-assigned for every expired
+   * to process in the wheel and 'data' will be re-assigned for every expired
    * handle we deal with.
    */
+  tick = Curl_timewheel_ms(now);
   do {
     /* the first loop lap 'data' can be NULL */
     if(data) {
@@ -2285,13 +2265,13 @@ static CURLMcode multi_socket(struct Curl_multi *multi,
     /* Check if there's one (more) expired timer to deal with! This function
        extracts a matching node if there is one */
 
-    multi->timetree = Curl_splaygetbest(now, multi->timetree, &t);
-    if(t) {
-      data = t->payload; /* assign this for next loop */
-      (void)add_next_timeout(now, multi, t->payload);
-    }
+    data = next_expired(multi, tick); /* assign this for next loop */
 
-  } while(t);
+  } while(data);
+
+  if(multi->closure_handle)
+    /* idle connections are owned by the closure handle */
+    Curl_prune_idle_connections(multi->closure_handle);
 
   *running_handles = multi->num_alive;
   return result;
@@ -2352,6 +2332,12 @@ CURLMcode curl_multi_setopt(CURLM *multi_handle,
   case CURLMOPT_MAX_TOTAL_CONNECTIONS:
     multi->max_total_connections = va_arg(param, long);
     break;
+  case CURLMOPT_MAX_HOST_IDLE:
+    multi->max_host_idle = va_arg(param, long);
+    break;
+  case CURLMOPT_IDLE_TIMEOUT:
+    multi->idle_timeout = va_arg(param, long);
+    break;
   default:
     res = CURLM_UNKNOWN_OPTION;
     break;
@@ -2393,31 +2379,126 @@ CURLMcode curl_multi_socket_all(CURLM *multi_handle, int *running_handles)
   return result;
 }
 
+/*
+ * Curl_wakeup_drain()
+ *
+ * Read all pending wakeups from the socket another thread writes to, to wake
+ * up the thread that waits for it.
+ */
+void Curl_wakeup_drain(curl_socket_t s)
+{
+  char buf[64];
+
+  while(sread(s, buf, sizeof(buf)) > 0)
+    ;
+}
+
+/*
+ * curl_multi_perform_events()
+ *
+ * A built-in event loop lap for the multi_socket API. The first call creates
+ * the event set, puts the sockets already known in it and drives all
+ * transfers once like curl_multi_socket_all(). From then on singlesocket()
+ * keeps the set up to date, and each call waits for ready sockets or the
+ * next timeout and then acts on exactly those, like the application would
+ * with curl_multi_socket_action().
+ */
+CURLMcode curl_multi_perform_events(CURLM *multi_handle, int timeout_ms,
+                                    int *running_handles)
+{
+  struct Curl_multi *multi=(struct Curl_multi *)multi_handle;
+  struct Curl_evready ready[CURL_EVSET_BATCH];
+  CURLMcode result = CURLM_OK;
+  long timeout_internal;
+  bool acted = FALSE;
+  int nready;
+  int i;
+
+  if(!GOOD_MULTI_HANDLE(multi))
+    return CURLM_BAD_HANDLE;
+
+  if(!multi->evset) {
+    struct curl_hash_iterator iter;
+    struct curl_hash_element *he;
+
+    multi->evset = Curl_evset_init();
+    if(!multi->evset)
+      return CURLM_OUT_OF_MEMORY;
+
+    Curl_hash_start_iterate(multi->sockhash, &iter);
+    for(he = Curl_hash_next_element(&iter); he;
+        he = Curl_hash_next_element(&iter)) {
+      struct Curl_sh_entry *entry = he->ptr;
+      (void)Curl_evset_update(multi->evset, entry->socket, entry->action,
+                              &entry->evslot);
+    }
+
+    if(multi->wakeup != CURL_SOCKET_BAD) {
+      if(Curl_evset_update(multi->evset, multi->wakeup, CURL_POLL_IN,
+                           &multi->wakeupslot)) {
+        Curl_evset_destroy(multi->evset);
+        multi->evset = NULL;
+        return CURLM_OUT_OF_MEMORY;
+      }
+    }
+
+    result = multi_socket(multi, TRUE, CURL_SOCKET_BAD, 0, running_handles);
+    if(CURLM_OK >= result)
+      update_timer(multi);
+    return result;
+  }
+
+  /* don't wait past the next internal timeout, also when there's no limit */
+  (void)multi_timeout(multi, &timeout_internal);
+  if((timeout_internal >= 0) &&
+     ((timeout_ms < 0) || (timeout_internal < (long)timeout_ms)))
+    timeout_ms = (int)timeout_internal;
+
+  nready = Curl_evset_wait(multi->evset, ready, CURL_EVSET_BATCH,
+                           timeout_ms);
+  if(nready < 0)
+    return CURLM_INTERNAL_ERROR;
+
+  for(i = 0; i < nready; i++) {
+    if(ready[i].fd == multi->wakeup) {
+      /* nothing to act on, the caller has something to do */
+      Curl_wakeup_drain(multi->wakeup);
+      continue;
+    }
+    acted = TRUE;
+    result = multi_socket(multi, FALSE, ready[i].fd, ready[i].events,
+                          running_handles);
+    if(result > CURLM_OK)
+      break;
+  }
+
+  if(!acted)
+    /* timed out or only woken up, the expired timers are due either way and
+       a caller woken up often must not keep them waiting */
+    result = multi_socket(multi, FALSE, CURL_SOCKET_TIMEOUT, 0,
+                          running_handles);
+
+  if(CURLM_OK >= result)
+    update_timer(multi);
+  return result;
+}
+
 static CURLMcode multi_timeout(struct Curl_multi *multi,
                                long *timeout_ms)
 {
-  static struct timeval tv_zero = {0,0};
-
-  if(multi->timetree) {
-    /* we have a tree of expire times */
-    struct timeval now = Curl_tvnow();
+  unsigned int expire;
 
-    /* splay the lowest to the bottom */
-    multi->timetree = Curl_splay(tv_zero, multi->timetree);
+  if(Curl_timewheel_next(&multi->timewheel, &expire)) {
+    /* we have a wheel of expire times */
+    int diff = (int)(expire - Curl_timewheel_ms(Curl_tvnow()));
 
-    if(Curl_splaycomparekeys(multi->timetree->key, now) > 0) {
+    /* Expire times are rounded up to the next whole millisecond when set, so
+       a timer is not due until the tick it was set for has been reached and
+       there's no risk of returning 0 while it is still a fraction of a
+       millisecond away, which could cause short bursts of busyloops. */
+    if(diff > 0)
       /* some time left before expiration */
-      *timeout_ms = curlx_tvdiff(multi->timetree->key, now);
-      if(!*timeout_ms)
-        /*
-         * Since we only provide millisecond resolution on the returned value
-         * and the diff might be less than one millisecond here, we don't
-         * return zero as that may cause short bursts of busyloops on fast
-         * processors while the diff is still present but less than one
-         * millisecond! instead we return 1 until the time is ripe.
-         */
-        *timeout_ms=1;
-    }
+      *timeout_ms = diff;
     else
       /* 0 means immediately */
       *timeout_ms = 0;
@@ -2447,6 +2528,7 @@ CURLMcode curl_multi_timeout(CURLM *multi_handle,
 static int update_timer(struct Curl_multi *multi)
 {
   long timeout_ms;
+  unsigned int expire;
 
   if(!multi->timer_cb)
     return 0;
@@ -2454,9 +2536,8 @@ static int update_timer(struct Curl_multi *multi)
     return -1;
   }
   if(timeout_ms < 0) {
-    static const struct timeval none={0,0};
-    if(Curl_splaycomparekeys(none, multi->timer_lastcall)) {
-      multi->timer_lastcall = none;
+    if(multi->timer_lastset) {
+      multi->timer_lastset = FALSE;
       /* there's no timeout now but there was one previously, tell the app to
          disable it */
       return multi->timer_cb((CURLM*)multi, -1, multi->timer_userp);
@@ -2464,14 +2545,16 @@ static int update_timer(struct Curl_multi *multi)
     return 0;
   }
 
-  /* When multi_timeout() is done, multi->timetree points to the node with the
-   * timeout we got the (relative) time-out time for. We can thus easily check
-   * if this is the same (fixed) time as we got in a previous call and then
-   * avoid calling the callback again. */
-  if(Curl_splaycomparekeys(multi->timetree->key, multi->timer_lastcall) == 0)
+  /* The wheel keeps the earliest expire time at hand, which is the one
+   * multi_timeout() got the (relative) time-out time for. We can thus easily
+   * check if this is the same (fixed) time as we got in a previous call and
+   * then avoid calling the callback again. */
+  (void)Curl_timewheel_next(&multi->timewheel, &expire);
+  if(multi->timer_lastset && (expire == multi->timer_lastcall))
     return 0;
 
-  multi->timer_lastcall = multi->timetree->key;
+  multi->timer_lastcall = expire;
+  multi->timer_lastset = TRUE;
 
   return multi->timer_cb((CURLM*)multi, timeout_ms, multi->timer_userp);
 }
@@ -2492,80 +2575,24 @@ static bool isHandleAtHead(struct SessionHandle *handle,
   return FALSE;
 }
 
-/*
- * multi_freetimeout()
- *
- * Callback used by the llist system when a single timeout list entry is
- * destroyed.
- */
-static void multi_freetimeout(void *user, void *entryptr)
-{
-  (void)user;
-
-  /* the entry was plain malloc()'ed */
-  free(entryptr);
-}
-
-/*
- * multi_addtimeout()
- *
- * Add a timestamp to the list of timeouts. Keep the list sorted so that head
- * of list is always the timeout nearest in time.
- *
- */
-static CURLMcode
-multi_addtimeout(struct curl_llist *timeoutlist,
-                 struct timeval *stamp)
-{
-  struct curl_llist_element *e;
-  struct timeval *timedup;
-  struct curl_llist_element *prev = NULL;
-
-  timedup = malloc(sizeof(*timedup));
-  if(!timedup)
-    return CURLM_OUT_OF_MEMORY;
-
-  /* copy the timestamp */
-  memcpy(timedup, stamp, sizeof(*timedup));
-
-  if(Curl_llist_count(timeoutlist)) {
-    /* find the correct spot in the list */
-    for(e = timeoutlist->head; e; e = e->next) {
-      struct timeval *checktime = e->ptr;
-      long diff = curlx_tvdiff(*checktime, *timedup);
-      if(diff > 0)
-        break;
-      prev = e;
-    }
-
-  }
-  /* else
-     this is the first timeout on the list */
-
-  if(!Curl_llist_insert_next(timeoutlist, prev, timedup)) {
-    free(timedup);
-    return CURLM_OUT_OF_MEMORY;
-  }
-
-  return CURLM_OK;
-}
-
 /*
  * Curl_expire()
  *
  * given a number of milliseconds from now to use to set the 'act before
  * this'-time for the transfer, to be extracted by curl_multi_timeout()
  *
- * Note that the timeout will be added to a queue of timeouts if it defines a
- * moment in time that is later than the current head of queue.
+ * Every call adds a timer of its own to the multi handle's timer wheel, next
+ * to the ones already set for the handle. They are all dropped the first time
+ * the handle is dealt with after they expired.
  *
  * Pass zero to clear all timeout values for this handle.
 */
 void Curl_expire(struct SessionHandle *data, long milli)
 {
   struct Curl_multi *multi = data->multi;
-  struct timeval *nowp = &data->state.expiretime;
-  int rc;
+  struct Curl_timer *t;
+  struct timeval now;
+  unsigned int expire;
 
   /* this is only interesting while there is still an associated multi struct
      remaining! */
@@ -2574,74 +2601,73 @@ void Curl_expire(struct SessionHandle *data, long milli)
 
   if(!milli) {
     /* No timeout, clear the time data. */
-    if(nowp->tv_sec || nowp->tv_usec) {
-      /* Since this is an cleared time, we must remove the previous entry from
-         the splay tree */
-      struct curl_llist *list = data->state.timeoutlist;
-
-      rc = Curl_splayremovebyaddr(multi->timetree,
-                                  &data->state.timenode,
-                                  &multi->timetree);
-      if(rc)
-        infof(data, "Internal error clearing splay node = %d\n", rc);
-
-      /* flush the timeout list too */
-      while(list->size > 0)
-        Curl_llist_remove(list, list->tail, NULL);
-
+    if(data->state.timers) {
+      /* take all of them out of the wheel and keep them for reuse */
+      while(data->state.timers) {
+        t = data->state.timers;
+        Curl_timewheel_remove(&multi->timewheel, t);
+        data->state.timers = t->sibling;
+        t->sibling = data->state.freetimers;
+        data->state.freetimers = t;
+      }
 #ifdef DEBUGBUILD
       infof(data, "Expire cleared\n");
 #endif
-      nowp->tv_sec = 0;
-      nowp->tv_usec = 0;
     }
+    return;
   }
-  else {
-    struct timeval set;
 
-    set = Curl_tvnow();
-    set.tv_sec += milli/1000;
-    set.tv_usec += (milli%1000)*1000;
+  if((milli < 0) || (milli > (long)CURL_TIMEWHEEL_MAX))
+    milli = (long)CURL_TIMEWHEEL_MAX;
 
-    if(set.tv_usec >= 1000000) {
-      set.tv_sec++;
-      set.tv_usec -= 1000000;
-    }
+  /* round up to the next whole millisecond so that the timer never fires
+     early */
+  now = Curl_tvnow();
+  expire = Curl_timewheel_ms(now) + (unsigned int)milli +
+    ((now.tv_usec % 1000) ? 1 : 0);
 
-    if(nowp->tv_sec || nowp->tv_usec) {
-      /* This means that the struct is added as a node in the splay tree.
-         Compare if the new time is earlier, and only remove-old/add-new if it
-         is. */
-      long diff = curlx_tvdiff(set, *nowp);
-      if(diff > 0) {
-        /* the new expire time was later so just add it to the queue
-           and get out */
-        multi_addtimeout(data->state.timeoutlist, &set);
-        return;
-      }
+  /* a timer for the same tick is already set */
+  for(t = data->state.timers; t; t = t->sibling)
+    if(t->expire == expire)
+      return;
 
-      /* the new time is newer than the presently set one, so add the current
-         to the queue and update the head */
-      multi_addtimeout(data->state.timeoutlist, nowp);
-
-      /* Since this is an updated time, we must remove the previous entry from
-         the splay tree first and then re-add the new value */
-      rc = Curl_splayremovebyaddr(multi->timetree,
-                                  &data->state.timenode,
-                                  &multi->timetree);
-      if(rc)
-        infof(data, "Internal error removing splay node = %d\n", rc);
-    }
+  t = data->state.freetimers;
+  if(t)
+    data->state.freetimers = t->sibling;
+  else {
+    t = calloc(1, sizeof(struct Curl_timer));
+    if(!t)
+      return;
+  }
 
-    *nowp = set;
-    data->state.timenode.payload = data;
-    multi->timetree = Curl_splayinsert(*nowp,
-                                       multi->timetree,
-                                       &data->state.timenode);
+  t->payload = data;
+  t->sibling = data->state.timers;
+  data->state.timers = t;
+  Curl_timewheel_add(&multi->timewheel, t, expire);
+}
+
+/*
+ * Curl_expire_free()
+ *
+ * Free the timers held by a handle that is being closed.
+ */
+void Curl_expire_free(struct SessionHandle *data)
+{
+  struct Curl_timer *t;
+
+  Curl_expire(data, 0);
+
+  while(data->state.timers) {
+    /* without a multi handle they can't be in a wheel */
+    t = data->state.timers;
+    data->state.timers = t->sibling;
+    free(t);
+  }
+  while(data->state.freetimers) {
+    t = data->state.freetimers;
+    data->state.freetimers = t->sibling;
+    free(t);
   }
-#if 0
-  Curl_splayprint(multi->timetree, 0, TRUE);
-#endif
 }
 
 CURLMcode curl_multi_assign(CURLM *multi_handle,
@@ -2671,6 +2697,16 @@ size_t Curl_multi_max_total_connections(struct Curl_multi *multi)
   return multi ? multi->max_total_connections : 0;
 }
 
+size_t Curl_multi_max_host_idle(struct Curl_multi *multi)
+{
+  return (multi && multi->max_host_idle > 0) ? multi->max_host_idle : 0;
+}
+
+long Curl_multi_idle_timeout(struct Curl_multi *multi)
+{
+  return multi ? multi->idle_timeout : 0;
+}
+
 size_t Curl_multi_max_pipeline_length(struct Curl_multi *multi)
 {
   return multi ? multi->max_pipeline_length : 0;
@@ -2686,12 +2722,14 @@ curl_off_t Curl_multi_chunk_length_penalty_size(struct Curl_multi *multi)
   return multi ? multi->chunk_length_penalty_size : 0;
 }
 
-struct curl_llist *Curl_multi_pipelining_site_bl(struct Curl_multi *multi)
+struct Curl_pipeline_bl *
+Curl_multi_pipelining_site_bl(struct Curl_multi *multi)
 {
   return multi->pipelining_site_bl;
 }
 
-struct curl_llist *Curl_multi_pipelining_server_bl(struct Curl_multi *multi)
+struct Curl_pipeline_bl *
+Curl_multi_pipelining_server_bl(struct Curl_multi *multi)
 {
   return multi->pipelining_server_bl;
 }
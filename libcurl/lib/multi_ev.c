@@ -0,0 +1,390 @@
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) 1998 - 2013, Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at http://curl.haxx.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ ***************************************************************************/
+
+#include "curl_setup.h"
+
+#include <curl/curl.h>
+
+#include "multi_ev.h"
+#include "select.h"
+
+#ifdef USE_EPOLL
+#include <sys/epoll.h>
+#endif
+
+#ifdef USE_KQUEUE
+#include <sys/event.h>
+#endif
+
+#include "curl_memory.h"
+/* The last #include file should be: */
+#include "memdebug.h"
+
+/*
+ * What curl_multi_socket_action() gets told about a ready socket that waits
+ * for 'action', mapped the same way Curl_socket_check() does it.
+ */
+static int ready_mask(int action, bool readable, bool writable,
+                      bool error, bool hangup)
+{
+  int mask = 0;
+
+  if(action & CURL_POLL_IN) {
+    if(readable || error || hangup)
+      mask |= CURL_CSELECT_IN;
+  }
+  if(action & CURL_POLL_OUT) {
+    if(writable)
+      mask |= CURL_CSELECT_OUT;
+    if(error || hangup)
+      mask |= CURL_CSELECT_ERR;
+  }
+  return mask;
+}
+
+#if defined(USE_EPOLL)
+
+struct Curl_evset {
+  int epfd;
+  struct epoll_event events[CURL_EVSET_BATCH];
+};
+
+struct Curl_evset *Curl_evset_init(void)
+{
+  struct Curl_evset *ev = calloc(1, sizeof(struct Curl_evset));
+  if(!ev)
+    return NULL;
+
+#ifdef EPOLL_CLOEXEC
+  ev->epfd = epoll_create1(EPOLL_CLOEXEC);
+#else
+  ev->epfd = epoll_create(CURL_EVSET_BATCH); /* the size is just a hint */
+#endif
+  if(ev->epfd == -1) {
+    free(ev);
+    return NULL;
+  }
+  return ev;
+}
+
+void Curl_evset_destroy(struct Curl_evset *ev)
+{
+  if(ev) {
+    close(ev->epfd);
+    free(ev);
+  }
+}
+
+CURLMcode Curl_evset_update(struct Curl_evset *ev, curl_socket_t s,
+                            int action, int *slot)
+{
+  struct epoll_event event;
+
+  memset(&event, 0, sizeof(event));
+
+  if(!(action & CURL_POLL_INOUT)) {
+    if(*slot) {
+      /* this fails when the socket is already closed, but closing it took
+         it out of the set as well */
+      (void)epoll_ctl(ev->epfd, EPOLL_CTL_DEL, s, &event);
+      *slot = 0;
+    }
+    return CURLM_OK;
+  }
+
+  if(action & CURL_POLL_IN)
+    event.events |= EPOLLIN;
+  if(action & CURL_POLL_OUT)
+    event.events |= EPOLLOUT;
+  /* keep what we wait for next to the socket, to map the events back */
+  event.data.u64 = (unsigned int)s |
+    ((uint64_t)(action & CURL_POLL_INOUT) << 32);
+
+  if(epoll_ctl(ev->epfd, *slot ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, s, &event)) {
+    int error = SOCKERRNO;
+
+    /* A closed socket leaves the set by itself, and its number may be in
+       use again before we are told. Try the other way around then. */
+    if(((error != ENOENT) && (error != EEXIST)) ||
+       epoll_ctl(ev->epfd, *slot ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, s, &event))
+      return (SOCKERRNO == ENOMEM) ? CURLM_OUT_OF_MEMORY :
+        CURLM_INTERNAL_ERROR;
+  }
+  *slot = 1;
+  return CURLM_OK;
+}
+
+int Curl_evset_wait(struct Curl_evset *ev, struct Curl_evready *ready,
+                    int maxready, int timeout_ms)
+{
+  int i;
+  int n;
+
+  if(maxready > CURL_EVSET_BATCH)
+    maxready = CURL_EVSET_BATCH;
+
+  n = epoll_wait(ev->epfd, ev->events, maxready, timeout_ms);
+  if(n < 0)
+    return (SOCKERRNO == EINTR) ? 0 : -1;
+
+  for(i = 0; i < n; i++) {
+    uint32_t r = ev->events[i].events;
+
+    ready[i].fd = (curl_socket_t)(ev->events[i].data.u64 & 0xffffffff);
+    ready[i].events = ready_mask((int)(ev->events[i].data.u64 >> 32),
+                                 (r & EPOLLIN) ? TRUE : FALSE,
+                                 (r & EPOLLOUT) ? TRUE : FALSE,
+                                 (r & EPOLLERR) ? TRUE : FALSE,
+                                 (r & EPOLLHUP) ? TRUE : FALSE);
+  }
+  return n;
+}
+
+#elif defined(USE_KQUEUE)
+
+struct Curl_evset {
+  int kq;
+  struct kevent events[CURL_EVSET_BATCH];
+};
+
+struct Curl_evset *Curl_evset_init(void)
+{
+  struct Curl_evset *ev = calloc(1, sizeof(struct Curl_evset));
+  if(!ev)
+    return NULL;
+
+  ev->kq = kqueue();
+  if(ev->kq == -1) {
+    free(ev);
+    return NULL;
+  }
+  return ev;
+}
+
+void Curl_evset_destroy(struct Curl_evset *ev)
+{
+  if(ev) {
+    close(ev->kq);
+    free(ev);
+  }
+}
+
+static int kq_change(struct Curl_evset *ev, curl_socket_t s, short filter,
+                     unsigned short flags)
+{
+  struct kevent change;
+
+  EV_SET(&change, s, filter, flags, 0, 0, NULL);
+  return kevent(ev->kq, &change, 1, NULL, 0, NULL);
+}
+
+/* For kqueue the slot holds the CURL_POLL_IN and CURL_POLL_OUT bits of the
+   filters we have added for the socket. */
+CURLMcode Curl_evset_update(struct Curl_evset *ev, curl_socket_t s,
+                            int action, int *slot)
+{
+  int want = action & CURL_POLL_INOUT;
+
+  /* deleting fails when the socket is already closed, but closing it took
+     it out of the set as well */
+  if((*slot & CURL_POLL_IN) && !(want & CURL_POLL_IN))
+    (void)kq_change(ev, s, EVFILT_READ, EV_DELETE);
+  if((*slot & CURL_POLL_OUT) && !(want & CURL_POLL_OUT))
+    (void)kq_change(ev, s, EVFILT_WRITE, EV_DELETE);
+  *slot &= want;
+
+  if((want & CURL_POLL_IN) && !(*slot & CURL_POLL_IN)) {
+    if(kq_change(ev, s, EVFILT_READ, EV_ADD))
+      return (SOCKERRNO == ENOMEM) ? CURLM_OUT_OF_MEMORY :
+        CURLM_INTERNAL_ERROR;
+    *slot |= CURL_POLL_IN;
+  }
+  if((want & CURL_POLL_OUT) && !(*slot & CURL_POLL_OUT)) {
+    if(kq_change(ev, s, EVFILT_WRITE, EV_ADD))
+      return (SOCKERRNO == ENOMEM) ? CURLM_OUT_OF_MEMORY :
+        CURLM_INTERNAL_ERROR;
+    *slot |= CURL_POLL_OUT;
+  }
+  return CURLM_OK;
+}
+
+int Curl_evset_wait(struct Curl_evset *ev, struct Curl_evready *ready,
+                    int maxready, int timeout_ms)
+{
+  struct timespec ts;
+  int i;
+  int n;
+  int num = 0;
+
+  if(maxready > CURL_EVSET_BATCH)
+    maxready = CURL_EVSET_BATCH;
+
+  ts.tv_sec = timeout_ms / 1000;
+  ts.tv_nsec = (timeout_ms % 1000) * 1000000;
+
+  n = kevent(ev->kq, NULL, 0, ev->events, maxready,
+             (timeout_ms < 0) ? NULL : &ts);
+  if(n < 0)
+    return (SOCKERRNO == EINTR) ? 0 : -1;
+
+  for(i = 0; i < n; i++) {
+    struct kevent *kev = &ev->events[i];
+    bool readable = (kev->filter == EVFILT_READ) ? TRUE : FALSE;
+    int mask = ready_mask(readable ? CURL_POLL_IN : CURL_POLL_OUT,
+                          readable, !readable,
+                          (kev->flags & EV_ERROR) ? TRUE : FALSE,
+                          (kev->flags & EV_EOF) ? TRUE : FALSE);
+
+    /* the read and write filters of a socket are separate events */
+    if(num && (ready[num - 1].fd == (curl_socket_t)kev->ident))
+      ready[num - 1].events |= mask;
+    else {
+      ready[num].fd = (curl_socket_t)kev->ident;
+      ready[num].events = mask;
+      num++;
+    }
+  }
+  return num;
+}
+
+#else /* neither epoll nor kqueue */
+
+/* The sockets are kept in a pollfd array for Curl_poll() that only changes
+   when a socket does, and the slot holds the socket's index + 1 in it. */
+struct Curl_evset {
+  struct pollfd *fds;
+  int **slots;       /* the caller's slot for each entry in 'fds' */
+  unsigned int num;  /* entries used */
+  unsigned int max;  /* entries allocated */
+  unsigned int next; /* where to start looking for ready ones */
+};
+
+struct Curl_evset *Curl_evset_init(void)
+{
+  return calloc(1, sizeof(struct Curl_evset));
+}
+
+void Curl_evset_destroy(struct Curl_evset *ev)
+{
+  if(ev) {
+    Curl_safefree(ev->fds);
+    Curl_safefree(ev->slots);
+    free(ev);
+  }
+}
+
+CURLMcode Curl_evset_update(struct Curl_evset *ev, curl_socket_t s,
+                            int action, int *slot)
+{
+  unsigned int i;
+
+  if(!(action & CURL_POLL_INOUT)) {
+    if(*slot) {
+      /* move the last one into the hole */
+      i = (unsigned int)*slot - 1;
+      ev->num--;
+      if(i != ev->num) {
+        ev->fds[i] = ev->fds[ev->num];
+        ev->slots[i] = ev->slots[ev->num];
+        *ev->slots[i] = (int)i + 1;
+      }
+      *slot = 0;
+    }
+    return CURLM_OK;
+  }
+
+  if(!*slot) {
+    if(ev->num == ev->max) {
+      unsigned int newmax = ev->max ? ev->max * 2 : 64;
+      struct pollfd *newfds;
+      int **newslots;
+
+      newfds = realloc(ev->fds, newmax * sizeof(struct pollfd));
+      if(!newfds)
+        return CURLM_OUT_OF_MEMORY;
+      ev->fds = newfds;
+      newslots = realloc(ev->slots, newmax * sizeof(int *));
+      if(!newslots)
+        return CURLM_OUT_OF_MEMORY;
+      ev->slots = newslots;
+      ev->max = newmax;
+    }
+    i = ev->num++;
+    ev->fds[i].fd = s;
+    ev->slots[i] = slot;
+    *slot = (int)i + 1;
+  }
+  else
+    i = (unsigned int)*slot - 1;
+
+  ev->fds[i].events = 0;
+  ev->fds[i].revents = 0;
+  if(action & CURL_POLL_IN)
+    ev->fds[i].events |= POLLIN;
+  if(action & CURL_POLL_OUT)
+    ev->fds[i].events |= POLLOUT;
+  return CURLM_OK;
+}
+
+int Curl_evset_wait(struct Curl_evset *ev, struct Curl_evready *ready,
+                    int maxready, int timeout_ms)
+{
+  unsigned int i;
+  unsigned int n;
+  int num = 0;
+  int rc;
+
+  if(!ev->num && (timeout_ms < 0))
+    /* Curl_poll() refuses to wait forever for nothing, but epoll_wait() and
+       kevent() do so on an empty set and this should behave the same */
+    return Curl_wait_ms(INT_MAX) ? -1 : 0;
+
+  rc = Curl_poll(ev->fds, ev->num, timeout_ms);
+  if(rc <= 0)
+    return (rc < 0) ? -1 : 0;
+
+  /* go round from where the last call stopped so that a long list of busy
+     sockets can't keep the others waiting */
+  i = (ev->next < ev->num) ? ev->next : 0;
+  for(n = 0; (n < ev->num) && (num < maxready); n++) {
+    struct pollfd *pfd = &ev->fds[i];
+
+    if(pfd->revents) {
+      int action = ((pfd->events & POLLIN) ? CURL_POLL_IN : 0) |
+        ((pfd->events & POLLOUT) ? CURL_POLL_OUT : 0);
+      ready[num].fd = pfd->fd;
+      ready[num].events = ready_mask(action,
+                                     (pfd->revents & POLLIN) ? TRUE : FALSE,
+                                     (pfd->revents & POLLOUT) ? TRUE : FALSE,
+                                     (pfd->revents & (POLLERR|POLLNVAL)) ?
+                                     TRUE : FALSE,
+                                     (pfd->revents & POLLHUP) ? TRUE : FALSE);
+      num++;
+    }
+    if(++i == ev->num)
+      i = 0;
+  }
+  ev->next = i;
+  return num;
+}
+
+#endif /* USE_EPOLL */
@@ -0,0 +1,71 @@
+#ifndef HEADER_CURL_MULTI_EV_H
+#define HEADER_CURL_MULTI_EV_H
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) 1998 - 2013, Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at http://curl.haxx.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ ***************************************************************************/
+
+/*
+ * The socket event set used by curl_multi_perform_events(). It is a
+ * persistent epoll or kqueue set where the system has one, and a persistent
+ * pollfd array for Curl_poll() everywhere else. The multi handle updates it
+ * from singlesocket() whenever what a socket waits for changes, so waiting
+ * costs nothing per idle socket.
+ */
+
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_EPOLL_CREATE)
+#define USE_EPOLL
+#elif defined(HAVE_SYS_EVENT_H) && defined(HAVE_KQUEUE)
+#define USE_KQUEUE
+#endif
+
+struct Curl_evset;
+
+/* one socket found ready by Curl_evset_wait() */
+struct Curl_evready {
+  curl_socket_t fd;
+  int events; /* CURL_CSELECT_* bits, as curl_multi_socket_action() takes */
+};
+
+/* the most sockets one Curl_evset_wait() call reports */
+#define CURL_EVSET_BATCH 128
+
+struct Curl_evset *Curl_evset_init(void);
+void Curl_evset_destroy(struct Curl_evset *ev);
+
+/*
+ * Make the set wait for 'action' (CURL_POLL_IN/OUT/INOUT) on the socket, or
+ * take it out of the set for CURL_POLL_NONE and CURL_POLL_REMOVE. 'slot' is
+ * an int kept by the caller with the socket for the set's own use, zero
+ * while the socket is not in the set. It must stay where it is until the
+ * socket has been taken out again.
+ */
+CURLMcode Curl_evset_update(struct Curl_evset *ev, curl_socket_t s,
+                            int action, int *slot);
+
+/*
+ * Wait at most 'timeout_ms' milliseconds (-1 for no limit) for any of the
+ * sockets in the set to get ready. Returns the number of 'ready' entries
+ * filled in, 0 on timeout and interrupted waits, or -1 on failure.
+ */
+int Curl_evset_wait(struct Curl_evset *ev, struct Curl_evready *ready,
+                    int maxready, int timeout_ms);
+
+#endif /* HEADER_CURL_MULTI_EV_H */
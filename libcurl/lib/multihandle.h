@@ -80,17 +80,25 @@ struct Curl_multi {
   void *socket_userp;
 
   /* Hostname cache */
-  struct curl_hash *hostcache;
+  struct Curl_dnscache *hostcache;
 
-  /* timetree points to the splay-tree of time nodes to figure out expire
-     times of all currently set timers */
-  struct Curl_tree *timetree;
+  /* the timer wheel all the easy handles' expire times are kept in */
+  struct Curl_timewheel timewheel;
 
   /* 'sockhash' is the lookup hash for socket descriptor => easy handles (note
      the pluralis form, there can be more than one easy handle waiting on the
      same actual socket) */
   struct curl_hash *sockhash;
 
+  /* persistent socket event set for curl_multi_perform_events(), created on
+     its first call and kept up to date from 'sockhash' after that */
+  struct Curl_evset *evset;
+
+  /* a socket curl_multi_perform_events() waits on too, only to be woken up
+     by another thread writing to it, or CURL_SOCKET_BAD */
+  curl_socket_t wakeup;
+  int wakeupslot; /* kept for the event set, see Curl_evset_update() */
+
   /* Whether pipelining is enabled for this multi handle */
   bool pipelining_enabled;
 
@@ -110,6 +118,12 @@ struct Curl_multi {
   long max_total_connections; /* if >0, a fixed limit of the maximum number
                                  of connections in total */
 
+  long max_host_idle; /* if >0, the maximum number of idle connections to
+                         keep per host */
+
+  long idle_timeout; /* if >0, idle connections are closed after this many
+                        milliseconds */
+
   long max_pipeline_length; /* if >0, maximum number of requests in a
                                pipeline */
 
@@ -122,17 +136,19 @@ struct Curl_multi {
                                      bigger than this is not
                                      considered for pipelining */
 
-  struct curl_llist *pipelining_site_bl; /* List of sites that are blacklisted
-                                            from pipelining */
+  struct Curl_pipeline_bl *pipelining_site_bl; /* Sites that are blacklisted
+                                                  from pipelining */
 
-  struct curl_llist *pipelining_server_bl; /* List of server types that are
-                                              blacklisted from pipelining */
+  struct Curl_pipeline_bl *pipelining_server_bl; /* Server types that are
+                                                    blacklisted from
+                                                    pipelining */
 
   /* timer callback and user data pointer for the *socket() API */
   curl_multi_timer_callback timer_cb;
   void *timer_userp;
-  struct timeval timer_lastcall; /* the fixed time for the timeout for the
-                                    previous callback */
+  unsigned int timer_lastcall; /* the fixed tick for the timeout for the
+                                  previous callback */
+  bool timer_lastset; /* TRUE when 'timer_lastcall' holds a tick */
 };
 
 #endif /* HEADER_CURL_MULTIHANDLE_H */
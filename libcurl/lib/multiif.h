@@ -28,6 +28,7 @@
  * Prototypes for library-wide functions provided by multi.c
  */
 void Curl_expire(struct SessionHandle *data, long milli);
+void Curl_expire_free(struct SessionHandle *data);
 
 bool Curl_multi_pipeline_enabled(const struct Curl_multi* multi);
 void Curl_multi_handlePipeBreak(struct SessionHandle *data);
@@ -62,6 +63,9 @@ void Curl_multi_set_easy_connection(struct SessionHandle *handle,
 
 void Curl_multi_process_pending_handles(struct Curl_multi *multi);
 
+/* Read everything written to a wakeup socket, see curl_executor_*() */
+void Curl_wakeup_drain(curl_socket_t s);
+
 /* Return the value of the CURLMOPT_MAX_HOST_CONNECTIONS option */
 size_t Curl_multi_max_host_connections(struct Curl_multi *multi);
 
@@ -75,14 +79,22 @@ curl_off_t Curl_multi_content_length_penalty_size(struct Curl_multi *multi);
 curl_off_t Curl_multi_chunk_length_penalty_size(struct Curl_multi *multi);
 
 /* Return the value of the CURLMOPT_PIPELINING_SITE_BL option */
-struct curl_llist *Curl_multi_pipelining_site_bl(struct Curl_multi *multi);
+struct Curl_pipeline_bl *
+Curl_multi_pipelining_site_bl(struct Curl_multi *multi);
 
 /* Return the value of the CURLMOPT_PIPELINING_SERVER_BL option */
-struct curl_llist *Curl_multi_pipelining_server_bl(struct Curl_multi *multi);
+struct Curl_pipeline_bl *
+Curl_multi_pipelining_server_bl(struct Curl_multi *multi);
 
 /* Return the value of the CURLMOPT_MAX_TOTAL_CONNECTIONS option */
 size_t Curl_multi_max_total_connections(struct Curl_multi *multi);
 
+/* Return the value of the CURLMOPT_MAX_HOST_IDLE option */
+size_t Curl_multi_max_host_idle(struct Curl_multi *multi);
+
+/* Return the value of the CURLMOPT_IDLE_TIMEOUT option */
+long Curl_multi_idle_timeout(struct Curl_multi *multi);
+
 /*
  * Curl_multi_closed()
  *
@@ -38,26 +38,89 @@
 /* The last #include file should be: */
 #include "memdebug.h"
 
+/*
+ * A pipelining blacklist is a hash of names, compared case insensitively.
+ *
+ * The site blacklist is keyed on host names, each with the list of its
+ * blacklisted port numbers. The server blacklist holds prefixes of Server:
+ * header values, so it also keeps the different lengths of its prefixes and
+ * a header is looked up once for each length.
+ */
+struct Curl_pipeline_bl {
+  struct curl_hash names;
+  size_t *lengths;  /* different prefix lengths, server blacklist only */
+  size_t nlengths;
+};
+
 struct site_blacklist_entry {
-  char *hostname;
+  struct site_blacklist_entry *next;
   unsigned short port;
 };
 
-static void site_blacklist_llist_dtor(void *user, void *element)
+static size_t bl_hash(void *key, size_t key_length, size_t slots_num)
+{
+  const char *key_str = key;
+  const char *end = key_str + key_length;
+  unsigned int h = 2166136261U;
+
+  while(key_str < end) {
+    h ^= (unsigned char)Curl_raw_toupper(*key_str++);
+    h *= 16777619U;
+  }
+
+  h ^= h >> 16;
+  h *= 0x85ebca6bU;
+  h ^= h >> 13;
+
+  return (h & (slots_num - 1));
+}
+
+static size_t bl_compare(void *k1, size_t key1_len, void *k2,
+                         size_t key2_len)
+{
+  if((key1_len == key2_len) && Curl_raw_nequal(k1, k2, key1_len))
+    return 1;
+
+  return 0;
+}
+
+static void site_blacklist_dtor(void *element)
 {
   struct site_blacklist_entry *entry = element;
-  (void)user;
 
-  Curl_safefree(entry->hostname);
-  Curl_safefree(entry);
+  while(entry) {
+    struct site_blacklist_entry *next = entry->next;
+    free(entry);
+    entry = next;
+  }
 }
 
-static void server_blacklist_llist_dtor(void *user, void *element)
+static void server_blacklist_dtor(void *element)
 {
-  char *server_name = element;
-  (void)user;
+  (void)element; /* the entries are only markers */
+}
+
+static struct Curl_pipeline_bl *bl_alloc(curl_hash_dtor dtor)
+{
+  struct Curl_pipeline_bl *bl = calloc(1, sizeof(struct Curl_pipeline_bl));
+
+  if(!bl)
+    return NULL;
 
-  Curl_safefree(server_name);
+  if(Curl_hash_init(&bl->names, 8, bl_hash, bl_compare, dtor)) {
+    free(bl);
+    return NULL;
+  }
+  return bl;
+}
+
+static void bl_free(struct Curl_pipeline_bl *bl)
+{
+  if(bl) {
+    Curl_hash_clean(&bl->names);
+    Curl_safefree(bl->lengths);
+    free(bl);
+  }
 }
 
 bool Curl_pipeline_penalized(struct SessionHandle *data,
@@ -137,6 +200,10 @@ void Curl_move_handle_from_send_to_recv_pipe(struct SessionHandle *handle,
   curr = conn->send_pipe->head;
   while(curr) {
     if(curr->ptr == handle) {
+      handle->req.pipe_sent = Curl_tvnow();
+      handle->req.pipe_depth = (long)conn->recv_pipe->size;
+      handle->req.pipe_waiting = TRUE;
+
       Curl_llist_move(conn->send_pipe, curr,
                       conn->recv_pipe, conn->recv_pipe->tail);
 
@@ -161,28 +228,150 @@ void Curl_move_handle_from_send_to_recv_pipe(struct SessionHandle *handle,
   }
 }
 
+/* Completed responses are added up until their bodies took this many
+   microseconds before the receive speed is updated, as responses that arrive
+   together complete at nearly the same time */
+#define PIPE_RATE_WINDOW 10000
+
+/* smooth like TCP's srtt, the values are kept times eight */
+#define PIPE_SMOOTH(avg, samples, sample) \
+  ((samples) ? (avg) + (sample) - (avg) / 8 : (sample) * 8)
+
+/*
+ * Called when data has been received for the handle at the head of the
+ * connection's receive pipeline.
+ */
+void Curl_pipeline_received(struct SessionHandle *data,
+                            struct connectdata *conn)
+{
+  struct SingleRequest *k = &data->req;
+  struct pipestats *ps = &conn->pipe;
+
+  ps->lastrecv = Curl_tvnow();
+
+  if(k->pipe_waiting) {
+    /* the first byte of this response */
+    long wait = curlx_tvdiff(ps->lastrecv, k->pipe_sent);
+
+    k->pipe_waiting = FALSE;
+    k->pipe_firstbyte = ps->lastrecv;
+    data->info.pipe_wait = wait;
+
+    if(!k->pipe_depth) {
+      /* The request was sent on an idle connection, so the wait was a round
+         trip plus the server's time to respond */
+      ps->rtt = PIPE_SMOOTH(ps->rtt, ps->rttsamples, wait);
+      ps->rttsamples++;
+    }
+  }
+}
+
+/*
+ * Called when the response of the handle at the head of the connection's
+ * receive pipeline is complete.
+ */
+void Curl_pipeline_done(struct SessionHandle *data,
+                        struct connectdata *conn)
+{
+  struct SingleRequest *k = &data->req;
+  struct pipestats *ps = &conn->pipe;
+  struct timeval since = k->pipe_sent;
+  long busy;
+  long us;
+
+  if((k->pipe_depth < 0) || k->pipe_waiting)
+    return; /* never went through the pipeline */
+
+  /* The connection was busy with this response since the previous one was
+     complete, or since the request was sent if that was later. That is
+     what each response ahead of a new request is expected to add to its
+     wait. */
+  if(ps->requests && (curlx_tvdiff(ps->lastdone, since) > 0))
+    since = ps->lastdone;
+  busy = curlx_tvdiff(ps->lastrecv, since);
+  ps->busy = PIPE_SMOOTH(ps->busy, ps->requests, busy);
+
+  /* The body came in since the first byte, measure the speed of that */
+  us = (long)(curlx_tvdiff_secs(ps->lastrecv, k->pipe_firstbyte) * 1000000);
+  ps->winbytes += k->bytecount + k->headerbytecount;
+  ps->winus += us;
+  if(ps->winus >= PIPE_RATE_WINDOW) {
+    curl_off_t rate = ps->winbytes * 1000000 / ps->winus;
+
+    if(ps->rate)
+      ps->rate += (rate - ps->rate) / 4;
+    else
+      ps->rate = rate;
+    ps->winbytes = 0;
+    ps->winus = 0;
+  }
+
+  ps->requests++;
+  ps->lastdone = ps->lastrecv;
+
+  data->info.pipe_depth = k->pipe_depth;
+  data->info.pipe = *ps;
+}
+
+/*
+ * Estimate how many milliseconds a request added to the connection's
+ * pipeline now would wait for the first byte of its response. That is a
+ * round trip, plus the time the response at the head has been stalled
+ * beyond that, plus what each response ahead is expected to keep the
+ * connection busy. For the head that is what is left of its body when the
+ * size and the connection's speed are known.
+ */
+long Curl_pipeline_estimate(struct connectdata *conn, struct timeval now)
+{
+  struct pipestats *ps = &conn->pipe;
+  long rtt = ps->rtt / 8;
+  long busy = ps->busy / 8;
+  long estimate = rtt;
+  size_t ahead = conn->send_pipe->size + conn->recv_pipe->size;
+  struct curl_llist_element *curr = conn->recv_pipe->head;
+
+  if(curr) {
+    struct SessionHandle *head = curr->ptr;
+    struct SingleRequest *k = &head->req;
+    struct timeval since = ps->lastrecv;
+    long stall;
+
+    if(curlx_tvdiff(k->pipe_sent, since) > 0)
+      since = k->pipe_sent;
+    stall = curlx_tvdiff(now, since) - rtt;
+    if(stall > 0)
+      estimate += stall;
+
+    if(!k->header && (k->size >= 0) && ps->rate) {
+      /* the body is coming in and its size is known */
+      if(k->size > k->bytecount)
+        estimate += (long)((k->size - k->bytecount) * 1000 / ps->rate);
+      ahead--;
+    }
+  }
+
+  return estimate + busy * (long)ahead;
+}
+
 bool Curl_pipeline_site_blacklisted(struct SessionHandle *handle,
                                     struct connectdata *conn)
 {
   if(handle->multi) {
-    struct curl_llist *blacklist =
+    struct Curl_pipeline_bl *blacklist =
       Curl_multi_pipelining_site_bl(handle->multi);
 
     if(blacklist) {
-      struct curl_llist_element *curr;
+      struct site_blacklist_entry *site;
 
-      curr = blacklist->head;
-      while(curr) {
-        struct site_blacklist_entry *site;
-
-        site = curr->ptr;
-        if(Curl_raw_equal(site->hostname, conn->host.name) &&
-           site->port == conn->remote_port) {
+      site = Curl_hash_pick(&blacklist->names, conn->host.name,
+                            strlen(conn->host.name));
+      while(site) {
+        if(site->port == conn->remote_port) {
           infof(handle, "Site %s:%d is pipeline blacklisted\n",
                 conn->host.name, conn->remote_port);
           return TRUE;
         }
-        curr = curr->next;
+        site = site->next;
       }
     }
   }
@@ -190,54 +379,57 @@ bool Curl_pipeline_site_blacklisted(struct SessionHandle *handle,
 }
 
 CURLMcode Curl_pipeline_set_site_blacklist(char **sites,
-                                           struct curl_llist **list_ptr)
+                                           struct Curl_pipeline_bl **list_ptr)
 {
-  struct curl_llist *old_list = *list_ptr;
-  struct curl_llist *new_list = NULL;
+  struct Curl_pipeline_bl *new_list = NULL;
 
   if(sites) {
-    new_list = Curl_llist_alloc((curl_llist_dtor) site_blacklist_llist_dtor);
+    new_list = bl_alloc(site_blacklist_dtor);
     if(!new_list)
       return CURLM_OUT_OF_MEMORY;
 
-    /* Parse the URLs and populate the list */
+    /* Parse the host names and ports and populate the hash */
     while(*sites) {
-      char *hostname;
-      char *port;
+      const char *hostname = *sites;
+      const char *port = strchr(hostname, ':');
+      size_t len = port ? (size_t)(port - hostname) : strlen(hostname);
       struct site_blacklist_entry *entry;
+      struct site_blacklist_entry *first;
 
       entry = malloc(sizeof(struct site_blacklist_entry));
-
-      hostname = strdup(*sites);
-      if(!hostname)
+      if(!entry) {
+        bl_free(new_list);
         return CURLM_OUT_OF_MEMORY;
-
-      port = strchr(hostname, ':');
-      if(port) {
-        *port = '\0';
-        port++;
-        entry->port = (unsigned short)strtol(port, NULL, 10);
       }
-      else {
+
+      if(port)
+        entry->port = (unsigned short)strtol(port + 1, NULL, 10);
+      else
         /* Default port number for HTTP */
         entry->port = 80;
-      }
-
-      entry->hostname = hostname;
 
-      if(!Curl_llist_insert_next(new_list, new_list->tail, entry))
-        return CURLM_OUT_OF_MEMORY;
+      /* add the port to the ones already listed for the host */
+      first = Curl_hash_pick(&new_list->names, (void *)hostname, len);
+      if(first) {
+        entry->next = first->next;
+        first->next = entry;
+      }
+      else {
+        entry->next = NULL;
+        if(!Curl_hash_add(&new_list->names, (void *)hostname, len, entry)) {
+          free(entry);
+          bl_free(new_list);
+          return CURLM_OUT_OF_MEMORY;
+        }
+      }
 
       sites++;
     }
   }
 
-  /* Free the old list */
-  if(old_list) {
-    Curl_llist_destroy(old_list, NULL);
-  }
-
-  /* This might be NULL if sites == NULL, i.e the blacklist is cleared */
+  /* Free the old list. This is NULL if sites == NULL, i.e the blacklist is
+     cleared */
+  bl_free(*list_ptr);
   *list_ptr = new_list;
 
   return CURLM_OK;
@@ -246,24 +438,22 @@ CURLMcode Curl_pipeline_set_site_blacklist(char **sites,
 bool Curl_pipeline_server_blacklisted(struct SessionHandle *handle,
                                       char *server_name)
 {
-  if(handle->multi) {
-    struct curl_llist *blacklist =
+  if(handle->multi && server_name) {
+    struct Curl_pipeline_bl *blacklist =
       Curl_multi_pipelining_server_bl(handle->multi);
 
     if(blacklist) {
-      struct curl_llist_element *curr;
-
-      curr = blacklist->head;
-      while(curr) {
-        char *bl_server_name;
-
-        bl_server_name = curr->ptr;
-        if(Curl_raw_nequal(bl_server_name, server_name,
-                           strlen(bl_server_name))) {
+      size_t len = strlen(server_name);
+      size_t i;
+
+      /* the lengths are sorted, so stop at the first one that is too long */
+      for(i = 0; i < blacklist->nlengths && blacklist->lengths[i] <= len;
+          i++) {
+        if(Curl_hash_pick(&blacklist->names, server_name,
+                          blacklist->lengths[i])) {
           infof(handle, "Server %s is blacklisted\n", server_name);
           return TRUE;
         }
-        curr = curr->next;
       }
     }
 
@@ -272,44 +462,62 @@ bool Curl_pipeline_server_blacklisted(struct SessionHandle *handle,
   return FALSE;
 }
 
-CURLMcode Curl_pipeline_set_server_blacklist(char **servers,
-                                             struct curl_llist **list_ptr)
+CURLMcode
+Curl_pipeline_set_server_blacklist(char **servers,
+                                   struct Curl_pipeline_bl **list_ptr)
 {
-  struct curl_llist *old_list = *list_ptr;
-  struct curl_llist *new_list = NULL;
+  struct Curl_pipeline_bl *new_list = NULL;
 
   if(servers) {
-    new_list = Curl_llist_alloc((curl_llist_dtor) server_blacklist_llist_dtor);
+    size_t count = 0;
+
+    new_list = bl_alloc(server_blacklist_dtor);
     if(!new_list)
       return CURLM_OUT_OF_MEMORY;
 
-    /* Parse the URLs and populate the list */
-    while(*servers) {
-      char *server_name;
+    while(servers[count])
+      count++;
 
-      server_name = strdup(*servers);
-      if(!server_name)
+    if(count) {
+      new_list->lengths = malloc(count * sizeof(size_t));
+      if(!new_list->lengths) {
+        bl_free(new_list);
         return CURLM_OUT_OF_MEMORY;
+      }
+    }
+
+    /* Populate the hash with the server names */
+    while(*servers) {
+      size_t len = strlen(*servers);
+      size_t i;
 
-      if(!Curl_llist_insert_next(new_list, new_list->tail, server_name))
+      if(!Curl_hash_add(&new_list->names, *servers, len, new_list)) {
+        bl_free(new_list);
         return CURLM_OUT_OF_MEMORY;
+      }
+
+      /* keep the lengths sorted and unique */
+      for(i = 0; i < new_list->nlengths && new_list->lengths[i] < len; i++)
+        ;
+      if(i == new_list->nlengths || new_list->lengths[i] != len) {
+        memmove(&new_list->lengths[i + 1], &new_list->lengths[i],
+                (new_list->nlengths - i) * sizeof(size_t));
+        new_list->lengths[i] = len;
+        new_list->nlengths++;
+      }
 
       servers++;
     }
   }
 
-  /* Free the old list */
-  if(old_list) {
-    Curl_llist_destroy(old_list, NULL);
-  }
-
-  /* This might be NULL if sites == NULL, i.e the blacklist is cleared */
+  /* Free the old list. This is NULL if servers == NULL, i.e the blacklist
+     is cleared */
+  bl_free(*list_ptr);
   *list_ptr = new_list;
 
   return CURLM_OK;
 }
 
-
 void print_pipeline(struct connectdata *conn)
 {
   struct curl_llist_element *curr;
@@ -318,7 +526,8 @@ void print_pipeline(struct connectdata *conn)
 
   cb_ptr = conn->bundle;
 
-  if(cb_ptr) {
+  /* this walks every connection to the host, only do it when it shows */
+  if(cb_ptr && data && data->set.verbose) {
     curr = cb_ptr->conn_list->head;
     while(curr) {
       conn = curr->ptr;
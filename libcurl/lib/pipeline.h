@@ -22,6 +22,8 @@
  *
  ***************************************************************************/
 
+struct Curl_pipeline_bl; /* declared and used only in pipeline.c */
+
 CURLcode Curl_add_handle_to_pipeline(struct SessionHandle *handle,
                                      struct connectdata *conn);
 void Curl_move_handle_from_send_to_recv_pipe(struct SessionHandle *handle,
@@ -29,17 +31,30 @@ void Curl_move_handle_from_send_to_recv_pipe(struct SessionHandle *handle,
 bool Curl_pipeline_penalized(struct SessionHandle *data,
                              struct connectdata *conn);
 
+void Curl_pipeline_received(struct SessionHandle *data,
+                            struct connectdata *conn);
+
+void Curl_pipeline_done(struct SessionHandle *data,
+                        struct connectdata *conn);
+
+/* A request is rather held back than added to a pipe where it is expected
+   to wait this many milliseconds longer than on a full one */
+#define PIPE_WAIT_SLACK 10
+
+long Curl_pipeline_estimate(struct connectdata *conn, struct timeval now);
+
 bool Curl_pipeline_site_blacklisted(struct SessionHandle *handle,
                                     struct connectdata *conn);
 
 CURLMcode Curl_pipeline_set_site_blacklist(char **sites,
-                                           struct curl_llist **list_ptr);
+                                           struct Curl_pipeline_bl **list_ptr);
 
 bool Curl_pipeline_server_blacklisted(struct SessionHandle *handle,
                                       char *server_name);
 
-CURLMcode Curl_pipeline_set_server_blacklist(char **servers,
-                                             struct curl_llist **list_ptr);
+CURLMcode
+Curl_pipeline_set_server_blacklist(char **servers,
+                                   struct Curl_pipeline_bl **list_ptr);
 
 void print_pipeline(struct connectdata *conn);
 
@@ -514,16 +514,14 @@ CURLcode Curl_read_plain(curl_socket_t sockfd,
 }
 
 /*
- * Internal read-from-socket function. This is meant to deal with plain
- * sockets, SSL sockets and kerberos sockets.
- *
- * Returns a regular CURLcode value.
+ * Reads at most 'maxread' bytes, or BUFSIZE when pipelining, into 'buf'.
  */
-CURLcode Curl_read(struct connectdata *conn, /* connection data */
-                   curl_socket_t sockfd,     /* read from this socket */
-                   char *buf,                /* store read data here */
-                   size_t sizerequested,     /* max amount to read */
-                   ssize_t *n)               /* amount bytes read */
+static CURLcode read_socket(struct connectdata *conn,
+                            curl_socket_t sockfd,
+                            char *buf,
+                            size_t sizerequested,
+                            size_t maxread,
+                            ssize_t *n)
 {
   CURLcode curlcode = CURLE_RECV_ERROR;
   ssize_t nread = 0;
@@ -558,9 +556,7 @@ CURLcode Curl_read(struct connectdata *conn, /* connection data */
     buffertofill = conn->master_buffer;
   }
   else {
-    bytesfromsocket = CURLMIN((long)sizerequested,
-                              conn->data->set.buffer_size ?
-                              conn->data->set.buffer_size : BUFSIZE);
+    bytesfromsocket = CURLMIN(sizerequested, maxread);
     buffertofill = buf;
   }
 
@@ -579,6 +575,37 @@ CURLcode Curl_read(struct connectdata *conn, /* connection data */
   return CURLE_OK;
 }
 
+/*
+ * Internal read-from-socket function. This is meant to deal with plain
+ * sockets, SSL sockets and kerberos sockets.
+ *
+ * Returns a regular CURLcode value.
+ */
+CURLcode Curl_read(struct connectdata *conn, /* connection data */
+                   curl_socket_t sockfd,     /* read from this socket */
+                   char *buf,                /* store read data here */
+                   size_t sizerequested,     /* max amount to read */
+                   ssize_t *n)               /* amount bytes read */
+{
+  size_t maxread = conn->data->set.buffer_size ?
+    (size_t)conn->data->set.buffer_size : BUFSIZE;
+
+  return read_socket(conn, sockfd, buf, sizerequested, maxread, n);
+}
+
+/*
+ * Curl_read() into a buffer of the application's, which is not limited to
+ * CURLOPT_BUFFERSIZE. Only the size of the buffer limits the read.
+ */
+CURLcode Curl_read_into(struct connectdata *conn,
+                        curl_socket_t sockfd,
+                        char *buf,
+                        size_t size,
+                        ssize_t *n)
+{
+  return read_socket(conn, sockfd, buf, size, size, n);
+}
+
 /* return 0 on success */
 static int showit(struct SessionHandle *data, curl_infotype type,
                   char *ptr, size_t size)
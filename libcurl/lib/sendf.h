@@ -69,6 +69,10 @@ ssize_t Curl_send_plain(struct connectdata *conn, int num,
 CURLcode Curl_read(struct connectdata *conn, curl_socket_t sockfd,
                    char *buf, size_t buffersize,
                    ssize_t *n);
+/* the same, into a buffer of the application's of any size */
+CURLcode Curl_read_into(struct connectdata *conn, curl_socket_t sockfd,
+                        char *buf, size_t size,
+                        ssize_t *n);
 /* internal write-function, does plain socket, SSL, SCP, SFTP and krb4 */
 CURLcode Curl_write(struct connectdata *conn,
                     curl_socket_t sockfd,
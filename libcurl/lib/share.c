@@ -116,7 +116,7 @@ curl_share_setopt(CURLSH *sh, CURLSHoption option, ...)
     switch( type ) {
     case CURL_LOCK_DATA_DNS:
       if(share->hostcache) {
-        Curl_hash_destroy(share->hostcache);
+        Curl_dnscache_destroy(share->hostcache);
         share->hostcache = NULL;
       }
       break;
@@ -193,7 +193,7 @@ curl_share_cleanup(CURLSH *sh)
   }
 
   if(share->hostcache) {
-    Curl_hash_destroy(share->hostcache);
+    Curl_dnscache_destroy(share->hostcache);
     share->hostcache = NULL;
   }
 
@@ -0,0 +1,358 @@
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) 1998 - 2013, Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at http://curl.haxx.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ ***************************************************************************/
+
+
+#include "curl_setup.h"
+
+#include "timewheel.h"
+
+#include "curl_memory.h"
+/* The last #include file should be: */
+#include "memdebug.h"
+
+/* Curl_timer.where: 0 when not queued, -1 on the expired list and the slot
+   number plus one otherwise */
+#define TIMER_IDLE     0
+#define TIMER_EXPIRED -1
+
+#define SLOTMASK (CURL_TIMEWHEEL_SLOTS - 1)
+#define SLOT(level, index) ((level) * CURL_TIMEWHEEL_SLOTS + (int)(index))
+
+/* ticks wrap around, so they are compared by their signed difference */
+#define TICKDIFF(a, b) ((int)((a) - (b)))
+
+#if defined(__GNUC__) && ((__GNUC__ > 3) || \
+                          ((__GNUC__ == 3) && (__GNUC_MINOR__ >= 4)))
+#define lowest_bit(x) __builtin_ctz(x)
+#else
+/* index of the lowest bit set in a non-zero 'bits' */
+static int lowest_bit(unsigned int bits)
+{
+  int n = 0;
+
+  while(!(bits & 1)) {
+    bits >>= 1;
+    n++;
+  }
+  return n;
+}
+#endif
+
+unsigned int Curl_timewheel_ms(struct timeval tv)
+{
+  return (unsigned int)tv.tv_sec * 1000U + (unsigned int)tv.tv_usec / 1000U;
+}
+
+void Curl_timewheel_init(struct Curl_timewheel *w, unsigned int now)
+{
+  memset(w, 0, sizeof(struct Curl_timewheel));
+  w->now = now;
+}
+
+static void expired_append(struct Curl_timewheel *w, struct Curl_timer *t)
+{
+  t->next = NULL;
+  t->prev = w->expired_tail;
+  if(w->expired_tail)
+    w->expired_tail->next = t;
+  else
+    w->expired = t;
+  w->expired_tail = t;
+  t->where = TIMER_EXPIRED;
+}
+
+/*
+ * Put a timer in the slot for its expiry time as seen from w->now: the first
+ * level if it expires within CURL_TIMEWHEEL_SLOTS ticks, the second within
+ * CURL_TIMEWHEEL_SLOTS squared and so on. A timer that is due goes straight
+ * to the expired list.
+ */
+static void queue_timer(struct Curl_timewheel *w, struct Curl_timer *t)
+{
+  unsigned int delta;
+  unsigned int index;
+  int level = 0;
+  int slot;
+
+  if(TICKDIFF(t->expire, w->now) <= 0) {
+    expired_append(w, t);
+    return;
+  }
+
+  delta = t->expire - w->now;
+  if(delta > CURL_TIMEWHEEL_MAX) {
+    t->expire = w->now + CURL_TIMEWHEEL_MAX;
+    delta = CURL_TIMEWHEEL_MAX;
+  }
+
+  while(delta >> (CURL_TIMEWHEEL_BITS * (level + 1)))
+    level++;
+
+  index = (t->expire >> (CURL_TIMEWHEEL_BITS * level)) & SLOTMASK;
+  slot = SLOT(level, index);
+
+  t->prev = NULL;
+  t->next = w->slots[slot];
+  if(t->next)
+    t->next->prev = t;
+  w->slots[slot] = t;
+  w->occupied[level] |= 1U << index;
+  t->where = slot + 1;
+}
+
+static void unlink_timer(struct Curl_timewheel *w, struct Curl_timer *t)
+{
+  if(t->where == TIMER_EXPIRED) {
+    if(t->prev)
+      t->prev->next = t->next;
+    else
+      w->expired = t->next;
+    if(t->next)
+      t->next->prev = t->prev;
+    else
+      w->expired_tail = t->prev;
+  }
+  else {
+    int slot = t->where - 1;
+
+    if(t->prev)
+      t->prev->next = t->next;
+    else
+      w->slots[slot] = t->next;
+    if(t->next)
+      t->next->prev = t->prev;
+    if(!w->slots[slot])
+      w->occupied[slot / CURL_TIMEWHEEL_SLOTS] &= ~(1U << (slot & SLOTMASK));
+  }
+
+  t->next = t->prev = NULL;
+  t->where = TIMER_IDLE;
+}
+
+/*
+ * Add a timer that expires at tick 'expire', which must be less than
+ * CURL_TIMEWHEEL_MAX ticks away. A timer that is already queued is moved.
+ */
+void Curl_timewheel_add(struct Curl_timewheel *w, struct Curl_timer *t,
+                        unsigned int expire)
+{
+  if(t->where != TIMER_IDLE)
+    Curl_timewheel_remove(w, t);
+
+  t->expire = expire;
+  queue_timer(w, t);
+
+  if(w->next_valid && (t->where != TIMER_EXPIRED) &&
+     (TICKDIFF(t->expire, w->next) < 0))
+    w->next = t->expire;
+}
+
+void Curl_timewheel_remove(struct Curl_timewheel *w, struct Curl_timer *t)
+{
+  if(t->where == TIMER_IDLE)
+    return;
+
+  if(w->next_valid && (t->where != TIMER_EXPIRED) &&
+     (t->expire == w->next))
+    /* the earliest one is going away, find the next one when asked */
+    w->next_valid = FALSE;
+
+  unlink_timer(w, t);
+}
+
+/* re-queue the timers of the current slot of 'level' as seen from w->now,
+   and the current slot of the level above when this one wrapped around */
+static void cascade(struct Curl_timewheel *w, int level)
+{
+  unsigned int index = (w->now >> (CURL_TIMEWHEEL_BITS * level)) & SLOTMASK;
+  int slot = SLOT(level, index);
+  struct Curl_timer *t = w->slots[slot];
+
+  w->slots[slot] = NULL;
+  w->occupied[level] &= ~(1U << index);
+
+  while(t) {
+    struct Curl_timer *next = t->next;
+    queue_timer(w, t);
+    t = next;
+  }
+
+  if(!index && (level + 1 < CURL_TIMEWHEEL_LEVELS))
+    cascade(w, level + 1);
+}
+
+static bool wheel_empty(struct Curl_timewheel *w)
+{
+  int level;
+
+  for(level = 0; level < CURL_TIMEWHEEL_LEVELS; level++)
+    if(w->occupied[level])
+      return FALSE;
+  return TRUE;
+}
+
+/*
+ * Move w->now forward to 'now', cascading the wider slots as their time
+ * comes and moving the timers of the first level slots passed on to the
+ * expired list. Runs of empty first level slots are skipped over.
+ */
+static void advance(struct Curl_timewheel *w, unsigned int now)
+{
+  if(w->next_valid && (TICKDIFF(w->next, now) <= 0))
+    w->next_valid = FALSE;
+
+  while(TICKDIFF(now, w->now) > 0) {
+    unsigned int tick = w->now + 1;
+    unsigned int index = tick & SLOTMASK;
+    struct Curl_timer *t;
+    int slot;
+
+    if(wheel_empty(w)) {
+      w->now = now;
+      break;
+    }
+
+    if(index) {
+      /* the next occupied slot in this turn of the first level, or the
+         start of the next turn */
+      unsigned int bits = w->occupied[0] >> index;
+      unsigned int stop = tick + (bits ? (unsigned int)lowest_bit(bits) :
+                                  CURL_TIMEWHEEL_SLOTS - index);
+
+      if(TICKDIFF(stop, now) > 0) {
+        w->now = now;
+        break;
+      }
+      if(!bits) {
+        w->now = stop - 1;
+        continue;
+      }
+      tick = stop;
+      w->now = tick;
+    }
+    else {
+      w->now = tick;
+      cascade(w, 1);
+    }
+
+    slot = SLOT(0, tick & SLOTMASK);
+    t = w->slots[slot];
+    w->slots[slot] = NULL;
+    w->occupied[0] &= ~(1U << (tick & SLOTMASK));
+    while(t) {
+      struct Curl_timer *next = t->next;
+      expired_append(w, t);
+      t = next;
+    }
+  }
+}
+
+/*
+ * Return an expired timer, taken off the wheel, or NULL when none expires
+ * at or before the tick 'now'.
+ */
+struct Curl_timer *Curl_timewheel_getexpired(struct Curl_timewheel *w,
+                                             unsigned int now)
+{
+  struct Curl_timer *t;
+
+  advance(w, now);
+
+  t = w->expired;
+  if(t)
+    unlink_timer(w, t);
+  return t;
+}
+
+/*
+ * Find the earliest expiry time in the slots. The slots of a level are in
+ * time order starting after the current one, and every timer in a slot of a
+ * wider level expires at or after the tick the slot gets cascaded at, so
+ * only the first occupied slot of each level needs to be looked at, and
+ * only when that could beat what the finer levels had.
+ */
+static bool find_next(struct Curl_timewheel *w, unsigned int *expire)
+{
+  bool found = FALSE;
+  unsigned int best = 0;
+  int level;
+
+  for(level = 0; level < CURL_TIMEWHEEL_LEVELS; level++) {
+    int shift = CURL_TIMEWHEEL_BITS * level;
+    unsigned int bits = w->occupied[level];
+    unsigned int start = ((w->now >> shift) + 1) & SLOTMASK;
+    unsigned int pos;
+    unsigned int first;
+    struct Curl_timer *t;
+
+    if(!bits)
+      continue;
+
+    if(start)
+      bits = ((bits >> start) | (bits << (CURL_TIMEWHEEL_SLOTS - start))) &
+        0xffffffffU;
+    pos = (unsigned int)lowest_bit(bits);
+
+    /* the tick this slot starts at */
+    first = ((w->now >> shift) + 1 + pos) << shift;
+    if(found && (TICKDIFF(first, best) >= 0))
+      continue;
+
+    if(level) {
+      /* the timers of a wider slot expire at different ticks */
+      t = w->slots[SLOT(level, (start + pos) & SLOTMASK)];
+      first = t->expire;
+      for(t = t->next; t; t = t->next)
+        if(TICKDIFF(t->expire, first) < 0)
+          first = t->expire;
+    }
+
+    if(!found || (TICKDIFF(first, best) < 0))
+      best = first;
+    found = TRUE;
+  }
+
+  *expire = best;
+  return found;
+}
+
+/*
+ * Get the tick the earliest timer expires at. Returns FALSE if there are no
+ * timers. An expired timer that hasn't been taken off yet counts as the
+ * earliest.
+ */
+bool Curl_timewheel_next(struct Curl_timewheel *w, unsigned int *expire)
+{
+  if(w->expired) {
+    *expire = w->expired->expire;
+    return TRUE;
+  }
+
+  if(!w->next_valid) {
+    if(!find_next(w, &w->next))
+      return FALSE;
+    w->next_valid = TRUE;
+  }
+
+  *expire = w->next;
+  return TRUE;
+}
@@ -0,0 +1,81 @@
+#ifndef HEADER_CURL_TIMEWHEEL_H
+#define HEADER_CURL_TIMEWHEEL_H
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) 1998 - 2013, Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at http://curl.haxx.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ ***************************************************************************/
+#include "curl_setup.h"
+
+/*
+ * A hierarchical timer wheel. Timers expire at a tick, a millisecond count
+ * that wraps around. They are kept in slots: the first level has one slot
+ * per tick and each following level has slots CURL_TIMEWHEEL_SLOTS times as
+ * wide as the level before. As time advances the timers of the wider slots
+ * are cascaded down into the finer ones, and the first level slots that are
+ * passed have their timers moved to a list of expired timers. Adding and
+ * removing a timer is O(1) and expiring them is done in batches.
+ */
+
+#define CURL_TIMEWHEEL_BITS   5
+#define CURL_TIMEWHEEL_SLOTS  (1 << CURL_TIMEWHEEL_BITS)
+#define CURL_TIMEWHEEL_LEVELS 6
+
+/* the farthest into the future a timer can be set, in ticks (12.4 days) */
+#define CURL_TIMEWHEEL_MAX \
+  ((1U << (CURL_TIMEWHEEL_BITS * CURL_TIMEWHEEL_LEVELS)) - 1)
+
+struct Curl_timer {
+  struct Curl_timer *next;    /* within the slot or the expired list */
+  struct Curl_timer *prev;
+  struct Curl_timer *sibling; /* for the owner to keep its timers on */
+  unsigned int expire;        /* the tick the timer expires at */
+  int where;                  /* what it is queued in, 0 for nothing */
+  void *payload;              /* data the wheel doesn't care about */
+};
+
+struct Curl_timewheel {
+  unsigned int now;           /* ticks up to and including this are done */
+  unsigned int next;          /* earliest expiry in the slots, when
+                                 'next_valid' is set */
+  bool next_valid;
+  unsigned int occupied[CURL_TIMEWHEEL_LEVELS]; /* a bit per non-empty slot */
+  struct Curl_timer *slots[CURL_TIMEWHEEL_LEVELS * CURL_TIMEWHEEL_SLOTS];
+  struct Curl_timer *expired; /* expired timers, in the order they expired */
+  struct Curl_timer *expired_tail;
+};
+
+/* the tick for a point in time */
+unsigned int Curl_timewheel_ms(struct timeval tv);
+
+void Curl_timewheel_init(struct Curl_timewheel *w, unsigned int now);
+
+void Curl_timewheel_add(struct Curl_timewheel *w, struct Curl_timer *t,
+                        unsigned int expire);
+
+void Curl_timewheel_remove(struct Curl_timewheel *w, struct Curl_timer *t);
+
+struct Curl_timer *Curl_timewheel_getexpired(struct Curl_timewheel *w,
+                                             unsigned int now);
+
+bool Curl_timewheel_next(struct Curl_timewheel *w, unsigned int *expire);
+
+#define Curl_timewheel_queued(t) ((t)->where != 0)
+
+#endif /* HEADER_CURL_TIMEWHEEL_H */
@@ -80,6 +80,7 @@
 #include "multiif.h"
 #include "connect.h"
 #include "non-ascii.h"
+#include "pipeline.h"
 
 #define _MPRINTF_REPLACE /* use our functions only */
 #include <curl/mprintf.h>
@@ -332,6 +333,37 @@ static void read_rewind(struct connectdata *conn,
 #endif
 }
 
+/*
+ * Asks the CURLOPT_RECVBUFFERFUNCTION for a buffer to receive the next piece
+ * of the response body into, and stores its size in *size. Returns NULL when
+ * our own buffer is to be used: there is no such callback, headers are still
+ * being read, or the data has to be decoded or kept around in our buffers.
+ */
+static char *app_recvbuffer(struct SessionHandle *data,
+                            struct connectdata *conn,
+                            struct SingleRequest *k,
+                            size_t *size)
+{
+  char *buf;
+  size_t bufsize = 0;
+
+  if(!data->set.frecvbuffer || k->header || k->ignorebody ||
+     conn->handler->readwrite || data->set.http_te_skip ||
+     (k->keepon & KEEP_RECV_PAUSE) ||
+     Curl_multi_pipeline_enabled(data->multi))
+    return NULL;
+
+  if(k->unencode)
+    return NULL;
+
+  buf = data->set.frecvbuffer(&bufsize, data->set.recvbuffer_client);
+  if(!buf || !bufsize)
+    return NULL;
+
+  *size = bufsize;
+  return buf;
+}
+
 /*
  * Check to see if CURLOPT_TIMECONDITION was met by comparing the time of the
  * remote document with the time provided by CURLOPT_TIMEVAL
@@ -387,7 +419,11 @@ static CURLcode readwrite_data(struct SessionHandle *data,
   do {
     size_t buffersize = data->set.buffer_size?
       data->set.buffer_size : BUFSIZE;
-    size_t bytestoread = buffersize;
+    size_t bytestoread;
+
+    /* the body may go straight into a buffer of the application's */
+    k->recvbuf = app_recvbuffer(data, conn, k, &buffersize);
+    bytestoread = buffersize;
 
     if(k->size != -1 && !k->header) {
       /* make sure we don't read "too much" if we can help it since we
@@ -400,7 +436,11 @@ static CURLcode readwrite_data(struct SessionHandle *data,
 
     if(bytestoread) {
       /* receive data from the network! */
-      result = Curl_read(conn, conn->sockfd, k->buf, bytestoread, &nread);
+      if(k->recvbuf)
+        result = Curl_read_into(conn, conn->sockfd, k->recvbuf, bytestoread,
+                                &nread);
+      else
+        result = Curl_read(conn, conn->sockfd, k->buf, bytestoread, &nread);
 
       /* read would've blocked */
       if(CURLE_AGAIN == result)
@@ -426,9 +466,11 @@ static CURLcode readwrite_data(struct SessionHandle *data,
     /* indicates data of zero size, i.e. empty file */
     is_empty_data = ((nread == 0) && (k->bodywrites == 0)) ? TRUE : FALSE;
 
-    /* NUL terminate, allowing string ops to be used */
+    /* NUL terminate, allowing string ops to be used. There is no room for
+       that in the application's buffer, and body data needs none. */
     if(0 < nread || is_empty_data) {
-      k->buf[nread] = 0;
+      if(!k->recvbuf)
+        k->buf[nread] = 0;
     }
     else if(0 >= nread) {
       /* if we receive 0 or less here, the server closed the connection
@@ -440,7 +482,7 @@ static CURLcode readwrite_data(struct SessionHandle *data,
 
     /* Default buffer to use when we write the buffer, it may be changed
        in the flow below before the actual storing is done. */
-    k->str = k->buf;
+    k->str = k->recvbuf ? k->recvbuf : k->buf;
 
     if(conn->handler->readwrite) {
       result = conn->handler->readwrite(data, conn, &nread, &readmore);
@@ -680,54 +722,26 @@ static CURLcode readwrite_data(struct SessionHandle *data,
             return result;
         }
         if(k->badheader < HEADER_ALLBAD) {
-          /* This switch handles various content encodings. If there's an
-             error here, be sure to check over the almost identical code
-             in http_chunks.c.
-             Make sure that ALL_CONTENT_ENCODINGS contains all the
-             encodings handled here. */
-#ifdef HAVE_LIBZ
-          switch (conn->data->set.http_ce_skip ?
-                  IDENTITY : k->auto_decoding) {
-          case IDENTITY:
-#endif
+          /* Content encodings are undone by the decoding stages set up
+             while parsing the headers, see content_encoding.c. This is
+             done the same way in http_chunks.c. */
+          if(k->unencode) {
+            /* Assume CLIENTWRITE_BODY; headers are not encoded. */
+            if(!k->ignorebody)
+              result = Curl_unencode_write(conn, k->str, (size_t)nread);
+          }
+          else if(!k->ignorebody) {
             /* This is the default when the server sends no
-               Content-Encoding header. See Curl_readwrite_init; the
-               memset() call initializes k->auto_decoding to zero. */
-            if(!k->ignorebody) {
-
+               Content-Encoding header. */
 #ifndef CURL_DISABLE_POP3
-              if(conn->handler->protocol&CURLPROTO_POP3)
-                result = Curl_pop3_write(conn, k->str, nread);
-              else
+            if(conn->handler->protocol&CURLPROTO_POP3)
+              result = Curl_pop3_write(conn, k->str, nread);
+            else
 #endif /* CURL_DISABLE_POP3 */
 
-                result = Curl_client_write(conn, CLIENTWRITE_BODY, k->str,
-                                           nread);
-            }
-#ifdef HAVE_LIBZ
-            break;
-
-          case DEFLATE:
-            /* Assume CLIENTWRITE_BODY; headers are not encoded. */
-            if(!k->ignorebody)
-              result = Curl_unencode_deflate_write(conn, k, nread);
-            break;
-
-          case GZIP:
-            /* Assume CLIENTWRITE_BODY; headers are not encoded. */
-            if(!k->ignorebody)
-              result = Curl_unencode_gzip_write(conn, k, nread);
-            break;
-
-          case COMPRESS:
-          default:
-            failf (data, "Unrecognized content encoding type. "
-                   "libcurl understands `identity', `deflate' and `gzip' "
-                   "content encodings.");
-            result = CURLE_BAD_CONTENT_ENCODING;
-            break;
+              result = Curl_client_write(conn, CLIENTWRITE_BODY, k->str,
+                                         nread);
           }
-#endif
         }
         k->badheader = HEADER_NORMAL; /* taken care of now */
 
@@ -735,6 +749,14 @@ static CURLcode readwrite_data(struct SessionHandle *data,
           return result;
       }
 
+      if(k->unencode) {
+        /* the decoded body is gathered in a buffer to be handed to the
+           client in as few calls as possible, pass on what this read gave */
+        result = Curl_unencode_flush(conn);
+        if(result)
+          return result;
+      }
+
     } /* if(! header and data to read ) */
 
     if(conn->handler->readwrite &&
@@ -1020,6 +1042,8 @@ CURLcode Curl_readwrite(struct connectdata *conn,
      ((select_res & CURL_CSELECT_IN) || conn->bits.stream_was_rewound)) {
 
     result = readwrite_data(data, conn, k, &didwhat, done);
+    if(!result && (didwhat & KEEP_RECV))
+      Curl_pipeline_received(data, conn);
     if(result || *done)
       return result;
   }
@@ -398,13 +398,9 @@ CURLcode Curl_close(struct SessionHandle *data)
        use and this is the one */
     curl_multi_cleanup(data->multi_easy);
 
-  /* Destroy the timeout list that is held in the easy handle. It is
-     /normally/ done by curl_multi_remove_handle() but this is "just in
-     case" */
-  if(data->state.timeoutlist) {
-    Curl_llist_destroy(data->state.timeoutlist, NULL);
-    data->state.timeoutlist = NULL;
-  }
+  /* Free the timers held in the easy handle. The pending ones are /normally/
+     cleared by curl_multi_remove_handle() but this is "just in case" */
+  Curl_expire_free(data);
 
   data->magic = 0; /* force a clear AFTER the possibly enforced removal from
                       the multi handle, since that function uses the magic
@@ -423,6 +419,7 @@ CURLcode Curl_close(struct SessionHandle *data)
   Curl_ssl_close_all(data);
   Curl_safefree(data->state.first_host);
   Curl_safefree(data->state.scratch);
+  Curl_safefree(data->state.unencbuf);
   Curl_ssl_free_certinfo(data);
 
   if(data->change.referer_alloc) {
@@ -1623,6 +1620,19 @@ CURLcode Curl_setopt(struct SessionHandle *data, CURLoption option,
 
     break;
 
+  case CURLOPT_RECVBUFFERFUNCTION:
+    /*
+     * Callback providing the buffers to receive bodies into
+     */
+    data->set.frecvbuffer = va_arg(param, curl_recvbuffer_callback);
+    break;
+  case CURLOPT_RECVBUFFERDATA:
+    /*
+     * Custom pointer to pass to the recvbuffer callback
+     */
+    data->set.recvbuffer_client = va_arg(param, void *);
+    break;
+
   case CURLOPT_PROGRESSDATA:
     /*
      * Custom client data to pass to the progress callback
@@ -2751,46 +2761,8 @@ static void signalPipeClose(struct curl_llist *pipeline, bool pipe_broke)
 static struct connectdata *
 find_oldest_idle_connection(struct SessionHandle *data)
 {
-  struct conncache *bc = data->state.conn_cache;
-  struct curl_hash_iterator iter;
-  struct curl_llist_element *curr;
-  struct curl_hash_element *he;
-  long highscore=-1;
-  long score;
-  struct timeval now;
-  struct connectdata *conn_candidate = NULL;
-  struct connectbundle *bundle;
-
-  now = Curl_tvnow();
-
-  Curl_hash_start_iterate(bc->hash, &iter);
-
-  he = Curl_hash_next_element(&iter);
-  while(he) {
-    struct connectdata *conn;
-
-    bundle = he->ptr;
-
-    curr = bundle->conn_list->head;
-    while(curr) {
-      conn = curr->ptr;
-
-      if(!conn->inuse) {
-        /* Set higher score for the age passed since the connection was used */
-        score = Curl_tvdiff(now, conn->now);
-
-        if(score > highscore) {
-          highscore = score;
-          conn_candidate = conn;
-        }
-      }
-      curr = curr->next;
-    }
-
-    he = Curl_hash_next_element(&iter);
-  }
-
-  return conn_candidate;
+  /* the idle list is kept in most recently used order */
+  return data->state.conn_cache->idle_tail;
 }
 
 /*
@@ -2804,34 +2776,60 @@ static struct connectdata *
 find_oldest_idle_connection_in_bundle(struct SessionHandle *data,
                                       struct connectbundle *bundle)
 {
-  struct curl_llist_element *curr;
-  long highscore=-1;
-  long score;
-  struct timeval now;
-  struct connectdata *conn_candidate = NULL;
+  (void)data;
+
+  return bundle->idle_tail;
+}
+
+/*
+ * Returns TRUE if the peer has closed this idle connection, or something
+ * else was sent on it that we did not ask for.
+ */
+static bool IdleConnectionIsDead(struct connectdata *conn)
+{
+  if(conn->handler->protocol & CURLPROTO_RTSP)
+    /* RTSP is a special case due to RTP interleaving */
+    return Curl_rtsp_connisdead(conn);
+
+  return SocketIsDead(conn->sock[FIRSTSOCKET]);
+}
+
+/*
+ * Closes the idle connections of the handle's connection cache that have not
+ * been used for CURLMOPT_IDLE_TIMEOUT milliseconds or that are dead. This
+ * walks all idle connections, so it only runs when
+ * CURL_CONNCACHE_PRUNE_INTERVAL has passed since the last time.
+ */
+void Curl_prune_idle_connections(struct SessionHandle *data)
+{
+  struct conncache *connc = data->state.conn_cache;
+  long idle_timeout = Curl_multi_idle_timeout(data->multi);
   struct connectdata *conn;
+  struct timeval now;
 
-  (void)data;
+  if(!connc || !connc->num_idle)
+    return;
 
   now = Curl_tvnow();
+  if(Curl_tvdiff(now, connc->last_prune) < CURL_CONNCACHE_PRUNE_INTERVAL)
+    return;
+  connc->last_prune = now;
 
-  curr = bundle->conn_list->head;
-  while(curr) {
-    conn = curr->ptr;
-
-    if(!conn->inuse) {
-      /* Set higher score for the age passed since the connection was used */
-      score = Curl_tvdiff(now, conn->now);
+  /* oldest first */
+  conn = connc->idle_tail;
+  while(conn) {
+    struct connectdata *prev = conn->cache_idle_prev;
+    bool expired = (idle_timeout > 0) &&
+      (Curl_tvdiff(now, conn->idle_since) >= idle_timeout);
 
-      if(score > highscore) {
-        highscore = score;
-        conn_candidate = conn;
-      }
+    if(expired || IdleConnectionIsDead(conn)) {
+      conn->data = data;
+      infof(data, "Closing %s connection %ld\n",
+            expired ? "idle" : "dead", conn->connection_id);
+      (void)Curl_disconnect(conn, /* dead_connection */ !expired);
     }
-    curr = curr->next;
+    conn = prev;
   }
-
-  return conn_candidate;
 }
 
 /*
@@ -2873,7 +2871,12 @@ ConnectionExists(struct SessionHandle *data,
   if(bundle) {
     size_t max_pipe_len = Curl_multi_max_pipeline_length(data->multi);
     size_t best_pipe_len = max_pipe_len;
+    long best_estimate = 0;
+    struct connectdata *full_pick = NULL;
+    long full_estimate = 0;
     struct curl_llist_element *curr;
+    struct connectdata *idle;
+    struct timeval now;
 
     infof(data, "Found bundle for host %s: %p\n",
           needle->host.name, (void *)bundle);
@@ -2884,8 +2887,20 @@ ConnectionExists(struct SessionHandle *data,
       canPipeline = FALSE;
     }
 
-    curr = bundle->conn_list->head;
-    while(curr) {
+    /* Without pipelining only an idle connection can be re-used, so then
+       only the bundle's idle list is looked at, most recently used first.
+       With pipelining the connections in use are candidates too. */
+    if(canPipeline) {
+      curr = bundle->conn_list->head;
+      idle = NULL;
+      now = Curl_tvnow();
+    }
+    else {
+      curr = NULL;
+      idle = bundle->idle_head;
+    }
+
+    while(curr || idle) {
       bool match = FALSE;
       bool credentialsMatch = FALSE;
       size_t pipeLen;
@@ -2894,8 +2909,14 @@ ConnectionExists(struct SessionHandle *data,
        * Note that if we use a HTTP proxy, we check connections to that
        * proxy and not to the actual remote server.
        */
-      check = curr->ptr;
-      curr = curr->next;
+      if(curr) {
+        check = curr->ptr;
+        curr = curr->next;
+      }
+      else {
+        check = idle;
+        idle = idle->bundle_idle_next;
+      }
 
       pipeLen = check->send_pipe->size + check->recv_pipe->size;
 
@@ -2903,17 +2924,11 @@ ConnectionExists(struct SessionHandle *data,
         /* The check for a dead socket makes sense only if there are no
            handles in pipeline and the connection isn't already marked in
            use */
-        bool dead;
-        if(check->handler->protocol & CURLPROTO_RTSP)
-          /* RTSP is a special case due to RTP interleaving */
-          dead = Curl_rtsp_connisdead(check);
-        else
-          dead = SocketIsDead(check->sock[FIRSTSOCKET]);
-
-        if(dead) {
+        if(IdleConnectionIsDead(check)) {
           check->data = data;
           infof(data, "Connection %ld seems to be dead!\n",
                 check->connection_id);
+          data->state.conn_cache->dead_on_reuse++;
 
           /* disconnect resources */
           Curl_disconnect(check, /* dead_connection */ TRUE);
@@ -3090,9 +3105,11 @@ ConnectionExists(struct SessionHandle *data,
         }
 
         if(canPipeline) {
+          long estimate;
+
           /* We can pipeline if we want to. Let's continue looking for
-             the optimal connection to use, i.e the shortest pipe that is not
-             blacklisted. */
+             the optimal connection to use, i.e the pipe on which the
+             request is expected to get its response first. */
 
           if(pipeLen == 0) {
             /* We have the optimal connection. Let's stop looking. */
@@ -3100,18 +3117,31 @@ ConnectionExists(struct SessionHandle *data,
             break;
           }
 
+          estimate = Curl_pipeline_estimate(check, now);
+
           /* We can't use the connection if the pipe is full */
-          if(pipeLen >= max_pipe_len)
+          if(pipeLen >= max_pipe_len) {
+            /* but remember how it compares to the ones we can use */
+            if(!full_pick || (estimate < full_estimate)) {
+              full_pick = check;
+              full_estimate = estimate;
+            }
             continue;
+          }
 
           /* We can't use the connection if the pipe is penalized */
           if(Curl_pipeline_penalized(data, check))
             continue;
 
-          if(pipeLen < best_pipe_len) {
-            /* This connection has a shorter pipe so far. We'll pick this
-               and continue searching */
+          /* Pick this connection if the request is expected to wait less on
+             it than on the best one so far, or if it has a shorter pipe when
+             the wait looks the same. A pipe that is long by count but has
+             only small responses queued beats a shorter one stuck behind a
+             large or stalled response. */
+          if(!chosen || (estimate < best_estimate) ||
+             ((estimate == best_estimate) && (pipeLen < best_pipe_len))) {
             chosen = check;
+            best_estimate = estimate;
             best_pipe_len = pipeLen;
             continue;
           }
@@ -3123,6 +3153,19 @@ ConnectionExists(struct SessionHandle *data,
         }
       }
     }
+
+    /* When the best pipe with room left is stuck behind a large or
+       stalled response while a full one is moving along, the request rather
+       waits for room in that one, or a new connection, like for a penalized
+       pipe */
+    if(chosen && full_pick && !*force_reuse &&
+       (chosen->send_pipe->size + chosen->recv_pipe->size) &&
+       (best_estimate > full_estimate + PIPE_WAIT_SLACK)) {
+      infof(data, "Connection #%ld is expected to be slower than the full "
+            "#%ld, not pipelining on it\n", chosen->connection_id,
+            full_pick->connection_id);
+      chosen = NULL;
+    }
   }
 
   if(chosen) {
@@ -3141,10 +3184,24 @@ ConnectionDone(struct SessionHandle *data, struct connectdata *conn)
   /* data->multi->maxconnects can be negative, deal with it. */
   size_t maxconnects =
     (data->multi->maxconnects < 0) ? 0 : data->multi->maxconnects;
+  size_t max_host_idle = Curl_multi_max_host_idle(data->multi);
   struct connectdata *conn_candidate = NULL;
+  bool kept = TRUE;
 
   /* Mark the current connection as 'unused' */
   conn->inuse = FALSE;
+  Curl_conncache_conn_idle(data->state.conn_cache, conn);
+
+  if(max_host_idle > 0 && conn->bundle &&
+     conn->bundle->num_idle > max_host_idle) {
+    infof(data, "Too many idle connections to host, closing the oldest.\n");
+
+    /* this is never the connection that was just put first on the list */
+    conn_candidate = find_oldest_idle_connection_in_bundle(data,
+                                                           conn->bundle);
+    conn_candidate->data = data;
+    (void)Curl_disconnect(conn_candidate, /* dead_connection */ FALSE);
+  }
 
   if(maxconnects > 0 &&
      data->state.conn_cache->num_connections > maxconnects) {
@@ -3153,6 +3210,9 @@ ConnectionDone(struct SessionHandle *data, struct connectdata *conn)
     conn_candidate = find_oldest_idle_connection(data);
 
     if(conn_candidate) {
+      if(conn_candidate == conn)
+        kept = FALSE;
+
       /* Set the connection's owner correctly */
       conn_candidate->data = data;
 
@@ -3161,7 +3221,7 @@ ConnectionDone(struct SessionHandle *data, struct connectdata *conn)
     }
   }
 
-  return (conn_candidate == conn) ? FALSE : TRUE;
+  return kept;
 }
 
 /*
@@ -3186,6 +3246,8 @@ static CURLcode ConnectionStore(struct SessionHandle *data,
   result = Curl_conncache_add_conn(data->state.conn_cache, conn);
   if(result != CURLE_OK)
     conn->connection_id = -1;
+  else
+    data->state.conn_cache->connects++;
 
   return result;
 }
@@ -5326,6 +5388,8 @@ static CURLcode create_conn(struct SessionHandle *data,
      we only acknowledge this option if this is not a re-used connection
      already (which happens due to follow-location or during a HTTP
      authentication phase). */
+  Curl_prune_idle_connections(data);
+
   if(data->set.reuse_fresh && !data->state.this_is_a_follow)
     reuse = FALSE;
   else
@@ -5358,6 +5422,8 @@ static CURLcode create_conn(struct SessionHandle *data,
      */
     conn_temp->inuse = TRUE; /* mark this as being in use so that no other
                                 handle in a multi stack may nick it */
+    Curl_conncache_conn_busy(data->state.conn_cache, conn_temp);
+    data->state.conn_cache->reused++;
     reuse_conn(conn, conn_temp);
     free(conn);          /* we don't need this anymore */
     conn = conn_temp;
@@ -5766,6 +5832,8 @@ static CURLcode do_init(struct connectdata *conn)
   k->start = Curl_tvnow(); /* start time */
   k->now = k->start;   /* current time is now */
   k->header = TRUE; /* assume header */
+  k->pipe_depth = -1; /* not in a pipeline yet */
+  k->pipe_waiting = FALSE;
 
   k->bytecount = 0;
 
@@ -65,6 +65,9 @@ void Curl_getoff_all_pipelines(struct SessionHandle *data,
 
 void Curl_close_connections(struct SessionHandle *data);
 
+/* close the idle connections that timed out or died, if it is time to look */
+void Curl_prune_idle_connections(struct SessionHandle *data);
+
 /* Called on connect, and if there's already a protocol-specific struct
    allocated for a different connection, this frees it that it can be setup
    properly later on. */
@@ -177,7 +177,7 @@
 #include "http_chunks.h" /* for the structs and enum stuff */
 #include "hostip.h"
 #include "hash.h"
-#include "splay.h"
+#include "timewheel.h"
 
 #include "imap.h"
 #include "pop3.h"
@@ -550,16 +550,6 @@ struct hostname {
 #define KEEP_SENDBITS (KEEP_SEND | KEEP_SEND_HOLD | KEEP_SEND_PAUSE)
 
 
-#ifdef HAVE_LIBZ
-typedef enum {
-  ZLIB_UNINIT,          /* uninitialized */
-  ZLIB_INIT,            /* initialized */
-  ZLIB_GZIP_HEADER,     /* reading gzip header */
-  ZLIB_GZIP_INFLATING,  /* inflating gzip stream */
-  ZLIB_INIT_GZIP        /* initialized in transparent gzip mode */
-} zlibInitState;
-#endif
-
 #ifdef CURLRES_ASYNCH
 struct Curl_async {
   char *hostname;
@@ -616,6 +606,14 @@ struct SingleRequest {
 
   struct timeval start;         /* transfer started at this time */
   struct timeval now;           /* current time */
+  struct timeval pipe_sent;     /* the request was put in the connection's
+                                   receive pipeline at this time */
+  long pipe_depth;              /* responses ahead of this one then, -1 when
+                                   it hasn't been put there */
+  struct timeval pipe_firstbyte; /* the first byte of the response was
+                                    received at this time */
+  bool pipe_waiting;            /* TRUE until the first byte of the response
+                                   has been received */
   bool header;                  /* incoming data has HTTP header */
   enum {
     HEADER_NORMAL,              /* no bad header at all */
@@ -640,23 +638,18 @@ struct SingleRequest {
   struct timeval start100;      /* time stamp to wait for the 100 code from */
   enum expect100 exp100;        /* expect 100 continue state */
 
-  int auto_decoding;            /* What content encoding. sec 3.5, RFC2616. */
-
-#define IDENTITY 0              /* No encoding */
-#define DEFLATE 1               /* zlib deflate [RFC 1950 & 1951] */
-#define GZIP 2                  /* gzip algorithm [RFC 1952] */
-#define COMPRESS 3              /* Not handled, added for completeness */
-
-#ifdef HAVE_LIBZ
-  zlibInitState zlib_init;      /* possible zlib init state;
-                                   undefined if Content-Encoding header. */
-  z_stream z;                   /* State structure for zlib. */
-#endif
+  struct contenc_writer *unencode; /* stack of decoding stages for the
+                                     content encodings of the body, top
+                                     first. NULL when it's not encoded */
+  size_t unencbuflen;           /* decoded bytes waiting in
+                                   state.unencbuf */
 
   time_t timeofdoc;
   long bodywrites;
 
   char *buf;
+  char *recvbuf;    /* set while the data read last went into a buffer of the
+                       CURLOPT_RECVBUFFERFUNCTION instead of 'buf' */
   char *uploadbuf;
   curl_socket_t maxfd;
 
@@ -798,6 +791,27 @@ typedef ssize_t (Curl_recv)(struct connectdata *conn, /* connection data */
                             size_t len,               /* max amount to read */
                             CURLcode *err);           /* error to return */
 
+/*
+ * What has been seen of the responses on a connection. The pipelining code
+ * estimates from this how long a request added to the connection would
+ * wait, and curl_easy_getinfo() returns it.
+ */
+struct pipestats {
+  long requests;           /* responses received completely */
+  long rtt;                /* smoothed wait for the first byte of a response
+                              to a request sent on an idle connection */
+  long rttsamples;         /* number of waits 'rtt' is made from */
+  long busy;               /* smoothed time the connection is busy with each
+                              response, waits for the server included */
+  curl_off_t rate;         /* smoothed receive speed in bytes per second, 0
+                              until measured */
+  curl_off_t winbytes;     /* bytes and microseconds of the responses not */
+  long winus;              /* counted into 'rate' yet */
+  struct timeval lastrecv; /* when data was last received */
+  struct timeval lastdone; /* when the previous response was complete */
+  /* 'rtt' and 'busy' are milliseconds times eight */
+};
+
 /*
  * The connectdata struct contains all fields and variables that should be
  * unique for an entire connection.
@@ -821,6 +835,16 @@ struct connectdata {
                  be used by any other easy handle without careful
                  consideration (== only for pipelining). */
 
+  /* While not in use, the connection is linked into two most-recently-used
+     lists of idle connections: the one of its bundle and the one of the
+     whole connection cache. See Curl_conncache_conn_idle() */
+  bool idle;
+  struct timeval idle_since; /* when it was last put on the idle lists */
+  struct connectdata *bundle_idle_next;
+  struct connectdata *bundle_idle_prev;
+  struct connectdata *cache_idle_next;
+  struct connectdata *cache_idle_prev;
+
   /**** Fields set when inited and not modified again */
   long connection_id; /* Contains a unique number to make it easier to
                          track the connections in the log output */
@@ -954,6 +978,7 @@ struct connectdata {
                                    send on this pipeline */
   struct curl_llist *recv_pipe; /* List of handles waiting to read
                                    their responses on this pipeline */
+  struct pipestats pipe; /* how the responses on this connection come in */
   char* master_buffer; /* The master buffer allocated on-demand;
                           used for pipelining. */
   size_t read_pos; /* Current read position in the master buffer */
@@ -1073,6 +1098,13 @@ struct PureInfo {
   struct curl_certinfo certs; /* info about the certs, only populated in
                                  OpenSSL builds. Asked for with
                                  CURLOPT_CERTINFO / CURLINFO_CERTINFO */
+
+  long pipe_depth; /* responses that were ahead of this one on the
+                      connection when the request was sent */
+  long pipe_wait;  /* milliseconds from sending the request until the first
+                      byte of the response */
+  struct pipestats pipe; /* the connection's statistics when the response
+                            was complete */
 };
 
 
@@ -1202,6 +1234,8 @@ struct UrlState {
   int tempwritetype;    /* type of the 'tempwrite' buffer as a bitmask that is
                            used with Curl_client_write() */
   char *scratch; /* huge buffer[BUFSIZE*2] when doing upload CRLF replacing */
+  char *unencbuf; /* CURL_MAX_WRITE_SIZE buffer the decoded body is gathered
+                    in before it's written to the client */
   bool errorbuf; /* Set to TRUE if the error buffer is already filled in.
                     This must be set to FALSE every time _easy_perform() is
                     called. */
@@ -1231,9 +1265,9 @@ struct UrlState {
 #if defined(USE_SSLEAY) && defined(HAVE_OPENSSL_ENGINE_H)
   ENGINE *engine;
 #endif /* USE_SSLEAY */
-  struct timeval expiretime; /* set this with Curl_expire() only */
-  struct Curl_tree timenode; /* for the splay stuff */
-  struct curl_llist *timeoutlist; /* list of pending timeouts */
+  struct Curl_timer *timers; /* pending timeouts, set with Curl_expire()
+                                only */
+  struct Curl_timer *freetimers; /* unused timers kept for reuse */
 
   /* a place to store the most recently set FTP entrypath */
   char *most_recent_ftp_entrypath;
@@ -1329,6 +1363,7 @@ struct DynamicStatic {
  */
 
 struct Curl_multi;    /* declared and used only in multi.c */
+struct Curl_xitem;    /* declared and used only in executor.c */
 
 enum dupstring {
   STRING_CERT,            /* client certificate file name */
@@ -1429,6 +1464,9 @@ struct UserDefined {
   int is_fwrite_set; /* boolean, has write callback been set to non-NULL? */
   curl_progress_callback fprogress; /* OLD and deprecated progress callback  */
   curl_xferinfo_callback fxferinfo; /* progress callback */
+  curl_recvbuffer_callback frecvbuffer; /* provides buffers to receive
+                                           bodies into */
+  void *recvbuffer_client; /* pointer to pass to the recvbuffer callback */
   curl_debug_callback fdebug;      /* function that write informational data */
   curl_ioctl_callback ioctl_func;  /* function for I/O control */
   curl_sockopt_callback fsockopt;  /* function for setting socket options */
@@ -1592,7 +1630,7 @@ struct UserDefined {
 };
 
 struct Names {
-  struct curl_hash *hostcache;
+  struct Curl_dnscache *hostcache;
   enum {
     HCACHE_NONE,    /* not pointing to anything */
     HCACHE_GLOBAL,  /* points to the (shrug) global one */
@@ -1638,6 +1676,8 @@ struct SessionHandle {
                                     struct to which this "belongs" when used
                                     by the easy interface */
   struct Curl_share *share;    /* Share, handles global variable mutexing */
+  struct Curl_xitem *xitem;    /* if non-NULL, the handle has been given to
+                                  an executor, see executor.c */
   struct SingleRequest req;    /* Request-specific data */
   struct UserDefined set;      /* values set by the libcurl user */
   struct DynamicStatic change; /* possibly modified userdefined data */
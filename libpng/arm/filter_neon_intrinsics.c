@@ -0,0 +1,240 @@
+
+/* filter_neon_intrinsics.c - NEON optimized filter functions
+ *
+ * Last changed in libpng 1.6.3 [July 18, 2013]
+ *
+ * This code is released under the libpng license.
+ * For conditions of distribution and use, see the disclaimer
+ * and license in png.h
+ */
+
+#include "../pngpriv.h"
+
+#ifdef PNG_READ_SUPPORTED
+
+#if PNG_ARM_NEON_OPT > 0
+
+/* Intrinsics rather than assembler: MSVC for ARM (Windows Phone 8) has no
+ * inline or GNU style assembler, but it does have arm_neon.h.
+ */
+#include <arm_neon.h>
+
+/* As in the SSE2 code each pixel depends on the one to its left, so a 64-bit
+ * register holds one pixel with a channel in each lane.  Pixels are moved
+ * through a png_uint_32 with memcpy as they are not aligned, and nothing is
+ * read or written outside of row_info->rowbytes.
+ */
+static uint8x8_t
+load4(png_const_bytep p)
+{
+   png_uint_32 tmp;
+   memcpy(&tmp, p, sizeof tmp);
+   return vreinterpret_u8_u32(vdup_n_u32(tmp));
+}
+
+static void
+store4(png_bytep p, uint8x8_t v)
+{
+   png_uint_32 tmp = vget_lane_u32(vreinterpret_u32_u8(v), 0);
+   memcpy(p, &tmp, sizeof tmp);
+}
+
+static uint8x8_t
+load3(png_const_bytep p)
+{
+   png_uint_32 tmp = 0;
+   memcpy(&tmp, p, 3);
+   return vreinterpret_u8_u32(vdup_n_u32(tmp));
+}
+
+static void
+store3(png_bytep p, uint8x8_t v)
+{
+   png_uint_32 tmp = vget_lane_u32(vreinterpret_u32_u8(v), 0);
+   memcpy(p, &tmp, 3);
+}
+
+void
+png_read_filter_row_up_neon(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   png_size_t rb = row_info->rowbytes;
+
+   /* Up has no dependency between pixels, so process 16 bytes at a time */
+   while (rb >= 16)
+   {
+      vst1q_u8(row, vaddq_u8(vld1q_u8(row), vld1q_u8(prev_row)));
+      row += 16;
+      prev_row += 16;
+      rb -= 16;
+   }
+
+   while (rb > 0)
+   {
+      *row = (png_byte)(*row + *prev_row++);
+      row++;
+      rb--;
+   }
+}
+
+void
+png_read_filter_row_sub3_neon(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   png_size_t rb = row_info->rowbytes;
+   uint8x8_t d = vdup_n_u8(0);
+
+   PNG_UNUSED(prev_row)
+
+   while (rb >= 4)
+   {
+      d = vadd_u8(load4(row), d);
+      store3(row, d);
+      row += 3;
+      rb -= 3;
+   }
+
+   if (rb > 0)
+   {
+      d = vadd_u8(load3(row), d);
+      store3(row, d);
+   }
+}
+
+void
+png_read_filter_row_sub4_neon(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   png_size_t rb = row_info->rowbytes;
+   uint8x8_t d = vdup_n_u8(0);
+
+   PNG_UNUSED(prev_row)
+
+   while (rb > 0)
+   {
+      d = vadd_u8(load4(row), d);
+      store4(row, d);
+      row += 4;
+      rb -= 4;
+   }
+}
+
+void
+png_read_filter_row_avg3_neon(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   /* vhadd_u8 is the truncated average required by PNG */
+   png_size_t rb = row_info->rowbytes;
+   uint8x8_t d = vdup_n_u8(0);
+
+   while (rb >= 4)
+   {
+      d = vadd_u8(load4(row), vhadd_u8(d, load4(prev_row)));
+      store3(row, d);
+      prev_row += 3;
+      row += 3;
+      rb -= 3;
+   }
+
+   if (rb > 0)
+   {
+      d = vadd_u8(load3(row), vhadd_u8(d, load3(prev_row)));
+      store3(row, d);
+   }
+}
+
+void
+png_read_filter_row_avg4_neon(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   png_size_t rb = row_info->rowbytes;
+   uint8x8_t d = vdup_n_u8(0);
+
+   while (rb > 0)
+   {
+      d = vadd_u8(load4(row), vhadd_u8(d, load4(prev_row)));
+      store4(row, d);
+      prev_row += 4;
+      row += 4;
+      rb -= 4;
+   }
+}
+
+/* 'a' is the reconstructed pixel to the left, 'b' the pixel above and 'c' the
+ * pixel above and to the left; the distances are computed on 16 bits.
+ */
+static uint8x8_t
+paeth(uint8x8_t a, uint8x8_t b, uint8x8_t c)
+{
+   uint8x8_t d, e;
+   uint16x8_t p1, pa, pb, pc;
+
+   p1 = vaddl_u8(a, b); /* a + b */
+   pc = vaddl_u8(c, c); /* c * 2 */
+   pa = vabdl_u8(b, c); /* pa */
+   pb = vabdl_u8(a, c); /* pb */
+   pc = vabdq_u16(p1, pc); /* pc */
+
+   p1 = vcleq_u16(pa, pb); /* pa <= pb */
+   pa = vcleq_u16(pa, pc); /* pa <= pc */
+   pb = vcleq_u16(pb, pc); /* pb <= pc */
+
+   p1 = vandq_u16(p1, pa); /* pa <= pb && pa <= pc */
+
+   d = vmovn_u16(pb);
+   e = vmovn_u16(p1);
+
+   d = vbsl_u8(d, b, c);
+   e = vbsl_u8(e, a, d);
+
+   return e;
+}
+
+void
+png_read_filter_row_paeth3_neon(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   /* The first pixel has no a or c, zero works for both */
+   png_size_t rb = row_info->rowbytes;
+   uint8x8_t b = vdup_n_u8(0), d = vdup_n_u8(0);
+
+   while (rb >= 4)
+   {
+      uint8x8_t c = b;
+      b = load4(prev_row);
+      d = vadd_u8(load4(row), paeth(d, b, c));
+      store3(row, d);
+      prev_row += 3;
+      row += 3;
+      rb -= 3;
+   }
+
+   if (rb > 0)
+   {
+      uint8x8_t c = b;
+      b = load3(prev_row);
+      d = vadd_u8(load3(row), paeth(d, b, c));
+      store3(row, d);
+   }
+}
+
+void
+png_read_filter_row_paeth4_neon(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   png_size_t rb = row_info->rowbytes;
+   uint8x8_t b = vdup_n_u8(0), d = vdup_n_u8(0);
+
+   while (rb > 0)
+   {
+      uint8x8_t c = b;
+      b = load4(prev_row);
+      d = vadd_u8(load4(row), paeth(d, b, c));
+      store4(row, d);
+      prev_row += 4;
+      row += 4;
+      rb -= 4;
+   }
+}
+#endif /* PNG_ARM_NEON_OPT > 0 */
+#endif /* READ */
@@ -0,0 +1,263 @@
+
+/* filter_sse2_intrinsics.c - SSE2 optimized filter functions
+ *
+ * Last changed in libpng 1.6.3 [July 18, 2013]
+ *
+ * This code is released under the libpng license.
+ * For conditions of distribution and use, see the disclaimer
+ * and license in png.h
+ */
+
+#include "../pngpriv.h"
+
+#ifdef PNG_READ_SUPPORTED
+
+#if PNG_INTEL_SSE_OPT > 0
+
+#include <emmintrin.h>
+
+/* The functions here work on one pixel (3 or 4 bytes) at a time in the low
+ * lanes of an SSE2 register: each pixel depends on the one to its left, so
+ * the lanes are the channels.  Pixels are moved through an int with memcpy
+ * because neither the row nor the pixels are aligned.  Nothing is read or
+ * written outside of row_info->rowbytes.
+ */
+static __m128i
+load4(const void *p)
+{
+   int tmp;
+   memcpy(&tmp, p, sizeof tmp);
+   return _mm_cvtsi32_si128(tmp);
+}
+
+static void
+store4(void *p, __m128i v)
+{
+   int tmp = _mm_cvtsi128_si32(v);
+   memcpy(p, &tmp, sizeof tmp);
+}
+
+static __m128i
+load3(const void *p)
+{
+   int tmp = 0;
+   memcpy(&tmp, p, 3);
+   return _mm_cvtsi32_si128(tmp);
+}
+
+static void
+store3(void *p, __m128i v)
+{
+   int tmp = _mm_cvtsi128_si32(v);
+   memcpy(p, &tmp, 3);
+}
+
+void
+png_read_filter_row_up_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   png_size_t rb = row_info->rowbytes;
+
+   /* Up has no dependency between pixels, so process 16 bytes at a time */
+   while (rb >= 16)
+   {
+      __m128i d = _mm_loadu_si128((const __m128i*)row);
+      __m128i b = _mm_loadu_si128((const __m128i*)prev_row);
+
+      _mm_storeu_si128((__m128i*)row, _mm_add_epi8(d, b));
+      row += 16;
+      prev_row += 16;
+      rb -= 16;
+   }
+
+   while (rb > 0)
+   {
+      *row = (png_byte)(*row + *prev_row++);
+      row++;
+      rb--;
+   }
+}
+
+void
+png_read_filter_row_sub3_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   /* Sub predicts each pixel from the pixel to its left, a; there is no pixel
+    * to the left of the first one, which is the same as a zero pixel.
+    */
+   png_size_t rb = row_info->rowbytes;
+   __m128i d = _mm_setzero_si128();
+
+   PNG_UNUSED(prev_row)
+
+   while (rb >= 4)
+   {
+      d = _mm_add_epi8(load4(row), d);
+      store3(row, d);
+      row += 3;
+      rb -= 3;
+   }
+
+   if (rb > 0)
+   {
+      d = _mm_add_epi8(load3(row), d);
+      store3(row, d);
+   }
+}
+
+void
+png_read_filter_row_sub4_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   png_size_t rb = row_info->rowbytes;
+   __m128i d = _mm_setzero_si128();
+
+   PNG_UNUSED(prev_row)
+
+   while (rb > 0)
+   {
+      d = _mm_add_epi8(load4(row), d);
+      store4(row, d);
+      row += 4;
+      rb -= 4;
+   }
+}
+
+/* PNG uses the truncated average of a and b, _mm_avg_epu8 rounds up: subtract
+ * one where the sum was odd.
+ */
+static __m128i
+avg_trunc(__m128i a, __m128i b)
+{
+   __m128i avg = _mm_avg_epu8(a, b);
+   return _mm_sub_epi8(avg, _mm_and_si128(_mm_xor_si128(a, b),
+      _mm_set1_epi8(1)));
+}
+
+void
+png_read_filter_row_avg3_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   png_size_t rb = row_info->rowbytes;
+   __m128i d = _mm_setzero_si128();
+
+   while (rb >= 4)
+   {
+      d = _mm_add_epi8(load4(row), avg_trunc(d, load4(prev_row)));
+      store3(row, d);
+      prev_row += 3;
+      row += 3;
+      rb -= 3;
+   }
+
+   if (rb > 0)
+   {
+      d = _mm_add_epi8(load3(row), avg_trunc(d, load3(prev_row)));
+      store3(row, d);
+   }
+}
+
+void
+png_read_filter_row_avg4_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   png_size_t rb = row_info->rowbytes;
+   __m128i d = _mm_setzero_si128();
+
+   while (rb > 0)
+   {
+      d = _mm_add_epi8(load4(row), avg_trunc(d, load4(prev_row)));
+      store4(row, d);
+      prev_row += 4;
+      row += 4;
+      rb -= 4;
+   }
+}
+
+/* Paeth works on 16-bit lanes, as |a + b - 2c| needs 10 bits; 'a' is the
+ * reconstructed pixel to the left, 'b' the pixel above and 'c' the pixel above
+ * and to the left.
+ */
+static __m128i
+abs_i16(__m128i x)
+{
+   __m128i is_negative = _mm_cmplt_epi16(x, _mm_setzero_si128());
+   return _mm_sub_epi16(_mm_xor_si128(x, is_negative), is_negative);
+}
+
+static __m128i
+if_then_else(__m128i c, __m128i t, __m128i e)
+{
+   return _mm_or_si128(_mm_and_si128(c, t), _mm_andnot_si128(c, e));
+}
+
+static __m128i
+paeth(__m128i a, __m128i b, __m128i c)
+{
+   __m128i pa, pb, pc, smallest;
+
+   pa = _mm_sub_epi16(b, c);
+   pb = _mm_sub_epi16(a, c);
+   pc = abs_i16(_mm_add_epi16(pa, pb));
+   pa = abs_i16(pa);
+   pb = abs_i16(pb);
+
+   /* Ties are broken in the order a, b, c */
+   smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+   return if_then_else(_mm_cmpeq_epi16(smallest, pa), a,
+      if_then_else(_mm_cmpeq_epi16(smallest, pb), b, c));
+}
+
+void
+png_read_filter_row_paeth3_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   png_size_t rb = row_info->rowbytes;
+   const __m128i zero = _mm_setzero_si128();
+   __m128i b = zero, d = zero;
+
+   /* The first pixel has no a or c, zero works for both: the prediction is
+    * then b, as required.  _mm_add_epi8 leaves the high byte of each 16-bit
+    * lane zero, so the result can be packed back directly.
+    */
+   while (rb >= 4)
+   {
+      __m128i c = b;
+      b = _mm_unpacklo_epi8(load4(prev_row), zero);
+      d = _mm_add_epi8(_mm_unpacklo_epi8(load4(row), zero), paeth(d, b, c));
+      store3(row, _mm_packus_epi16(d, d));
+      prev_row += 3;
+      row += 3;
+      rb -= 3;
+   }
+
+   if (rb > 0)
+   {
+      __m128i c = b;
+      b = _mm_unpacklo_epi8(load3(prev_row), zero);
+      d = _mm_add_epi8(_mm_unpacklo_epi8(load3(row), zero), paeth(d, b, c));
+      store3(row, _mm_packus_epi16(d, d));
+   }
+}
+
+void
+png_read_filter_row_paeth4_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   png_size_t rb = row_info->rowbytes;
+   const __m128i zero = _mm_setzero_si128();
+   __m128i b = zero, d = zero;
+
+   while (rb > 0)
+   {
+      __m128i c = b;
+      b = _mm_unpacklo_epi8(load4(prev_row), zero);
+      d = _mm_add_epi8(_mm_unpacklo_epi8(load4(row), zero), paeth(d, b, c));
+      store4(row, _mm_packus_epi16(d, d));
+      prev_row += 4;
+      row += 4;
+      rb -= 4;
+   }
+}
+#endif /* PNG_INTEL_SSE_OPT > 0 */
+#endif /* READ */
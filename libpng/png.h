@@ -1748,6 +1748,18 @@ PNG_EXPORT(226, void, png_set_text_compression_method, (png_structrp png_ptr,
     int method));
 #endif /* PNG_WRITE_CUSTOMIZE_ZTXT_COMPRESSION_SUPPORTED */
 
+#ifdef PNG_WRITE_THREADS_SUPPORTED
+/* Filter and compress the image data on 'threads' threads; 0 or 1 (the
+ * default) writes it on the calling thread, a negative value uses one thread
+ * per processor.  Call this before the first png_write_row.  The image is
+ * split in bands of rows compressed separately, so the result is slightly
+ * larger; images that are interlaced or fit in one band are always written
+ * on the calling thread.
+ */
+PNG_EXPORT(245, void, png_set_write_threads, (png_structrp png_ptr,
+    int threads));
+#endif
+
 /* These next functions are called for input/output, memory, and error
  * handling.  They are in the file pngrio.c, pngwio.c, and pngerror.c,
  * and call standard C I/O routines such as fread(), fwrite(), and
@@ -3124,6 +3136,12 @@ typedef struct
     * because that call initializes the 'flags' field.
     */
 
+#define PNG_IMAGE_FLAG_THREADS 0x08
+   /* On write filter and compress the image on one thread per processor, see
+    * png_set_write_threads.  Ignored if libpng was built without
+    * PNG_WRITE_THREADS_SUPPORTED, and on read.
+    */
+
 #ifdef PNG_SIMPLIFIED_READ_SUPPORTED
 /* READ APIs
  * ---------
@@ -3182,6 +3200,30 @@ PNG_EXPORT(237, int, png_image_finish_read, (png_imagep image,
     * written to the colormap; this may be less than the original value.
     */
 
+typedef PNG_CALLBACK(int, *png_image_row_ptr, (png_imagep image,
+   png_uint_32 y, png_voidp row, png_voidp row_arg));
+
+PNG_EXPORT(246, int, png_image_finish_read_rows, (png_imagep image,
+   png_const_colorp background, png_image_row_ptr row_fn, png_voidp row_arg,
+   void *colormap));
+   /* As png_image_finish_read but, rather than filling in an image buffer,
+    * each row is passed to row_fn in the final format as soon as it has been
+    * decoded, from the top (y == 0) down.  'row' is in a buffer owned by libpng
+    * and is only valid during the call; it may be modified.  row_fn must return
+    * non-zero to continue or 0 to stop the read, in which case
+    * png_image_finish_read_rows fails.
+    *
+    * For non-interlaced images only one row is held at any time, so the rows
+    * can be converted straight into their final destination (a texture or an
+    * upload buffer for example.)  Interlaced images must be assembled in a
+    * full image buffer first; the rows are then passed on once all the passes
+    * have been read.
+    *
+    * background and colormap are as for png_image_finish_read, except that
+    * where composition "directly onto the buffer" would happen the row is
+    * composed on black.
+    */
+
 PNG_EXPORT(238, void, png_image_free, (png_imagep image));
    /* Free any data allocated by libpng in image->opaque, setting the pointer to
     * NULL.  May be called at any time after the structure is initialized.
@@ -3289,6 +3331,106 @@ PNG_EXPORT(244, int, png_set_option, (png_structrp png_ptr, int option,
  *  END OF HARDWARE OPTIONS
  ******************************************************************************/
 
+#ifdef PNG_READ_SUPPORTED
+/*******************************************************************************
+ *  HEADER PROBE
+ *******************************************************************************
+ *
+ * These APIs return the IHDR values of a PNG without creating a png_struct:
+ * only the signature and the IHDR chunk (the first 33 bytes of the file) are
+ * read, nothing is allocated and libpng error handling is not involved.  This
+ * is intended for finding the size of large numbers of images quickly; the
+ * rest of the file is not checked at all.
+ */
+typedef struct
+{
+   png_uint_32 width;
+   png_uint_32 height;
+   png_byte    bit_depth;
+   png_byte    color_type;
+   png_byte    interlace_method;
+   png_byte    valid;            /* 1 if a valid IHDR was found, else 0 */
+} png_probe, *png_probep;
+
+PNG_EXPORT(247, int, png_probe_memory, (png_probep probe,
+   png_const_voidp memory, png_size_t size));
+   /* Fill in 'probe' from the start of a PNG in memory; returns probe->valid.
+    * 'size' need only cover the signature and the IHDR chunk.
+    */
+
+#ifdef PNG_STDIO_SUPPORTED
+PNG_EXPORT(248, int, png_probe_files, (png_probep probes,
+   const char * const *file_names, int count));
+   /* Probe 'count' files, setting probes[i] from file_names[i].  Returns the
+    * number of valid PNG files found.
+    */
+#endif
+#endif /* PNG_READ_SUPPORTED */
+
+#ifdef PNG_DECODER_POOL_SUPPORTED
+/*******************************************************************************
+ *  DECODER POOL
+ *******************************************************************************
+ *
+ * A decoder pool is a cache of the memory blocks libpng allocates for a read:
+ * the png_struct, png_info, zlib inflate state and window and the row buffers.
+ * When a png_struct created from the pool is destroyed its memory goes back to
+ * the pool and is used again by the next one, so decoding a series of similar
+ * images (icons for example) does not go back to the system allocator each
+ * time.  At most PNG_DECODER_POOL_CACHE_SIZE bytes are kept.
+ *
+ * A pool must only be used by one thread at a time and must not be destroyed
+ * while any png_struct created from it still exists.
+ */
+typedef struct png_decoder_pool_struct png_decoder_pool;
+typedef png_decoder_pool * png_decoder_poolp;
+
+PNG_EXPORTA(249, png_decoder_poolp, png_decoder_pool_create, (void),
+   PNG_ALLOCATED);
+PNG_EXPORT(250, void, png_decoder_pool_destroy, (png_decoder_poolp pool));
+
+PNG_EXPORTA(251, png_structp, png_create_read_struct_pooled,
+   (png_decoder_poolp pool, png_const_charp user_png_ver, png_voidp error_ptr,
+   png_error_ptr error_fn, png_error_ptr warn_fn), PNG_ALLOCATED);
+   /* As png_create_read_struct, but all memory is allocated from 'pool'. */
+
+#ifdef PNG_SIMPLIFIED_READ_SUPPORTED
+PNG_EXPORT(252, int, png_image_begin_read_from_memory_pooled,
+   (png_imagep image, png_const_voidp memory, png_size_t size,
+   png_decoder_poolp pool));
+   /* As png_image_begin_read_from_memory, using memory from 'pool' until the
+    * image is freed.
+    */
+
+/* One image of a png_image_decode_batch call. */
+typedef struct
+{
+   /* Set by the application: */
+   png_const_voidp  memory;      /* The PNG file in memory */
+   png_size_t       size;
+   png_uint_32      format;      /* Output format, not a color-map one */
+   png_const_colorp background;  /* As for png_image_finish_read */
+   void            *buffer;      /* The output image */
+   png_alloc_size_t buffer_size; /* Bytes available at buffer */
+   png_int_32       row_stride;  /* As for png_image_finish_read */
+
+   /* Set by png_image_decode_batch: */
+   png_image        image;       /* Header; image.message on failure */
+   int              result;      /* Non-zero if the image was decoded */
+} png_decode_job, *png_decode_jobp;
+
+PNG_EXPORT(253, int, png_image_decode_batch, (png_decode_jobp jobs, int count,
+   int threads));
+   /* Decode 'count' images from memory on up to 'threads' threads (one per
+    * processor if 'threads' is 0 or less), each thread with its own decoder
+    * pool.  The calling thread decodes images too.  An image fails if the
+    * buffer is too small for it in the requested format, so png_probe_memory
+    * can be used to size the buffers first.  Returns the number of images
+    * decoded.
+    */
+#endif /* PNG_SIMPLIFIED_READ_SUPPORTED */
+#endif /* PNG_DECODER_POOL_SUPPORTED */
+
 /* Maintainer: Put new public prototypes here ^, in libpng.3, and project
  * defs, scripts/pnglibconf.h, and scripts/pnglibconf.h.prebuilt
  */
@@ -3298,7 +3440,7 @@ PNG_EXPORT(244, int, png_set_option, (png_structrp png_ptr, int option,
  * scripts/symbols.def as well.
  */
 #ifdef PNG_EXPORT_LAST_ORDINAL
-  PNG_EXPORT_LAST_ORDINAL(244);
+  PNG_EXPORT_LAST_ORDINAL(253);
 #endif
 
 #ifdef __cplusplus
@@ -0,0 +1,287 @@
+
+/* pngpool.c - reuse of decoder memory and batch decoding on several threads
+ *
+ * Last changed in libpng 1.6.3 [July 18, 2013]
+ *
+ * This code is released under the libpng license.
+ * For conditions of distribution and use, see the disclaimer
+ * and license in png.h
+ *
+ * A png_decoder_pool is the mem_ptr of the png_structs created from it, with
+ * png_decoder_pool_malloc and png_decoder_pool_free as their malloc_fn and
+ * free_fn.  Blocks freed by libpng (including the inflate state and window,
+ * which zlib allocates through png_zalloc) are kept in a small cache and
+ * returned again for a request of a similar size, so a sequence of decodes
+ * settles down to making no calls to the system allocator at all.
+ */
+
+#include "pngpriv.h"
+
+#ifdef PNG_DECODER_POOL_SUPPORTED
+
+#include "pngthrd.h"
+
+/* The most blocks kept; a decode allocates around a dozen. */
+#define PNG_DECODER_POOL_BLOCKS 32
+
+/* Every block starts with its size.  The header is 16 bytes so that the
+ * alignment of the system malloc is kept (a png_struct contains a jmp_buf,
+ * which needs 16 byte alignment on some 64-bit systems.)
+ */
+typedef union png_pool_header
+{
+   png_alloc_size_t size;
+   double           align[2];
+} png_pool_header;
+
+struct png_decoder_pool_struct
+{
+   png_pool_header *blocks[PNG_DECODER_POOL_BLOCKS]; /* free blocks */
+   int              num_blocks;
+   png_alloc_size_t cached;                          /* bytes in blocks */
+};
+
+static void
+png_decoder_pool_empty(png_decoder_poolp pool)
+{
+   while (pool->num_blocks > 0)
+      free(pool->blocks[--pool->num_blocks]);
+
+   pool->cached = 0;
+}
+
+PNG_FUNCTION(png_voidp /* PRIVATE */ PNGCBAPI,
+png_decoder_pool_malloc,(png_structp png_ptr, png_alloc_size_t size),
+   PNG_ALLOCATED)
+{
+   png_decoder_poolp pool = png_voidcast(png_decoder_poolp,
+      png_get_mem_ptr(png_ptr));
+   png_pool_header *block;
+   int best = -1;
+   int i;
+
+   /* The smallest cached block that fits, without wasting more than half of
+    * it.
+    */
+   for (i = 0; i < pool->num_blocks; ++i)
+   {
+      png_alloc_size_t have = pool->blocks[i]->size;
+
+      if (have >= size && have - size <= have / 2 &&
+         (best < 0 || have < pool->blocks[best]->size))
+         best = i;
+   }
+
+   if (best >= 0)
+   {
+      block = pool->blocks[best];
+      pool->blocks[best] = pool->blocks[--pool->num_blocks];
+      pool->cached -= block->size;
+      return block + 1;
+   }
+
+   if (size > PNG_SIZE_MAX - (sizeof *block))
+      return NULL;
+
+   block = png_voidcast(png_pool_header*, malloc((size_t)size +
+      (sizeof *block)));
+
+   if (block == NULL)
+      return NULL;
+
+   block->size = size;
+   return block + 1;
+}
+
+void /* PRIVATE */ PNGCBAPI
+png_decoder_pool_free(png_structp png_ptr, png_voidp ptr)
+{
+   png_decoder_poolp pool = png_voidcast(png_decoder_poolp,
+      png_get_mem_ptr(png_ptr));
+   png_pool_header *block;
+
+   if (ptr == NULL)
+      return;
+
+   block = png_voidcast(png_pool_header*, ptr);
+   --block;
+
+   if (pool->num_blocks < PNG_DECODER_POOL_BLOCKS &&
+      block->size <= PNG_DECODER_POOL_CACHE_SIZE - pool->cached)
+   {
+      pool->blocks[pool->num_blocks++] = block;
+      pool->cached += block->size;
+   }
+
+   else
+      free(block);
+}
+
+PNG_FUNCTION(png_decoder_poolp,PNGAPI
+png_decoder_pool_create,(void),PNG_ALLOCATED)
+{
+   png_decoder_poolp pool = png_voidcast(png_decoder_poolp,
+      malloc(sizeof *pool));
+
+   if (pool != NULL)
+      memset(pool, 0, (sizeof *pool));
+
+   return pool;
+}
+
+void PNGAPI
+png_decoder_pool_destroy(png_decoder_poolp pool)
+{
+   if (pool != NULL)
+   {
+      png_decoder_pool_empty(pool);
+      free(pool);
+   }
+}
+
+PNG_FUNCTION(png_structp,PNGAPI
+png_create_read_struct_pooled,(png_decoder_poolp pool,
+   png_const_charp user_png_ver, png_voidp error_ptr, png_error_ptr error_fn,
+   png_error_ptr warn_fn),PNG_ALLOCATED)
+{
+   if (pool == NULL)
+      return NULL;
+
+   return png_create_read_struct_2(user_png_ver, error_ptr, error_fn, warn_fn,
+      pool, png_decoder_pool_malloc, png_decoder_pool_free);
+}
+
+#ifdef PNG_SIMPLIFIED_READ_SUPPORTED
+/* png_image_decode_batch: the jobs are taken in order by the calling thread
+ * and the worker threads; each has its own pool.
+ */
+typedef struct png_decode_batch
+{
+   png_decode_jobp jobs;
+   int             count;
+   int             next;     /* next job to take */
+   int             decoded;  /* successful jobs */
+   png_mutex       mutex;
+} png_decode_batch;
+
+static void
+png_decode_job_run(png_decode_jobp job, png_decoder_poolp pool)
+{
+   png_imagep image = &job->image;
+
+   memset(image, 0, (sizeof *image));
+   image->version = PNG_IMAGE_VERSION;
+   job->result = 0;
+
+   if (png_image_begin_read_from_memory_pooled(image, job->memory, job->size,
+      pool))
+   {
+      png_int_32 row_stride = job->row_stride;
+      png_alloc_size_t check;
+
+      image->format = job->format;
+
+      if (row_stride == 0)
+         row_stride = PNG_IMAGE_ROW_STRIDE(*image);
+
+      check = row_stride < 0 ? -(png_alloc_size_t)row_stride :
+         (png_alloc_size_t)row_stride;
+
+      if (image->format & PNG_FORMAT_FLAG_COLORMAP)
+         png_image_error(image,
+            "png_image_decode_batch: color-map output not supported");
+
+      else if (job->buffer == NULL || check < PNG_IMAGE_ROW_STRIDE(*image) ||
+         check > job->buffer_size /
+            (PNG_IMAGE_PIXEL_COMPONENT_SIZE(image->format) * image->height))
+         png_image_error(image, "png_image_decode_batch: buffer too small");
+
+      else
+         job->result = png_image_finish_read(image, job->background,
+            job->buffer, row_stride, NULL);
+   }
+}
+
+static void
+png_decode_batch_work(png_decode_batch *batch)
+{
+   png_decoder_pool pool;
+   int decoded = 0;
+
+   memset(&pool, 0, (sizeof pool));
+
+   for (;;)
+   {
+      int i;
+
+      png_mutex_lock(&batch->mutex);
+      i = batch->next++;
+      png_mutex_unlock(&batch->mutex);
+
+      if (i >= batch->count)
+         break;
+
+      png_decode_job_run(batch->jobs + i, &pool);
+
+      if (batch->jobs[i].result)
+         ++decoded;
+   }
+
+   png_decoder_pool_empty(&pool);
+
+   png_mutex_lock(&batch->mutex);
+   batch->decoded += decoded;
+   png_mutex_unlock(&batch->mutex);
+}
+
+static PNG_THREAD_RETURN_TYPE
+png_decode_batch_main(void *arg)
+{
+   png_decode_batch_work(png_voidcast(png_decode_batch*, arg));
+   return PNG_THREAD_RETURN;
+}
+
+/* The most threads started by one call */
+#define PNG_DECODE_BATCH_THREADS 64
+
+int PNGAPI
+png_image_decode_batch(png_decode_jobp jobs, int count, int threads)
+{
+   png_thread thread[PNG_DECODE_BATCH_THREADS];
+   png_decode_batch batch;
+   int started = 0;
+
+   if (jobs == NULL || count <= 0)
+      return 0;
+
+   if (threads <= 0)
+      threads = png_thread_cpus();
+
+   if (threads > count)
+      threads = count;
+
+   if (threads > PNG_DECODE_BATCH_THREADS + 1)
+      threads = PNG_DECODE_BATCH_THREADS + 1;
+
+   batch.jobs = jobs;
+   batch.count = count;
+   batch.next = 0;
+   batch.decoded = 0;
+   png_mutex_init(&batch.mutex);
+
+   /* The calling thread is one of the threads */
+   while (started < threads - 1 &&
+      png_thread_create(&thread[started], png_decode_batch_main, &batch))
+      ++started;
+
+   png_decode_batch_work(&batch);
+
+   while (started > 0)
+      png_thread_join(thread[--started]);
+
+   png_mutex_destroy(&batch.mutex);
+
+   return batch.decoded;
+}
+#endif /* PNG_SIMPLIFIED_READ_SUPPORTED */
+#endif /* PNG_DECODER_POOL_SUPPORTED */
@@ -114,7 +114,10 @@
     * unconditionally on NEON instructions not crashing, otherwise we must
     * disable use of NEON instructions:
     */
-#  ifdef __ARM_NEON__
+#  if defined(__ARM_NEON__) || defined(__ARM_NEON) || defined(_M_ARM)
+      /* Windows on ARM (including Windows Phone 8) requires NEON, MSVC does
+       * not define __ARM_NEON__.
+       */
 #     define PNG_ARM_NEON_OPT 2
 #  else
 #     define PNG_ARM_NEON_OPT 0
@@ -128,6 +131,23 @@
 #  define PNG_FILTER_OPTIMIZATIONS png_init_filter_functions_neon
 #endif
 
+#ifndef PNG_INTEL_SSE_OPT
+   /* Intel SSE2 optimizations are used when the compiler may generate SSE2
+    * code anyway: always on x86-64, and on x86 with -msse2 (GCC) or /arch:SSE2
+    * (MSVC).  Define PNG_INTEL_SSE_OPT to 0 to disable them.
+    */
+#  if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) ||\
+      (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#     define PNG_INTEL_SSE_OPT 1
+#  else
+#     define PNG_INTEL_SSE_OPT 0
+#  endif
+#endif
+
+#if PNG_INTEL_SSE_OPT > 0 && !defined(PNG_FILTER_OPTIMIZATIONS)
+#  define PNG_FILTER_OPTIMIZATIONS png_init_filter_functions_sse2
+#endif
+
 /* Is this a build of a DLL where compilation of the object modules requires
  * different preprocessor settings to those required for a simple library?  If
  * so PNG_BUILD_DLL must be set.
@@ -1155,10 +1175,41 @@ PNG_INTERNAL_FUNCTION(void,png_read_filter_row_paeth3_neon,(png_row_infop
 PNG_INTERNAL_FUNCTION(void,png_read_filter_row_paeth4_neon,(png_row_infop
     row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
 
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_up_sse2,(png_row_infop row_info,
+    png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_sub3_sse2,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_sub4_sse2,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_avg3_sse2,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_avg4_sse2,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_paeth3_sse2,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_paeth4_sse2,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+
 /* Choose the best filter to use and filter the row data */
 PNG_INTERNAL_FUNCTION(void,png_write_find_filter,(png_structrp png_ptr,
     png_row_infop row_info),PNG_EMPTY);
 
+#ifdef PNG_WRITE_THREADS_SUPPORTED
+/* Parallel filtering and compression of the IDAT data, see pngwthrd.c */
+PNG_INTERNAL_FUNCTION(void,png_write_threads_start,(png_structrp png_ptr),
+    PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_write_threads_row,(png_structrp png_ptr,
+    png_row_infop row_info),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_write_threads_filtered_row,(png_structrp png_ptr,
+    png_const_bytep row, png_size_t row_length),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_write_threads_flush,(png_structrp png_ptr),
+    PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_write_threads_end,(png_structrp png_ptr),
+    PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_write_threads_free,(png_structrp png_ptr),
+    PNG_EMPTY);
+#endif
+
 #ifdef PNG_SEQUENTIAL_READ_SUPPORTED
 PNG_INTERNAL_FUNCTION(void,png_read_IDAT_data,(png_structrp png_ptr,
    png_bytep output, png_alloc_size_t avail_out),PNG_EMPTY);
@@ -1976,6 +2027,16 @@ PNG_INTERNAL_FUNCTION(void, png_image_free, (png_imagep image), PNG_EMPTY);
 
 #endif /* SIMPLIFIED READ/WRITE */
 
+#ifdef PNG_DECODER_POOL_SUPPORTED
+/* The malloc_fn and free_fn of a png_struct using a png_decoder_pool, which is
+ * the mem_ptr.
+ */
+PNG_INTERNAL_FUNCTION(png_voidp PNGCBAPI,png_decoder_pool_malloc,
+   (png_structp png_ptr, png_alloc_size_t size),PNG_ALLOCATED);
+PNG_INTERNAL_FUNCTION(void PNGCBAPI,png_decoder_pool_free,(png_structp png_ptr,
+   png_voidp ptr),PNG_EMPTY);
+#endif
+
 /* These are initialization functions for hardware specific PNG filter
  * optimizations; list these here then select the appropriate one at compile
  * time using the macro PNG_FILTER_OPTIMIZATIONS.  If the macro is not defined
@@ -1992,6 +2053,8 @@ PNG_INTERNAL_FUNCTION(void, PNG_FILTER_OPTIMIZATIONS, (png_structp png_ptr,
     */
 PNG_INTERNAL_FUNCTION(void, png_init_filter_functions_neon,
    (png_structp png_ptr, unsigned int bpp), PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void, png_init_filter_functions_sse2,
+   (png_structp png_ptr, unsigned int bpp), PNG_EMPTY);
 #endif
 
 /* Maintainer: Put new private prototypes here ^ */
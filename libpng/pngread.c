@@ -1116,6 +1116,126 @@ png_read_png(png_structrp png_ptr, png_inforp info_ptr,
 #endif /* PNG_INFO_IMAGE_SUPPORTED */
 #endif /* PNG_SEQUENTIAL_READ_SUPPORTED */
 
+/* HEADER PROBE
+ *
+ * The signature and IHDR occupy the first 33 bytes of a PNG file: 8 bytes of
+ * signature, the 8 byte chunk header, 13 bytes of data and the CRC.  The
+ * checks are those of png_check_IHDR without the user limits.
+ */
+#define PNG_PROBE_SIZE 33
+
+static int
+png_probe_IHDR(png_probep probe, png_const_bytep buf)
+{
+   static PNG_CONST png_byte png_IHDR_header[8] = {0, 0, 0, 13, 73, 72, 68, 82};
+   png_uint_32 width, height;
+   int bit_depth, color_type;
+
+   memset(probe, 0, (sizeof *probe));
+
+   if (png_sig_cmp(buf, 0, 8) != 0 || memcmp(buf+8, png_IHDR_header, 8) != 0)
+      return 0;
+
+   if (crc32(crc32(0, Z_NULL, 0), buf+12, 17) != png_get_uint_32(buf+29))
+      return 0;
+
+   width = png_get_uint_32(buf+16);
+   height = png_get_uint_32(buf+20);
+   bit_depth = buf[24];
+   color_type = buf[25];
+
+   if (width == 0 || width > PNG_UINT_31_MAX ||
+       height == 0 || height > PNG_UINT_31_MAX)
+      return 0;
+
+   switch (color_type)
+   {
+      case PNG_COLOR_TYPE_GRAY:
+         if (bit_depth != 1 && bit_depth != 2 && bit_depth != 4 &&
+             bit_depth != 8 && bit_depth != 16)
+            return 0;
+         break;
+
+      case PNG_COLOR_TYPE_PALETTE:
+         if (bit_depth != 1 && bit_depth != 2 && bit_depth != 4 &&
+             bit_depth != 8)
+            return 0;
+         break;
+
+      case PNG_COLOR_TYPE_RGB:
+      case PNG_COLOR_TYPE_GRAY_ALPHA:
+      case PNG_COLOR_TYPE_RGB_ALPHA:
+         if (bit_depth != 8 && bit_depth != 16)
+            return 0;
+         break;
+
+      default:
+         return 0;
+   }
+
+   /* Compression, filter and interlace methods */
+   if (buf[26] != PNG_COMPRESSION_TYPE_BASE || buf[27] != PNG_FILTER_TYPE_BASE
+       || buf[28] >= PNG_INTERLACE_LAST)
+      return 0;
+
+   probe->width = width;
+   probe->height = height;
+   probe->bit_depth = (png_byte)bit_depth;
+   probe->color_type = (png_byte)color_type;
+   probe->interlace_method = buf[28];
+   probe->valid = 1;
+
+   return 1;
+}
+
+int PNGAPI
+png_probe_memory(png_probep probe, png_const_voidp memory, png_size_t size)
+{
+   if (probe == NULL)
+      return 0;
+
+   if (memory == NULL || size < PNG_PROBE_SIZE)
+   {
+      memset(probe, 0, (sizeof *probe));
+      return 0;
+   }
+
+   return png_probe_IHDR(probe, png_voidcast(png_const_bytep, memory));
+}
+
+#ifdef PNG_STDIO_SUPPORTED
+int PNGAPI
+png_probe_files(png_probep probes, const char * const *file_names, int count)
+{
+   int found = 0;
+   int i;
+
+   if (probes == NULL || file_names == NULL)
+      return 0;
+
+   for (i = 0; i < count; ++i)
+   {
+      png_byte buf[PNG_PROBE_SIZE];
+      FILE *fp = fopen(file_names[i], "rb");
+
+      memset(probes+i, 0, (sizeof probes[i]));
+
+      if (fp == NULL)
+         continue;
+
+      /* Only 33 bytes are wanted, so avoid stdio allocating a buffer */
+      setvbuf(fp, NULL, _IONBF, 0);
+
+      if (fread(buf, PNG_PROBE_SIZE, 1, fp) == 1)
+         found += png_probe_IHDR(probes+i, buf);
+
+      (void)fclose(fp);
+   }
+
+   return found;
+}
+#endif /* PNG_STDIO_SUPPORTED */
+
 #ifdef PNG_SIMPLIFIED_READ_SUPPORTED
 /* SIMPLIFIED READ
  *
@@ -1156,7 +1276,12 @@ typedef struct
    png_int_32 row_stride;
    png_voidp  colormap;
    png_const_colorp background;
+   png_image_row_ptr row_fn;            /* png_image_finish_read_rows */
+   png_voidp       row_arg;
    /* Local variables: */
+   png_voidp       row_buffer;          /* For row_fn, allocated here */
+   png_size_t      row_size;            /* Bytes in one output row */
+   int             clear_row;           /* Compose on black */
    png_voidp       local_row;
    png_voidp       first_row;
    ptrdiff_t       row_bytes;           /* step between rows */
@@ -1171,12 +1296,24 @@ typedef struct
  * instead so that control is returned safely back to this routine.
  */
 static int
-png_image_read_init(png_imagep image)
+png_image_read_init(png_imagep image, png_voidp pool)
 {
    if (image->opaque == NULL)
    {
-      png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, image,
-          png_safe_error, png_safe_warning);
+      png_structp png_ptr;
+
+#     ifdef PNG_DECODER_POOL_SUPPORTED
+         if (pool != NULL)
+            png_ptr = png_create_read_struct_pooled(
+               png_voidcast(png_decoder_poolp, pool), PNG_LIBPNG_VER_STRING,
+               image, png_safe_error, png_safe_warning);
+
+         else
+#     else
+         PNG_UNUSED(pool)
+#     endif
+         png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, image,
+             png_safe_error, png_safe_warning);
 
       /* And set the rest of the structure to NULL to ensure that the various
        * fields are consistent.
@@ -1341,7 +1478,7 @@ png_image_begin_read_from_stdio(png_imagep image, FILE* file)
    {
       if (file != NULL)
       {
-         if (png_image_read_init(image))
+         if (png_image_read_init(image, NULL))
          {
             /* This is slightly evil, but png_init_io doesn't do anything other
              * than this and we haven't changed the standard IO functions so
@@ -1375,7 +1512,7 @@ png_image_begin_read_from_file(png_imagep image, const char *file_name)
 
          if (fp != NULL)
          {
-            if (png_image_read_init(image))
+            if (png_image_read_init(image, NULL))
             {
                image->opaque->png_ptr->io_ptr = fp;
                image->opaque->owned_file = 1;
@@ -1433,14 +1570,15 @@ png_image_memory_read(png_structp png_ptr, png_bytep out, png_size_t need)
    }
 }
 
-int PNGAPI png_image_begin_read_from_memory(png_imagep image,
-   png_const_voidp memory, png_size_t size)
+static int
+png_image_begin_read_memory(png_imagep image, png_const_voidp memory,
+   png_size_t size, png_voidp pool)
 {
    if (image != NULL && image->version == PNG_IMAGE_VERSION)
    {
       if (memory != NULL && size > 0)
       {
-         if (png_image_read_init(image))
+         if (png_image_read_init(image, pool))
          {
             /* Now set the IO functions to read from the memory buffer and
              * store it into io_ptr.  Again do this in-place to avoid calling a
@@ -1467,6 +1605,20 @@ int PNGAPI png_image_begin_read_from_memory(png_imagep image,
    return 0;
 }
 
+int PNGAPI png_image_begin_read_from_memory(png_imagep image,
+   png_const_voidp memory, png_size_t size)
+{
+   return png_image_begin_read_memory(image, memory, size, NULL);
+}
+
+#ifdef PNG_DECODER_POOL_SUPPORTED
+int PNGAPI png_image_begin_read_from_memory_pooled(png_imagep image,
+   png_const_voidp memory, png_size_t size, png_decoder_poolp pool)
+{
+   return png_image_begin_read_memory(image, memory, size, pool);
+}
+#endif
+
 /* Utility function to skip chunks that are not used by the simplified image
  * read functions and an appropriate macro to call it.
  */
@@ -2780,6 +2932,25 @@ png_image_read_colormap(png_voidp argument)
    return 1/*ok*/;
 }
 
+/* Called by each of the row reading routines below when output row 'y' is
+ * complete.  This is only active for png_image_finish_read_rows with a
+ * non-interlaced image; display->first_row is then the single row buffer
+ * and display->row_bytes is 0.
+ */
+static void
+png_image_row_done(png_image_read_control *display, png_uint_32 y)
+{
+   if (display->row_fn != NULL && display->row_bytes == 0)
+   {
+      if (!display->row_fn(display->image, y, display->first_row,
+         display->row_arg))
+         png_error(display->image->opaque->png_ptr, "row callback failed");
+
+      if (display->clear_row)
+         memset(display->first_row, 0, display->row_size);
+   }
+}
+
 /* The final part of the color-map read called from png_image_finish_read. */
 static int
 png_image_read_and_map(png_voidp argument)
@@ -2964,6 +3135,8 @@ png_image_read_and_map(png_voidp argument)
                default:
                   break;
             }
+
+            png_image_row_done(display, y);
          }
       }
    }
@@ -3095,6 +3268,7 @@ png_image_read_colormapped(png_voidp argument)
          while (y-- > 0)
          {
             png_read_row(png_ptr, row, NULL);
+            png_image_row_done(display, image->height-1 - y);
             row += row_bytes;
          }
       }
@@ -3211,6 +3385,8 @@ png_image_read_composite(png_voidp argument)
 
                inrow += channels+1; /* components and alpha channel */
             }
+
+            png_image_row_done(display, y);
          }
       }
    }
@@ -3358,6 +3534,8 @@ png_image_read_background(png_voidp argument)
 
                         inrow += 2; /* gray and alpha channel */
                      }
+
+                     png_image_row_done(display, y);
                   }
                }
 
@@ -3402,6 +3580,7 @@ png_image_read_background(png_voidp argument)
                         inrow += 2; /* gray and alpha channel */
                      }
 
+                     png_image_row_done(display, y);
                      row += display->row_bytes;
                   }
                }
@@ -3493,6 +3672,8 @@ png_image_read_background(png_voidp argument)
 
                      inrow += 2; /* components and alpha channel */
                   }
+
+                  png_image_row_done(display, y);
                }
             }
          }
@@ -3921,6 +4102,7 @@ png_image_read_direct(png_voidp argument)
          while (y-- > 0)
          {
             png_read_row(png_ptr, row, NULL);
+            png_image_row_done(display, image->height-1 - y);
             row += row_bytes;
          }
       }
@@ -3929,6 +4111,22 @@ png_image_read_direct(png_voidp argument)
    }
 }
 
+/* Choose the correct 'end' routine; for the color-map case all the setup has
+ * already been done.
+ */
+static int
+png_image_read_end(png_image_read_control *display)
+{
+   png_imagep image = display->image;
+
+   if (image->format & PNG_FORMAT_FLAG_COLORMAP)
+      return png_safe_execute(image, png_image_read_colormap, display) &&
+         png_safe_execute(image, png_image_read_colormapped, display);
+
+   else
+      return png_safe_execute(image, png_image_read_direct, display);
+}
+
 int PNGAPI
 png_image_finish_read(png_imagep image, png_const_colorp background,
    void *buffer, png_int_32 row_stride, void *colormap)
@@ -3963,18 +4161,7 @@ png_image_finish_read(png_imagep image, png_const_colorp background,
             display.background = background;
             display.local_row = NULL;
 
-            /* Choose the correct 'end' routine; for the color-map case all the
-             * setup has already been done.
-             */
-            if (image->format & PNG_FORMAT_FLAG_COLORMAP)
-               result =
-                  png_safe_execute(image, png_image_read_colormap, &display) &&
-                  png_safe_execute(image, png_image_read_colormapped, &display);
-
-            else
-               result =
-                  png_safe_execute(image, png_image_read_direct, &display);
-
+            result = png_image_read_end(&display);
             png_image_free(image);
             return result;
          }
@@ -3996,5 +4183,125 @@ png_image_finish_read(png_imagep image, png_const_colorp background,
    return 0;
 }
 
+/* Pass on the rows of an interlaced image once all the passes are read. */
+static int
+png_image_read_rows_deliver(png_voidp argument)
+{
+   png_image_read_control *display = png_voidcast(png_image_read_control*,
+      argument);
+   png_imagep image = display->image;
+   png_bytep row = png_voidcast(png_bytep, display->row_buffer);
+   png_uint_32 y;
+
+   for (y = 0; y < image->height; ++y)
+   {
+      if (!display->row_fn(image, y, row, display->row_arg))
+         png_error(image->opaque->png_ptr, "row callback failed");
+
+      row += display->row_size;
+   }
+
+   return 1;
+}
+
+/* The guts of png_image_finish_read_rows.  The output is produced in a buffer
+ * allocated here; one row for a non-interlaced image, otherwise the whole image
+ * because the passes must be combined before any row is complete.
+ */
+static int
+png_image_read_rows(png_voidp argument)
+{
+   png_image_read_control *display = png_voidcast(png_image_read_control*,
+      argument);
+   png_imagep image = display->image;
+   png_structrp png_ptr = image->opaque->png_ptr;
+   png_uint_32 rows = 1;
+   png_alloc_size_t size;
+   int result;
+
+   display->row_size = PNG_IMAGE_ROW_STRIDE(*image) *
+      PNG_IMAGE_PIXEL_COMPONENT_SIZE(image->format);
+
+   if (png_ptr->interlaced != PNG_INTERLACE_NONE)
+   {
+      rows = image->height;
+      display->row_stride = PNG_IMAGE_ROW_STRIDE(*image);
+   }
+
+   else /* every row is produced in the same buffer */
+      display->row_stride = 0;
+
+   if (display->row_size > PNG_SIZE_MAX / rows)
+      png_error(png_ptr, "image too large");
+
+   size = rows * display->row_size;
+
+   /* Composition on the existing contents of the row is done on black */
+   if (display->clear_row)
+      display->row_buffer = png_calloc(png_ptr, size);
+
+   else
+      display->row_buffer = png_malloc(png_ptr, size);
+
+   display->buffer = display->row_buffer;
+
+   result = png_image_read_end(display);
+
+   /* Rows of an interlaced image have not been passed on yet */
+   if (result && display->row_bytes != 0)
+      result = png_safe_execute(image, png_image_read_rows_deliver, display);
+
+   png_free(png_ptr, display->row_buffer);
+   display->row_buffer = NULL;
+
+   return result;
+}
+
+int PNGAPI
+png_image_finish_read_rows(png_imagep image, png_const_colorp background,
+   png_image_row_ptr row_fn, png_voidp row_arg, void *colormap)
+{
+   if (image != NULL && image->version == PNG_IMAGE_VERSION)
+   {
+      if (image->opaque != NULL && row_fn != NULL)
+      {
+         if ((image->format & PNG_FORMAT_FLAG_COLORMAP) == 0 ||
+            (image->colormap_entries > 0 && colormap != NULL))
+         {
+            int result;
+            png_image_read_control display;
+
+            memset(&display, 0, (sizeof display));
+            display.image = image;
+            display.colormap = colormap;
+            display.background = background;
+            display.row_fn = row_fn;
+            display.row_arg = row_arg;
+            display.clear_row = background == NULL && (image->format &
+               (PNG_FORMAT_FLAG_ALPHA|PNG_FORMAT_FLAG_LINEAR)) == 0;
+            display.local_row = NULL;
+
+            result = png_safe_execute(image, png_image_read_rows, &display);
+            png_image_free(image);
+            return result;
+         }
+
+         else
+            return png_image_error(image,
+               "png_image_finish_read_rows[color-map]: no color-map");
+      }
+
+      else
+         return png_image_error(image,
+            "png_image_finish_read_rows: invalid argument");
+   }
+
+   else if (image != NULL)
+      return png_image_error(image,
+         "png_image_finish_read_rows: damaged PNG_IMAGE_VERSION");
+
+   return 0;
+}
+
 #endif /* PNG_SIMPLIFIED_READ_SUPPORTED */
 #endif /* PNG_READ_SUPPORTED */
@@ -65,6 +65,11 @@ typedef struct png_compression_buffer
    png_byte                       output[1]; /* actually zbuf_size */
 } png_compression_buffer, *png_compression_bufferp;
 
+#ifdef PNG_WRITE_THREADS_SUPPORTED
+/* State of the parallel IDAT compression, private to pngwthrd.c */
+typedef struct png_write_threads_struct *png_write_threadsp;
+#endif
+
 #define PNG_COMPRESSION_BUFFER_SIZE(pp)\
    (offsetof(png_compression_buffer, output) + (pp)->zbuffer_size)
 #endif
@@ -193,6 +198,11 @@ struct png_struct_def
    int zlib_mem_level;        /* holds zlib compression memory level */
    int zlib_strategy;         /* holds zlib compression strategy */
 #endif
+#ifdef PNG_WRITE_THREADS_SUPPORTED
+   int write_threads_count;        /* from png_set_write_threads */
+   png_write_threadsp write_threads; /* parallel IDAT state, pngwthrd.c */
+   png_voidp write_worker;         /* set in the copies used by the workers */
+#endif
 /* Added at libpng 1.5.4 */
 #ifdef PNG_WRITE_CUSTOMIZE_ZTXT_COMPRESSION_SUPPORTED
    int zlib_text_level;            /* holds zlib compression level */
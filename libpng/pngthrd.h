@@ -0,0 +1,81 @@
+
+/* pngthrd.h - thread primitives used internally by libpng
+ *
+ * Last changed in libpng 1.6.3 [July 18, 2013]
+ *
+ * This code is released under the libpng license.
+ * For conditions of distribution and use, see the disclaimer
+ * and license in png.h
+ *
+ * Included after pngpriv.h by the modules that start threads (pngwthrd.c and
+ * pngpool.c); Win32 threads and condition variables (Vista and later,
+ * including Windows Phone 8), otherwise pthreads.
+ */
+
+#ifndef PNGTHRD_H
+#define PNGTHRD_H
+
+#if defined(_WIN32)
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#  include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+typedef HANDLE png_thread;
+typedef CRITICAL_SECTION png_mutex;
+typedef CONDITION_VARIABLE png_cond;
+#  define PNG_THREAD_RETURN_TYPE DWORD WINAPI
+#  define PNG_THREAD_RETURN      0
+#  define png_thread_create(t,fn,arg)\
+   ((*(t) = CreateThread(NULL, 0, fn, arg, 0, NULL)) != NULL)
+#  define png_thread_join(t)\
+   (WaitForSingleObjectEx(t, INFINITE, FALSE), CloseHandle(t))
+#  define png_mutex_init(m)      InitializeCriticalSectionEx(m, 2000, 0)
+#  define png_mutex_lock(m)      EnterCriticalSection(m)
+#  define png_mutex_unlock(m)    LeaveCriticalSection(m)
+#  define png_mutex_destroy(m)   DeleteCriticalSection(m)
+#  define png_cond_init(c)       InitializeConditionVariable(c)
+#  define png_cond_wait(c,m)     SleepConditionVariableCS(c, m, INFINITE)
+#  define png_cond_broadcast(c)  WakeAllConditionVariable(c)
+#  define png_cond_destroy(c)
+#else
+typedef pthread_t png_thread;
+typedef pthread_mutex_t png_mutex;
+typedef pthread_cond_t png_cond;
+#  define PNG_THREAD_RETURN_TYPE void *
+#  define PNG_THREAD_RETURN      NULL
+#  define png_thread_create(t,fn,arg) (pthread_create(t, NULL, fn, arg) == 0)
+#  define png_thread_join(t)     pthread_join(t, NULL)
+#  define png_mutex_init(m)      pthread_mutex_init(m, NULL)
+#  define png_mutex_lock(m)      pthread_mutex_lock(m)
+#  define png_mutex_unlock(m)    pthread_mutex_unlock(m)
+#  define png_mutex_destroy(m)   pthread_mutex_destroy(m)
+#  define png_cond_init(c)       pthread_cond_init(c, NULL)
+#  define png_cond_wait(c,m)     pthread_cond_wait(c, m)
+#  define png_cond_broadcast(c)  pthread_cond_broadcast(c)
+#  define png_cond_destroy(c)    pthread_cond_destroy(c)
+#endif
+
+/* The number of processors, used when the application asks for 'one thread
+ * per processor'.
+ */
+static int
+png_thread_cpus(void)
+{
+#if defined(_WIN32)
+   SYSTEM_INFO info;
+
+   GetNativeSystemInfo(&info);
+   return (int)info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+   long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+   return n > 0 && n < 256 ? (int)n : 1;
+#else
+   return 1;
+#endif
+}
+
+#endif /* PNGTHRD_H */
@@ -809,6 +809,12 @@ png_write_row(png_structrp png_ptr, png_const_bytep row)
 #endif
 
    /* Find a filter if necessary, filter the row and write it out. */
+#ifdef PNG_WRITE_THREADS_SUPPORTED
+   if (png_ptr->write_threads != NULL)
+      png_write_threads_row(png_ptr, &row_info);
+
+   else
+#endif
    png_write_find_filter(png_ptr, &row_info);
 
    if (png_ptr->write_row_fn != NULL)
@@ -841,6 +847,12 @@ png_write_flush(png_structrp png_ptr)
    if (png_ptr->row_number >= png_ptr->num_rows)
       return;
 
+#ifdef PNG_WRITE_THREADS_SUPPORTED
+   if (png_ptr->write_threads != NULL)
+      png_write_threads_flush(png_ptr);
+
+   else
+#endif
    png_compress_IDAT(png_ptr, NULL, 0, Z_SYNC_FLUSH);
    png_ptr->flush_rows = 0;
    png_flush(png_ptr);
@@ -857,6 +869,11 @@ png_write_destroy(png_structrp png_ptr)
 {
    png_debug(1, "in png_write_destroy");
 
+#ifdef PNG_WRITE_THREADS_SUPPORTED
+   /* Stop the workers first, they use the filter settings */
+   png_write_threads_free(png_ptr);
+#endif
+
    /* Free any memory zlib uses */
    if (png_ptr->flags & PNG_FLAG_ZSTREAM_INITIALIZED)
       deflateEnd(&png_ptr->zstream);
@@ -1373,6 +1390,19 @@ png_set_compression_method(png_structrp png_ptr, int method)
    png_ptr->zlib_method = method;
 }
 
+#ifdef PNG_WRITE_THREADS_SUPPORTED
+void PNGAPI
+png_set_write_threads(png_structrp png_ptr, int threads)
+{
+   png_debug(1, "in png_set_write_threads");
+
+   if (png_ptr == NULL)
+      return;
+
+   png_ptr->write_threads_count = threads;
+}
+#endif
+
 /* The following were added to libpng-1.5.4 */
 #ifdef PNG_WRITE_CUSTOMIZE_ZTXT_COMPRESSION_SUPPORTED
 void PNGAPI
@@ -2166,6 +2196,11 @@ png_image_write_main(png_voidp argument)
       png_set_compression_level(png_ptr, 3);
    }
 
+#  ifdef PNG_WRITE_THREADS_SUPPORTED
+      if ((image->flags & PNG_IMAGE_FLAG_THREADS) != 0)
+         png_set_write_threads(png_ptr, -1);
+#  endif
+
    /* Check for the cases that currently require a pre-transform on the row
     * before it is written.  This only applies when the input is 16-bit and
     * either there is an alpha channel or it is converted to 8-bit.
@@ -0,0 +1,611 @@
+
+/* pngwthrd.c - filter and compress IDAT data on several threads
+ *
+ * Last changed in libpng 1.6.3 [July 18, 2013]
+ *
+ * This code is released under the libpng license.
+ * For conditions of distribution and use, see the disclaimer
+ * and license in png.h
+ *
+ * When png_set_write_threads has been called the transformed rows given to
+ * png_write_row are collected in bands of about PNG_WRITE_THREADS_BAND_SIZE
+ * bytes.  Worker threads select the filters (with the normal
+ * png_write_find_filter, run on a private copy of the png_struct) and deflate
+ * each band with their own zlib stream.  Every band but the last ends with
+ * Z_FULL_FLUSH, so the raw deflate data of the bands can simply be
+ * concatenated after one zlib header; the Adler-32 values of the bands are
+ * combined with adler32_combine.  The calling thread writes each band as an
+ * IDAT chunk, in order.
+ *
+ * Because each band starts with an empty deflate window the compressed size is
+ * very slightly larger than with a single stream.  Interlaced images are always
+ * written on the calling thread.
+ */
+
+#include "pngpriv.h"
+
+#ifdef PNG_WRITE_THREADS_SUPPORTED
+
+#include "pngthrd.h"
+
+/* One band of rows.  The rows are stored with their filter byte, so a band is
+ * exactly the data given to deflate for it.
+ */
+typedef struct png_write_band
+{
+   png_bytep        rows;        /* num_rows rows of row_size bytes */
+   png_bytep        prev;        /* the (unfiltered) row above the band */
+   png_bytep        output;      /* compressed data */
+   png_alloc_size_t output_size; /* allocated size of output */
+   png_alloc_size_t output_len;  /* used size of output */
+   png_uint_32      first_row;   /* row number of the first row */
+   png_uint_32      num_rows;
+   uLong            adler;       /* Adler-32 of the uncompressed band */
+   int              flush;       /* Z_FULL_FLUSH, Z_FINISH for the last band */
+   int              ret;         /* zlib return code */
+   int              done;        /* compressed, waiting to be written */
+} png_write_band;
+
+typedef struct png_write_worker
+{
+   png_write_threadsp threads;
+   png_struct         png;       /* private copy for png_write_find_filter */
+   z_stream           zstream;
+   int                zstream_ok;
+   png_write_band    *band;      /* the band being compressed */
+   png_thread         thread;
+} png_write_worker;
+
+struct png_write_threads_struct
+{
+   png_write_worker *workers;
+   int               num_workers; /* workers allocated */
+   int               num_started; /* threads running */
+   png_write_band   *bands;
+   int               num_bands;   /* ring of bands, indexed by band number */
+   png_size_t        row_size;    /* rowbytes + 1 */
+   png_uint_32       band_rows;   /* rows in a full band */
+   png_row_info      row_info;    /* transformed row description */
+   png_bytep         prev_filters;/* initial filter history (weighted) */
+   int               strategy;    /* zlib strategy, as for the IDAT stream */
+   int               sync_ok;     /* mutex and cond initialized */
+
+   /* The calling thread fills band 'next_band' and writes the bands in
+    * order from 'next_write'.  The workers take bands in order from
+    * 'next_compress' up to 'submitted'.  All counts are band numbers.
+    */
+   png_uint_32       next_band;
+   png_uint_32       filled;      /* rows in band next_band */
+   png_uint_32       next_write;
+   png_uint_32       next_compress;
+   png_uint_32       submitted;
+   uLong             adler;       /* Adler-32 of the bands written */
+   int               quit;
+
+   png_mutex         mutex;       /* protects the band numbers and 'done' */
+   png_cond          cond;        /* signalled when they change */
+};
+
+#define png_write_band_of(t, n) (&(t)->bands[(n) % (png_uint_32)(t)->num_bands])
+
+static PNG_CONST png_byte png_IDAT_string[5] = { 73,  68,  65,  84, '\0'};
+
+/* Called by png_write_filtered_row in a worker's copy of the png_struct with
+ * the chosen filtered row.
+ */
+void /* PRIVATE */
+png_write_threads_filtered_row(png_structrp png_ptr, png_const_bytep row,
+   png_size_t row_length)
+{
+   png_write_worker *worker = png_voidcast(png_write_worker*,
+      png_ptr->write_worker);
+   png_write_band *band = worker->band;
+
+   if (band->ret != Z_OK)
+      return;
+
+   band->adler = adler32(band->adler, row, (uInt)row_length);
+
+   worker->zstream.next_in = PNGZ_INPUT_CAST(row);
+   worker->zstream.avail_in = (uInt)row_length;
+   band->ret = deflate(&worker->zstream, Z_NO_FLUSH);
+
+   /* The output buffer is large enough for the whole band */
+   if (band->ret == Z_OK && worker->zstream.avail_in != 0)
+      band->ret = Z_BUF_ERROR;
+}
+
+/* Filter and compress one band; runs on a worker thread, so nothing here may
+ * call png_error or allocate memory through libpng.
+ */
+static void
+png_write_threads_band(png_write_worker *worker, png_write_band *band)
+{
+   png_write_threadsp threads = worker->threads;
+   png_structp png_ptr = &worker->png;
+   png_bytep row = band->rows;
+   png_uint_32 i;
+
+   worker->band = band;
+   band->adler = adler32(0L, Z_NULL, 0);
+   band->ret = deflateReset(&worker->zstream);
+   worker->zstream.next_out = band->output;
+   worker->zstream.avail_out = (uInt)band->output_size;
+
+#ifdef PNG_WRITE_WEIGHTED_FILTER_SUPPORTED
+   /* The heuristic starts again with each band */
+   if (png_ptr->num_prev_filters > 0)
+      memcpy(png_ptr->prev_filters, threads->prev_filters,
+         png_ptr->num_prev_filters);
+#endif
+
+   for (i = 0; i < band->num_rows && band->ret == Z_OK; i++)
+   {
+      png_row_info row_info = threads->row_info;
+
+      /* row[0] is the filter byte of the unfiltered row, set when the row
+       * was stored; prev_row is only used if it was allocated.
+       */
+      png_ptr->row_buf = row;
+      if (png_ptr->prev_row != NULL)
+         png_ptr->prev_row = i > 0 ? row - threads->row_size : band->prev;
+      png_ptr->row_number = band->first_row + i;
+
+      png_write_find_filter(png_ptr, &row_info);
+      row += threads->row_size;
+   }
+
+   if (band->ret == Z_OK)
+   {
+      worker->zstream.avail_in = 0;
+      band->ret = deflate(&worker->zstream, band->flush);
+
+      if (band->flush == Z_FINISH && band->ret == Z_STREAM_END)
+         band->ret = Z_OK;
+
+      else if (band->ret == Z_OK && (band->flush == Z_FINISH ||
+         worker->zstream.avail_out == 0))
+         band->ret = Z_BUF_ERROR;
+   }
+
+   band->output_len = band->output_size - worker->zstream.avail_out;
+   worker->band = NULL;
+}
+
+static PNG_THREAD_RETURN_TYPE
+png_write_threads_main(void *arg)
+{
+   png_write_worker *worker = png_voidcast(png_write_worker*, arg);
+   png_write_threadsp threads = worker->threads;
+
+   png_mutex_lock(&threads->mutex);
+
+   for (;;)
+   {
+      png_write_band *band;
+
+      while (!threads->quit && threads->next_compress >= threads->submitted)
+         png_cond_wait(&threads->cond, &threads->mutex);
+
+      if (threads->quit)
+         break;
+
+      band = png_write_band_of(threads, threads->next_compress++);
+      png_mutex_unlock(&threads->mutex);
+
+      png_write_threads_band(worker, band);
+
+      png_mutex_lock(&threads->mutex);
+      band->done = 1;
+      png_cond_broadcast(&threads->cond);
+   }
+
+   png_mutex_unlock(&threads->mutex);
+   return PNG_THREAD_RETURN;
+}
+
+/* Stop the workers and free everything; safe to call on a partially
+ * initialized structure, and from png_write_destroy after a png_error.
+ */
+void /* PRIVATE */
+png_write_threads_free(png_structrp png_ptr)
+{
+   png_write_threadsp threads = png_ptr->write_threads;
+   int i;
+
+   if (threads == NULL)
+      return;
+
+   png_ptr->write_threads = NULL;
+
+   if (threads->num_started > 0)
+   {
+      png_mutex_lock(&threads->mutex);
+      threads->quit = 1;
+      png_cond_broadcast(&threads->cond);
+      png_mutex_unlock(&threads->mutex);
+
+      for (i = 0; i < threads->num_started; i++)
+         png_thread_join(threads->workers[i].thread);
+   }
+
+   if (threads->sync_ok)
+   {
+      png_cond_destroy(&threads->cond);
+      png_mutex_destroy(&threads->mutex);
+   }
+
+   if (threads->workers != NULL)
+   {
+      for (i = 0; i < threads->num_workers; i++)
+      {
+         png_write_worker *worker = &threads->workers[i];
+
+         if (worker->zstream_ok)
+            deflateEnd(&worker->zstream);
+
+         png_free(png_ptr, worker->png.sub_row);
+         png_free(png_ptr, worker->png.up_row);
+         png_free(png_ptr, worker->png.avg_row);
+         png_free(png_ptr, worker->png.paeth_row);
+#ifdef PNG_WRITE_WEIGHTED_FILTER_SUPPORTED
+         png_free(png_ptr, worker->png.prev_filters);
+#endif
+      }
+
+      png_free(png_ptr, threads->workers);
+   }
+
+   if (threads->bands != NULL)
+   {
+      for (i = 0; i < threads->num_bands; i++)
+      {
+         png_free(png_ptr, threads->bands[i].rows);
+         png_free(png_ptr, threads->bands[i].prev);
+         png_free(png_ptr, threads->bands[i].output);
+      }
+
+      png_free(png_ptr, threads->bands);
+   }
+
+   png_free(png_ptr, threads->prev_filters);
+   png_free(png_ptr, threads);
+}
+
+/* Allocate a filter buffer like png_write_start_row does */
+static png_bytep
+png_write_threads_filter_row(png_structrp png_ptr, png_bytep row, int filter)
+{
+   png_bytep buf;
+
+   if (row == NULL)
+      return NULL;
+
+   buf = png_voidcast(png_bytep, png_malloc(png_ptr, png_ptr->rowbytes + 1));
+   buf[0] = (png_byte)filter;
+   return buf;
+}
+
+/* Called at the end of png_write_start_row: set up the bands and start the
+ * workers if the image is worth it, otherwise the rows are written normally.
+ */
+void /* PRIVATE */
+png_write_threads_start(png_structrp png_ptr)
+{
+   png_write_threadsp threads;
+   png_size_t row_size = png_ptr->rowbytes + 1;
+   png_alloc_size_t band_size, output_size;
+   png_uint_32 band_rows;
+   int num_workers = png_ptr->write_threads_count;
+   int level = png_ptr->zlib_level;
+   int strategy;
+   int i;
+
+   if (num_workers < 0)
+      num_workers = png_thread_cpus();
+
+   if (num_workers < 2 || png_ptr->interlaced ||
+       png_ptr->compression_type != PNG_COMPRESSION_TYPE_BASE)
+      return;
+
+   band_rows = (png_uint_32)(PNG_WRITE_THREADS_BAND_SIZE / row_size);
+   if (band_rows == 0)
+      band_rows = 1;
+
+   /* A single band is better compressed by the normal code */
+   if (png_ptr->num_rows <= band_rows)
+      return;
+
+   if ((png_ptr->num_rows + band_rows - 1) / band_rows < (png_uint_32)num_workers)
+      num_workers = (int)((png_ptr->num_rows + band_rows - 1) / band_rows);
+
+   /* The same strategy as png_deflate_claim for IDAT */
+   if (png_ptr->flags & PNG_FLAG_ZLIB_CUSTOM_STRATEGY)
+      strategy = png_ptr->zlib_strategy;
+
+   else if (png_ptr->do_filter != PNG_FILTER_NONE)
+      strategy = PNG_Z_DEFAULT_STRATEGY;
+
+   else
+      strategy = PNG_Z_DEFAULT_NOFILTER_STRATEGY;
+
+   /* Worst case of deflate (stored blocks), plus the final flush */
+   band_size = band_rows * (png_alloc_size_t)row_size;
+   output_size = band_size + (band_size >> 3) + (band_size >> 6) + 64;
+   if (output_size > ZLIB_IO_MAX)
+      return;
+
+   threads = png_voidcast(png_write_threadsp, png_calloc(png_ptr,
+      (sizeof *threads)));
+   png_ptr->write_threads = threads;
+
+   threads->row_size = row_size;
+   threads->band_rows = band_rows;
+   threads->strategy = strategy;
+   threads->adler = adler32(0L, Z_NULL, 0);
+   threads->row_info.color_type = png_ptr->color_type;
+   threads->row_info.width = png_ptr->width;
+   threads->row_info.rowbytes = png_ptr->rowbytes;
+   threads->row_info.bit_depth = png_ptr->bit_depth;
+   threads->row_info.channels = png_ptr->channels;
+   threads->row_info.pixel_depth = png_ptr->pixel_depth;
+
+   /* Two bands per worker: one being compressed, one waiting */
+   threads->bands = png_voidcast(png_write_band*, png_calloc(png_ptr,
+      2 * num_workers * (sizeof *threads->bands)));
+   threads->num_bands = 2 * num_workers;
+
+   for (i = 0; i < threads->num_bands; i++)
+   {
+      png_write_band *band = &threads->bands[i];
+
+      band->rows = png_voidcast(png_bytep, png_malloc(png_ptr, band_size));
+      band->prev = png_voidcast(png_bytep, png_calloc(png_ptr, row_size));
+      band->output = png_voidcast(png_bytep, png_malloc(png_ptr, output_size));
+      band->output_size = output_size;
+   }
+
+#ifdef PNG_WRITE_WEIGHTED_FILTER_SUPPORTED
+   if (png_ptr->num_prev_filters > 0)
+   {
+      threads->prev_filters = png_voidcast(png_bytep, png_malloc(png_ptr,
+         png_ptr->num_prev_filters));
+      memcpy(threads->prev_filters, png_ptr->prev_filters,
+         png_ptr->num_prev_filters);
+   }
+#endif
+
+   threads->workers = png_voidcast(png_write_worker*, png_calloc(png_ptr,
+      num_workers * (sizeof *threads->workers)));
+
+   for (i = 0; i < num_workers; i++)
+   {
+      png_write_worker *worker = &threads->workers[i];
+
+      /* The copy shares the read-only state of the png_struct (filter
+       * settings and weights); the buffers written by png_write_find_filter
+       * are private.
+       */
+      worker->threads = threads;
+      worker->png = *png_ptr;
+      worker->png.write_threads = NULL;
+      worker->png.write_worker = worker;
+      worker->png.sub_row = worker->png.up_row = NULL;
+      worker->png.avg_row = worker->png.paeth_row = NULL;
+#ifdef PNG_WRITE_WEIGHTED_FILTER_SUPPORTED
+      worker->png.prev_filters = NULL;
+#endif
+      threads->num_workers = i + 1;
+
+      worker->png.sub_row = png_write_threads_filter_row(png_ptr,
+         png_ptr->sub_row, PNG_FILTER_VALUE_SUB);
+      worker->png.up_row = png_write_threads_filter_row(png_ptr,
+         png_ptr->up_row, PNG_FILTER_VALUE_UP);
+      worker->png.avg_row = png_write_threads_filter_row(png_ptr,
+         png_ptr->avg_row, PNG_FILTER_VALUE_AVG);
+      worker->png.paeth_row = png_write_threads_filter_row(png_ptr,
+         png_ptr->paeth_row, PNG_FILTER_VALUE_PAETH);
+#ifdef PNG_WRITE_WEIGHTED_FILTER_SUPPORTED
+      if (png_ptr->num_prev_filters > 0)
+         worker->png.prev_filters = png_voidcast(png_bytep, png_malloc(png_ptr,
+            png_ptr->num_prev_filters));
+#endif
+
+      /* Raw deflate: the zlib header and trailer are written here */
+      memset(&worker->zstream, 0, (sizeof worker->zstream));
+      if (deflateInit2(&worker->zstream, level, png_ptr->zlib_method,
+         -png_ptr->zlib_window_bits, png_ptr->zlib_mem_level, strategy) != Z_OK)
+         png_error(png_ptr, "zlib failed to initialize compressor");
+      worker->zstream_ok = 1;
+   }
+
+   png_mutex_init(&threads->mutex);
+   png_cond_init(&threads->cond);
+   threads->sync_ok = 1;
+
+   for (i = 0; i < num_workers; i++)
+   {
+      png_write_worker *worker = &threads->workers[i];
+
+      if (!png_thread_create(&worker->thread, png_write_threads_main, worker))
+         break;
+
+      threads->num_started = i + 1;
+   }
+
+   /* Without threads the rows are written by the normal code */
+   if (threads->num_started == 0)
+      png_write_threads_free(png_ptr);
+}
+
+/* Write band 'next_write' as an IDAT chunk once it is compressed */
+static void
+png_write_threads_write(png_structrp png_ptr, png_write_threadsp threads)
+{
+   png_write_band *band = png_write_band_of(threads, threads->next_write);
+   png_byte header[2], trailer[4];
+   png_size_t header_len = 0, trailer_len = 0;
+
+   png_mutex_lock(&threads->mutex);
+   while (!band->done)
+      png_cond_wait(&threads->cond, &threads->mutex);
+   png_mutex_unlock(&threads->mutex);
+
+   if (band->ret != Z_OK)
+   {
+      png_zstream_error(png_ptr, band->ret);
+      png_error(png_ptr, png_ptr->zstream.msg);
+   }
+
+   if (threads->next_write == 0)
+   {
+      /* The zlib header, as deflate would write it */
+      int level = png_ptr->zlib_level;
+      int level_flags;
+      unsigned int cmf = ((unsigned int)(png_ptr->zlib_window_bits - 8) << 4) |
+         Z_DEFLATED;
+      unsigned int check;
+
+      if (level == Z_DEFAULT_COMPRESSION)
+         level = 6;
+
+      if (threads->strategy >= Z_HUFFMAN_ONLY || level < 2)
+         level_flags = 0;
+
+      else if (level < 6)
+         level_flags = 1;
+
+      else if (level == 6)
+         level_flags = 2;
+
+      else
+         level_flags = 3;
+
+      check = (cmf << 8) | ((unsigned int)level_flags << 6);
+      check += 31 - check % 31;
+      header[0] = (png_byte)(check >> 8);
+      header[1] = (png_byte)check;
+      header_len = 2;
+   }
+
+   threads->adler = adler32_combine(threads->adler, band->adler,
+      (z_off_t)(band->num_rows * threads->row_size));
+
+   if (band->flush == Z_FINISH)
+   {
+      png_save_uint_32(trailer, (png_uint_32)threads->adler);
+      trailer_len = 4;
+   }
+
+   png_write_chunk_start(png_ptr, png_IDAT_string, (png_uint_32)(header_len +
+      band->output_len + trailer_len));
+   if (header_len > 0)
+      png_write_chunk_data(png_ptr, header, header_len);
+   png_write_chunk_data(png_ptr, band->output, band->output_len);
+   if (trailer_len > 0)
+      png_write_chunk_data(png_ptr, trailer, trailer_len);
+   png_write_chunk_end(png_ptr);
+   png_ptr->mode |= PNG_HAVE_IDAT;
+
+   band->done = 0;
+   threads->next_write++;
+}
+
+/* Give the band being filled to the workers */
+static void
+png_write_threads_submit(png_write_threadsp threads, int flush)
+{
+   png_write_band *band = png_write_band_of(threads, threads->next_band);
+
+   band->num_rows = threads->filled;
+   band->flush = flush;
+
+   png_mutex_lock(&threads->mutex);
+   threads->submitted = ++threads->next_band;
+   png_cond_broadcast(&threads->cond);
+   png_mutex_unlock(&threads->mutex);
+
+   threads->filled = 0;
+}
+
+/* Used by png_write_row in place of png_write_find_filter: the transformed row
+ * is in png_ptr->row_buf + 1.
+ */
+void /* PRIVATE */
+png_write_threads_row(png_structrp png_ptr, png_row_infop row_info)
+{
+   png_write_threadsp threads = png_ptr->write_threads;
+   png_write_band *band = png_write_band_of(threads, threads->next_band);
+
+   if (threads->filled == 0)
+   {
+      /* Starting a band: its slot must have been written out */
+      while (threads->next_write + threads->num_bands <= threads->next_band)
+         png_write_threads_write(png_ptr, threads);
+
+      band->first_row = png_ptr->row_number;
+
+      if (threads->next_band > 0 && png_ptr->prev_row != NULL)
+      {
+         png_write_band *prev = png_write_band_of(threads,
+            threads->next_band - 1);
+
+         memcpy(band->prev, prev->rows + (prev->num_rows - 1) *
+            threads->row_size, threads->row_size);
+      }
+   }
+
+   {
+      png_bytep row = band->rows + threads->filled * threads->row_size;
+
+      row[0] = PNG_FILTER_VALUE_NONE;
+      memcpy(row + 1, png_ptr->row_buf + 1, row_info->rowbytes);
+   }
+   threads->filled++;
+
+   if (png_ptr->row_number + 1 >= png_ptr->num_rows)
+      png_write_threads_submit(threads, Z_FINISH);
+
+   else if (threads->filled >= threads->band_rows)
+      png_write_threads_submit(threads, Z_FULL_FLUSH);
+
+   /* Finish row - updates counters and ends the IDAT data if last row */
+   png_write_finish_row(png_ptr);
+
+#ifdef PNG_WRITE_FLUSH_SUPPORTED
+   png_ptr->flush_rows++;
+
+   if (png_ptr->flush_dist > 0 &&
+       png_ptr->flush_rows >= png_ptr->flush_dist)
+   {
+      png_write_flush(png_ptr);
+   }
+#endif
+}
+
+/* png_write_flush: end the current band and write everything */
+void /* PRIVATE */
+png_write_threads_flush(png_structrp png_ptr)
+{
+   png_write_threadsp threads = png_ptr->write_threads;
+
+   if (threads->filled > 0)
+      png_write_threads_submit(threads, Z_FULL_FLUSH);
+
+   while (threads->next_write < threads->next_band)
+      png_write_threads_write(png_ptr, threads);
+}
+
+/* Called by png_write_finish_row after the last row */
+void /* PRIVATE */
+png_write_threads_end(png_structrp png_ptr)
+{
+   png_write_threadsp threads = png_ptr->write_threads;
+
+   while (threads->next_write < threads->next_band)
+      png_write_threads_write(png_ptr, threads);
+
+   png_ptr->mode |= PNG_HAVE_IDAT | PNG_AFTER_IDAT;
+   png_write_threads_free(png_ptr);
+}
+#endif /* PNG_WRITE_THREADS_SUPPORTED */
@@ -2038,6 +2038,11 @@ png_write_start_row(png_structrp png_ptr)
       png_ptr->num_rows = png_ptr->height;
       png_ptr->usr_width = png_ptr->width;
    }
+
+#ifdef PNG_WRITE_THREADS_SUPPORTED
+   if (png_ptr->write_threads_count != 0)
+      png_write_threads_start(png_ptr);
+#endif
 }
 
 /* Internal use only.  Called when finished processing a row of data. */
@@ -2121,6 +2126,12 @@ png_write_finish_row(png_structrp png_ptr)
 
    /* If we get here, we've just written the last row, so we need
       to flush the compressor */
+#ifdef PNG_WRITE_THREADS_SUPPORTED
+   if (png_ptr->write_threads != NULL)
+      png_write_threads_end(png_ptr);
+
+   else
+#endif
    png_compress_IDAT(png_ptr, NULL, 0, Z_FINISH);
 }
 
@@ -2995,6 +3006,15 @@ png_write_filtered_row(png_structrp png_ptr, png_bytep filtered_row,
 
    png_debug1(2, "filter = %d", filtered_row[0]);
 
+#ifdef PNG_WRITE_THREADS_SUPPORTED
+   /* In a worker thread the row goes to the band being compressed */
+   if (png_ptr->write_worker != NULL)
+   {
+      png_write_threads_filtered_row(png_ptr, filtered_row, full_row_length);
+      return;
+   }
+#endif
+
    png_compress_IDAT(png_ptr, filtered_row, full_row_length, Z_NO_FLUSH);
 
    /* Swap the current and previous rows */
@@ -3,6 +3,13 @@
  * For conditions of distribution and use, see copyright notice in zlib.h
  *
  * Compile this file with -DNO_GZCOMPRESS to avoid the compression code.
+ *
+ * The I/O buffer size can be changed per file with gzbuffer(). When reading,
+ * gzindex() enables an access point index in the manner of examples/zran.c:
+ * every span bytes of uncompressed output the inflate state is saved at a
+ * deflate block boundary (file offset, bit offset and the 32K window), so
+ * that gzseek() can resume inflation at the nearest preceding access point
+ * instead of rewinding and decompressing from the start of the file.
  */
 
 /* @(#) $Id$ */
@@ -23,9 +30,13 @@ struct internal_state {int dummy;}; /* for buggy compilers */
 #  ifdef MAXSEG_64K
 #    define Z_BUFSIZE 4096 /* minimize memory usage for 16-bit DOS */
 #  else
-#    define Z_BUFSIZE 16384
+#    define Z_BUFSIZE 65536 /* default size, see gzbuffer() */
 #  endif
 #endif
+#ifndef Z_BUFSIZE_MIN
+#  define Z_BUFSIZE_MIN 64 /* smallest size accepted by gzbuffer() */
+#endif
+#define WINSIZE 32768U      /* sliding window size saved with access points */
 #ifndef Z_PRINTF_BUFSIZE
 #  define Z_PRINTF_BUFSIZE 4096
 #endif
@@ -53,6 +64,17 @@ static int const gz_magic[2] = {0x1f, 0x8b}; /* gzip magic header */
 #define COMMENT      0x10 /* bit 4 set: file comment present */
 #define RESERVED     0xE0 /* bits 5..7: reserved */
 
+/* access point entry of the gzindex() index */
+typedef struct gz_access {
+    z_off_t out;      /* corresponding offset in uncompressed data */
+    z_off_t in;       /* value of s->in (compressed bytes inflated) */
+    z_off_t pos;      /* file offset of the first byte not yet inflated */
+    int     bits;     /* number of bits (1-7) from byte at pos - 1, or 0 */
+    Byte    *window;  /* preceding uncompressed data, or NULL if the point
+                         is the start of a gzip member */
+    uInt    wlen;     /* number of valid bytes in window */
+} gz_access;
+
 typedef struct gz_stream {
     z_stream stream;
     int      z_err;   /* error code for last stream operation */
@@ -70,6 +92,13 @@ typedef struct gz_stream {
     z_off_t  out;     /* bytes out of deflate or inflate */
     int      back;    /* one character push-back */
     int      last;    /* true if push-back is last character */
+    uInt     size;    /* size of inbuf (reading) or outbuf (writing) */
+    int      nocrc;   /* true if the member was entered from an access
+                         point, so that its trailer cannot be verified */
+    z_off_t  span;    /* distance between access points, 0 if no index */
+    int      have;    /* number of access points in list */
+    int      room;    /* number of entries allocated for list */
+    gz_access *list;  /* access points, in increasing order of out */
 } gz_stream;
 
 
@@ -80,6 +109,9 @@ local void   check_header OF((gz_stream *s));
 local int    destroy      OF((gz_stream *s));
 local void   putLong      OF((FILE *file, uLong x));
 local uLong  getLong      OF((gz_stream *s));
+local void   free_index   OF((gz_stream *s));
+local void   add_point    OF((gz_stream *s, int bits, int member));
+local int    use_point    OF((gz_stream *s, z_off_t offset));
 
 /* ===========================================================================
      Opens a gzip (.gz) file for reading or writing. The mode parameter
@@ -123,6 +155,11 @@ local gzFile gz_open (path, mode, fd)
     s->crc = crc32(0L, Z_NULL, 0);
     s->msg = NULL;
     s->transparent = 0;
+    s->size = Z_BUFSIZE;
+    s->nocrc = 0;
+    s->span = 0;
+    s->have = s->room = 0;
+    s->list = NULL;
 
     s->path = (char*)ALLOC(strlen(path)+1);
     if (s->path == NULL) {
@@ -156,13 +193,13 @@ local gzFile gz_open (path, mode, fd)
                            Z_DEFLATED, -MAX_WBITS, DEF_MEM_LEVEL, strategy);
         /* windowBits is passed < 0 to suppress zlib header */
 
-        s->stream.next_out = s->outbuf = (Byte*)ALLOC(Z_BUFSIZE);
+        s->stream.next_out = s->outbuf = (Byte*)ALLOC(s->size);
 #endif
         if (err != Z_OK || s->outbuf == Z_NULL) {
             return destroy(s), (gzFile)Z_NULL;
         }
     } else {
-        s->stream.next_in  = s->inbuf = (Byte*)ALLOC(Z_BUFSIZE);
+        s->stream.next_in  = s->inbuf = (Byte*)ALLOC(s->size);
 
         err = inflateInit2(&(s->stream), -MAX_WBITS);
         /* windowBits is passed < 0 to tell that there is no zlib header.
@@ -175,7 +212,7 @@ local gzFile gz_open (path, mode, fd)
             return destroy(s), (gzFile)Z_NULL;
         }
     }
-    s->stream.avail_out = Z_BUFSIZE;
+    s->stream.avail_out = s->size;
 
     errno = 0;
     s->file = fd < 0 ? F_OPEN(path, fmode) : (FILE*)fdopen(fd, fmode);
@@ -244,10 +281,10 @@ int ZEXPORT gzsetparams (file, level, strategy)
     if (s->stream.avail_out == 0) {
 
         s->stream.next_out = s->outbuf;
-        if (fwrite(s->outbuf, 1, Z_BUFSIZE, s->file) != Z_BUFSIZE) {
+        if (fwrite(s->outbuf, 1, s->size, s->file) != s->size) {
             s->z_err = Z_ERRNO;
         }
-        s->stream.avail_out = Z_BUFSIZE;
+        s->stream.avail_out = s->size;
     }
 
     return deflateParams (&(s->stream), level, strategy);
@@ -264,7 +301,7 @@ local int get_byte(s)
     if (s->z_eof) return EOF;
     if (s->stream.avail_in == 0) {
         errno = 0;
-        s->stream.avail_in = (uInt)fread(s->inbuf, 1, Z_BUFSIZE, s->file);
+        s->stream.avail_in = (uInt)fread(s->inbuf, 1, s->size, s->file);
         if (s->stream.avail_in == 0) {
             s->z_eof = 1;
             if (ferror(s->file)) s->z_err = Z_ERRNO;
@@ -300,7 +337,7 @@ local void check_header(s)
     if (len < 2) {
         if (len) s->inbuf[0] = s->stream.next_in[0];
         errno = 0;
-        len = (uInt)fread(s->inbuf + len, 1, Z_BUFSIZE >> len, s->file);
+        len = (uInt)fread(s->inbuf + len, 1, s->size >> len, s->file);
         if (len == 0 && ferror(s->file)) s->z_err = Z_ERRNO;
         s->stream.avail_in += len;
         s->stream.next_in = s->inbuf;
@@ -380,6 +417,7 @@ local int destroy (s)
     }
     if (s->z_err < 0) err = s->z_err;
 
+    free_index(s);
     TRYFREE(s->inbuf);
     TRYFREE(s->outbuf);
     TRYFREE(s->path);
@@ -387,6 +425,201 @@ local int destroy (s)
     return err;
 }
 
+/* ===========================================================================
+     Frees the access point index of a gz_stream and stops further indexing.
+*/
+local void free_index (s)
+    gz_stream *s;
+{
+    while (s->have) {
+        s->have--;
+        TRYFREE(s->list[s->have].window);
+    }
+    TRYFREE(s->list);
+    s->list = NULL;
+    s->room = 0;
+    s->span = 0;
+}
+
+/* ===========================================================================
+     Saves the current position of a gz_stream opened for reading as an
+   access point, unless a point at or beyond s->out is already known. bits
+   is the number of unused bits in the last byte given to inflate. If member
+   is true, s is at the start of the deflate data of a gzip member and no
+   window needs to be saved. Running out of memory, or a file position that
+   cannot be determined, drops the index instead of failing the read.
+*/
+local void add_point (s, bits, member)
+    gz_stream *s;
+    int bits;
+    int member;
+{
+    gz_access *next;
+
+    if (s->have && s->out <= s->list[s->have - 1].out) return;
+
+    if (s->have == s->room) {
+        int room = s->room ? s->room << 1 : 8;
+
+        next = (gz_access*)ALLOC(room * sizeof(gz_access));
+        if (next == NULL) {
+            free_index(s);
+            return;
+        }
+        if (s->have) zmemcpy(next, s->list, s->have * sizeof(gz_access));
+        TRYFREE(s->list);
+        s->list = next;
+        s->room = room;
+    }
+    next = s->list + s->have;
+
+    next->pos = ftell(s->file);
+    if (next->pos < 0) {
+        free_index(s);
+        return;
+    }
+    next->pos -= s->stream.avail_in;
+    next->in = s->in;
+    next->out = s->out;
+    next->bits = bits;
+    next->window = NULL;
+    next->wlen = 0;
+    if (!member) {
+        next->window = (Byte*)ALLOC(WINSIZE);
+        if (next->window == NULL) {
+            free_index(s);
+            return;
+        }
+        (void)inflateGetDictionary(&(s->stream), next->window, &next->wlen);
+    }
+    s->have++;
+}
+
+/* ===========================================================================
+     Repositions a gz_stream opened for reading at the last access point at
+   or before offset, if that is closer than the current position (or if the
+   current position is past offset). Returns 0 on success, including when no
+   access point is used, or -1 on error.
+*/
+local int use_point (s, offset)
+    gz_stream *s;
+    z_off_t offset;
+{
+    gz_access *point;
+    int lo = 0, hi = s->have, mid;
+    int c;
+
+    /* find the number of points with out <= offset */
+    while (lo < hi) {
+        mid = (lo + hi) >> 1;
+        if (s->list[mid].out <= offset) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == 0) return 0;
+    point = s->list + lo - 1;
+    if (offset >= s->out && point->out <= s->out) return 0;
+
+    /* restart inflate at the access point */
+    s->z_err = Z_OK;
+    s->z_eof = 0;
+    s->back = EOF;
+    s->stream.avail_in = 0;
+    s->stream.next_in = s->inbuf;
+    if (fseek(s->file, point->pos - (point->bits ? 1 : 0), SEEK_SET) < 0)
+        return -1;
+    (void)inflateReset(&(s->stream));
+    if (point->bits) {
+        c = get_byte(s);
+        if (c == EOF) return -1;
+        (void)inflatePrime(&(s->stream), point->bits,
+                           c >> (8 - point->bits));
+    }
+    if (point->window != NULL)
+        (void)inflateSetDictionary(&(s->stream), point->window, point->wlen);
+    s->in = point->in;
+    s->out = point->out;
+    s->crc = crc32(0L, Z_NULL, 0);
+    s->nocrc = point->window != NULL;
+    return 0;
+}
+
+/* ===========================================================================
+     Changes the size of the buffer used to read or write the given
+   compressed file. Pending input or output is kept.
+*/
+int ZEXPORT gzbuffer (file, size)
+    gzFile file;
+    unsigned size;
+{
+    gz_stream *s = (gz_stream*)file;
+    Byte *buf;
+
+    if (s == NULL || (s->mode != 'r' && s->mode != 'w')) return -1;
+    if (size < Z_BUFSIZE_MIN) size = Z_BUFSIZE_MIN;
+    if (size == s->size) return 0;
+
+    if (s->mode == 'w') {
+#ifdef NO_GZCOMPRESS
+        return -1;
+#else
+        uInt len = s->size - s->stream.avail_out;
+
+        if (len != 0) {
+            if ((uInt)fwrite(s->outbuf, 1, len, s->file) != len) {
+                s->z_err = Z_ERRNO;
+                return -1;
+            }
+            s->stream.next_out = s->outbuf;
+            s->stream.avail_out = s->size;
+        }
+        buf = (Byte*)ALLOC(size);
+        if (buf == Z_NULL) return -1;
+        TRYFREE(s->outbuf);
+        s->stream.next_out = s->outbuf = buf;
+        s->stream.avail_out = size;
+
+        /* zeroes for gzseek, reallocated at the new size when needed */
+        TRYFREE(s->inbuf);
+        s->inbuf = Z_NULL;
+#endif
+    } else {
+        if (s->stream.avail_in > size) return -1;
+        buf = (Byte*)ALLOC(size);
+        if (buf == Z_NULL) return -1;
+        if (s->stream.avail_in)
+            zmemcpy(buf, s->stream.next_in, s->stream.avail_in);
+        TRYFREE(s->inbuf);
+        s->stream.next_in = s->inbuf = buf;
+
+        /* gzseek scratch buffer, reallocated at the new size when needed */
+        TRYFREE(s->outbuf);
+        s->outbuf = Z_NULL;
+    }
+    s->size = size;
+    return 0;
+}
+
+/* ===========================================================================
+     Builds an access point index every span uncompressed bytes while the
+   given file is read, for use by gzseek. A span of zero drops the index.
+*/
+int ZEXPORT gzindex (file, span)
+    gzFile file;
+    z_off_t span;
+{
+    gz_stream *s = (gz_stream*)file;
+
+    if (s == NULL || s->mode != 'r' || span < 0) return -1;
+    if (span == 0) {
+        free_index(s);
+        return 0;
+    }
+    if (ftell(s->file) < 0) return -1;   /* access points need fseek */
+    if (span < (z_off_t)WINSIZE) span = WINSIZE;
+    s->span = span;
+    return 0;
+}
+
 /* ===========================================================================
      Reads the given number of uncompressed bytes from the compressed file.
    gzread returns the number of bytes actually read (0 for end of file).
@@ -449,7 +682,7 @@ int ZEXPORT gzread (file, buf, len)
         if (s->stream.avail_in == 0 && !s->z_eof) {
 
             errno = 0;
-            s->stream.avail_in = (uInt)fread(s->inbuf, 1, Z_BUFSIZE, s->file);
+            s->stream.avail_in = (uInt)fread(s->inbuf, 1, s->size, s->file);
             if (s->stream.avail_in == 0) {
                 s->z_eof = 1;
                 if (ferror(s->file)) {
@@ -461,16 +694,25 @@ int ZEXPORT gzread (file, buf, len)
         }
         s->in += s->stream.avail_in;
         s->out += s->stream.avail_out;
-        s->z_err = inflate(&(s->stream), Z_NO_FLUSH);
+        /* With an index, stop at each deflate block boundary so that the
+         * state can be saved there as an access point.
+         */
+        s->z_err = inflate(&(s->stream), s->span ? Z_BLOCK : Z_NO_FLUSH);
         s->in -= s->stream.avail_in;
         s->out -= s->stream.avail_out;
 
+        if (s->span && s->z_err == Z_OK &&
+            (s->stream.data_type & 128) && !(s->stream.data_type & 64) &&
+            s->out - (s->have ? s->list[s->have - 1].out : 0) >= s->span) {
+            add_point(s, s->stream.data_type & 7, 0);
+        }
+
         if (s->z_err == Z_STREAM_END) {
             /* Check CRC and original size */
             s->crc = crc32(s->crc, start, (uInt)(s->stream.next_out - start));
             start = s->stream.next_out;
 
-            if (getLong(s) != s->crc) {
+            if (getLong(s) != s->crc && !s->nocrc) {
                 s->z_err = Z_DATA_ERROR;
             } else {
                 (void)getLong(s);
@@ -482,6 +724,8 @@ int ZEXPORT gzread (file, buf, len)
                 if (s->z_err == Z_OK) {
                     inflateReset(&(s->stream));
                     s->crc = crc32(0L, Z_NULL, 0);
+                    s->nocrc = 0;
+                    if (s->span) add_point(s, 0, 1);
                 }
             }
         }
@@ -573,11 +817,11 @@ int ZEXPORT gzwrite (file, buf, len)
         if (s->stream.avail_out == 0) {
 
             s->stream.next_out = s->outbuf;
-            if (fwrite(s->outbuf, 1, Z_BUFSIZE, s->file) != Z_BUFSIZE) {
+            if (fwrite(s->outbuf, 1, s->size, s->file) != s->size) {
                 s->z_err = Z_ERRNO;
                 break;
             }
-            s->stream.avail_out = Z_BUFSIZE;
+            s->stream.avail_out = s->size;
         }
         s->in += s->stream.avail_in;
         s->out += s->stream.avail_out;
@@ -715,7 +959,7 @@ local int do_flush (file, flush)
     s->stream.avail_in = 0; /* should be zero already anyway */
 
     for (;;) {
-        len = Z_BUFSIZE - s->stream.avail_out;
+        len = s->size - s->stream.avail_out;
 
         if (len != 0) {
             if ((uInt)fwrite(s->outbuf, 1, len, s->file) != len) {
@@ -723,7 +967,7 @@ local int do_flush (file, flush)
                 return Z_ERRNO;
             }
             s->stream.next_out = s->outbuf;
-            s->stream.avail_out = Z_BUFSIZE;
+            s->stream.avail_out = s->size;
         }
         if (done) break;
         s->out += s->stream.avail_out;
@@ -762,7 +1006,8 @@ int ZEXPORT gzflush (file, flush)
       gzseek returns the resulting offset location as measured in bytes from
    the beginning of the uncompressed stream, or -1 in case of error.
       SEEK_END is not implemented, returns error.
-      In this version of the library, gzseek can be extremely slow.
+      When reading without an index (see gzindex), gzseek can be extremely
+   slow.
 */
 z_off_t ZEXPORT gzseek (file, offset, whence)
     gzFile file;
@@ -787,13 +1032,13 @@ z_off_t ZEXPORT gzseek (file, offset, whence)
 
         /* At this point, offset is the number of zero bytes to write. */
         if (s->inbuf == Z_NULL) {
-            s->inbuf = (Byte*)ALLOC(Z_BUFSIZE); /* for seeking */
+            s->inbuf = (Byte*)ALLOC(s->size); /* for seeking */
             if (s->inbuf == Z_NULL) return -1L;
-            zmemzero(s->inbuf, Z_BUFSIZE);
+            zmemzero(s->inbuf, s->size);
         }
         while (offset > 0)  {
-            uInt size = Z_BUFSIZE;
-            if (offset < Z_BUFSIZE) size = (uInt)offset;
+            uInt size = s->size;
+            if (offset < s->size) size = (uInt)offset;
 
             size = gzwrite(file, s->inbuf, size);
             if (size == 0) return -1L;
@@ -822,7 +1067,11 @@ z_off_t ZEXPORT gzseek (file, offset, whence)
         return offset;
     }
 
-    /* For a negative seek, rewind and use positive seek */
+    /* Resume at the closest access point, if any is closer than the
+     * current position. For a negative seek without a usable access point,
+     * rewind and use positive seek.
+     */
+    if (s->have && use_point(s, offset) < 0) return -1L;
     if (offset >= s->out) {
         offset -= s->out;
     } else if (gzrewind(file) < 0) {
@@ -831,7 +1080,7 @@ z_off_t ZEXPORT gzseek (file, offset, whence)
     /* offset is now the number of bytes to skip. */
 
     if (offset != 0 && s->outbuf == Z_NULL) {
-        s->outbuf = (Byte*)ALLOC(Z_BUFSIZE);
+        s->outbuf = (Byte*)ALLOC(s->size);
         if (s->outbuf == Z_NULL) return -1L;
     }
     if (offset && s->back != EOF) {
@@ -841,8 +1090,8 @@ z_off_t ZEXPORT gzseek (file, offset, whence)
         if (s->last) s->z_err = Z_STREAM_END;
     }
     while (offset > 0)  {
-        int size = Z_BUFSIZE;
-        if (offset < Z_BUFSIZE) size = (int)offset;
+        int size = s->size;
+        if (offset < s->size) size = (int)offset;
 
         size = gzread(file, s->outbuf, (uInt)size);
         if (size <= 0) return -1L;
@@ -867,6 +1116,7 @@ int ZEXPORT gzrewind (file)
     s->stream.avail_in = 0;
     s->stream.next_in = s->inbuf;
     s->crc = crc32(0L, Z_NULL, 0);
+    s->nocrc = 0;
     if (!s->transparent) (void)inflateReset(&s->stream);
     s->in = 0;
     s->out = 0;
@@ -1208,6 +1208,36 @@ uInt dictLength;
     return Z_OK;
 }
 
+int ZEXPORT inflateGetDictionary(strm, dictionary, dictLength)
+z_streamp strm;
+Bytef *dictionary;
+uInt *dictLength;
+{
+    struct inflate_state FAR *state;
+    unsigned copy;
+
+    /* check state */
+    if (strm == Z_NULL || strm->state == Z_NULL) return Z_STREAM_ERROR;
+    state = (struct inflate_state FAR *)strm->state;
+
+    /* copy the whave bytes that end at the window write index, oldest
+       first -- the window is circular, and after inflateSetDictionary()
+       the valid bytes sit at the end of the window with write at zero */
+    if (state->whave && dictionary != Z_NULL) {
+        if (state->write >= state->whave)
+            zmemcpy(dictionary, state->window + state->write - state->whave,
+                    state->whave);
+        else {
+            copy = state->whave - state->write;
+            zmemcpy(dictionary, state->window + state->wsize - copy, copy);
+            zmemcpy(dictionary + copy, state->window, state->write);
+        }
+    }
+    if (dictLength != Z_NULL)
+        *dictLength = state->whave;
+    return Z_OK;
+}
+
 int ZEXPORT inflateGetHeader(strm, head)
 z_streamp strm;
 gz_headerp head;
@@ -0,0 +1,303 @@
+/* iommap.c -- IO base function header for compress/uncompress .zip
+   files using zlib + zip or unzip API
+   This IO API version maps the whole file in memory (read only)
+
+   The read function only copies from the mapping; unzOpenMapped (see
+   unzip.h) also uses mmap_file_data to inflate entries straight from it.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "zlib.h"
+#include "ioapi.h"
+#include "iommap.h"
+
+#if defined(NO_MMAP)
+#  include <stdio.h>
+#elif defined(_WIN32)
+#  include <windows.h>
+#else
+#  include <sys/types.h>
+#  include <sys/stat.h>
+#  include <sys/mman.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+voidpf ZCALLBACK mmap_open_file_func OF((
+   voidpf opaque,
+   const char* filename,
+   int mode));
+
+uLong ZCALLBACK mmap_read_file_func OF((
+   voidpf opaque,
+   voidpf stream,
+   void* buf,
+   uLong size));
+
+uLong ZCALLBACK mmap_write_file_func OF((
+   voidpf opaque,
+   voidpf stream,
+   const void* buf,
+   uLong size));
+
+long ZCALLBACK mmap_tell_file_func OF((
+   voidpf opaque,
+   voidpf stream));
+
+long ZCALLBACK mmap_seek_file_func OF((
+   voidpf opaque,
+   voidpf stream,
+   uLong offset,
+   int origin));
+
+int ZCALLBACK mmap_close_file_func OF((
+   voidpf opaque,
+   voidpf stream));
+
+int ZCALLBACK mmap_error_file_func OF((
+   voidpf opaque,
+   voidpf stream));
+
+typedef struct
+{
+    unsigned char* base;    /* start of the mapping */
+    uLong size;             /* size of the file */
+    uLong pos;              /* current position for read/seek/tell */
+    int error;
+#if !defined(NO_MMAP) && defined(_WIN32)
+    HANDLE hf;
+    HANDLE hmap;
+#endif
+} MMAPFILE_IOMMAP;
+
+voidpf ZCALLBACK mmap_open_file_func (opaque, filename, mode)
+   voidpf opaque;
+   const char* filename;
+   int mode;
+{
+    MMAPFILE_IOMMAP* mf;
+
+    if ((filename==NULL) ||
+        ((mode & ZLIB_FILEFUNC_MODE_READWRITEFILTER)!=ZLIB_FILEFUNC_MODE_READ))
+        return NULL;
+
+    mf = (MMAPFILE_IOMMAP*)malloc(sizeof(MMAPFILE_IOMMAP));
+    if (mf==NULL)
+        return NULL;
+    mf->base = NULL;
+    mf->size = 0;
+    mf->pos = 0;
+    mf->error = 0;
+
+#if defined(NO_MMAP)
+    {
+        FILE* file = fopen(filename, "rb");
+        long size;
+
+        if (file==NULL)
+        {
+            free(mf);
+            return NULL;
+        }
+        if ((fseek(file, 0, SEEK_END)!=0) || ((size = ftell(file)) < 0) ||
+            (fseek(file, 0, SEEK_SET)!=0))
+            size = -1;
+        if (size > 0)
+            mf->base = (unsigned char*)malloc((size_t)size);
+        if ((mf->base==NULL) ||
+            (fread(mf->base, 1, (size_t)size, file)!=(size_t)size))
+        {
+            if (mf->base!=NULL)
+                free(mf->base);
+            fclose(file);
+            free(mf);
+            return NULL;
+        }
+        mf->size = (uLong)size;
+        fclose(file);
+    }
+#elif defined(_WIN32)
+    {
+        DWORD dwSizeHigh = 0;
+        DWORD dwSize;
+
+        mf->hmap = NULL;
+        mf->hf = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+                             OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+        if (mf->hf == INVALID_HANDLE_VALUE)
+        {
+            free(mf);
+            return NULL;
+        }
+        dwSize = GetFileSize(mf->hf, &dwSizeHigh);
+        if ((dwSize != INVALID_FILE_SIZE) && (dwSizeHigh == 0) && (dwSize > 0))
+            mf->hmap = CreateFileMapping(mf->hf, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mf->hmap != NULL)
+            mf->base = (unsigned char*)MapViewOfFile(mf->hmap, FILE_MAP_READ,
+                                                     0, 0, 0);
+        if (mf->base == NULL)
+        {
+            if (mf->hmap != NULL)
+                CloseHandle(mf->hmap);
+            CloseHandle(mf->hf);
+            free(mf);
+            return NULL;
+        }
+        mf->size = (uLong)dwSize;
+    }
+#else
+    {
+        struct stat st;
+        void* base = MAP_FAILED;
+        int fd = open(filename, O_RDONLY);
+
+        if (fd < 0)
+        {
+            free(mf);
+            return NULL;
+        }
+        if ((fstat(fd, &st) == 0) && (st.st_size > 0) &&
+            ((uLong)st.st_size == (size_t)st.st_size))
+            base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (base == MAP_FAILED)
+        {
+            free(mf);
+            return NULL;
+        }
+        mf->base = (unsigned char*)base;
+        mf->size = (uLong)st.st_size;
+    }
+#endif
+    return mf;
+}
+
+
+uLong ZCALLBACK mmap_read_file_func (opaque, stream, buf, size)
+   voidpf opaque;
+   voidpf stream;
+   void* buf;
+   uLong size;
+{
+    MMAPFILE_IOMMAP* mf = (MMAPFILE_IOMMAP*)stream;
+    if (mf==NULL)
+        return 0;
+    if (mf->pos >= mf->size)
+        return 0;
+    if (size > mf->size - mf->pos)
+        size = mf->size - mf->pos;
+    memcpy(buf, mf->base + mf->pos, (size_t)size);
+    mf->pos += size;
+    return size;
+}
+
+
+uLong ZCALLBACK mmap_write_file_func (opaque, stream, buf, size)
+   voidpf opaque;
+   voidpf stream;
+   const void* buf;
+   uLong size;
+{
+    if (stream!=NULL)
+        ((MMAPFILE_IOMMAP*)stream) -> error = 1;
+    return 0;
+}
+
+long ZCALLBACK mmap_tell_file_func (opaque, stream)
+   voidpf opaque;
+   voidpf stream;
+{
+    if (stream==NULL)
+        return -1;
+    return (long)((MMAPFILE_IOMMAP*)stream) -> pos;
+}
+
+long ZCALLBACK mmap_seek_file_func (opaque, stream, offset, origin)
+   voidpf opaque;
+   voidpf stream;
+   uLong offset;
+   int origin;
+{
+    MMAPFILE_IOMMAP* mf = (MMAPFILE_IOMMAP*)stream;
+    uLong pos;
+
+    if (mf==NULL)
+        return -1;
+    switch (origin)
+    {
+    case ZLIB_FILEFUNC_SEEK_CUR :
+        pos = mf->pos + offset;
+        break;
+    case ZLIB_FILEFUNC_SEEK_END :
+        pos = mf->size + offset;
+        break;
+    case ZLIB_FILEFUNC_SEEK_SET :
+        pos = offset;
+        break;
+    default: return -1;
+    }
+    if (pos > mf->size)
+        return -1;
+    mf->pos = pos;
+    return 0;
+}
+
+int ZCALLBACK mmap_close_file_func (opaque, stream)
+   voidpf opaque;
+   voidpf stream;
+{
+    MMAPFILE_IOMMAP* mf = (MMAPFILE_IOMMAP*)stream;
+
+    if (mf==NULL)
+        return -1;
+#if defined(NO_MMAP)
+    free(mf->base);
+#elif defined(_WIN32)
+    UnmapViewOfFile(mf->base);
+    CloseHandle(mf->hmap);
+    CloseHandle(mf->hf);
+#else
+    munmap(mf->base, (size_t)mf->size);
+#endif
+    free(mf);
+    return 0;
+}
+
+int ZCALLBACK mmap_error_file_func (opaque, stream)
+   voidpf opaque;
+   voidpf stream;
+{
+    int ret=-1;
+    if (stream!=NULL)
+    {
+        ret = ((MMAPFILE_IOMMAP*)stream) -> error;
+    }
+    return ret;
+}
+
+const unsigned char* mmap_file_data (stream, psize)
+   voidpf stream;
+   uLong* psize;
+{
+    MMAPFILE_IOMMAP* mf = (MMAPFILE_IOMMAP*)stream;
+    if (mf==NULL)
+        return NULL;
+    if (psize!=NULL)
+        *psize = mf->size;
+    return mf->base;
+}
+
+void fill_mmap_filefunc (pzlib_filefunc_def)
+  zlib_filefunc_def* pzlib_filefunc_def;
+{
+    pzlib_filefunc_def->zopen_file = mmap_open_file_func;
+    pzlib_filefunc_def->zread_file = mmap_read_file_func;
+    pzlib_filefunc_def->zwrite_file = mmap_write_file_func;
+    pzlib_filefunc_def->ztell_file = mmap_tell_file_func;
+    pzlib_filefunc_def->zseek_file = mmap_seek_file_func;
+    pzlib_filefunc_def->zclose_file = mmap_close_file_func;
+    pzlib_filefunc_def->zerror_file = mmap_error_file_func;
+    pzlib_filefunc_def->opaque = NULL;
+}
@@ -0,0 +1,31 @@
+/* iommap.h -- IO base function header for compress/uncompress .zip
+   files using zlib + zip or unzip API
+   This IO API version maps the whole file in memory (read only)
+
+   On Win32 the file is mapped with MapViewOfFile, on other systems with
+   mmap. Compile with -DNO_MMAP to read the file in an allocated buffer
+   instead, on systems without memory mapped files.
+*/
+
+#ifndef _ZLIBIOMMAP_H
+#define _ZLIBIOMMAP_H
+
+#ifndef _ZLIBIOAPI_H
+#include "ioapi.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void fill_mmap_filefunc OF((zlib_filefunc_def* pzlib_filefunc_def));
+
+/* Return the start of the mapping of a stream opened by the functions of
+   fill_mmap_filefunc, and store its size in *psize. */
+const unsigned char* mmap_file_data OF((voidpf stream, uLong* psize));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,625 @@
+/*
+  Parallel extraction and creation of several files for Minizip
+
+  Read mzparallel.h for more info
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "zlib.h"
+#include "unzip.h"
+#include "zip.h"
+#include "mzparallel.h"
+
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#endif
+
+#ifndef local
+#  define local static
+#endif
+
+#ifndef ALLOC
+# define ALLOC(size) (malloc(size))
+#endif
+#ifndef TRYFREE
+# define TRYFREE(p) {if (p) free(p);}
+#endif
+
+#ifndef PARALLEL_BUFSIZE
+#define PARALLEL_BUFSIZE (65536)
+#endif
+
+/* Minimal thread layer: Win32 threads and condition variables (Vista and
+   later, and Windows Phone 8), or pthreads */
+#ifdef _WIN32
+typedef HANDLE mz_thread;
+typedef CRITICAL_SECTION mz_mutex;
+typedef CONDITION_VARIABLE mz_cond;
+typedef DWORD mz_thread_ret;
+#  define MZ_THREAD_CALL        WINAPI
+#  define MZ_THREAD_RETURN      0
+#  define mz_mutex_init(m)      InitializeCriticalSectionEx(m, 2000, 0)
+#  define mz_mutex_lock(m)      EnterCriticalSection(m)
+#  define mz_mutex_unlock(m)    LeaveCriticalSection(m)
+#  define mz_mutex_destroy(m)   DeleteCriticalSection(m)
+#  define mz_cond_init(c)       InitializeConditionVariable(c)
+#  define mz_cond_wait(c,m)     SleepConditionVariableCS(c, m, INFINITE)
+#  define mz_cond_broadcast(c)  WakeAllConditionVariable(c)
+#  define mz_cond_destroy(c)
+#else
+typedef pthread_t mz_thread;
+typedef pthread_mutex_t mz_mutex;
+typedef pthread_cond_t mz_cond;
+typedef void* mz_thread_ret;
+#  define MZ_THREAD_CALL
+#  define MZ_THREAD_RETURN      NULL
+#  define mz_mutex_init(m)      pthread_mutex_init(m, NULL)
+#  define mz_mutex_lock(m)      pthread_mutex_lock(m)
+#  define mz_mutex_unlock(m)    pthread_mutex_unlock(m)
+#  define mz_mutex_destroy(m)   pthread_mutex_destroy(m)
+#  define mz_cond_init(c)       pthread_cond_init(c, NULL)
+#  define mz_cond_wait(c,m)     pthread_cond_wait(c, m)
+#  define mz_cond_broadcast(c)  pthread_cond_broadcast(c)
+#  define mz_cond_destroy(c)    pthread_cond_destroy(c)
+#endif
+
+typedef mz_thread_ret (MZ_THREAD_CALL *mz_thread_func) OF((void* arg));
+
+/*
+  Start nb_threads threads running func(arg), storing them in threads.
+  return the number of threads actually started
+*/
+local int mzparallel_Start(threads, nb_threads, func, arg)
+    mz_thread* threads;
+    int nb_threads;
+    mz_thread_func func;
+    void* arg;
+{
+    int nb_started;
+    for (nb_started=0;nb_started<nb_threads;nb_started++)
+    {
+#ifdef _WIN32
+        threads[nb_started] = CreateThread(NULL, 0, func, arg, 0, NULL);
+        if (threads[nb_started] == NULL)
+            break;
+#else
+        if (pthread_create(&threads[nb_started], NULL, func, arg) != 0)
+            break;
+#endif
+    }
+    return nb_started;
+}
+
+local void mzparallel_Join(threads, nb_threads)
+    mz_thread* threads;
+    int nb_threads;
+{
+    int i;
+    for (i=0;i<nb_threads;i++)
+    {
+#ifdef _WIN32
+        WaitForSingleObjectEx(threads[i], INFINITE, FALSE);
+        CloseHandle(threads[i]);
+#else
+        pthread_join(threads[i], NULL);
+#endif
+    }
+}
+
+
+/***************************************************************************/
+/* Extraction */
+
+typedef struct
+{
+    const char* zipfilename;
+    zlib_filefunc_def* pzlib_filefunc_def;
+    unz_parallel_entry* entries;
+    unz_file_pos* pos;          /* position of each file in the zipfile */
+    uLong number_entry;
+    uLong next;                 /* next file to extract */
+    mz_mutex mutex;             /* protects next */
+} unz_parallel_s;
+
+local unzFile unzparallel_Open(p)
+    unz_parallel_s* p;
+{
+    if (p->pzlib_filefunc_def==NULL)
+        return unzOpenMapped(p->zipfilename);
+    return unzOpen2(p->zipfilename, p->pzlib_filefunc_def);
+}
+
+/*
+  Uncompress the current file of uf in the file destname, using buf
+    (PARALLEL_BUFSIZE bytes) to transfer the data.
+*/
+local int unzparallel_ExtractToFile(uf, destname, buf)
+    unzFile uf;
+    const char* destname;
+    char* buf;
+{
+    int err;
+    FILE* fout;
+
+    err = unzOpenCurrentFile(uf);
+    if (err!=UNZ_OK)
+        return err;
+
+    fout = fopen(destname, "wb");
+    if (fout==NULL)
+        err = UNZ_ERRNO;
+    while (err==UNZ_OK)
+    {
+        int iRead = unzReadCurrentFile(uf, buf, PARALLEL_BUFSIZE);
+        if (iRead<0)
+            err = iRead;
+        else if (iRead==0)
+            break;
+        else if (fwrite(buf, (unsigned)iRead, 1, fout)!=1)
+            err = UNZ_ERRNO;
+    }
+    if ((fout!=NULL) && (fclose(fout)!=0) && (err==UNZ_OK))
+        err = UNZ_ERRNO;
+
+    if (err==UNZ_OK)
+        return unzCloseCurrentFile(uf);
+    unzCloseCurrentFile(uf);
+    return err;
+}
+
+local mz_thread_ret MZ_THREAD_CALL unzparallel_Worker(arg)
+    void* arg;
+{
+    unz_parallel_s* p = (unz_parallel_s*)arg;
+    unzFile uf = NULL;
+    char* buf = NULL;
+
+    for (;;)
+    {
+        unz_parallel_entry* entry;
+        unz_file_info file_info;
+        uLong i;
+
+        mz_mutex_lock(&p->mutex);
+        i = p->next;
+        if (p->next < p->number_entry)
+            p->next++;
+        mz_mutex_unlock(&p->mutex);
+        if (i >= p->number_entry)
+            break;
+
+        entry = p->entries + i;
+        if (entry->err!=UNZ_OK)
+            continue; /* not found in the zipfile */
+
+        /* each worker has its own reader, positioned on its files */
+        if (uf==NULL)
+            uf = unzparallel_Open(p);
+        if ((buf==NULL) && (entry->destname!=NULL))
+            buf = (char*)ALLOC(PARALLEL_BUFSIZE);
+        if ((uf==NULL) || ((buf==NULL) && (entry->destname!=NULL)))
+        {
+            entry->err = (uf==NULL) ? UNZ_ERRNO : UNZ_INTERNALERROR;
+            continue;
+        }
+
+        entry->err = unzGoToFilePos(uf, p->pos + i);
+        if (entry->err==UNZ_OK)
+            entry->err = unzGetCurrentFileInfo(uf, &file_info,
+                                               NULL, 0, NULL, 0, NULL, 0);
+        if (entry->err!=UNZ_OK)
+            continue;
+        entry->uncompressed_size = file_info.uncompressed_size;
+
+        if (entry->destname!=NULL)
+            entry->err = unzparallel_ExtractToFile(uf, entry->destname, buf);
+        else
+            entry->err = unzExtractCurrentFile(uf, entry->buf, entry->size_buf);
+    }
+
+    if (uf!=NULL)
+        unzClose(uf);
+    TRYFREE(buf);
+    return MZ_THREAD_RETURN;
+}
+
+extern int ZEXPORT unzExtractParallel (zipfilename, pzlib_filefunc_def,
+                                       entries, number_entry, nb_threads)
+    const char* zipfilename;
+    zlib_filefunc_def* pzlib_filefunc_def;
+    unz_parallel_entry* entries;
+    uLong number_entry;
+    int nb_threads;
+{
+    unz_parallel_s p;
+    unzFile uf;
+    mz_thread* threads = NULL;
+    int nb_started = 0;
+    int err = UNZ_OK;
+    uLong i;
+
+    if ((zipfilename==NULL) || ((entries==NULL) && (number_entry!=0)) ||
+        (nb_threads<1))
+        return UNZ_PARAMERROR;
+    if (number_entry==0)
+        return UNZ_OK;
+
+    p.zipfilename = zipfilename;
+    p.pzlib_filefunc_def = pzlib_filefunc_def;
+    p.entries = entries;
+    p.number_entry = number_entry;
+    p.next = 0;
+    p.pos = (unz_file_pos*)ALLOC(number_entry*sizeof(unz_file_pos));
+    if (p.pos==NULL)
+        return UNZ_INTERNALERROR;
+
+    /* locate the files once; the workers only jump to their position */
+    uf = unzparallel_Open(&p);
+    if (uf==NULL)
+    {
+        TRYFREE(p.pos);
+        return UNZ_ERRNO;
+    }
+    for (i=0;i<number_entry;i++)
+    {
+        entries[i].uncompressed_size = 0;
+        entries[i].err = unzLocateFile(uf, entries[i].filename, 0);
+        if (entries[i].err==UNZ_OK)
+            entries[i].err = unzGetFilePos(uf, p.pos + i);
+    }
+    unzClose(uf);
+
+    /* the calling thread is one of the workers */
+    if ((uLong)nb_threads > number_entry)
+        nb_threads = (int)number_entry;
+    mz_mutex_init(&p.mutex);
+    if (nb_threads > 1)
+        threads = (mz_thread*)ALLOC((nb_threads-1)*sizeof(mz_thread));
+    if (threads!=NULL)
+        nb_started = mzparallel_Start(threads, nb_threads-1,
+                                      unzparallel_Worker, &p);
+    unzparallel_Worker(&p);
+    mzparallel_Join(threads, nb_started);
+    mz_mutex_destroy(&p.mutex);
+    TRYFREE(threads);
+    TRYFREE(p.pos);
+
+    for (i=0;(i<number_entry) && (err==UNZ_OK);i++)
+        err = entries[i].err;
+    return err;
+}
+
+
+/***************************************************************************/
+/* Creation */
+
+/* compressed data of a file, waiting to be written */
+typedef struct
+{
+    Bytef* out;                 /* compressed data (NULL for a stored buf) */
+    uLong size_out;             /* size of the compressed data */
+    uLong room;                 /* allocated size of out */
+    uLong uncompressed_size;
+    uLong crc;
+    int done;                   /* set when compressed (under mutex) */
+} zip_parallel_data;
+
+typedef struct
+{
+    zip_parallel_entry* entries;
+    zip_parallel_data* data;
+    uLong number_entry;
+    uLong next;                 /* next file to compress */
+    uLong next_write;           /* next file to write */
+    uLong window;               /* files compressed ahead of next_write */
+    mz_mutex mutex;             /* protects next, next_write and done */
+    mz_cond cond;               /* signaled when they change */
+} zip_parallel_s;
+
+/*
+  Make room for at least one more byte in data->out
+*/
+local int zipparallel_Grow(data)
+    zip_parallel_data* data;
+{
+    uLong room = data->room ? data->room * 2 : PARALLEL_BUFSIZE;
+    Bytef* out;
+
+    if (room <= data->room)
+        return ZIP_INTERNALERROR;
+    out = (Bytef*)ALLOC(room);
+    if (out==NULL)
+        return ZIP_INTERNALERROR;
+    if (data->size_out!=0)
+        memcpy(out, data->out, data->size_out);
+    TRYFREE(data->out);
+    data->out = out;
+    data->room = room;
+    return ZIP_OK;
+}
+
+/*
+  Compress (raw deflate) or copy one file in memory, using buf
+    (PARALLEL_BUFSIZE bytes) to read it if it comes from srcname.
+*/
+local int zipparallel_Compress(entry, data, buf)
+    const zip_parallel_entry* entry;
+    zip_parallel_data* data;
+    Bytef* buf;
+{
+    z_stream stream;
+    FILE* fin = NULL;
+    int err = ZIP_OK;
+    int flush = Z_NO_FLUSH;
+
+    data->crc = crc32(0L, Z_NULL, 0);
+    data->uncompressed_size = 0;
+
+    if ((entry->method!=0) && (entry->method!=Z_DEFLATED))
+        return ZIP_PARAMERROR;
+    if (entry->srcname!=NULL)
+    {
+        fin = fopen(entry->srcname, "rb");
+        if (fin==NULL)
+            return ZIP_ERRNO;
+    }
+    else if ((entry->buf==NULL) && (entry->size_buf!=0))
+        return ZIP_PARAMERROR;
+
+    if (entry->method==Z_DEFLATED)
+    {
+        stream.zalloc = (alloc_func)0;
+        stream.zfree = (free_func)0;
+        stream.opaque = (voidpf)0;
+        err = deflateInit2(&stream, entry->level, Z_DEFLATED, -MAX_WBITS,
+                           DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY);
+        if ((err==Z_OK) && (fin==NULL))
+        {
+            /* room for the whole buffer, deflated in one call */
+            data->room = deflateBound(&stream, entry->size_buf);
+            data->out = (Bytef*)ALLOC(data->room ? data->room : 1);
+            if (data->out==NULL)
+            {
+                deflateEnd(&stream);
+                err = ZIP_INTERNALERROR;
+            }
+        }
+        if (err!=Z_OK)
+        {
+            if (fin!=NULL)
+                fclose(fin);
+            return ZIP_INTERNALERROR;
+        }
+    }
+
+    while ((err==ZIP_OK) && (flush!=Z_FINISH))
+    {
+        const Bytef* in;
+        uLong size_in;
+
+        if (fin!=NULL)
+        {
+            size_in = (uLong)fread(buf, 1, PARALLEL_BUFSIZE, fin);
+            if (size_in < PARALLEL_BUFSIZE)
+            {
+                if (ferror(fin))
+                {
+                    err = ZIP_ERRNO;
+                    break;
+                }
+                flush = Z_FINISH;
+            }
+            in = buf;
+        }
+        else
+        {
+            size_in = entry->size_buf;
+            flush = Z_FINISH;
+            in = (const Bytef*)entry->buf;
+        }
+        data->crc = crc32(data->crc, in, (uInt)size_in);
+        data->uncompressed_size += size_in;
+
+        if (entry->method==0)
+        {
+            /* stored: a buf is written as is, a file is copied */
+            if (fin==NULL)
+                break;
+            while ((err==ZIP_OK) && (data->room - data->size_out < size_in))
+                err = zipparallel_Grow(data);
+            if (err==ZIP_OK)
+            {
+                memcpy(data->out + data->size_out, in, size_in);
+                data->size_out += size_in;
+            }
+            continue;
+        }
+
+        stream.next_in = (Bytef*)in;
+        stream.avail_in = (uInt)size_in;
+        do
+        {
+            if ((data->size_out == data->room) &&
+                ((err = zipparallel_Grow(data)) != ZIP_OK))
+                break;
+            stream.next_out = data->out + data->size_out;
+            stream.avail_out = (uInt)(data->room - data->size_out);
+            err = deflate(&stream, flush);
+            data->size_out = data->room - stream.avail_out;
+        } while ((err==Z_OK) &&
+                 ((stream.avail_in!=0) || (flush==Z_FINISH)));
+        if (err==Z_STREAM_END)
+            err = ZIP_OK;
+        else if (err!=Z_OK)
+            err = ZIP_INTERNALERROR; /* deflate or zipparallel_Grow failed */
+    }
+
+    if (entry->method==Z_DEFLATED)
+        deflateEnd(&stream);
+    if (fin!=NULL)
+        fclose(fin);
+    return err;
+}
+
+/*
+  Write one compressed file in the zipfile, with the raw API of zip.c
+*/
+local int zipparallel_Write(file, entry, data)
+    zipFile file;
+    const zip_parallel_entry* entry;
+    const zip_parallel_data* data;
+{
+    const Bytef* out = data->out;
+    uLong size_out = data->size_out;
+    int err;
+
+    if (out==NULL)
+    {
+        /* stored buf */
+        out = (const Bytef*)entry->buf;
+        size_out = entry->size_buf;
+    }
+
+    err = zipOpenNewFileInZip2(file, entry->filename, &entry->zipfi,
+                               NULL, 0, NULL, 0, NULL,
+                               entry->method, entry->level, 1);
+    while ((err==ZIP_OK) && (size_out > 0))
+    {
+        unsigned len = 0x40000000;
+        if (size_out < len)
+            len = (unsigned)size_out;
+        err = zipWriteInFileInZip(file, out, len);
+        out += len;
+        size_out -= len;
+    }
+    if (err==ZIP_OK)
+        err = zipCloseFileInZipRaw(file, data->uncompressed_size, data->crc);
+    return err;
+}
+
+local mz_thread_ret MZ_THREAD_CALL zipparallel_Worker(arg)
+    void* arg;
+{
+    zip_parallel_s* p = (zip_parallel_s*)arg;
+    Bytef* buf = (Bytef*)ALLOC(PARALLEL_BUFSIZE);
+
+    for (;;)
+    {
+        uLong i;
+        int err;
+
+        mz_mutex_lock(&p->mutex);
+        while ((p->next < p->number_entry) &&
+               (p->next >= p->next_write + p->window))
+            mz_cond_wait(&p->cond, &p->mutex);
+        i = p->next;
+        if (p->next < p->number_entry)
+            p->next++;
+        mz_mutex_unlock(&p->mutex);
+        if (i >= p->number_entry)
+            break;
+
+        if ((buf==NULL) && (p->entries[i].srcname!=NULL))
+            err = ZIP_INTERNALERROR;
+        else
+            err = zipparallel_Compress(p->entries + i, p->data + i, buf);
+
+        mz_mutex_lock(&p->mutex);
+        p->entries[i].err = err;
+        p->data[i].done = 1;
+        mz_cond_broadcast(&p->cond);
+        mz_mutex_unlock(&p->mutex);
+    }
+
+    TRYFREE(buf);
+    return MZ_THREAD_RETURN;
+}
+
+extern int ZEXPORT zipAddParallel (file, entries, number_entry, nb_threads)
+    zipFile file;
+    zip_parallel_entry* entries;
+    uLong number_entry;
+    int nb_threads;
+{
+    zip_parallel_s p;
+    mz_thread* threads;
+    Bytef* buf = NULL;
+    int nb_started = 0;
+    int err = ZIP_OK;
+    uLong i;
+
+    if ((file==NULL) || ((entries==NULL) && (number_entry!=0)) ||
+        (nb_threads<1))
+        return ZIP_PARAMERROR;
+    if (number_entry==0)
+        return ZIP_OK;
+
+    p.entries = entries;
+    p.number_entry = number_entry;
+    p.next = 0;
+    p.next_write = 0;
+    p.window = 2*(uLong)nb_threads;
+    p.data = (zip_parallel_data*)ALLOC(number_entry*sizeof(zip_parallel_data));
+    threads = (mz_thread*)ALLOC(nb_threads*sizeof(mz_thread));
+    if ((p.data==NULL) || (threads==NULL))
+    {
+        TRYFREE(p.data);
+        TRYFREE(threads);
+        return ZIP_INTERNALERROR;
+    }
+    memset(p.data, 0, number_entry*sizeof(zip_parallel_data));
+
+    /* the workers compress, the calling thread writes in order */
+    mz_mutex_init(&p.mutex);
+    mz_cond_init(&p.cond);
+    if ((uLong)nb_threads > number_entry)
+        nb_threads = (int)number_entry;
+    nb_started = mzparallel_Start(threads, nb_threads,
+                                  zipparallel_Worker, &p);
+
+    for (i=0;i<number_entry;i++)
+    {
+        mz_mutex_lock(&p.mutex);
+        if ((nb_started==0) && (p.next==i))
+        {
+            /* no thread could be started: compress here */
+            p.next++;
+            mz_mutex_unlock(&p.mutex);
+            if ((buf==NULL) && (entries[i].srcname!=NULL))
+                buf = (Bytef*)ALLOC(PARALLEL_BUFSIZE);
+            if ((buf==NULL) && (entries[i].srcname!=NULL))
+                entries[i].err = ZIP_INTERNALERROR;
+            else
+                entries[i].err = zipparallel_Compress(entries + i, p.data + i, buf);
+            mz_mutex_lock(&p.mutex);
+            p.data[i].done = 1;
+        }
+        while (!p.data[i].done)
+            mz_cond_wait(&p.cond, &p.mutex);
+        mz_mutex_unlock(&p.mutex);
+
+        if (entries[i].err==ZIP_OK)
+            entries[i].err = zipparallel_Write(file, entries + i, p.data + i);
+        if ((err==ZIP_OK) && (entries[i].err!=ZIP_OK))
+            err = entries[i].err;
+        TRYFREE(p.data[i].out);
+        p.data[i].out = NULL;
+
+        mz_mutex_lock(&p.mutex);
+        p.next_write = i+1;
+        mz_cond_broadcast(&p.cond);
+        mz_mutex_unlock(&p.mutex);
+    }
+
+    mzparallel_Join(threads, nb_started);
+    mz_cond_destroy(&p.cond);
+    mz_mutex_destroy(&p.mutex);
+    TRYFREE(threads);
+    TRYFREE(p.data);
+    TRYFREE(buf);
+    return err;
+}
@@ -0,0 +1,84 @@
+/*
+  Parallel extraction and creation of several files for Minizip
+
+  The files are uncompressed or compressed by a pool of worker threads
+  (Win32 threads, or pthreads on other systems). For extraction, each
+  worker opens its own unzFile and jumps to its files with unzGoToFilePos.
+  For creation, the workers deflate the files in memory, and the calling
+  thread writes them in order with the raw API of zip.c, so that the
+  local headers and the central directory are the same as with
+  zipOpenNewFileInZip/zipWriteInFileInZip/zipCloseFileInZip.
+*/
+
+#ifndef _zip_parallel_H
+#define _zip_parallel_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef _ZLIB_H
+#include "zlib.h"
+#endif
+
+#include "unzip.h"
+#include "zip.h"
+
+/* one file to extract with unzExtractParallel */
+typedef struct unz_parallel_entry_s
+{
+    const char* filename;   /* name of the file in the zipfile */
+    const char* destname;   /* file to create (its directory must exist),
+                               or NULL to uncompress in buf */
+    voidp buf;              /* destination if destname is NULL */
+    uLong size_buf;         /* size of buf */
+
+    uLong uncompressed_size;/* out: uncompressed size of the file */
+    int err;                /* out: UNZ_OK, or the error for this file */
+} unz_parallel_entry;
+
+/* one file to add with zipAddParallel */
+typedef struct zip_parallel_entry_s
+{
+    const char* filename;   /* name of the file in the zipfile */
+    zip_fileinfo zipfi;     /* date and attributes */
+    const char* srcname;    /* file to read, or NULL to compress buf */
+    const void* buf;        /* source if srcname is NULL */
+    uLong size_buf;         /* size of buf */
+    int method;             /* 0 for store, Z_DEFLATED for deflate */
+    int level;              /* level of compression */
+
+    int err;                /* out: ZIP_OK, or the error for this file */
+} zip_parallel_entry;
+
+/*
+  Extract number_entry files of the zipfile zipfilename on nb_threads
+    threads. If pzlib_filefunc_def is NULL, the zipfile is opened with
+    unzOpenMapped, else with unzOpen2 (each worker opens it once).
+  return UNZ_OK if all the files were extracted, or the first error
+    (the error of each file is in entries[i].err)
+*/
+extern int ZEXPORT unzExtractParallel OF((const char* zipfilename,
+                                          zlib_filefunc_def* pzlib_filefunc_def,
+                                          unz_parallel_entry* entries,
+                                          uLong number_entry,
+                                          int nb_threads));
+
+/*
+  Add number_entry files to the opened zipfile file, compressing them on
+    nb_threads threads. The files are written in the order of entries.
+    At most 2*nb_threads compressed files are kept in memory while they
+    wait for their turn.
+  return ZIP_OK if all the files were added, or the first error
+    (the error of each file is in entries[i].err)
+*/
+extern int ZEXPORT zipAddParallel OF((zipFile file,
+                                      zip_parallel_entry* entries,
+                                      uLong number_entry,
+                                      int nb_threads));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
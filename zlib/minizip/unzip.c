@@ -40,6 +40,7 @@ woven in by Terry Thorsen 1/2003.
 #include <string.h>
 #include "zlib.h"
 #include "unzip.h"
+#include "iommap.h"
 
 #ifdef STDC
 #  include <stddef.h>
@@ -123,6 +124,17 @@ typedef struct
 } file_in_zip_read_info_s;
 
 
+/* unz_index_entry_s is one file of the name index of a mapped zipfile */
+typedef struct unz_index_entry_s
+{
+    const char* name;           /* file name in the mapped central dir */
+    uLong size_filename;        /* length of name (not zero terminated) */
+    uLong hash;                 /* hash of name, see unzlocal_HashName */
+    uLong num_file;             /* number of the file in the zipfile */
+    uLong pos_in_central_dir;   /* pos of the file in the central dir */
+} unz_index_entry;
+
+
 /* unz_s contain internal information about the zipfile
 */
 typedef struct
@@ -149,6 +161,15 @@ typedef struct
     unsigned long keys[3];     /* keys defining the pseudo-random sequence */
     const unsigned long* pcrc_32_tab;
 #    endif
+
+    const unsigned char* map_base; /* whole zipfile, if opened by
+                                      unzOpenMapped, else NULL */
+    uLong map_size;             /* size of the mapping */
+    unz_index_entry* index;     /* the files of a mapped zipfile */
+    uLong index_count;          /* number of entries in index */
+    long* index_slots;          /* hash table of positions in index, -1 for
+                                   an empty slot */
+    uLong index_mask;           /* number of slots - 1 (a power of 2 - 1) */
 } unz_s;
 
 
@@ -488,6 +509,12 @@ extern unzFile ZEXPORT unzOpen2 (path, pzlib_filefunc_def)
     us.central_pos = central_pos;
     us.pfile_in_zip_read = NULL;
     us.encrypted = 0;
+    us.map_base = NULL;
+    us.map_size = 0;
+    us.index = NULL;
+    us.index_count = 0;
+    us.index_slots = NULL;
+    us.index_mask = 0;
 
 
     s=(unz_s*)ALLOC(sizeof(unz_s));
@@ -520,11 +547,162 @@ extern int ZEXPORT unzClose (file)
         unzCloseCurrentFile(file);
 
     ZCLOSE(s->z_filefunc, s->filestream);
+    TRYFREE(s->index);
+    TRYFREE(s->index_slots);
     TRYFREE(s);
     return UNZ_OK;
 }
 
 
+/*
+  Hash of a file name for the index of a mapped zipfile. The name is case
+    folded the same way as strcmpcasenosensitive_internal, so that both case
+    sensitive and case insensitive lookups find it in the same slot chain.
+*/
+local uLong unzlocal_HashName (name, size_name)
+    const char* name;
+    uLong size_name;
+{
+    uLong h = 2166136261UL;  /* FNV-1a */
+    uLong i;
+    for (i=0;i<size_name;i++)
+    {
+        char c = name[i];
+        if ((c>='a') && (c<='z'))
+            c -= 0x20;
+        h = ((h ^ (unsigned char)c) * 16777619UL) & 0xffffffffUL;
+    }
+    return h;
+}
+
+/*
+  Compare the not zero terminated name of an index entry with szFileName
+  return 1 if they are equal, with the iCaseSensitivity of
+    unzStringFileNameCompare
+*/
+local int unzlocal_IndexNameEqual (entry, szFileName, iCaseSensitivity)
+    const unz_index_entry* entry;
+    const char* szFileName;
+    int iCaseSensitivity;
+{
+    uLong i;
+
+    if (iCaseSensitivity==0)
+        iCaseSensitivity=CASESENSITIVITYDEFAULTVALUE;
+
+    for (i=0;i<entry->size_filename;i++)
+    {
+        char c1=entry->name[i];
+        char c2=szFileName[i];
+        if (c2=='\0')
+            return 0;
+        if (iCaseSensitivity!=1)
+        {
+            if ((c1>='a') && (c1<='z'))
+                c1 -= 0x20;
+            if ((c2>='a') && (c2<='z'))
+                c2 -= 0x20;
+        }
+        if (c1!=c2)
+            return 0;
+    }
+    return szFileName[i]=='\0';
+}
+
+/*
+  Build the name index of a zipfile opened by unzOpenMapped, walking the
+    central directory once in the mapping.
+*/
+local int unzlocal_BuildIndex (s)
+    unz_s* s;
+{
+    const unsigned char* cd;
+    const unsigned char* p;
+    const unsigned char* end;
+    uLong count, nb_slots, i;
+
+    if ((s->byte_before_the_zipfile+s->offset_central_dir > s->map_size) ||
+        (s->size_central_dir > s->map_size -
+                               (s->byte_before_the_zipfile+s->offset_central_dir)))
+        return UNZ_BADZIPFILE;
+    cd = s->map_base + s->byte_before_the_zipfile + s->offset_central_dir;
+    end = cd + s->size_central_dir;
+
+    /* count the entries: number_entry is only 16 bits wide */
+    count = 0;
+    for (p = cd; p + SIZECENTRALDIRITEM <= end; count++)
+    {
+        if ((p[0]!=0x50) || (p[1]!=0x4b) || (p[2]!=0x01) || (p[3]!=0x02))
+            break;
+        p += SIZECENTRALDIRITEM + (p[28] | (p[29]<<8)) +
+             (p[30] | (p[31]<<8)) + (p[32] | (p[33]<<8));
+    }
+    if (p > end)
+        return UNZ_BADZIPFILE;
+
+    for (nb_slots = 16; nb_slots < count*2; nb_slots <<= 1)
+        ;
+    s->index = (unz_index_entry*)ALLOC((count ? count : 1)*sizeof(unz_index_entry));
+    s->index_slots = (long*)ALLOC(nb_slots*sizeof(long));
+    if ((s->index==NULL) || (s->index_slots==NULL))
+        return UNZ_INTERNALERROR;
+    s->index_count = count;
+    s->index_mask = nb_slots-1;
+    for (i=0;i<nb_slots;i++)
+        s->index_slots[i] = -1;
+
+    for (p = cd, i = 0; i < count; i++)
+    {
+        unz_index_entry* entry = s->index + i;
+        uLong slot;
+
+        entry->name = (const char*)p + SIZECENTRALDIRITEM;
+        entry->size_filename = p[28] | (p[29]<<8);
+        entry->hash = unzlocal_HashName(entry->name, entry->size_filename);
+        entry->num_file = i;
+        entry->pos_in_central_dir = s->offset_central_dir + (uLong)(p - cd);
+
+        /* linear probing; entries keep central directory order along a
+           chain, so the first of duplicated names is found first */
+        for (slot = entry->hash & s->index_mask;
+             s->index_slots[slot] != -1;
+             slot = (slot+1) & s->index_mask)
+            ;
+        s->index_slots[slot] = (long)i;
+
+        p += SIZECENTRALDIRITEM + entry->size_filename +
+             (p[30] | (p[31]<<8)) + (p[32] | (p[33]<<8));
+    }
+    return UNZ_OK;
+}
+
+/*
+  Open a Zip file as unzOpen, but map it in memory and index the names of
+    its files. unzLocateFile is then a hash lookup, unzReadCurrentFile
+    inflates straight from the mapping, and unzGetCurrentFileView and
+    unzExtractCurrentFile can be used.
+*/
+extern unzFile ZEXPORT unzOpenMapped (path)
+    const char *path;
+{
+    zlib_filefunc_def mmap_filefunc;
+    unz_s* s;
+
+    fill_mmap_filefunc(&mmap_filefunc);
+    s = (unz_s*)unzOpen2(path, &mmap_filefunc);
+    if (s==NULL)
+        return NULL;
+
+    s->map_base = mmap_file_data(s->filestream, &s->map_size);
+    if ((s->map_base==NULL) || (unzlocal_BuildIndex(s)!=UNZ_OK))
+    {
+        unzClose((unzFile)s);
+        return NULL;
+    }
+    return (unzFile)s;
+}
+
+
 /*
   Write info about the ZipFile in the *pglobal_info structure.
   No preparation of the structure is needed
@@ -848,6 +1026,32 @@ extern int ZEXPORT unzLocateFile (file, szFileName, iCaseSensitivity)
     if (!s->current_file_ok)
         return UNZ_END_OF_LIST_OF_FILE;
 
+    if (s->index_slots!=NULL)
+    {
+        /* mapped zipfile: hash lookup in the index */
+        uLong hash = unzlocal_HashName(szFileName, (uLong)strlen(szFileName));
+        uLong slot;
+
+        for (slot = hash & s->index_mask;
+             s->index_slots[slot] != -1;
+             slot = (slot+1) & s->index_mask)
+        {
+            const unz_index_entry* entry = s->index + s->index_slots[slot];
+            if ((entry->hash==hash) &&
+                unzlocal_IndexNameEqual(entry, szFileName, iCaseSensitivity))
+            {
+                s->num_file = entry->num_file;
+                s->pos_in_central_dir = entry->pos_in_central_dir;
+                err = unzlocal_GetCurrentFileInfoInternal(file,&s->cur_file_info,
+                                                           &s->cur_file_info_internal,
+                                                           NULL,0,NULL,0,NULL,0);
+                s->current_file_ok = (err == UNZ_OK);
+                return err;
+            }
+        }
+        return UNZ_END_OF_LIST_OF_FILE;
+    }
+
     /* Save the current state */
     num_fileSaved = s->num_file;
     pos_in_central_dirSaved = s->pos_in_central_dir;
@@ -1162,6 +1366,7 @@ extern int ZEXPORT unzOpenCurrentFile3 (file, method, level, raw, password)
     pfile_in_zip_read_info->stream.avail_in = (uInt)0;
 
     s->pfile_in_zip_read = pfile_in_zip_read_info;
+    s->encrypted=0;
 
 #    ifndef NOUNCRYPT
     if (password != NULL)
@@ -1270,38 +1475,59 @@ extern int ZEXPORT unzReadCurrentFile  (file, buf, len)
                 uReadThis = (uInt)pfile_in_zip_read_info->rest_read_compressed;
             if (uReadThis == 0)
                 return UNZ_EOF;
-            if (ZSEEK(pfile_in_zip_read_info->z_filefunc,
-                      pfile_in_zip_read_info->filestream,
-                      pfile_in_zip_read_info->pos_in_zipfile +
-                         pfile_in_zip_read_info->byte_before_the_zipfile,
-                         ZLIB_FILEFUNC_SEEK_SET)!=0)
-                return UNZ_ERRNO;
-            if (ZREAD(pfile_in_zip_read_info->z_filefunc,
-                      pfile_in_zip_read_info->filestream,
-                      pfile_in_zip_read_info->read_buffer,
-                      uReadThis)!=uReadThis)
-                return UNZ_ERRNO;
+            if ((s->map_base!=NULL) && (!s->encrypted))
+            {
+                /* mapped zipfile: inflate straight from the mapping */
+                uLong pos = pfile_in_zip_read_info->pos_in_zipfile +
+                            pfile_in_zip_read_info->byte_before_the_zipfile;
+
+                uReadThis = (uInt)-1;
+                if (pfile_in_zip_read_info->rest_read_compressed<uReadThis)
+                    uReadThis = (uInt)pfile_in_zip_read_info->rest_read_compressed;
+                if ((pos > s->map_size) || (uReadThis > s->map_size - pos))
+                    return UNZ_ERRNO;
+
+                pfile_in_zip_read_info->pos_in_zipfile += uReadThis;
+                pfile_in_zip_read_info->rest_read_compressed-=uReadThis;
+                pfile_in_zip_read_info->stream.next_in =
+                    (Bytef*)(s->map_base + pos);
+                pfile_in_zip_read_info->stream.avail_in = (uInt)uReadThis;
+            }
+            else
+            {
+                if (ZSEEK(pfile_in_zip_read_info->z_filefunc,
+                          pfile_in_zip_read_info->filestream,
+                          pfile_in_zip_read_info->pos_in_zipfile +
+                             pfile_in_zip_read_info->byte_before_the_zipfile,
+                             ZLIB_FILEFUNC_SEEK_SET)!=0)
+                    return UNZ_ERRNO;
+                if (ZREAD(pfile_in_zip_read_info->z_filefunc,
+                          pfile_in_zip_read_info->filestream,
+                          pfile_in_zip_read_info->read_buffer,
+                          uReadThis)!=uReadThis)
+                    return UNZ_ERRNO;
 
 
 #            ifndef NOUNCRYPT
-            if(s->encrypted)
-            {
-                uInt i;
-                for(i=0;i<uReadThis;i++)
-                  pfile_in_zip_read_info->read_buffer[i] =
-                      zdecode(s->keys,s->pcrc_32_tab,
-                              pfile_in_zip_read_info->read_buffer[i]);
-            }
+                if(s->encrypted)
+                {
+                    uInt i;
+                    for(i=0;i<uReadThis;i++)
+                      pfile_in_zip_read_info->read_buffer[i] =
+                          zdecode(s->keys,s->pcrc_32_tab,
+                                  pfile_in_zip_read_info->read_buffer[i]);
+                }
 #            endif
 
 
-            pfile_in_zip_read_info->pos_in_zipfile += uReadThis;
+                pfile_in_zip_read_info->pos_in_zipfile += uReadThis;
 
-            pfile_in_zip_read_info->rest_read_compressed-=uReadThis;
+                pfile_in_zip_read_info->rest_read_compressed-=uReadThis;
 
-            pfile_in_zip_read_info->stream.next_in =
-                (Bytef*)pfile_in_zip_read_info->read_buffer;
-            pfile_in_zip_read_info->stream.avail_in = (uInt)uReadThis;
+                pfile_in_zip_read_info->stream.next_in =
+                    (Bytef*)pfile_in_zip_read_info->read_buffer;
+                pfile_in_zip_read_info->stream.avail_in = (uInt)uReadThis;
+            }
         }
 
         if ((pfile_in_zip_read_info->compression_method==0) || (pfile_in_zip_read_info->raw))
@@ -1524,6 +1750,184 @@ extern int ZEXPORT unzCloseCurrentFile (file)
 }
 
 
+/*
+  Locate the data of the current file in the mapping of a zipfile opened by
+    unzOpenMapped, after checking its local header.
+  return NULL if the local header is bad or the data is out of the mapping
+*/
+local const Bytef* unzlocal_MappedFileData (s)
+    unz_s* s;
+{
+    uInt iSizeVar;
+    uLong offset_local_extrafield;
+    uInt  size_local_extrafield;
+    uLong pos;
+
+    if (unzlocal_CheckCurrentFileCoherencyHeader(s,&iSizeVar,
+                &offset_local_extrafield,&size_local_extrafield)!=UNZ_OK)
+        return NULL;
+
+    pos = s->byte_before_the_zipfile +
+          s->cur_file_info_internal.offset_curfile + SIZEZIPLOCALHEADER +
+          iSizeVar;
+    if ((pos > s->map_size) ||
+        (s->cur_file_info.compressed_size > s->map_size - pos))
+        return NULL;
+    return s->map_base + pos;
+}
+
+/*
+  Give a pointer to the data of the current file, without copy, if it is
+    stored (not compressed) and not encrypted in a zipfile opened by
+    unzOpenMapped. The data is valid until unzClose, and is not checked
+    against the crc.
+  return UNZ_OK if *pdata was set, UNZ_PARAMERROR if no view is possible
+*/
+extern int ZEXPORT unzGetCurrentFileView (file, pdata)
+    unzFile file;
+    const void** pdata;
+{
+    unz_s* s;
+    const Bytef* data;
+
+    if ((file==NULL) || (pdata==NULL))
+        return UNZ_PARAMERROR;
+    s=(unz_s*)file;
+    if ((!s->current_file_ok) || (s->map_base==NULL) ||
+        (s->cur_file_info.compression_method!=0) ||
+        ((s->cur_file_info.flag & 1)!=0) ||
+        (s->cur_file_info.compressed_size!=s->cur_file_info.uncompressed_size))
+        return UNZ_PARAMERROR;
+
+    data = unzlocal_MappedFileData(s);
+    if (data==NULL)
+        return UNZ_BADZIPFILE;
+    *pdata = data;
+    return UNZ_OK;
+}
+
+/*
+  Translate a zlib error code, as returned by inflate or passed on by
+    unzOpenCurrentFile and unzReadCurrentFile, to the UNZ_ code returned by
+    unzExtractCurrentFile; UNZ_ codes are returned unchanged
+*/
+local int unzlocal_InflateError (err)
+    int err;
+{
+    switch (err)
+    {
+    case Z_ERRNO:
+        return UNZ_ERRNO;
+    case Z_MEM_ERROR:
+    case Z_STREAM_ERROR:
+        return UNZ_INTERNALERROR;
+    case Z_NEED_DICT:
+    case Z_DATA_ERROR:
+    case Z_BUF_ERROR:
+    case Z_STREAM_END:
+        return UNZ_BADZIPFILE;
+    }
+    return err;
+}
+
+/*
+  Uncompress the whole current file in buf, which must be able to hold its
+    uncompressed_size. For a zipfile opened by unzOpenMapped, a deflated
+    file is inflated with one call from the mapping; otherwise the file is
+    read with unzOpenCurrentFile/unzReadCurrentFile.
+  return UNZ_OK if the file was uncompressed and its crc is good
+*/
+extern int ZEXPORT unzExtractCurrentFile (file, buf, len)
+    unzFile file;
+    voidp buf;
+    uLong len;
+{
+    int err=UNZ_OK;
+    unz_s* s;
+    const Bytef* data;
+    uLong size;
+
+    if (file==NULL)
+        return UNZ_PARAMERROR;
+    s=(unz_s*)file;
+    if (!s->current_file_ok)
+        return UNZ_PARAMERROR;
+    size = s->cur_file_info.uncompressed_size;
+    if ((size > len) || ((buf==NULL) && (size!=0)) ||
+        ((s->cur_file_info.flag & 1)!=0))
+        return UNZ_PARAMERROR;
+
+    if (s->pfile_in_zip_read != NULL)
+        unzCloseCurrentFile(file);
+
+    if (s->map_base==NULL)
+    {
+        uLong done = 0;
+
+        err = unzOpenCurrentFile(file);
+        while ((err==UNZ_OK) && (done < size))
+        {
+            uInt uReadThis = (uInt)-1;
+            int iRead;
+            if (size - done < uReadThis)
+                uReadThis = (uInt)(size - done);
+            if (uReadThis > 0x7fffffff)
+                uReadThis = 0x7fffffff;
+            iRead = unzReadCurrentFile(file, (char*)buf + done, uReadThis);
+            if (iRead < 0)
+                err = iRead;
+            else if (iRead == 0)
+                err = UNZ_BADZIPFILE;
+            else
+                done += (uLong)iRead;
+        }
+        if (err==UNZ_OK)
+            return unzCloseCurrentFile(file);
+        if (s->pfile_in_zip_read != NULL)
+            unzCloseCurrentFile(file);
+        return unzlocal_InflateError(err);
+    }
+
+    data = unzlocal_MappedFileData(s);
+    if (data==NULL)
+        return UNZ_BADZIPFILE;
+
+    if (s->cur_file_info.compression_method==0)
+    {
+        if (s->cur_file_info.compressed_size!=size)
+            return UNZ_BADZIPFILE;
+        if (size!=0)
+            memcpy(buf, data, (size_t)size);
+    }
+    else if (s->cur_file_info.compression_method==Z_DEFLATED)
+    {
+        z_stream stream;
+
+        stream.zalloc = (alloc_func)0;
+        stream.zfree = (free_func)0;
+        stream.opaque = (voidpf)0;
+        stream.next_in = (Bytef*)data;
+        stream.avail_in = (uInt)s->cur_file_info.compressed_size;
+        err = inflateInit2(&stream, -MAX_WBITS);
+        if (err!=Z_OK)
+            return unzlocal_InflateError(err);
+        stream.next_out = (Bytef*)buf;
+        stream.avail_out = (uInt)size;
+        err = inflate(&stream, Z_FINISH);
+        inflateEnd(&stream);
+        if ((err!=Z_STREAM_END) || (stream.total_out!=size))
+            return (err==Z_MEM_ERROR) ? UNZ_INTERNALERROR : UNZ_BADZIPFILE;
+    }
+    else
+        return UNZ_BADZIPFILE;
+
+    if (crc32(crc32(0L, Z_NULL, 0), (const Bytef*)buf, (uInt)size) !=
+        s->cur_file_info.crc)
+        return UNZ_CRCERROR;
+    return UNZ_OK;
+}
+
+
 /*
   Get the global comment string of the ZipFile, in the szComment buffer.
   uSizeBuf is the size of the szComment buffer.
@@ -337,6 +337,47 @@ extern int ZEXPORT unzGetLocalExtrafield OF((unzFile file,
     the error code
 */
 
+/***************************************************************************/
+/* Mapped zipfiles (see iommap.h) */
+
+extern unzFile ZEXPORT unzOpenMapped OF((const char *path));
+/*
+  Open a Zip file like unzOpen, but map the whole file in memory (read only)
+    and build a hash index of the names of its files once.
+  With such a handle, unzLocateFile costs a hash lookup instead of a walk of
+    the central directory, unzReadCurrentFile inflates straight from the
+    mapping without an intermediate read buffer, and stored files can be
+    accessed without copy with unzGetCurrentFileView.
+  Case insensitive lookups only fold the ASCII letters, as the default
+    STRCMPCASENOSENTIVEFUNCTION.
+  The handle is closed with unzClose.
+*/
+
+extern int ZEXPORT unzGetCurrentFileView OF((unzFile file,
+                                             const void** pdata));
+/*
+  Set *pdata to the data of the current file inside the mapping, if the
+    zipfile was opened by unzOpenMapped and the current file is stored (not
+    compressed) and not encrypted. The data is uncompressed_size bytes long,
+    stays valid until unzClose, and its crc is not checked.
+  return UNZ_OK if *pdata was set, UNZ_PARAMERROR if the current file cannot
+    be viewed without copy (use unzExtractCurrentFile instead)
+*/
+
+extern int ZEXPORT unzExtractCurrentFile OF((unzFile file,
+                                             voidp buf,
+                                             uLong len));
+/*
+  Uncompress the whole current file (not encrypted) in buf. len is the size
+    of buf, which must be at least the uncompressed_size of the file.
+  For a zipfile opened by unzOpenMapped, the file is inflated in a single
+    call from the mapping to buf; for other zipfiles, it is read with
+    unzOpenCurrentFile and unzReadCurrentFile.
+  return UNZ_OK if the file was uncompressed and its crc is good,
+    UNZ_CRCERROR if the crc is bad, UNZ_BADZIPFILE if the data is corrupt,
+    or another UNZ_ error code <0
+*/
+
 /***************************************************************************/
 
 /* Get the current file offset */
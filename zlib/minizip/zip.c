@@ -981,7 +981,9 @@ extern int ZEXPORT zipWriteInFileInZip (file, buf, len)
 
     zi->ci.stream.next_in = (void*)buf;
     zi->ci.stream.avail_in = len;
-    zi->ci.crc32 = crc32(zi->ci.crc32,buf,len);
+    /* in raw mode the crc is given to zipCloseFileInZipRaw */
+    if (!zi->ci.raw)
+        zi->ci.crc32 = crc32(zi->ci.crc32,buf,len);
 
     while ((err==ZIP_OK) && (zi->ci.stream.avail_in>0))
     {
@@ -1006,14 +1008,12 @@ extern int ZEXPORT zipWriteInFileInZip (file, buf, len)
         }
         else
         {
-            uInt copy_this,i;
+            uInt copy_this;
             if (zi->ci.stream.avail_in < zi->ci.stream.avail_out)
                 copy_this = zi->ci.stream.avail_in;
             else
                 copy_this = zi->ci.stream.avail_out;
-            for (i=0;i<copy_this;i++)
-                *(((char*)zi->ci.stream.next_out)+i) =
-                    *(((const char*)zi->ci.stream.next_in)+i);
+            zmemcpy(zi->ci.stream.next_out, zi->ci.stream.next_in, copy_this);
             {
                 zi->ci.stream.avail_in -= copy_this;
                 zi->ci.stream.avail_out-= copy_this;
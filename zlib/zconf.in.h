@@ -28,6 +28,7 @@
 #  define deflatePrime          z_deflatePrime
 #  define inflateInit2_         z_inflateInit2_
 #  define inflateSetDictionary  z_inflateSetDictionary
+#  define inflateGetDictionary  z_inflateGetDictionary
 #  define inflateSync           z_inflateSync
 #  define inflateSyncPoint      z_inflateSyncPoint
 #  define inflateCopy           z_inflateCopy
@@ -755,6 +755,23 @@ ZEXTERN int ZEXPORT inflateSetDictionary OF((z_streamp strm,
    inflate().
 */
 
+ZEXTERN int ZEXPORT inflateGetDictionary OF((z_streamp strm,
+                                             Bytef *dictionary,
+                                             uInt  *dictLength));
+/*
+     Returns the sliding dictionary being maintained by inflate.  dictLength is
+   set to the number of bytes in the dictionary, and that many bytes are copied
+   to dictionary.  dictionary must have enough space, where 32768 bytes is
+   always enough.  If inflateGetDictionary() is called with dictionary equal to
+   Z_NULL, then only the dictionary length is returned, and nothing is copied.
+   Together with inflatePrime() and inflateSetDictionary() this allows a raw
+   inflate to be suspended at a block boundary and resumed later from a saved
+   file position (see gzindex below).
+
+     inflateGetDictionary returns Z_OK on success, or Z_STREAM_ERROR if the
+   stream state is inconsistent.
+*/
+
 ZEXTERN int ZEXPORT inflateSync OF((z_streamp strm));
 /*
     Skips invalid compressed data until a full flush point (see above the
@@ -1095,6 +1112,19 @@ ZEXTERN gzFile ZEXPORT gzdopen  OF((int fd, const char *mode));
    the (de)compression state.
 */
 
+ZEXTERN int ZEXPORT gzbuffer OF((gzFile file, unsigned size));
+/*
+     Sets the size of the buffer used to read from or write to the given
+   compressed file. The default buffer size is 64K bytes (4K bytes on 16-bit
+   systems); larger buffers reduce the number of file system calls for large
+   sequential reads and writes. Sizes below 64 bytes are rounded up. gzbuffer
+   may be called at any time; pending input or output is preserved.
+
+     gzbuffer returns 0 on success, or -1 on failure, such as an invalid file,
+   insufficient memory, a write error while flushing pending output, or a
+   new size that is too small to hold the input already read ahead.
+*/
+
 ZEXTERN int ZEXPORT gzsetparams OF((gzFile file, int level, int strategy));
 /*
      Dynamically update the compression level or strategy. See the description
@@ -1188,9 +1218,9 @@ ZEXTERN z_off_t ZEXPORT    gzseek OF((gzFile file,
    uncompressed data stream. The whence parameter is defined as in lseek(2);
    the value SEEK_END is not supported.
      If the file is opened for reading, this function is emulated but can be
-   extremely slow. If the file is opened for writing, only forward seeks are
-   supported; gzseek then compresses a sequence of zeroes up to the new
-   starting position.
+   extremely slow, unless an index is being built with gzindex. If the file is
+   opened for writing, only forward seeks are supported; gzseek then
+   compresses a sequence of zeroes up to the new starting position.
 
       gzseek returns the resulting offset location as measured in bytes from
    the beginning of the uncompressed stream, or -1 in case of error, in
@@ -1198,6 +1228,26 @@ ZEXTERN z_off_t ZEXPORT    gzseek OF((gzFile file,
    would be before the current position.
 */
 
+ZEXTERN int ZEXPORT    gzindex OF((gzFile file, z_off_t span));
+/*
+     Builds an index of access points for a file opened for reading, so that
+   gzseek does not need to rewind and decompress again from the start of the
+   file. While the file is read (by gzread or by forward gzseek), the inflate
+   state is saved at the first deflate block boundary after every span bytes
+   of uncompressed data, along with the preceding 32K of uncompressed data.
+   gzseek then resumes decompression at the closest saved point at or before
+   the requested offset, so that at most about span bytes must be
+   decompressed for any seek within the part of the file already read. Seeks
+   beyond that part read forward and extend the index on the way. Each access
+   point uses 32K of memory; a span of a few megabytes is a good compromise.
+   The start of every gzip member of a concatenated file is also indexed.
+
+     Spans smaller than 32K are rounded up, and a span of zero discards the
+   index. The trailer check value of a member that is entered through an
+   access point cannot be verified and is skipped. The underlying file must
+   support fseek. gzindex returns 0 on success or -1 on failure.
+*/
+
 ZEXTERN int ZEXPORT    gzrewind OF((gzFile file));
 /*
      Rewinds the given file. This function is supported only for reading.